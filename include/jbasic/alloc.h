@@ -0,0 +1,88 @@
+#ifndef JBASIC_ALLOC_H
+#define JBASIC_ALLOC_H
+
+#include <stddef.h>
+#include <jbasic/defs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+	Allocator used by an environment (env->allocator) for the token pool,
+	the tables, texts, resources and array buffers. It's chosen with
+	jbas_env_init_with_allocator() and stays the same until
+	jbas_env_destroy(), which calls its `destroy`.
+
+	jbas_libc_allocator is the default. A bump arena
+	(jbas_arena_allocator_init()) hands out memory from big chunks and
+	frees nothing until the environment is destroyed - it suits
+	environments that are run once, since the memory of the arrays
+	dropped by jbas_env_reset() isn't reused.
+
+	jbas_region_allocator_init() carves everything out of a single
+	caller-provided buffer without calling malloc() at all (the static
+	profile, see README). Like the arena, it only takes back the most
+	recent block, so the buffer has to be sized for the peak usage.
+
+	An environment is used by one thread at a time, so the allocators
+	don't need to be thread-safe. PARALLEL FOR threads have environments
+	of their own that use the libc allocator.
+*/
+
+typedef struct jbas_allocator
+{
+	//! Returns `size` zeroed bytes (NULL on failure)
+	void *(*alloc)(void *ctx, size_t size);
+
+	//! Resizes a block of `old_size` bytes keeping its contents. The bytes
+	//! past `old_size` are undefined. Returns NULL (and keeps the block) on failure.
+	void *(*realloc)(void *ctx, void *ptr, size_t old_size, size_t size);
+
+	//! Frees a block of `size` bytes
+	void (*free)(void *ctx, void *ptr, size_t size);
+
+	//! Called by jbas_env_destroy() once everything has been freed (may be NULL)
+	void (*destroy)(void *ctx);
+
+	void *ctx;
+} jbas_allocator;
+
+/**
+	State of a region allocator (provided by the host)
+*/
+typedef struct jbas_region
+{
+	unsigned char *buffer;
+	size_t size;
+	size_t used;  //!< Bytes taken from the buffer (including the alignment)
+	size_t peak;  //!< The highest `used` so far
+	size_t last;  //!< Offset of the most recent block (SIZE_MAX if it has been freed)
+} jbas_region;
+
+extern const jbas_allocator jbas_libc_allocator;
+
+jbas_error jbas_arena_allocator_init(jbas_allocator *a, size_t chunk_size);
+void jbas_region_allocator_init(jbas_allocator *a, jbas_region *region, void *buffer, size_t size);
+
+static inline void *jbas_alloc(const jbas_allocator *a, size_t size)
+{
+	return a->alloc(a->ctx, size ? size : 1);
+}
+
+static inline void *jbas_realloc(const jbas_allocator *a, void *ptr, size_t old_size, size_t size)
+{
+	if (!ptr) return jbas_alloc(a, size);
+	return a->realloc(a->ctx, ptr, old_size, size ? size : 1);
+}
+
+static inline void jbas_free(const jbas_allocator *a, void *ptr, size_t size)
+{
+	if (ptr) a->free(a->ctx, ptr, size ? size : 1);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
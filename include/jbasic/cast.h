@@ -14,4 +14,7 @@ jbas_error jbas_token_to_number(jbas_env *env, jbas_token *t);
 jbas_error jbas_token_to_number_type(jbas_env *env, jbas_token *t, jbas_number_type type);
 bool jbas_can_cast_to_number(jbas_token *t);
 
+jbas_error jbas_float_parse(const char *s, jbas_float *f);
+int jbas_float_format(char *buf, size_t size, jbas_float f);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,65 @@
+#ifndef JBASIC_CHECKPOINT_H
+#define JBASIC_CHECKPOINT_H
+
+#include <stdint.h>
+#include <jbasic/defs.h>
+
+/*
+	Checkpoints of a running program. A checkpoint holds the values of
+	all bound variables (numbers and whole arrays) and the instruction the
+	program stopped at. The enclosing blocks are not stored - they are
+	found again in the program, which has to be the same one when the
+	checkpoint is restored (this is checked with a fingerprint of the
+	tokens). C functions are stored by the names bound to them.
+
+	Checkpoints are requested with env->checkpoint_pending (which can be
+	set from a signal handler) and taken by env->checkpoint_handler before
+	the next interpreted instruction. Compiled loops finish first.
+
+	Layout (host byte order):
+		jbas_checkpoint_header
+		for each resource:
+			jbas_checkpoint_resource
+			array elements [size]
+		for each symbol:
+			jbas_checkpoint_symbol
+			char name[name_length]
+*/
+
+#define JBAS_CHECKPOINT_MAGIC "JBCK"
+#define JBAS_CHECKPOINT_VERSION 1
+
+typedef struct jbas_checkpoint_header
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t fingerprint; //!< Hash of the program tokens
+	int32_t position;     //!< Index of the instruction in the program (-1 for the beginning)
+	uint32_t resource_count;
+	uint32_t symbol_count;
+	uint32_t reserved;
+} jbas_checkpoint_header;
+
+typedef struct jbas_checkpoint_resource
+{
+	int32_t type;        //!< jbas_resource_type
+	int32_t number_type; //!< jbas_number_type of numbers
+	union
+	{
+		jbas_int i;
+		jbas_float f;
+	};
+	uint32_t reserved;
+	uint64_t size;       //!< Number of array elements
+} jbas_checkpoint_resource;
+
+typedef struct jbas_checkpoint_symbol
+{
+	uint32_t name_length;
+	int32_t resource;    //!< Resource record index
+} jbas_checkpoint_symbol;
+
+jbas_error jbas_env_checkpoint(jbas_env *env, int fd);
+jbas_error jbas_env_restore(jbas_env *env, int fd, const jbas_cres *cres, int count);
+
+#endif
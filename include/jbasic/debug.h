@@ -13,5 +13,6 @@ void jbas_debug_dump_resource(FILE *f, jbas_resource *res);
 void jbas_debug_dump_symbol(FILE *f, jbas_symbol *sym);
 void jbas_debug_dump_symbol_table(FILE *f, jbas_env *env);
 void jbas_debug_dump_resource_manager(FILE *f, jbas_resource_manager *rm);
+void jbas_debug_print_code(FILE *f, jbas_token *begin, jbas_token *end);
 
 #endif
\ No newline at end of file
@@ -1,6 +1,8 @@
 #ifndef JBASIC_DEFS
 #define JBASIC_DEFS
 
+#include <stdint.h>
+
 typedef enum jbas_error
 {
 	JBAS_OK = 0,
@@ -33,12 +35,73 @@ typedef enum jbas_error
 	JBAS_BAD_COMPARE,
 	JBAS_EVAL_OVERFLOW, // Operator stack overflow
 	JBAS_EVAL_NON_SCALAR, // Attempt to evaluate non-scalar token
+	JBAS_MEMO_MANAGER_OVERFLOW,
+	JBAS_UNSUPPORTED, // Construct not supported by the translator or the JIT compiler
+	JBAS_BAD_IMAGE, // Corrupt or incompatible precompiled image
+	JBAS_IO_ERROR,
+	JBAS_ENV_BUSY, // The environment already holds a different program
+	JBAS_BAD_CHECKPOINT, // Corrupt checkpoint or one taken from a different program
+	JBAS_WOULD_BLOCK, // A C function would block - the run is suspended (see sched.h)
+	JBAS_YIELD, // The run has been suspended on request (env->yield_pending)
+	JBAS_BUDGET_EXHAUSTED, // The run has used up env->budget - it's suspended until the budget is refilled
+	JBAS_MEMORY_LIMIT, // An allocation would exceed env->memory.limit
 } jbas_error;
 
 
 
 typedef int jbas_int;
+
+/*
+	Floats of the static profile (JBAS_STATIC) can be replaced with
+	Q16.16 fixed point numbers (JBAS_FIXED). The JIT, images and jbc
+	assume IEEE floats, so fixed point is limited to that profile.
+	Arithmetic that differs between the two goes through these macros.
+*/
+#ifdef JBAS_FIXED
+#ifndef JBAS_STATIC
+#error "JBAS_FIXED requires JBAS_STATIC"
+#endif
+typedef int32_t jbas_float;
+#define JBAS_FIXED_ONE 65536
+#define JBAS_FIXED_MAX INT32_MAX
+
+/*
+	Results out of the range saturate to +-JBAS_FIXED_MAX (instead of
+	wrapping around) and division by zero gives +-JBAS_FIXED_MAX like
+	it gives +-inf with floats, so fixed point scripts don't trap.
+*/
+static inline jbas_float jbas_fixed_saturate(int64_t v)
+{
+	return v > JBAS_FIXED_MAX ? JBAS_FIXED_MAX : v < -JBAS_FIXED_MAX ? -JBAS_FIXED_MAX : v;
+}
+
+static inline jbas_float jbas_fixed_div(jbas_float a, jbas_float b)
+{
+	if (!b) return a > 0 ? JBAS_FIXED_MAX : a < 0 ? -JBAS_FIXED_MAX : 0;
+	return jbas_fixed_saturate((int64_t) a * JBAS_FIXED_ONE / b);
+}
+
+#define JBAS_FLOAT_FROM_INT(i) jbas_fixed_saturate((int64_t) (i) * JBAS_FIXED_ONE)
+#define JBAS_FLOAT_TO_INT(f) ((jbas_int) ((f) / JBAS_FIXED_ONE))
+#define JBAS_FLOAT_ADD(a, b) jbas_fixed_saturate((int64_t) (a) + (b))
+#define JBAS_FLOAT_SUB(a, b) jbas_fixed_saturate((int64_t) (a) - (b))
+#define JBAS_FLOAT_MUL(a, b) jbas_fixed_saturate((int64_t) (a) * (b) / JBAS_FIXED_ONE)
+#define JBAS_FLOAT_DIV(a, b) jbas_fixed_div(a, b)
+#define JBAS_FLOAT_MOD(a, b) ((b) ? (jbas_float) ((int64_t) (a) % (b)) : 0)
+#else
 typedef float jbas_float;
+#define JBAS_FLOAT_FROM_INT(i) ((jbas_float) (i))
+#define JBAS_FLOAT_TO_INT(f) ((jbas_int) (f))
+#define JBAS_FLOAT_ADD(a, b) ((a) + (b))
+#define JBAS_FLOAT_SUB(a, b) ((a) - (b))
+#define JBAS_FLOAT_MUL(a, b) ((a) * (b))
+#define JBAS_FLOAT_DIV(a, b) ((a) / (b))
+#ifdef JBAS_STATIC
+#define JBAS_FLOAT_MOD(a, b) ((a) - (jbas_float) (int64_t) ((a) / (b)) * (b)) // No libm
+#else
+#define JBAS_FLOAT_MOD(a, b) fmodf(a, b)
+#endif
+#endif
 
 
 // Env forward declaration
@@ -54,6 +117,15 @@ typedef struct jbas_cres
 	};
 } jbas_cres;
 
+/*
+	Layout of jbas_env and of everything it embeds (the token pool and
+	the managers), which C functions of JBASLIB libraries access directly.
+	Libraries export it as `int jbas_abi_version = JBAS_ABI_VERSION;` and
+	the loaders refuse libraries built against a different layout. It has
+	to be bumped whenever one of those structures changes.
+*/
+#define JBAS_ABI_VERSION 4
+
 #ifdef JBAS_ERROR_REASONS
 	#define JBAS_ERROR_REASON(env, s) ((env)->error_reason = (__FILE__ ": " s)); 
 #else
@@ -0,0 +1,53 @@
+#ifndef JBASIC_EXPR_H
+#define JBASIC_EXPR_H
+
+#include <stdint.h>
+#include <jbasic/defs.h>
+#include <jbasic/token.h>
+
+/*
+	Expression trees are a read-only view of token lists. They are built
+	at load time by the optimizer - the evaluation itself is still done by
+	jbas_eval(). Parsing mirrors the way jbas_eval() resolves precedence:
+	prefix and call operators bind tighter than any binary operator.
+*/
+
+typedef enum jbas_expr_type
+{
+	JBAS_EXPR_OPERAND, //!< Symbol, number, string, ...
+	JBAS_EXPR_PAREN,   //!< Parentheses - `a` is the contents (NULL if empty)
+	JBAS_EXPR_UNARY,   //!< Prefix operator - `a` is the operand
+	JBAS_EXPR_BINARY,  //!< Binary operator - `a` and `b` are the operands
+	JBAS_EXPR_CALL,    //!< Call operator - `a` is the callee, `b` the arguments (can be NULL)
+} jbas_expr_type;
+
+typedef struct jbas_expr
+{
+	jbas_expr_type type;
+	jbas_token *token;        //!< Operand, operator or parentheses token
+	const jbas_operator *op;  //!< Operator (with fallback resolved)
+	jbas_token *begin, *end;  //!< First and last token of the expression
+	jbas_token **list;        //!< Handle of the list containing the expression
+	struct jbas_expr *a, *b;
+	struct jbas_expr *parent;
+} jbas_expr;
+
+#define JBAS_EXPR_MAX_NODES 256
+
+typedef struct jbas_expr_tree
+{
+	jbas_expr nodes[JBAS_EXPR_MAX_NODES];
+	int node_count;
+	jbas_expr *root;
+} jbas_expr_tree;
+
+jbas_error jbas_expr_parse(jbas_expr_tree *tree, jbas_token *begin, jbas_token *end, jbas_token **list);
+bool jbas_expr_is_assign(const jbas_expr *e);
+bool jbas_expr_is_tuple(const jbas_expr *e);
+const jbas_expr *jbas_expr_strip(const jbas_expr *e);
+unsigned int jbas_expr_hash(const jbas_expr *e);
+bool jbas_expr_equal(const jbas_expr *e1, const jbas_expr *e2);
+int jbas_expr_size(const jbas_expr *e);
+bool jbas_expr_eval_int(const jbas_expr *e, const jbas_symbol *var, int64_t value, int64_t *result);
+
+#endif
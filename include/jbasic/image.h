@@ -0,0 +1,71 @@
+#ifndef JBASIC_IMAGE_H
+#define JBASIC_IMAGE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <jbasic/defs.h>
+
+/*
+	Precompiled program images. An image holds the tokenized (and already
+	optimized and type-inferred) program together with the texts and
+	symbols it references. All pointers are stored as indices into the
+	image tables, so loading it is just a matter of mapping the file and
+	relinking the tokens - nothing has to be parsed.
+
+	Layout (host byte order, all records are 4-byte aligned):
+		jbas_image_header
+		jbas_image_text   [text_count]
+		jbas_image_symbol [symbol_count]
+		int32_t           [memo_count]   (memo kinds)
+		jbas_image_token  [token_count]
+		char              [blob_size]    (text contents)
+*/
+
+#define JBAS_IMAGE_MAGIC "JBX\x1a"
+#define JBAS_IMAGE_VERSION 3
+
+typedef struct jbas_image_header
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t text_count;
+	uint32_t symbol_count;
+	uint32_t memo_count;
+	uint32_t token_count;
+	uint32_t blob_size;
+	int32_t root; //!< First token of the program
+} jbas_image_header;
+
+typedef struct jbas_image_text
+{
+	uint32_t offset; //!< Offset in the blob
+	uint32_t length;
+} jbas_image_text;
+
+typedef struct jbas_image_symbol
+{
+	int32_t name; //!< Text index
+	int32_t type; //!< jbas_symbol_type
+} jbas_image_symbol;
+
+typedef struct jbas_image_token
+{
+	int32_t type;
+	int32_t r;     //!< Next token in the list (-1 at the end)
+	int32_t index; //!< Operator, keyword, symbol or text index, or the first token of the sublist
+	int32_t extra; //!< Memo index of parentheses or number type
+	int32_t line;  //!< Source line
+	union
+	{
+		jbas_int i;
+		jbas_float f;
+	};
+} jbas_image_token;
+
+jbas_error jbas_image_write(jbas_env *env, FILE *f);
+jbas_error jbas_image_load(jbas_env *env, const char *path);
+jbas_error jbas_image_load_memory(jbas_env *env, const void *data, size_t size);
+bool jbas_image_probe(const char *path);
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef JBASIC_INFER_H
+#define JBASIC_INFER_H
+
+#include <jbasic/defs.h>
+#include <jbasic/symbol.h>
+#include <jbasic/expr.h>
+
+/*
+	Load-time type inference. Every assignment in the program is visited
+	until the types stop changing - the result holds regardless of the
+	order the instructions are executed in. Symbols that are always bound
+	to values of the same type can be kept untagged by the engines that
+	care about that. Everything else is JBAS_TYPE_POLY.
+*/
+
+jbas_error jbas_infer_types(jbas_env *env);
+jbas_symbol_type jbas_infer_expr_type(const jbas_expr *e);
+const char *jbas_symbol_type_str(jbas_symbol_type type);
+
+#endif
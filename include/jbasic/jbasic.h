@@ -12,6 +12,7 @@ extern "C" {
 #include <stdlib.h>
 #include <stdbool.h>
 #include <math.h>
+#include <signal.h>
 
 #include <jbasic/defs.h>
 #include <jbasic/token.h>
@@ -20,10 +21,22 @@ extern "C" {
 #include <jbasic/resource.h>
 #include <jbasic/symbol.h>
 #include <jbasic/kw.h>
+#include <jbasic/memo.h>
+#include <jbasic/program.h>
+#include <jbasic/memory.h>
+#include <jbasic/alloc.h>
 
 
+#define JBAS_MAX_FDS 64 //!< Descriptors a program can have open at once
+#define JBAS_MAX_CALL_RESULTS 16 //!< C function results kept for an instruction that would block
+
 /**
 	Environment for BASIC program execution
+
+	Environments don't share any mutable state - the only data used by all
+	of them are the constant operator and keyword tables. Different
+	environments can be used by different threads at the same time,
+	but a single environment must not be used by more threads at once.
 */
 typedef struct jbas_env
 {
@@ -31,11 +44,103 @@ typedef struct jbas_env
 	jbas_text_manager text_manager;
 	jbas_resource_manager resource_manager;
 	jbas_symbol_manager symbol_manager;
+	jbas_memo_manager memo_manager;
 	jbas_token *tokens; //!< Tokenized program
 
 	const char *error_reason; //!< Reason for returning an error
+	int jit_threshold; //!< Loop iterations before the loop is compiled (0 disables the JIT)
+
+	FILE *input;  //!< Program input (stdin by default)
+	FILE *output; //!< Program output (stdout by default)
+
+	const jbas_program *program; //!< Compiled program linked by jbas_exec()
+
+	volatile sig_atomic_t checkpoint_pending; //!< Set (e.g. by a signal handler) to request a checkpoint
+	jbas_error (*checkpoint_handler)(jbas_env *env); //!< Called before the next instruction once requested
+	jbas_token *position; //!< Instruction being checkpointed, or the one jbas_run() resumes from
+
+	int thread_count;      //!< Threads running PARALLEL FOR (0 = one per CPU, 1 = the calling thread only)
+	struct jbas_pool *pool; //!< Created by the first PARALLEL FOR
+
+	volatile sig_atomic_t yield_pending; //!< Set to suspend the run before the next instruction
+	struct jbas_task *task; //!< Scheduler task running the environment (see sched.h)
+
+	//! Instructions and loop iterations left before the run is suspended
+	//! with JBAS_BUDGET_EXHAUSTED (-1 = no limit)
+	int64_t budget;
+
+	jbas_memory memory; //!< Bytes used by the environment and its limit (see memory.h)
+	jbas_allocator allocator; //!< Allocator of all the memory above (see alloc.h)
+	struct jbas_profile *profile; //!< Collects the time spent on every line when set (see profile.h)
+	jbas_token *volatile current; //!< Instruction being run (read by the sampling profiler)
+
+	// Counters kept by the interpreter (see jbas_env_get_stats())
+	uint64_t statement_count; //!< Instructions run
+	uint64_t cfun_calls;      //!< C function calls
+	uint64_t array_bytes;     //!< Bytes allocated for the arrays by IDIM and FDIM
+
+	int line; //!< Source line jbas_tokenize_string() continues at (1 at first)
+
+	// Descriptors opened by the program's C functions (see jbas_env_add_fd())
+	int fds[JBAS_MAX_FDS];
+	int fd_count;
+	int fd_shared; //!< The first fd_shared descriptors belong to the environment running the PARALLEL FOR loop
+
+	// Blocks the run is inside of, kept when it's suspended (see jbas_frame)
+	jbas_frame *frames;
+	int frame_count;
+	int frame_size;
+	bool suspended; //!< The last jbas_run() has been suspended at env->position
+
+	// Results of the C functions already called by the instruction that
+	// would block. When it's run again, the calls return them instead of
+	// being made twice (see jbas_eval_instruction()).
+	jbas_number_token call_results[JBAS_MAX_CALL_RESULTS];
+	int call_result_count;
+	int call_result_next;   //!< Result the next call returns
+	bool call_results_lost; //!< A call couldn't be kept (too many or not a number)
+	jbas_token *call_results_at; //!< Instruction the results belong to
 } jbas_env;
 
+/**
+	Bytes held by the parts of an environment (see jbas_env_footprint())
+*/
+typedef struct jbas_footprint
+{
+	size_t tokens;    //!< Token pool
+	size_t texts;     //!< Text table and the strings
+	size_t symbols;   //!< Symbol table
+	size_t resources; //!< Resource table and the resources
+	size_t arrays;    //!< Array buffers
+	size_t memos;     //!< Memo table
+	size_t total;
+} jbas_footprint;
+
+/**
+	Counters of an environment (see jbas_env_get_stats()). They count from
+	jbas_env_init() or jbas_env_reset_stats() on, jbas_env_reset() leaves
+	them alone. The `_used` values are the current state.
+*/
+typedef struct jbas_env_stats
+{
+	uint64_t statements;        //!< Instructions run by the interpreter (a compiled loop is one)
+	uint64_t cfun_calls;        //!< C function calls
+	uint64_t tokens_taken;      //!< Tokens taken from the token pool
+	uint64_t tokens_returned;   //!< Tokens returned to the token pool
+	int tokens_used;            //!< Tokens in use (the program included)
+	int tokens_peak;            //!< The most tokens in use at once
+	uint64_t resources_created;
+	uint64_t resources_deleted;
+	int resources_used;
+	int resources_peak;         //!< The most resources at once
+	uint64_t gc_runs;           //!< Garbage collections
+	uint64_t gc_collected;      //!< Resources deleted by the garbage collections
+	uint64_t array_bytes;       //!< Bytes allocated for the arrays by IDIM and FDIM
+	int texts_used;
+	int symbols_used;
+	int memos_used;
+} jbas_env_stats;
+
 
 bool jbas_is_name_char(char c);
 int jbas_namecmp(const char *s1, const char *end1, const char *s2, const char *end2);
@@ -45,12 +150,22 @@ int jbas_printf(jbas_env *env, const char *format, ...);
 jbas_error jbas_eval(jbas_env *env, jbas_token *begin, jbas_token **result);
 jbas_error jbas_eval_instruction(jbas_env *env, jbas_token *begin, jbas_token **next, jbas_token **result);
 jbas_error jbas_run_step(jbas_env *env, jbas_token *begin, jbas_token **next);
+jbas_error jbas_charge_budget(jbas_env *env, jbas_token *at);
 jbas_error jbas_run_block(jbas_env *env, jbas_token *begin, jbas_token *end, jbas_token **next);
 jbas_error jbas_run(jbas_env *env);
 jbas_error jbas_get_token(jbas_env *env, const char *const str, const char **next, jbas_token ***lists, int *level);
 jbas_error jbas_tokenize_string(jbas_env *env, const char *str);
-jbas_error jbas_env_init(jbas_env *env, int token_count, int text_count, int symbol_count, int resource_count);
+jbas_error jbas_env_init(jbas_env *env, int token_count, int text_count, int symbol_count, int resource_count, int memo_count);
+jbas_error jbas_env_init_with_allocator(jbas_env *env, const jbas_allocator *allocator,
+	int token_count, int text_count, int symbol_count, int resource_count, int memo_count);
 void jbas_env_destroy(jbas_env *env);
+void jbas_env_reset(jbas_env *env);
+void jbas_env_footprint(const jbas_env *env, jbas_footprint *fp);
+void jbas_env_get_stats(const jbas_env *env, jbas_env_stats *stats);
+void jbas_env_reset_stats(jbas_env *env);
+jbas_error jbas_env_add_fd(jbas_env *env, int fd);
+bool jbas_env_owns_fd(const jbas_env *env, int fd);
+int jbas_env_close_fd(jbas_env *env, int fd);
 
 #define JBAS_MAX_EVAL_OPERATORS 64
 #define JBAS_TOKENIZE_PAREN_LEVELS 256
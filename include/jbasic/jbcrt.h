@@ -0,0 +1,140 @@
+#ifndef JBASIC_JBCRT_H
+#define JBASIC_JBCRT_H
+
+#include <jbasic/jbasic.h>
+
+/*
+	Runtime for programs translated to C by jbc. Values of symbols whose
+	type could be inferred are kept in plain C variables. Everything else
+	is a tagged jbc_value. The semantics (promotions, errors, printing)
+	are the same as in the interpreter.
+*/
+
+#define JBC_UNSET (-1) //!< jbc_value type of a symbol that has not been bound yet
+
+typedef struct jbc_value
+{
+	int type; //!< jbas_number_type or JBC_UNSET
+	union
+	{
+		jbas_int i;
+		jbas_float f;
+	};
+} jbc_value;
+
+typedef struct jbc_array
+{
+	void *ptr;
+	size_t size;
+} jbc_array;
+
+/**
+	Argument of a C function - a number, an array or a string constant
+*/
+typedef enum jbc_arg_type
+{
+	JBC_ARG_NUMBER,
+	JBC_ARG_INT_ARRAY,
+	JBC_ARG_FLOAT_ARRAY,
+	JBC_ARG_STRING,
+} jbc_arg_type;
+
+typedef struct jbc_arg
+{
+	jbc_arg_type type;
+	union
+	{
+		jbc_value value;
+		jbc_array *array;
+		const char *str;
+	};
+} jbc_arg;
+
+/**
+	C function imported from JBASLIB - resolved on the first call
+*/
+typedef struct jbc_cfun
+{
+	const char *name;
+	jbas_error (*cfun)(jbas_env *env, jbas_token *arg, jbas_token *res);
+} jbc_cfun;
+
+typedef enum jbc_math_op
+{
+	JBC_ADD,
+	JBC_SUB,
+	JBC_MUL,
+	JBC_DIV,
+	JBC_REM,
+	JBC_MOD,
+} jbc_math_op;
+
+typedef enum jbc_cmp_op
+{
+	JBC_EQ,
+	JBC_NEQ,
+	JBC_LESS,
+	JBC_GREATER,
+	JBC_LEQ,
+	JBC_GEQ,
+} jbc_cmp_op;
+
+void jbc_init(void);
+void jbc_exit(void);
+_Noreturn void jbc_fail(jbas_error err, const char *reason);
+jbc_value jbc_fail_value(jbas_error err, const char *reason);
+
+jbc_value jbc_get(const jbc_value *v);
+jbc_value jbc_cast(jbc_value v, jbas_number_type type);
+jbc_value jbc_math(jbc_math_op op, jbc_value a, jbc_value b);
+jbas_int jbc_cmp(jbc_cmp_op op, jbc_value a, jbc_value b);
+jbc_value jbc_neg(jbc_value v);
+
+void jbc_print_value(jbc_value v);
+void jbc_print_symbol(const jbc_value *v);
+void jbc_print_string(const char *s);
+
+void jbc_idim(jbc_array *a, jbas_int size);
+void jbc_fdim(jbc_array *a, jbas_int size);
+jbc_value jbc_call(jbc_cfun *f, int argc, const jbc_arg *argv);
+
+static inline jbc_value jbc_bool(jbas_int i) { return (jbc_value){.type = JBAS_NUM_BOOL, .i = i}; }
+static inline jbc_value jbc_int(jbas_int i) { return (jbc_value){.type = JBAS_NUM_INT, .i = i}; }
+static inline jbc_value jbc_float(jbas_float f) { return (jbc_value){.type = JBAS_NUM_FLOAT, .f = f}; }
+
+static inline jbc_arg jbc_arg_value(jbc_value v) { return (jbc_arg){.type = JBC_ARG_NUMBER, .value = v}; }
+static inline jbc_arg jbc_arg_iarray(jbc_array *a) { return (jbc_arg){.type = JBC_ARG_INT_ARRAY, .array = a}; }
+static inline jbc_arg jbc_arg_farray(jbc_array *a) { return (jbc_arg){.type = JBC_ARG_FLOAT_ARRAY, .array = a}; }
+static inline jbc_arg jbc_arg_string(const char *s) { return (jbc_arg){.type = JBC_ARG_STRING, .str = s}; }
+
+static inline jbas_int jbc_to_int(jbc_value v) { return jbc_cast(v, JBAS_NUM_INT).i; }
+static inline jbas_int jbc_to_bool(jbc_value v) { return jbc_cast(v, JBAS_NUM_BOOL).i; }
+static inline jbas_float jbc_to_float(jbc_value v) { return jbc_cast(v, JBAS_NUM_FLOAT).f; }
+
+static inline jbas_int jbc_mod(jbas_int a, jbas_int b)
+{
+	return (a % b + b) % b;
+}
+
+/**
+	Bounds checked array element access
+*/
+static inline void jbc_check_index(const jbc_array *a, jbas_int n)
+{
+	if (n < 0) jbc_fail(JBAS_BAD_INDEX, "src/op.c: invalid array index (negative)");
+	if ((size_t) n >= a->size) jbc_fail(JBAS_BAD_INDEX, "src/op.c: invalid array index (out of bounds)");
+}
+
+static inline jbas_int *jbc_iref(jbc_array *a, jbas_int n)
+{
+	jbc_check_index(a, n);
+	return (jbas_int*) a->ptr + n;
+}
+
+static inline jbas_float *jbc_fref(jbc_array *a, jbas_int n)
+{
+	jbc_check_index(a, n);
+	return (jbas_float*) a->ptr + n;
+}
+
+#endif
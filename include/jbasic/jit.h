@@ -0,0 +1,50 @@
+#ifndef JBASIC_JIT_H
+#define JBASIC_JIT_H
+
+#include <stdint.h>
+#include <jbasic/defs.h>
+#include <jbasic/token.h>
+#include <jbasic/symbol.h>
+
+/*
+	JIT compiler for hot WHILE loops (x86-64 only). A loop is compiled once
+	it has run jit_threshold times, provided that it only works with numeric
+	scalars, IDIM and FDIM arrays, arithmetic and comparisons. FLOAT values
+	are computed with SSE in single precision, just like jbas_float. Everything
+	else stays interpreted - that includes % and MOD of FLOAT values, FLOAT
+	conditions and symbols that hold both integers and FLOAT values (the
+	compiled code needs to know which of them it reads).
+
+	The compiled code works on a copy of the symbol values (a frame) which
+	is written back when it returns. The types of the values are checked
+	on each entry and failed array index checks hand the rest of the loop
+	back to the interpreter, starting with the offending instruction.
+*/
+
+#define JBAS_JIT_DEFAULT_THRESHOLD 16
+
+/**
+	JIT state of a WHILE loop (kept in the keyword token)
+*/
+typedef struct jbas_jit_loop
+{
+	int count;    //!< Number of interpreted iterations
+	bool failed;  //!< The loop cannot be compiled
+
+	void *code;
+	size_t code_size;
+
+	jbas_symbol **symbols; //!< Symbols referenced by the code
+	int *slots;            //!< Frame slots of the symbols (arrays take two)
+	int symbol_count;
+	int64_t *frame;
+	int slot_count;
+
+	jbas_token **deopt;    //!< Instructions the interpreter resumes from
+	int deopt_count;
+} jbas_jit_loop;
+
+jbas_error jbas_jit_run(jbas_env *env, jbas_token *loop, bool *done);
+void jbas_jit_loop_destroy(jbas_jit_loop *loop);
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <jbasic/defs.h>
 #include <jbasic/token.h>
+#include <stdbool.h>
 
 typedef enum jbas_keyword_id
 {
@@ -11,21 +12,33 @@ typedef enum jbas_keyword_id
 
 	JBAS_KW_IF,
 	JBAS_KW_ELSE,
-	JBAS_KW_THEN = JBAS_KW_NOP,
-	JBAS_KW_ENDIF = JBAS_KW_END,
 
 	JBAS_KW_WHILE,
-	JBAS_KW_DO = JBAS_KW_NOP,
-	JBAS_KW_ENDWHILE = JBAS_KW_END,
 
 	JBAS_KW_IDIM,
 	JBAS_KW_FDIM,
 
-	// JBAS_KW_FOR,
-	// JBAS_KW_
-	// JBAS_KW_ENDFOR = JBAS_KW_END,
-
 	JBAS_KW_PRINT,
+
+	JBAS_KW_SELECT,
+	JBAS_KW_CASE,
+	JBAS_KW_TO,
+
+	JBAS_KW_PARALLEL,
+	JBAS_KW_FOR,
+	JBAS_KW_REDUCE,
+
+	// Hidden keywords inserted by the optimizer
+	JBAS_KW_INVALIDATE,
+	JBAS_KW_STEP,
+	JBAS_KW_CHECK,
+
+	// Aliases - these have to come last, so they don't shift the values above
+	JBAS_KW_THEN = JBAS_KW_NOP,
+	JBAS_KW_ENDIF = JBAS_KW_END,
+	JBAS_KW_DO = JBAS_KW_NOP,
+	JBAS_KW_ENDWHILE = JBAS_KW_END,
+	// JBAS_KW_ENDFOR = JBAS_KW_END,
 } jbas_keyword_id;
 
 typedef struct jbas_keyword
@@ -39,7 +52,20 @@ typedef struct jbas_keyword
 
 extern const jbas_keyword jbas_keywords[];
 
-#define JBAS_KEYWORD_COUNT 7
+#define JBAS_KEYWORD_COUNT 16
+
+/**
+	Block being run. The IF, WHILE, SELECT and PARALLEL keywords push
+	one on env->frames while they run a branch (the loop body, a clause)
+	and a suspended run leaves them there, so jbas_run() continues it
+	without looking for the blocks in the program (see jbas_resume()).
+*/
+typedef struct jbas_frame
+{
+	jbas_token *kw;   //!< Keyword opening the block
+	jbas_token *stop; //!< Where the branch being run ends (NULL if not known yet)
+	jbas_token *end;  //!< END of the block (NULL if not known yet)
+} jbas_frame;
 
 const jbas_keyword *jbas_get_keyword_by_str(const char *b, const char *e);
 
@@ -48,5 +74,10 @@ jbas_error jbas_get_block_end(jbas_env *env, jbas_token *begin, jbas_token **mat
 
 
 jbas_error jbas_eval_keyword(jbas_env *env, jbas_token *token, jbas_token **next);
+bool jbas_is_suspension(jbas_error err);
+jbas_error jbas_frame_push(jbas_env *env, jbas_token *kw, jbas_token *stop, jbas_token *end);
+jbas_error jbas_resume(jbas_env *env, jbas_token *begin, jbas_token *at, jbas_token **next);
+jbas_error jbas_resume_suspended(jbas_env *env, jbas_token *at, jbas_token **next);
+void jbas_keyword_token_destroy(jbas_env *env, jbas_token *t);
 
 #endif
\ No newline at end of file
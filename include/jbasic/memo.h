@@ -0,0 +1,40 @@
+#ifndef JBASIC_MEMO_H
+#define JBASIC_MEMO_H
+
+#include <jbasic/defs.h>
+#include <jbasic/token.h>
+
+/*
+	Memos are hidden temporaries created by the load-time optimizer.
+	A parenthesis token can have a memo attached - once the parentheses
+	are evaluated, the result is stored in the memo and reused until
+	the memo is invalidated.
+*/
+typedef enum jbas_memo_kind
+{
+	JBAS_MEMO_VALUE,  //!< Cached value of the parentheses
+	JBAS_MEMO_BOUNDS, //!< Array index in the (call) parentheses is known to be in range
+} jbas_memo_kind;
+
+typedef struct jbas_memo
+{
+	jbas_memo_kind kind;
+	jbas_number_token value; //!< The value or array size the index has been checked against
+	bool valid;
+} jbas_memo;
+
+typedef struct jbas_memo_manager
+{
+	jbas_memo *memo_storage;
+	int memo_count;
+	int max_count;
+	const jbas_allocator *allocator;
+} jbas_memo_manager;
+
+jbas_error jbas_memo_manager_init(jbas_memo_manager *mm, int max_count, const jbas_allocator *allocator);
+void jbas_memo_manager_destroy(jbas_memo_manager *mm);
+jbas_error jbas_memo_create(jbas_memo_manager *mm, jbas_memo **memo);
+int jbas_memo_id(jbas_memo_manager *mm, jbas_memo *memo);
+void jbas_memo_invalidate_all(jbas_memo_manager *mm);
+
+#endif
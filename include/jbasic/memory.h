@@ -0,0 +1,46 @@
+#ifndef JBASIC_MEMORY_H
+#define JBASIC_MEMORY_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <jbasic/defs.h>
+
+/*
+	Memory accounting of an environment (env->memory). Resources, texts
+	and array buffers are charged when they're allocated and released
+	when they're freed. The token pool and the other tables have a fixed
+	size and are charged when the environment is initialized. Allocations
+	that would exceed the limit fail with JBAS_MEMORY_LIMIT.
+*/
+
+typedef struct jbas_memory
+{
+	size_t used;  //!< Bytes in use
+	size_t peak;  //!< The highest `used` so far
+	size_t limit; //!< Hard limit in bytes (0 = no limit)
+} jbas_memory;
+
+/**
+	Checks whether `bytes` more would fit into the limit
+*/
+static inline bool jbas_memory_fits(const jbas_memory *m, size_t bytes)
+{
+	return !m || !m->limit || (m->used <= m->limit && bytes <= m->limit - m->used);
+}
+
+static inline jbas_error jbas_memory_charge(jbas_memory *m, size_t bytes)
+{
+	if (!jbas_memory_fits(m, bytes)) return JBAS_MEMORY_LIMIT;
+	if (!m) return JBAS_OK;
+
+	m->used += bytes;
+	if (m->used > m->peak) m->peak = m->used;
+	return JBAS_OK;
+}
+
+static inline void jbas_memory_release(jbas_memory *m, size_t bytes)
+{
+	if (m) m->used -= bytes < m->used ? bytes : m->used;
+}
+
+#endif
@@ -22,6 +22,7 @@ typedef struct jbas_operator
 	jbas_error (*handler)(jbas_env *env, jbas_token *a, jbas_token *b, jbas_token *res);
 	const jbas_operator *fallback;
 	bool eval_args;
+	bool pure; //!< No side effects, always results in a number
 } jbas_operator;
 
 typedef struct jbas_operator_sort_bucket
@@ -0,0 +1,27 @@
+#ifndef JBASIC_OPT_H
+#define JBASIC_OPT_H
+
+#include <stdio.h>
+#include <jbasic/defs.h>
+#include <jbasic/token.h>
+
+/*
+	Load-time optimizer. It rewrites the tokenized program in place.
+	Hoisted values are stored in memos attached to parentheses, so the
+	evaluation order (and thus the errors) is exactly the same as
+	in the original program - the value is only computed on first use.
+*/
+
+typedef enum jbas_opt_flags
+{
+	JBAS_OPT_LICM = 1 << 0, //!< Loop-invariant expression hoisting
+	JBAS_OPT_IND  = 1 << 1, //!< Strength reduction of `i * c` induction expressions
+	JBAS_OPT_CSE  = 1 << 2, //!< Common subexpression elimination in straight-line code
+	JBAS_OPT_BOUNDS = 1 << 3, //!< Array bounds checks moved in front of loops
+
+	JBAS_OPT_ALL = JBAS_OPT_LICM | JBAS_OPT_IND | JBAS_OPT_CSE | JBAS_OPT_BOUNDS,
+} jbas_opt_flags;
+
+jbas_error jbas_optimize(jbas_env *env, int flags, FILE *report);
+
+#endif
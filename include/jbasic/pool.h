@@ -0,0 +1,60 @@
+#ifndef JBASIC_POOL_H
+#define JBASIC_POOL_H
+
+#include <stdint.h>
+#include <jbasic/defs.h>
+#include <jbasic/token.h>
+#include <jbasic/symbol.h>
+
+/*
+	PARALLEL FOR loops and the thread pool running them.
+
+		PARALLEL FOR i = a TO b [REDUCE + s]...
+			...
+		END
+
+	The iterations a..b (inclusive) are split between the threads of
+	a pool owned by the environment (env->thread_count, one per CPU by
+	default). Every thread runs the body in its own environment with
+	a copy of the program, so the temporaries, memos and token scratch
+	space are private. Threads that run out of iterations steal half
+	of the remaining range of another thread.
+
+	On entry, every thread gets a private copy of the scalar variables.
+	Arrays are shared - concurrent writes to the same element are not
+	ordered and the last writer wins. Changes of scalars are discarded
+	when the loop ends, apart from the REDUCE + variables, which start
+	at zero in every thread and whose sums are added to the variable.
+	The loop variable ends up at b + 1. Arrays cannot be (re)dimensioned
+	in the body.
+
+	With env->thread_count == 1 (and in nested loops, which run in the
+	thread of the enclosing loop), the iterations run one by one in the
+	environment itself like an ordinary counted loop - the scalars are
+	not private then. The pool threads don't take checkpoints, they are
+	taken once the loop has finished.
+*/
+
+/**
+	Parsed PARALLEL FOR header (kept in the keyword token)
+*/
+typedef struct jbas_parallel
+{
+	jbas_symbol *var;
+	jbas_token *from, *from_end; //!< Bounds expressions - [from, from_end)
+	jbas_token *to, *to_end;
+	jbas_symbol **reduce;        //!< REDUCE + variables
+	int reduce_count;
+	jbas_token *body, *end;      //!< The body and the token following its END
+	int32_t position;            //!< Index of the keyword in the program
+} jbas_parallel;
+
+typedef struct jbas_pool jbas_pool;
+
+jbas_error jbas_parallel_parse(jbas_env *env, jbas_token *kw, jbas_parallel **par);
+void jbas_parallel_destroy(jbas_env *env, jbas_parallel *par);
+
+jbas_error jbas_pool_run(jbas_env *env, jbas_parallel *par, int64_t from, int64_t to);
+void jbas_pool_destroy(jbas_pool *pool);
+
+#endif
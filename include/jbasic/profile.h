@@ -0,0 +1,92 @@
+#ifndef JBASIC_PROFILE_H
+#define JBASIC_PROFILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <signal.h>
+#include <jbasic/defs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+	Per-line profile of a run. While env->profile is set, jbas_run_step()
+	measures every instruction it runs and charges it to the source line
+	of the instruction's first token (jbas_token.line). The `total` time
+	includes the instructions run in the blocks of the instruction (the
+	body of a WHILE loop, for example), `self` doesn't. Tokens taken from
+	the token pool, resources created and garbage collections are charged
+	to the innermost instruction only.
+
+	Instructions inserted by the optimizer are charged to the line of the
+	loop or the instruction they have been inserted for. Compiled loops and
+	PARALLEL FOR loops are measured as a whole.
+
+	The sampler is much cheaper - the only thing the interpreter does is
+	keeping the instruction it runs in env->current. SIGPROF (setitimer()
+	with ITIMER_PROF) counts how often every instruction is found there
+	and jbas_sampler_write() adds the blocks around the instructions
+	(WHILE, IF, SELECT, PARALLEL FOR) and writes the stacks in the collapsed
+	format of flame graph tools (`frame;frame;frame count` lines). There
+	can only be one sampler running in a process.
+*/
+
+#define JBAS_SAMPLER_MAX_DEPTH 256 //!< Blocks written into a stack at most
+
+typedef struct jbas_profile_line
+{
+	uint64_t count;     //!< Instructions run
+	uint64_t total_ns;  //!< Wall time including the nested instructions
+	uint64_t self_ns;   //!< Wall time without the nested instructions
+	uint64_t tokens;    //!< Tokens taken from the token pool
+	uint64_t resources; //!< Resources created
+	uint64_t gc_runs;   //!< Garbage collections
+} jbas_profile_line;
+
+/**
+	Instruction being run
+*/
+typedef struct jbas_profile_frame
+{
+	int line;
+	jbas_profile_line start; //!< Clock and counters when the instruction started
+	jbas_profile_line child; //!< Used by the nested instructions
+} jbas_profile_frame;
+
+typedef struct jbas_profile
+{
+	jbas_profile_line *lines; //!< Indexed by the line number (0 = unknown line)
+	int line_count;
+	jbas_profile_frame *stack;
+	int depth;
+	int stack_size;
+} jbas_profile;
+
+/**
+	Sampling profiler of an environment
+*/
+typedef struct jbas_sampler
+{
+	jbas_env *env;
+	uint32_t *counts;           //!< Samples of every token of the token pool
+	volatile uint64_t samples;  //!< All samples (including those taken outside of instructions)
+	struct sigaction old_action;
+} jbas_sampler;
+
+void jbas_profile_init(jbas_profile *p);
+void jbas_profile_destroy(jbas_profile *p);
+jbas_error jbas_profile_enter(jbas_profile *p, jbas_env *env, int line);
+void jbas_profile_leave(jbas_profile *p, jbas_env *env);
+void jbas_profile_report(const jbas_profile *p, FILE *f, const char *source);
+
+jbas_error jbas_sampler_start(jbas_sampler *s, jbas_env *env, int interval_us);
+void jbas_sampler_stop(jbas_sampler *s);
+jbas_error jbas_sampler_write(const jbas_sampler *s, FILE *f, const char *source);
+void jbas_sampler_destroy(jbas_sampler *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
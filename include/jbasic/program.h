@@ -0,0 +1,29 @@
+#ifndef JBASIC_PROGRAM_H
+#define JBASIC_PROGRAM_H
+
+#include <jbasic/defs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+	Compile-once, run-many API. jbas_compile() runs the tokenizer, the
+	optimizer and the type inference and keeps the result as an in-memory
+	image (see image.h). The program is immutable, so it can be shared by
+	any number of environments (and threads). jbas_exec() links it into
+	an environment - which only takes a pass over the image - and runs it.
+*/
+
+typedef struct jbas_program jbas_program;
+
+jbas_error jbas_compile(jbas_env *env, const char *source, int opt_flags, jbas_program **program);
+jbas_error jbas_link(jbas_env *env, const jbas_program *program);
+jbas_error jbas_exec(jbas_env *env, const jbas_program *program);
+void jbas_program_destroy(jbas_program *program);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
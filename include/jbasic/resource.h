@@ -3,6 +3,8 @@
 
 #include <jbasic/defs.h>
 #include <jbasic/token.h>
+#include <jbasic/memory.h>
+#include <jbasic/alloc.h>
 
 /*
 	Resources are created dynamically during the program execution.
@@ -37,7 +39,7 @@ typedef struct jbas_resource
 		jbas_number_token number;
 		jbas_error (*cfun)(jbas_env *env, jbas_token *arg, jbas_token *res);
 		int *iptr;
-		float *fptr;
+		jbas_float *fptr;
 		char *str;
 		void *data;
 	};
@@ -49,10 +51,20 @@ typedef struct jbas_resource_manager
 	jbas_resource **refs;
 	int ref_count;
 	int max_count;
+#ifdef JBAS_STATIC
+	jbas_resource *storage; //!< All resources (the static profile allocates them up front)
+#endif
+	int peak_count;      //!< Highest ref_count since the statistics were reset
+	uint64_t created;    //!< Resources created so far
+	uint64_t deleted;    //!< Resources deleted so far
+	uint64_t gc_runs;    //!< Garbage collections so far
+	uint64_t collected;  //!< Resources deleted by the garbage collections
+	jbas_memory *memory; //!< Accounting of the resources and the arrays (may be NULL)
+	const jbas_allocator *allocator; //!< Allocates the resources and the arrays
 } jbas_resource_manager;
 
 
-jbas_error jbas_resource_manager_init(jbas_resource_manager *rm, int max_count);
+jbas_error jbas_resource_manager_init(jbas_resource_manager *rm, int max_count, const jbas_allocator *allocator);
 jbas_error jbas_resource_manager_garbage_collect(jbas_resource_manager *rm, int *collected);
 void jbas_resource_delete(jbas_resource_manager *rm, jbas_resource *res);
 jbas_error jbas_resource_remove_ref(jbas_resource *res);
@@ -60,5 +72,7 @@ jbas_error jbas_resource_add_ref(jbas_resource *res);
 jbas_error jbas_resource_create(jbas_resource_manager *rm, jbas_resource **res);
 void jbas_resource_copy(jbas_resource *dest, jbas_resource *src);
 void jbas_resource_manager_destroy(jbas_resource_manager *rm);
+void jbas_resource_manager_reset(jbas_resource_manager *rm);
+size_t jbas_resource_array_bytes(const jbas_resource *res);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,99 @@
+#ifndef JBASIC_SCHED_H
+#define JBASIC_SCHED_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <jbasic/defs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+	Cooperative scheduler running many environments on one thread.
+
+	A run is suspended between two instructions when env->yield_pending
+	is set (jbas_run() returns JBAS_YIELD), or when a C function returns
+	JBAS_WOULD_BLOCK (e.g. GETCHAR on a non-blocking input without data).
+	The instruction the run stopped at is kept in env->position and the
+	blocks around it on env->frames (see jbas_frame), so nothing is left
+	on the C stack in between and the next jbas_run() continues from
+	there in time proportional to the nesting depth.
+	An instruction that would block is run again from its beginning. The
+	C functions it has already called return the same results again
+	instead of being called twice (up to JBAS_MAX_CALL_RESULTS numbers),
+	so only the function that blocks has to do that before it has any
+	side effects.
+
+	With sched->slice set, every turn of a task is limited to that many
+	steps of env->budget, so a runaway loop can't hold up the others.
+	Yielded tasks and the ones that have used up their slice go to the
+	back of the queue. Blocked ones wait until
+	jbas_sched_wake() is called for them (e.g. by sched->wait).
+	PARALLEL FOR threads cannot be suspended.
+
+	C functions doing non-blocking I/O call jbas_sched_wait_fd() when
+	the descriptor isn't ready. The task is then woken by an epoll loop
+	(jbas_sched_poll()) once the descriptor is readable/writable, so a
+	single thread can drive any number of I/O-bound scripts. Outside of
+	the scheduler, jbas_sched_wait_fd() simply blocks in poll().
+*/
+
+typedef enum jbas_task_state
+{
+	JBAS_TASK_READY,
+	JBAS_TASK_BLOCKED,
+	JBAS_TASK_DONE,
+} jbas_task_state;
+
+/**
+	Environment run by the scheduler. Provided by the host.
+*/
+typedef struct jbas_task
+{
+	jbas_env *env;
+	jbas_task_state state;
+	jbas_error status;             //!< Result of the finished run
+	void *data;                    //!< Host data
+	struct jbas_task *prev, *next; //!< Ready queue or blocked list
+
+	int wait_fd;                   //!< Descriptor the blocked task waits for (-1 if none)
+	short wait_events;             //!< POLLIN/POLLOUT
+	bool polled;                   //!< wait_fd is in the epoll set
+} jbas_task;
+
+typedef struct jbas_sched
+{
+	jbas_task *ready, *ready_tail;
+	jbas_task *blocked;
+	int task_count;                //!< Tasks that haven't finished
+	int blocked_count;
+	int polled_count;              //!< Blocked tasks waiting in the epoll set
+	int epoll_fd;                  //!< Created on the first use (-1 before)
+	int64_t slice;                 //!< Budget of one turn (0 = a turn ends by yielding or blocking only)
+
+	//! Called when all tasks are blocked - should wake some of them
+	//! (NULL waits for the descriptors, the other tasks are woken after
+	//! a millisecond)
+	jbas_error (*wait)(struct jbas_sched *sched);
+
+	//! Called when a task finishes (may be NULL)
+	void (*done)(struct jbas_sched *sched, jbas_task *task);
+
+	void *data;                    //!< Host data
+} jbas_sched;
+
+void jbas_sched_init(jbas_sched *sched);
+void jbas_sched_destroy(jbas_sched *sched);
+void jbas_sched_add(jbas_sched *sched, jbas_task *task, jbas_env *env);
+void jbas_sched_wake(jbas_sched *sched, jbas_task *task);
+jbas_error jbas_sched_step(jbas_sched *sched);
+jbas_error jbas_sched_run(jbas_sched *sched);
+jbas_error jbas_sched_poll(jbas_sched *sched, int timeout);
+jbas_error jbas_sched_wait_fd(jbas_env *env, int fd, short events);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -5,6 +5,20 @@
 #include <jbasic/text.h>
 #include <jbasic/resource.h>
 
+/**
+	Type of values a symbol can be bound to (inferred at load time)
+*/
+typedef enum jbas_symbol_type
+{
+	JBAS_TYPE_NONE = 0,    //!< Never bound
+	JBAS_TYPE_BOOL,
+	JBAS_TYPE_INT,
+	JBAS_TYPE_FLOAT,
+	JBAS_TYPE_INT_ARRAY,
+	JBAS_TYPE_FLOAT_ARRAY,
+	JBAS_TYPE_POLY,        //!< Different types, tuples, functions, ...
+} jbas_symbol_type;
+
 /**
 	Symbols are links between names in the code and resoruces.
 */
@@ -12,6 +26,7 @@ typedef struct jbas_symbol
 {
 	jbas_text *name;
 	jbas_resource *res;
+	jbas_symbol_type type; //!< See jbas_infer_types()
 } jbas_symbol;
 
 /*
@@ -24,14 +39,20 @@ typedef struct jbas_symbol_manager
 	int *free_slots;	
 	int free_slot_count;
 	int max_count;
+
+	int *used_slots; //!< Slots of all existing symbols (in no particular order)
+	int *used_index; //!< Position of each slot in used_slots
+	int used_count;
+	const jbas_allocator *allocator;
 } jbas_symbol_manager;
 
-jbas_error jbas_symbol_manager_init(jbas_symbol_manager *sm, int symbol_count);
+jbas_error jbas_symbol_manager_init(jbas_symbol_manager *sm, int symbol_count, const jbas_allocator *allocator);
 void jbas_symbol_manager_destroy(jbas_symbol_manager *sm);
 
 jbas_error jbas_symbol_create(jbas_env *env, jbas_symbol **sym, const char *s, const char *end);
 jbas_error jbas_symbol_lookup(jbas_symbol_manager *sm, jbas_symbol **sym, const char *s, const char *end);
 void jbas_symbol_destroy(jbas_symbol_manager *sm, jbas_symbol *sym);
+jbas_error jbas_symbol_import(jbas_env *env, const jbas_cres *cres, int count);
 
 bool jbas_is_scalar_symbol(jbas_token *t);
 jbas_error jbas_eval_scalar_symbol(jbas_env *env, jbas_token *t);
@@ -2,6 +2,8 @@
 #define JBASIC_TEXT_H
 
 #include <jbasic/defs.h>
+#include <jbasic/memory.h>
+#include <jbasic/alloc.h>
 #include <stddef.h>
 #include <stdbool.h>
 
@@ -18,9 +20,11 @@ typedef struct
 	int *free_slots;
 	int free_slot_count;
 	int max_count;
+	jbas_memory *memory; //!< Accounting of the texts (may be NULL)
+	const jbas_allocator *allocator;
 } jbas_text_manager;
 
-jbas_error jbas_text_manager_init(jbas_text_manager *tm, int text_count);
+jbas_error jbas_text_manager_init(jbas_text_manager *tm, int text_count, const jbas_allocator *allocator);
 jbas_error jbas_text_create(jbas_text_manager *tm, const char *s, const char *end, jbas_text **txt);
 jbas_error jbas_text_lookup(jbas_text_manager *tm, const char *s, const char *end, jbas_text **txt);
 jbas_error jbas_text_lookup_create(jbas_text_manager *tm, const char *s, const char *end, jbas_text **txt);
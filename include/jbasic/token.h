@@ -3,6 +3,7 @@
 
 #include <jbasic/defs.h>
 #include <jbasic/text.h>
+#include <jbasic/alloc.h>
 
 typedef enum
 {
@@ -23,6 +24,7 @@ typedef struct jbas_keyword jbas_keyword;
 typedef struct jbas_paren jbas_paren;
 typedef struct jbas_token jbas_token;
 typedef struct jbas_resource jbas_resource;
+typedef struct jbas_memo jbas_memo;
 
 typedef struct
 {
@@ -38,6 +40,7 @@ typedef struct
 typedef struct
 {
 	const jbas_keyword *kw;
+	void *data; //!< Cached by the keyword handler (e.g. compiled SELECT)
 } jbas_keyword_token;
 
 typedef struct
@@ -70,6 +73,7 @@ typedef struct
 typedef struct jbas_paren_token
 {
 	jbas_token *tokens;
+	jbas_memo *memo; //!< Cached value of the parentheses (optimizer)
 } jbas_paren_token;
 
 typedef struct jbas_resource_token
@@ -83,6 +87,7 @@ typedef struct jbas_resource_token
 typedef struct jbas_token
 {
 	jbas_token_type type;
+	int line; //!< Source line the token comes from (0 if it's been made by the optimizer)
 	union
 	{
 		jbas_keyword_token keyword_token;
@@ -110,6 +115,14 @@ typedef struct
 	jbas_token **unused_stack;
 	int pool_size;
 	int unused_count;
+
+	jbas_token **mark_stack; //!< Copy of the unused stack made by jbas_token_pool_mark()
+	int mark_count;
+	int low_count;           //!< Lowest unused_count since the pool was marked
+	uint64_t taken;          //!< Tokens handed out by jbas_token_pool_get() so far
+	uint64_t returned;       //!< Tokens given back by jbas_token_pool_return() so far
+	int min_count;           //!< Lowest unused_count since the statistics were reset
+	const jbas_allocator *allocator;
 } jbas_token_pool;
 
 jbas_error jbas_token_move(jbas_token *dest, jbas_token *src, jbas_token_pool *pool);
@@ -117,8 +130,10 @@ jbas_error jbas_token_copy(jbas_token *dest, jbas_token *src, jbas_token_pool *p
 jbas_error jbas_token_swap(jbas_token *dest, jbas_token *src, jbas_token_pool *pool);
 jbas_error jbas_token_pool_get(jbas_token_pool *pool, jbas_token **t);
 jbas_error jbas_token_pool_return(jbas_token_pool *pool, jbas_token *t);
-jbas_error jbas_token_pool_init(jbas_token_pool *pool, int size);
+jbas_error jbas_token_pool_init(jbas_token_pool *pool, int size, const jbas_allocator *allocator);
 jbas_error jbas_token_pool_destroy(jbas_token_pool *pool);
+jbas_error jbas_token_pool_mark(jbas_token_pool *pool);
+void jbas_token_pool_rewind(jbas_token_pool *pool);
 jbas_token *jbas_token_list_begin(jbas_token *t);
 jbas_token *jbas_token_list_end(jbas_token *t);
 jbas_error jbas_token_list_insert_from_pool(
@@ -0,0 +1,1240 @@
+#include <jbasic/jbasic.h>
+#include <jbasic/expr.h>
+#include <jbasic/infer.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+/*
+	JBasic to C translator. The program is tokenized just like in jbi and
+	every instruction is turned into C code that does exactly what
+	jbas_eval() would do - the operators are emitted in the same order
+	they would be evaluated in. Symbols with inferred types (see
+	jbas_infer_types()) become plain C variables, the rest is handled
+	by the runtime in src/jbcrt.c.
+*/
+
+/**
+	Kinds of values an operand evaluates to
+*/
+typedef enum jbc_kind
+{
+	JBC_NUM,   //!< Number - `type` is BOOL, INT, FLOAT or POLY (jbc_value)
+	JBC_REF,   //!< Array element - pointer to jbas_int (INT) or jbas_float (FLOAT)
+	JBC_SYM,   //!< Symbol - its value is read when it's needed
+	JBC_STR,   //!< String constant
+	JBC_TUPLE,
+} jbc_kind;
+
+#define JBC_MAX_EXPR 256
+
+typedef struct jbc_operand
+{
+	jbc_kind kind;
+	jbas_symbol_type type;
+	char c[JBC_MAX_EXPR];     //!< C expression (for numbers and array elements)
+	jbas_symbol *sym;
+	jbas_token *str;
+	struct jbc_operand *items; //!< Tuple items
+	int count;
+} jbc_operand;
+
+#define JBC_MAX_TUPLE_ITEMS 1024
+
+typedef struct jbc_ctx
+{
+	jbas_env *env;
+	FILE *f;
+	int indent;
+	int temp_count;
+
+	jbas_expr_tree *tree;
+	jbc_operand *values;  //!< Values of binary operators indexed by tree nodes
+	jbc_operand *items;   //!< Storage for tuple items (reset with every instruction)
+	int item_count;
+	unsigned char *used;  //!< Symbols referenced by the code, indexed by symbol storage index
+} jbc_ctx;
+
+#define JBC_USED_VAR  1
+#define JBC_USED_CFUN 2
+
+#define JBC_REASON_NUMBER "src/cast.c: could not convert token to number"
+
+static jbas_error jbc_list(jbc_ctx *ctx, jbas_expr *e, jbc_operand *res);
+static jbas_error jbc_block(jbc_ctx *ctx, jbas_token *begin, jbas_token *end);
+
+/**
+	Writes a line of code
+*/
+static void jbc_emit(jbc_ctx *ctx, const char *format, ...)
+{
+	for (int i = 0; i < ctx->indent; i++)
+		fputc('\t', ctx->f);
+
+	va_list ap;
+	va_start(ap, format);
+	vfprintf(ctx->f, format, ap);
+	va_end(ap);
+	fputc('\n', ctx->f);
+}
+
+/**
+	Formats a C expression into the operand
+*/
+static jbas_error jbc_set(jbc_ctx *ctx, jbc_operand *op, const char *format, ...)
+{
+	va_list ap;
+	va_start(ap, format);
+	int n = vsnprintf(op->c, sizeof(op->c), format, ap);
+	va_end(ap);
+
+	if (n < 0 || n >= sizeof(op->c))
+	{
+		JBAS_ERROR_REASON(ctx->env, "expression too long");
+		return JBAS_UNSUPPORTED;
+	}
+
+	return JBAS_OK;
+}
+
+static jbas_error jbc_unsupported(jbc_ctx *ctx, const char *reason)
+{
+	ctx->env->error_reason = reason;
+	return JBAS_UNSUPPORTED;
+}
+
+static int jbc_sym_index(jbc_ctx *ctx, jbas_symbol *sym)
+{
+	return sym - ctx->env->symbol_manager.symbol_storage;
+}
+
+static bool jbc_is_cfun(jbas_symbol *sym)
+{
+	return sym->res && sym->res->type == JBAS_RESOURCE_CFUN && sym->type == JBAS_TYPE_POLY;
+}
+
+/**
+	Name of the C variable holding the symbol
+*/
+static const char *jbc_var(jbc_ctx *ctx, jbas_symbol *sym)
+{
+	static char buf[JBC_MAX_EXPR];
+	snprintf(buf, sizeof(buf), "%s%d", jbc_is_cfun(sym) ? "f" : "v", jbc_sym_index(ctx, sym));
+	ctx->used[jbc_sym_index(ctx, sym)] |= jbc_is_cfun(sym) ? JBC_USED_CFUN : JBC_USED_VAR;
+	return buf;
+}
+
+static const char *jbc_c_type(jbas_symbol_type type)
+{
+	switch (type)
+	{
+		case JBAS_TYPE_BOOL:
+		case JBAS_TYPE_INT:
+			return "jbas_int";
+
+		case JBAS_TYPE_FLOAT:
+			return "jbas_float";
+
+		default:
+			return "jbc_value";
+	}
+}
+
+/**
+	Creates a temporary variable holding the number
+*/
+static void jbc_temp(jbc_ctx *ctx, jbc_operand *res, jbas_symbol_type type, const char *value)
+{
+	int n = ctx->temp_count++;
+	jbc_emit(ctx, "%s t%d = %s;", jbc_c_type(type), n, value);
+	*res = (jbc_operand){.kind = JBC_NUM, .type = type};
+	snprintf(res->c, sizeof(res->c), "t%d", n);
+}
+
+/**
+	Converts C expression of a number to the given C type
+*/
+static jbas_error jbc_as(jbc_ctx *ctx, const jbc_operand *n, jbas_symbol_type type, char *buf)
+{
+	const char *fmt = "%s";
+	switch (type)
+	{
+		case JBAS_TYPE_BOOL:
+			if (n->type == JBAS_TYPE_INT || n->type == JBAS_TYPE_FLOAT) fmt = "((%s) != 0)";
+			else if (n->type == JBAS_TYPE_POLY) fmt = "jbc_to_bool(%s)";
+			break;
+
+		case JBAS_TYPE_INT:
+			if (n->type == JBAS_TYPE_FLOAT) fmt = "((jbas_int) (%s))";
+			else if (n->type == JBAS_TYPE_POLY) fmt = "jbc_to_int(%s)";
+			break;
+
+		case JBAS_TYPE_FLOAT:
+			if (n->type == JBAS_TYPE_BOOL || n->type == JBAS_TYPE_INT) fmt = "((jbas_float) (%s))";
+			else if (n->type == JBAS_TYPE_POLY) fmt = "jbc_to_float(%s)";
+			break;
+
+		default:
+			if (n->type == JBAS_TYPE_BOOL) fmt = "jbc_bool(%s)";
+			else if (n->type == JBAS_TYPE_INT) fmt = "jbc_int(%s)";
+			else if (n->type == JBAS_TYPE_FLOAT) fmt = "jbc_float(%s)";
+			break;
+	}
+
+	int len = snprintf(buf, JBC_MAX_EXPR, fmt, n->c);
+	if (len < 0 || len >= JBC_MAX_EXPR)
+	{
+		JBAS_ERROR_REASON(ctx->env, "expression too long");
+		return JBAS_UNSUPPORTED;
+	}
+
+	return JBAS_OK;
+}
+
+/**
+	Turns operand into a number (like jbas_token_to_number()). If that's
+	not possible, the code fails with given error at run time.
+*/
+static jbas_error jbc_number(jbc_ctx *ctx, const jbc_operand *op, jbc_operand *n, jbas_error err, const char *reason)
+{
+	*n = (jbc_operand){.kind = JBC_NUM, .type = op->type};
+	switch (op->kind)
+	{
+		case JBC_NUM:
+			return jbc_set(ctx, n, "%s", op->c);
+
+		case JBC_REF:
+			return jbc_set(ctx, n, "(*%s)", op->c);
+
+		case JBC_SYM:
+			n->type = op->sym->type;
+			if (n->type == JBAS_TYPE_BOOL || n->type == JBAS_TYPE_INT || n->type == JBAS_TYPE_FLOAT)
+				return jbc_set(ctx, n, "%s", jbc_var(ctx, op->sym));
+			if (n->type == JBAS_TYPE_POLY && !jbc_is_cfun(op->sym))
+				return jbc_set(ctx, n, "jbc_get(&%s)", jbc_var(ctx, op->sym));
+			break;
+
+		case JBC_TUPLE:
+			if (op->count == 1) return jbc_number(ctx, &op->items[0], n, err, reason);
+			break;
+
+		default:
+			break;
+	}
+
+	// Not a number
+	n->type = JBAS_TYPE_POLY;
+	return jbc_set(ctx, n, "jbc_fail_value(%d, \"%s\")", err, reason);
+}
+
+static void jbc_write_string(FILE *f, const char *s)
+{
+	fputc('"', f);
+	for (; *s; s++)
+	{
+		if (*s == '"' || *s == '\\') fprintf(f, "\\%c", *s);
+		else if (*s == '\n') fprintf(f, "\\n");
+		else if (*s == '\t') fprintf(f, "\\t");
+		else if ((unsigned char) *s < 32 || (unsigned char) *s >= 127) fprintf(f, "\\%03o", (unsigned char) *s);
+		else fputc(*s, f);
+	}
+	fputc('"', f);
+}
+
+/**
+	Prints operand - see jbas_op_print()
+*/
+static jbas_error jbc_print(jbc_ctx *ctx, const jbc_operand *op)
+{
+	char buf[JBC_MAX_EXPR];
+	jbas_error err = JBAS_OK;
+
+	switch (op->kind)
+	{
+		case JBC_NUM:
+			err = jbc_as(ctx, op, JBAS_TYPE_POLY, buf);
+			if (!err) jbc_emit(ctx, "jbc_print_value(%s);", buf);
+			break;
+
+		case JBC_SYM:
+			{
+				jbas_symbol_type type = op->sym->type;
+				if (type == JBAS_TYPE_POLY && !jbc_is_cfun(op->sym))
+					jbc_emit(ctx, "jbc_print_symbol(&%s);", jbc_var(ctx, op->sym));
+				else if (type == JBAS_TYPE_BOOL || type == JBAS_TYPE_INT || type == JBAS_TYPE_FLOAT)
+				{
+					jbc_operand n;
+					err = jbc_number(ctx, op, &n, JBAS_OK, "");
+					if (!err) err = jbc_as(ctx, &n, JBAS_TYPE_POLY, buf);
+					if (!err) jbc_emit(ctx, "jbc_print_value(%s);", buf);
+				}
+				else if (type == JBAS_TYPE_NONE && !op->sym->res)
+					jbc_emit(ctx, "jbc_print_string(\"<NULL>\");");
+				else
+					jbc_emit(ctx, "jbc_print_string(\"<NONSCALAR>\");");
+			}
+			break;
+
+		case JBC_STR:
+			for (int i = 0; i < ctx->indent; i++) fputc('\t', ctx->f);
+			fprintf(ctx->f, "jbc_print_string(");
+			jbc_write_string(ctx->f, op->str->string_token.txt->str);
+			fprintf(ctx->f, ");\n");
+			break;
+
+		// Array element pointers and tuples
+		default:
+			jbc_emit(ctx, "jbc_print_string(\"???\");");
+			break;
+	}
+
+	return err;
+}
+
+/**
+	Evaluates the operand alone - parentheses contents, call and prefix operators
+*/
+static jbas_error jbc_leaf(jbc_ctx *ctx, jbas_expr *e, jbc_operand *res)
+{
+	jbas_error err;
+	char buf[JBC_MAX_EXPR];
+
+	switch (e->type)
+	{
+		case JBAS_EXPR_OPERAND:
+			*res = (jbc_operand){.kind = JBC_NUM};
+			switch (e->token->type)
+			{
+				case JBAS_TOKEN_NUMBER:
+					{
+						jbas_number_token *n = &e->token->number_token;
+						if (n->type == JBAS_NUM_FLOAT)
+							return res->type = JBAS_TYPE_FLOAT, jbc_set(ctx, res, "((jbas_float) %.9e)", n->f);
+						res->type = n->type == JBAS_NUM_BOOL ? JBAS_TYPE_BOOL : JBAS_TYPE_INT;
+						return jbc_set(ctx, res, "%d", n->i);
+					}
+
+				case JBAS_TOKEN_SYMBOL:
+					*res = (jbc_operand){.kind = JBC_SYM, .sym = e->token->symbol_token.sym};
+					return JBAS_OK;
+
+				case JBAS_TOKEN_STRING:
+					*res = (jbc_operand){.kind = JBC_STR, .str = e->token};
+					return JBAS_OK;
+
+				default:
+					return jbc_unsupported(ctx, "unsupported operand");
+			}
+
+		// Empty parentheses are 0
+		case JBAS_EXPR_PAREN:
+			if (!e->a)
+			{
+				*res = (jbc_operand){.kind = JBC_NUM, .type = JBAS_TYPE_INT};
+				return jbc_set(ctx, res, "0");
+			}
+			return jbc_list(ctx, e->a, res);
+
+		case JBAS_EXPR_CALL:
+			{
+				if (e->a->type != JBAS_EXPR_OPERAND || e->a->token->type != JBAS_TOKEN_SYMBOL)
+					return jbc_unsupported(ctx, "only symbols can be called");
+				jbas_symbol *sym = e->a->token->symbol_token.sym;
+
+				// Arguments
+				jbc_operand args = {.kind = JBC_NUM, .type = JBAS_TYPE_INT, .c = "0"};
+				if (e->b)
+				{
+					err = jbc_list(ctx, e->b, &args);
+					if (err) return err;
+				}
+
+				// Array element
+				if (sym->type == JBAS_TYPE_INT_ARRAY || sym->type == JBAS_TYPE_FLOAT_ARRAY)
+				{
+					jbc_operand index;
+					bool is_int = sym->type == JBAS_TYPE_INT_ARRAY;
+					err = jbc_number(ctx, &args, &index, JBAS_BAD_INDEX, "src/op.c: invalid array index (not a number?)");
+					if (!err) err = jbc_as(ctx, &index, JBAS_TYPE_INT, buf);
+					if (err) return err;
+
+					int n = ctx->temp_count++;
+					const char *var = jbc_var(ctx, sym);
+					jbc_emit(ctx, "%s *t%d = %s(&%s, %s);", is_int ? "jbas_int" : "jbas_float", n, is_int ? "jbc_iref" : "jbc_fref", var, buf);
+					*res = (jbc_operand){.kind = JBC_REF, .type = is_int ? JBAS_TYPE_INT : JBAS_TYPE_FLOAT};
+					return jbc_set(ctx, res, "t%d", n);
+				}
+
+				// Unbound symbol
+				if (sym->type == JBAS_TYPE_NONE)
+				{
+					jbc_temp(ctx, res, JBAS_TYPE_POLY, "jbc_fail_value(JBAS_BAD_CALL, \"src/op.c: no resource to be called?\")");
+					return JBAS_OK;
+				}
+
+				if (!jbc_is_cfun(sym))
+					return jbc_unsupported(ctx, "only arrays and C functions can be called");
+
+				// C function - arrays and strings are passed as they are, the rest as numbers
+				const jbc_operand *argv = &args;
+				int argc = 1;
+				if (args.kind == JBC_TUPLE) argv = args.items, argc = args.count;
+				else if (!e->b) argc = 0;
+
+				int n = ctx->temp_count++;
+				if (argc) jbc_emit(ctx, "jbc_arg t%d[%d];", n, argc);
+				for (int i = 0; i < argc; i++)
+				{
+					const jbc_operand *arg = &argv[i];
+					if (arg->kind == JBC_SYM && (arg->sym->type == JBAS_TYPE_INT_ARRAY || arg->sym->type == JBAS_TYPE_FLOAT_ARRAY))
+					{
+						bool is_int = arg->sym->type == JBAS_TYPE_INT_ARRAY;
+						jbc_emit(ctx, "t%d[%d] = %s(&%s);", n, i, is_int ? "jbc_arg_iarray" : "jbc_arg_farray", jbc_var(ctx, arg->sym));
+						continue;
+					}
+
+					if (arg->kind == JBC_STR)
+					{
+						for (int k = 0; k < ctx->indent; k++) fputc('\t', ctx->f);
+						fprintf(ctx->f, "t%d[%d] = jbc_arg_string(", n, i);
+						jbc_write_string(ctx->f, arg->str->string_token.txt->str);
+						fprintf(ctx->f, ");\n");
+						continue;
+					}
+
+					jbc_operand a;
+					err = jbc_number(ctx, arg, &a, JBAS_CAST_FAILED, JBC_REASON_NUMBER);
+					if (!err) err = jbc_as(ctx, &a, JBAS_TYPE_POLY, buf);
+					if (err) return err;
+					jbc_emit(ctx, "t%d[%d] = jbc_arg_value(%s);", n, i, buf);
+				}
+
+				char call[JBC_MAX_EXPR];
+				snprintf(call, sizeof(call), "jbc_call(&%s, %d, %s)", jbc_var(ctx, sym), argc, argc ? "" : "NULL");
+				if (argc) snprintf(call + strlen(call) - 1, sizeof(call) - strlen(call) + 1, "t%d)", n);
+				jbc_temp(ctx, res, JBAS_TYPE_POLY, call);
+				return JBAS_OK;
+			}
+
+		case JBAS_EXPR_UNARY:
+			{
+				jbc_operand a, n;
+				err = jbc_leaf(ctx, e->a, &a);
+				if (err) return err;
+
+				const char *s = e->op->str;
+				if (!strcmp(s, "-"))
+				{
+					err = jbc_number(ctx, &a, &n, JBAS_CAST_FAILED, JBC_REASON_NUMBER);
+					if (err) return err;
+					if (n.type == JBAS_TYPE_POLY) snprintf(buf, sizeof(buf), "jbc_neg(%s)", n.c);
+					else snprintf(buf, sizeof(buf), "-(%s)", n.c);
+					jbc_temp(ctx, res, n.type, buf);
+					return JBAS_OK;
+				}
+
+				if (!strcmp(s, "!") || !strcmp(s, "NOT"))
+				{
+					err = jbc_number(ctx, &a, &n, JBAS_CAST_FAILED, "src/op.c: invalid NOT operand");
+					if (!err) err = jbc_as(ctx, &n, JBAS_TYPE_BOOL, buf);
+					if (err) return err;
+					char v[JBC_MAX_EXPR + 8];
+					snprintf(v, sizeof(v), "!%s", buf);
+					jbc_temp(ctx, res, JBAS_TYPE_BOOL, v);
+					return JBAS_OK;
+				}
+
+				// PRINT, PRINTLN and INPUT result in the operand itself
+				if (!strcmp(s, "PRINT") || !strcmp(s, "PRINTLN"))
+				{
+					err = jbc_print(ctx, &a);
+					if (err) return err;
+					if (!strcmp(s, "PRINTLN")) jbc_emit(ctx, "jbc_print_string(\"\\n\");");
+				}
+
+				*res = a;
+				return JBAS_OK;
+			}
+
+		default:
+			return jbc_unsupported(ctx, "unexpected binary operator");
+	}
+}
+
+/**
+	Stores number in a symbol
+*/
+static jbas_error jbc_store(jbc_ctx *ctx, jbas_symbol *sym, const jbc_operand *n)
+{
+	char buf[JBC_MAX_EXPR];
+	jbas_symbol_type type = sym->type;
+
+	if (type == JBAS_TYPE_POLY && jbc_is_cfun(sym))
+		return jbc_unsupported(ctx, "C functions cannot be reassigned");
+	// Tagged values only reach typed symbols from reads of unbound symbols (which fail)
+	if (type != JBAS_TYPE_POLY && n->type != JBAS_TYPE_POLY && type != n->type)
+		return jbc_unsupported(ctx, "assigned value does not match the inferred type");
+
+	jbas_error err = jbc_as(ctx, n, type, buf);
+	if (err) return err;
+	jbc_emit(ctx, "%s = %s;", jbc_var(ctx, sym), buf);
+	return JBAS_OK;
+}
+
+/**
+	Assignment - see jbas_op_assign()
+*/
+static jbas_error jbc_assign(jbc_ctx *ctx, const jbc_operand *a, const jbc_operand *b, jbc_operand *res)
+{
+	jbas_error err;
+	jbc_operand n;
+	char buf[JBC_MAX_EXPR];
+
+	// Array elements
+	if (a->kind == JBC_REF)
+	{
+		err = jbc_number(ctx, b, &n, JBAS_CAST_FAILED, JBC_REASON_NUMBER);
+		if (!err) err = jbc_as(ctx, &n, a->type, buf);
+		if (err) return err;
+		jbc_temp(ctx, &n, a->type, buf);
+		jbc_emit(ctx, "*%s = %s;", a->c, n.c);
+		if (res) *res = n;
+		return JBAS_OK;
+	}
+
+	// Two tuples
+	if (a->kind == JBC_TUPLE && b->kind == JBC_TUPLE)
+	{
+		for (int i = 0; i < a->count && i < b->count; i++)
+		{
+			err = jbc_assign(ctx, &a->items[i], &b->items[i], NULL);
+			if (err) return err;
+		}
+		if (res) *res = *b;
+		return JBAS_OK;
+	}
+
+	if (a->kind != JBC_SYM)
+	{
+		jbc_emit(ctx, "jbc_fail(JBAS_BAD_ASSIGN, \"src/op.c: cannot assign value (not a pointer, not a tuple, not a symbol)\");");
+		if (res) *res = *b;
+		return JBAS_OK;
+	}
+
+	switch (b->kind)
+	{
+		case JBC_SYM:
+			if (b->sym->type == JBAS_TYPE_INT_ARRAY || b->sym->type == JBAS_TYPE_FLOAT_ARRAY || jbc_is_cfun(b->sym))
+				return jbc_unsupported(ctx, "arrays and functions cannot be assigned");
+			// fallthrough
+
+		case JBC_NUM:
+		case JBC_REF:
+			err = jbc_number(ctx, b, &n, JBAS_CAST_FAILED, JBC_REASON_NUMBER);
+			if (!err) err = jbc_store(ctx, a->sym, &n);
+			if (err) return err;
+			break;
+
+		default:
+			jbc_emit(ctx, "jbc_fail(JBAS_BAD_ASSIGN, NULL);");
+			break;
+	}
+
+	if (res) *res = *b;
+	return JBAS_OK;
+}
+
+/**
+	Comma operator - builds a tuple
+*/
+static jbas_error jbc_comma(jbc_ctx *ctx, const jbc_operand *a, const jbc_operand *b, jbc_operand *res)
+{
+	int na = a->kind == JBC_TUPLE ? a->count : 1;
+	int nb = b->kind == JBC_TUPLE ? b->count : 1;
+	if (ctx->item_count + na + nb > JBC_MAX_TUPLE_ITEMS)
+		return jbc_unsupported(ctx, "too many tuple items");
+
+	jbc_operand *items = &ctx->items[ctx->item_count];
+	ctx->item_count += na + nb;
+	if (a->kind == JBC_TUPLE) memcpy(items, a->items, na * sizeof(*items));
+	else items[0] = *a;
+	if (b->kind == JBC_TUPLE) memcpy(items + na, b->items, nb * sizeof(*items));
+	else items[na] = *b;
+
+	*res = (jbc_operand){.kind = JBC_TUPLE, .items = items, .count = na + nb};
+	return JBAS_OK;
+}
+
+/**
+	Arithmetic operators and comparisons
+*/
+static jbas_error jbc_math(jbc_ctx *ctx, const char *s, const jbc_operand *a, const jbc_operand *b, jbc_operand *res)
+{
+	static const char *const math[] = {"+", "-", "*", "/", "%", "mod"};
+	static const char *const math_ops[] = {"JBC_ADD", "JBC_SUB", "JBC_MUL", "JBC_DIV", "JBC_REM", "JBC_MOD"};
+	static const char *const cmp[] = {"==", "!=", "<", ">", "<=", ">="};
+	static const char *const cmp_ops[] = {"JBC_EQ", "JBC_NEQ", "JBC_LESS", "JBC_GREATER", "JBC_LEQ", "JBC_GEQ"};
+
+	int m = -1, c = -1;
+	for (int i = 0; i < 6; i++)
+	{
+		if (!strcmp(s, math[i])) m = i;
+		if (!strcmp(s, cmp[i])) c = i;
+	}
+	if (m < 0 && c < 0) return jbc_unsupported(ctx, "unsupported operator");
+
+	jbas_error err;
+	jbc_operand na, nb;
+	char ba[JBC_MAX_EXPR], bb[JBC_MAX_EXPR], v[3 * JBC_MAX_EXPR];
+	if (c >= 0)
+	{
+		err = jbc_number(ctx, a, &na, JBAS_BAD_COMPARE, "src/op.c: attempted to compare incomparable entities");
+		if (!err) err = jbc_number(ctx, b, &nb, JBAS_BAD_COMPARE, "src/op.c: attempted to compare incomparable entities");
+	}
+	else
+	{
+		err = jbc_number(ctx, a, &na, JBAS_CAST_FAILED, JBC_REASON_NUMBER);
+		if (!err) err = jbc_number(ctx, b, &nb, JBAS_CAST_FAILED, JBC_REASON_NUMBER);
+	}
+	if (err) return err;
+
+	// Tagged values
+	jbas_symbol_type type = na.type >= nb.type ? na.type : nb.type;
+	if (type == JBAS_TYPE_POLY)
+	{
+		err = jbc_as(ctx, &na, JBAS_TYPE_POLY, ba);
+		if (!err) err = jbc_as(ctx, &nb, JBAS_TYPE_POLY, bb);
+		if (err) return err;
+		snprintf(v, sizeof(v), "%s(%s, %s, %s)", c >= 0 ? "jbc_cmp" : "jbc_math", c >= 0 ? cmp_ops[c] : math_ops[m], ba, bb);
+		jbc_temp(ctx, res, c >= 0 ? JBAS_TYPE_BOOL : JBAS_TYPE_POLY, v);
+		return JBAS_OK;
+	}
+
+	// Both types are known - see jbas_number_type_promotion()
+	err = jbc_as(ctx, &na, type, ba);
+	if (!err) err = jbc_as(ctx, &nb, type, bb);
+	if (err) return err;
+
+	if (c >= 0)
+		snprintf(v, sizeof(v), "(%s) %s (%s)", ba, cmp[c], bb);
+	else if (m >= 4 && type == JBAS_TYPE_FLOAT)
+		snprintf(v, sizeof(v), "fmodf(%s, %s)", ba, bb);
+	else if (m == 5)
+		snprintf(v, sizeof(v), "jbc_mod(%s, %s)", ba, bb);
+	else
+		snprintf(v, sizeof(v), "(%s) %s (%s)", ba, math[m], bb);
+
+	jbc_temp(ctx, res, c >= 0 ? JBAS_TYPE_BOOL : type, v);
+	return JBAS_OK;
+}
+
+/**
+	Evaluates operand of a binary operator - either it's already been
+	evaluated (binary operator) or it's evaluated now
+*/
+static jbas_error jbc_binary_operand(jbc_ctx *ctx, jbas_expr *e, jbc_operand *res)
+{
+	if (e->type == JBAS_EXPR_BINARY)
+	{
+		*res = ctx->values[e - ctx->tree->nodes];
+		return JBAS_OK;
+	}
+
+	return jbc_leaf(ctx, e, res);
+}
+
+/**
+	AND and OR - the right operand is only evaluated if necessary
+*/
+static jbas_error jbc_logic(jbc_ctx *ctx, jbas_expr *e, jbc_operand *res)
+{
+	bool is_and = !strcmp(e->op->str, "&&") || !strcmp(e->op->str, "AND");
+	char buf[JBC_MAX_EXPR];
+	jbas_error err;
+
+	// jbas_op_and() does not evaluate operators attached to the operands
+	for (jbas_expr *o = e->a; o; o = o == e->a ? e->b : NULL)
+		if (o->type == JBAS_EXPR_UNARY || o->type == JBAS_EXPR_CALL)
+			return jbc_unsupported(ctx, "operators attached to AND/OR operands have to be put in parentheses");
+
+	jbc_operand a, b, n;
+	err = jbc_binary_operand(ctx, e->a, &a);
+	if (!err) err = jbc_number(ctx, &a, &n, JBAS_CAST_FAILED, JBC_REASON_NUMBER);
+	if (!err) err = jbc_as(ctx, &n, JBAS_TYPE_BOOL, buf);
+	if (err) return err;
+	jbc_temp(ctx, res, JBAS_TYPE_BOOL, buf);
+
+	jbc_emit(ctx, "if (%s%s)", is_and ? "" : "!", res->c);
+	jbc_emit(ctx, "{");
+	ctx->indent++;
+	err = jbc_binary_operand(ctx, e->b, &b);
+	if (!err) err = jbc_number(ctx, &b, &n, JBAS_CAST_FAILED, JBC_REASON_NUMBER);
+	if (!err) err = jbc_as(ctx, &n, JBAS_TYPE_BOOL, buf);
+	if (err) return err;
+	jbc_emit(ctx, "%s = %s != 0;", res->c, buf);
+	ctx->indent--;
+	jbc_emit(ctx, "}");
+	return JBAS_OK;
+}
+
+/**
+	Collects binary operators of the list in order of their position
+*/
+static void jbc_collect(jbas_expr *e, jbas_expr **ops, int *count)
+{
+	if (e->type != JBAS_EXPR_BINARY) return;
+	jbc_collect(e->a, ops, count);
+	ops[(*count)++] = e;
+	jbc_collect(e->b, ops, count);
+}
+
+/**
+	Evaluates contents of parentheses or an instruction. The binary operators
+	are evaluated in the same order as in jbas_eval().
+*/
+static jbas_error jbc_list(jbc_ctx *ctx, jbas_expr *e, jbc_operand *res)
+{
+	jbas_expr *ops[JBAS_EXPR_MAX_NODES];
+	int pos[JBAS_EXPR_MAX_NODES];
+	int count = 0;
+	jbc_collect(e, ops, &count);
+	if (!count) return jbc_leaf(ctx, e, res);
+
+	// Sort by precedence (stable), then by associativity - see jbas_operator_token_compare()
+	for (int i = 0; i < count; i++)
+		pos[i] = ops[i]->op->type == JBAS_OP_BINARY_RL ? -i : i;
+	for (int i = 1; i < count; i++)
+		for (int j = i; j > 0; j--)
+		{
+			jbas_expr *x = ops[j - 1], *y = ops[j];
+			if (x->op->level > y->op->level || (x->op->level == y->op->level && pos[j - 1] < pos[j])) break;
+			int p = pos[j - 1];
+			ops[j - 1] = y, ops[j] = x;
+			pos[j - 1] = pos[j], pos[j] = p;
+		}
+
+	for (int i = 0; i < count; i++)
+	{
+		jbas_expr *o = ops[i];
+		jbc_operand *v = &ctx->values[o - ctx->tree->nodes];
+		jbas_error err;
+
+		if (!o->op->eval_args)
+		{
+			err = jbc_logic(ctx, o, v);
+			if (err) return err;
+			continue;
+		}
+
+		jbc_operand a, b;
+		err = jbc_binary_operand(ctx, o->a, &a);
+		if (!err) err = jbc_binary_operand(ctx, o->b, &b);
+		if (err) return err;
+
+		if (o->op->type == JBAS_OP_BINARY_RL) err = jbc_assign(ctx, &a, &b, v);
+		else if (!strcmp(o->op->str, ",")) err = jbc_comma(ctx, &a, &b, v);
+		else err = jbc_math(ctx, o->op->str, &a, &b, v);
+		if (err) return err;
+	}
+
+	*res = ctx->values[e - ctx->tree->nodes];
+	return JBAS_OK;
+}
+
+/**
+	Parses and evaluates tokens [begin, end)
+*/
+static jbas_error jbc_eval(jbc_ctx *ctx, jbas_token *begin, jbas_token *end, jbas_token **list, jbc_operand *res)
+{
+	jbas_error err = jbas_expr_parse(ctx->tree, begin, end, list);
+	if (err)
+	{
+		JBAS_ERROR_REASON(ctx->env, "could not parse expression");
+		return err;
+	}
+
+	ctx->item_count = 0;
+	if (!ctx->tree->root)
+	{
+		*res = (jbc_operand){.kind = JBC_NUM, .type = JBAS_TYPE_INT, .c = "0"};
+		return JBAS_OK;
+	}
+
+	return jbc_list(ctx, ctx->tree->root, res);
+}
+
+/**
+	Evaluates condition to a C expression
+*/
+static jbas_error jbc_condition(jbc_ctx *ctx, jbas_token *begin, jbas_token *end, char *buf)
+{
+	jbc_operand v, n;
+	jbas_error err = jbc_eval(ctx, begin, end, &ctx->env->tokens, &v);
+	if (!err) err = jbc_number(ctx, &v, &n, JBAS_CAST_FAILED, "src/kw.c: could not convert IF condition to BOOL");
+	if (!err) err = jbc_as(ctx, &n, JBAS_TYPE_BOOL, buf);
+	return err;
+}
+
+static jbas_token *jbc_find_delimiter(jbas_token *t, jbas_token *end)
+{
+	while (t && t != end && t->type != JBAS_TOKEN_DELIMITER)
+		t = t->r;
+	return t;
+}
+
+static bool jbc_is_kw(const jbas_token *t, jbas_keyword_id id)
+{
+	return t && t->type == JBAS_TOKEN_KEYWORD && t->keyword_token.kw->id == id;
+}
+
+static jbas_error jbc_if(jbc_ctx *ctx, jbas_token *begin, jbas_token *t_end)
+{
+	char cond[JBC_MAX_EXPR];
+	jbas_token *t_delim = jbc_find_delimiter(begin->r, t_end);
+	if (t_delim == t_end) return jbc_unsupported(ctx, "IF without a body");
+
+	// The matching ELSE
+	jbas_token *t_else, *t;
+	int level = 0;
+	for (t = begin->r; t && (level || !jbc_is_kw(t, JBAS_KW_ELSE)); t = t->r)
+	{
+		level += jbas_block_level_diff(t);
+		if (level < 0)
+		{
+			t = NULL;
+			break;
+		}
+	}
+	t_else = t;
+
+	jbc_emit(ctx, "{");
+	ctx->indent++;
+	jbas_error err = jbc_condition(ctx, begin->r, t_delim, cond);
+	if (err) return err;
+	jbc_emit(ctx, "if (%s)", cond);
+	jbc_emit(ctx, "{");
+	ctx->indent++;
+	err = jbc_block(ctx, t_delim->r, t_else ? t_else : t_end);
+	if (err) return err;
+	ctx->indent--;
+	jbc_emit(ctx, "}");
+
+	if (t_else)
+	{
+		jbc_emit(ctx, "else");
+		jbc_emit(ctx, "{");
+		ctx->indent++;
+		err = jbc_block(ctx, t_else->r, t_end);
+		if (err) return err;
+		ctx->indent--;
+		jbc_emit(ctx, "}");
+	}
+
+	ctx->indent--;
+	jbc_emit(ctx, "}");
+	return JBAS_OK;
+}
+
+static jbas_error jbc_while(jbc_ctx *ctx, jbas_token *begin, jbas_token *t_end)
+{
+	char cond[JBC_MAX_EXPR];
+	jbas_token *t_delim = jbc_find_delimiter(begin->r, t_end);
+	if (t_delim == t_end) return jbc_unsupported(ctx, "WHILE without a body");
+
+	jbc_emit(ctx, "while (1)");
+	jbc_emit(ctx, "{");
+	ctx->indent++;
+	jbas_error err = jbc_condition(ctx, begin->r, t_delim, cond);
+	if (err) return err;
+	jbc_emit(ctx, "if (!%s) break;", cond);
+	err = jbc_block(ctx, t_delim->r, t_end);
+	if (err) return err;
+	ctx->indent--;
+	jbc_emit(ctx, "}");
+	return JBAS_OK;
+}
+
+static jbas_token *jbc_label_end(jbas_token *t)
+{
+	while (t && t->type != JBAS_TOKEN_DELIMITER && !jbc_is_kw(t, JBAS_KW_TO)
+		&& !(t->type == JBAS_TOKEN_OPERATOR && !strcmp(t->operator_token.op->str, ",")))
+		t = t->r;
+	return t;
+}
+
+/**
+	SELECT is translated into a sequence of tests followed by a switch.
+	The C compiler turns the constant ones into a jump table on its own.
+*/
+static jbas_error jbc_select(jbc_ctx *ctx, jbas_token *begin, jbas_token *t_end)
+{
+	jbas_error err;
+	jbas_token *t_delim = jbc_find_delimiter(begin->r, t_end);
+	if (t_delim == t_end) return jbc_unsupported(ctx, "SELECT requires an expression");
+
+	// CASE keywords at the SELECT level
+	jbas_token *clauses[JBAS_EXPR_MAX_NODES];
+	int clause_count = 0, level = 0;
+	for (jbas_token *t = t_delim->r; t && t != t_end; t = t->r)
+	{
+		if (!level && jbc_is_kw(t, JBAS_KW_CASE))
+		{
+			if (clause_count == JBAS_EXPR_MAX_NODES) return jbc_unsupported(ctx, "too many CASE clauses");
+			clauses[clause_count++] = t;
+		}
+		else if (!level && !clause_count && t->type != JBAS_TOKEN_DELIMITER)
+			return jbc_unsupported(ctx, "SELECT body must begin with CASE");
+		level += jbas_block_level_diff(t);
+	}
+
+	jbc_emit(ctx, "{");
+	ctx->indent++;
+
+	// The selector
+	jbc_operand v, x;
+	err = jbc_eval(ctx, begin->r, t_delim, &ctx->env->tokens, &v);
+	if (!err) err = jbc_number(ctx, &v, &x, JBAS_CAST_FAILED, "src/kw.c: SELECT expression has to be a number");
+	if (err) return err;
+	jbc_temp(ctx, &x, x.type, x.c);
+	int clause = ctx->temp_count++;
+	jbc_emit(ctx, "int t%d = -1;", clause);
+
+	// Labels are tested in order
+	jbc_emit(ctx, "do");
+	jbc_emit(ctx, "{");
+	ctx->indent++;
+	for (int i = 0; i < clause_count; i++)
+	{
+		jbas_token *c = clauses[i]->r;
+		if (jbc_is_kw(c, JBAS_KW_ELSE))
+		{
+			if (i != clause_count - 1) return jbc_unsupported(ctx, "CASE ELSE has to be the last one");
+			break;
+		}
+
+		while (1)
+		{
+			jbas_token *e = jbc_label_end(c);
+			jbas_token *hi_begin = c, *hi_end = e;
+			if (jbc_is_kw(e, JBAS_KW_TO))
+			{
+				hi_begin = e->r;
+				hi_end = jbc_label_end(hi_begin);
+			}
+			if (c == e || hi_begin == hi_end) return jbc_unsupported(ctx, "missing CASE label");
+
+			jbc_emit(ctx, "{");
+			ctx->indent++;
+			jbc_operand v_lo, v_hi, lo, hi, cmp_lo, cmp_hi;
+			err = jbc_eval(ctx, c, e, &ctx->env->tokens, &v_lo);
+			if (!err) err = jbc_number(ctx, &v_lo, &lo, JBAS_CAST_FAILED, JBC_REASON_NUMBER);
+			if (!err && hi_begin != c)
+			{
+				err = jbc_eval(ctx, hi_begin, hi_end, &ctx->env->tokens, &v_hi);
+				if (!err) err = jbc_number(ctx, &v_hi, &hi, JBAS_CAST_FAILED, JBC_REASON_NUMBER);
+			}
+			else hi = lo;
+			if (!err) err = jbc_math(ctx, "<=", &lo, &x, &cmp_lo);
+			if (!err) err = jbc_math(ctx, "<=", &x, &hi, &cmp_hi);
+			if (err) return err;
+			jbc_emit(ctx, "if (%s && %s) { t%d = %d; break; }", cmp_lo.c, cmp_hi.c, clause, i);
+			ctx->indent--;
+			jbc_emit(ctx, "}");
+
+			if (!hi_end || hi_end->type != JBAS_TOKEN_OPERATOR) break;
+			c = hi_end->r;
+		}
+	}
+	ctx->indent--;
+	jbc_emit(ctx, "} while (0);");
+
+	// Clause bodies
+	jbc_emit(ctx, "switch (t%d)", clause);
+	jbc_emit(ctx, "{");
+	ctx->indent++;
+	for (int i = 0; i < clause_count; i++)
+	{
+		bool is_else = jbc_is_kw(clauses[i]->r, JBAS_KW_ELSE);
+		jbas_token *t = jbc_find_delimiter(clauses[i], t_end);
+		jbc_emit(ctx, is_else ? "default:" : "case %d:", i);
+		ctx->indent++;
+		jbc_emit(ctx, "{");
+		ctx->indent++;
+		if (t && t != t_end)
+		{
+			err = jbc_block(ctx, t->r, i + 1 < clause_count ? clauses[i + 1] : t_end);
+			if (err) return err;
+		}
+		ctx->indent--;
+		jbc_emit(ctx, "}");
+		jbc_emit(ctx, "break;");
+		ctx->indent--;
+	}
+	ctx->indent--;
+	jbc_emit(ctx, "}");
+
+	ctx->indent--;
+	jbc_emit(ctx, "}");
+	return JBAS_OK;
+}
+
+/**
+	IDIM and FDIM - the dimension is the single token following the symbol
+*/
+static jbas_error jbc_dim(jbc_ctx *ctx, jbas_token *begin)
+{
+	jbas_token *sym = begin->r;
+	if (!sym || sym->type != JBAS_TOKEN_SYMBOL || !sym->r || sym->r->type == JBAS_TOKEN_DELIMITER)
+		return jbc_unsupported(ctx, "DIM requires symbol name and dimension");
+
+	bool is_int = begin->keyword_token.kw->id == JBAS_KW_IDIM;
+	if (sym->symbol_token.sym->type != (is_int ? JBAS_TYPE_INT_ARRAY : JBAS_TYPE_FLOAT_ARRAY))
+		return jbc_unsupported(ctx, "array symbols cannot be reused for anything else");
+
+	jbc_operand v, n;
+	char buf[JBC_MAX_EXPR];
+	jbas_token *dim = sym->r;
+	jbas_error err;
+	jbc_emit(ctx, "{");
+	ctx->indent++;
+	if (dim->type == JBAS_TOKEN_PAREN)
+		err = jbc_eval(ctx, jbas_token_list_begin(dim->paren_token.tokens), NULL, &dim->paren_token.tokens, &v);
+	else
+		err = jbc_eval(ctx, dim, dim->r, &ctx->env->tokens, &v);
+	if (!err) err = jbc_number(ctx, &v, &n, JBAS_BAD_DIM, "src/kw.c: DIM requires integer dimension(s)");
+	if (!err) err = jbc_as(ctx, &n, JBAS_TYPE_INT, buf);
+	if (err) return err;
+	jbc_emit(ctx, "%s(&%s, %s);", is_int ? "jbc_idim" : "jbc_fdim", jbc_var(ctx, sym->symbol_token.sym), buf);
+	ctx->indent--;
+	jbc_emit(ctx, "}");
+	return JBAS_OK;
+}
+
+/**
+	Translates block [begin, end) - see jbas_run_block()
+*/
+static jbas_error jbc_block(jbc_ctx *ctx, jbas_token *begin, jbas_token *end)
+{
+	jbas_error err;
+	jbas_token *t = begin;
+	while (t && t != end)
+	{
+		if (t->type == JBAS_TOKEN_DELIMITER)
+		{
+			t = t->r;
+			continue;
+		}
+
+		if (t->type == JBAS_TOKEN_KEYWORD)
+		{
+			jbas_keyword_id id = t->keyword_token.kw->id;
+			if (id == JBAS_KW_IF || id == JBAS_KW_WHILE || id == JBAS_KW_SELECT)
+			{
+				jbas_token *t_end;
+				err = jbas_get_block_end(ctx->env, t, &t_end);
+				if (err) return err;
+
+				if (id == JBAS_KW_IF) err = jbc_if(ctx, t, t_end);
+				else if (id == JBAS_KW_WHILE) err = jbc_while(ctx, t, t_end);
+				else err = jbc_select(ctx, t, t_end);
+				if (err) return err;
+				t = t_end;
+			}
+			else if (id == JBAS_KW_PARALLEL)
+				return jbc_unsupported(ctx, "PARALLEL FOR");
+			else if (id == JBAS_KW_IDIM || id == JBAS_KW_FDIM)
+			{
+				err = jbc_dim(ctx, t);
+				if (err) return err;
+				t = jbc_find_delimiter(t, NULL);
+			}
+			else
+				t = t->r;
+
+			continue;
+		}
+
+		// Ordinary instruction
+		jbas_token *t_delim = jbc_find_delimiter(t, NULL);
+		jbc_operand v;
+		jbc_emit(ctx, "{");
+		ctx->indent++;
+		err = jbc_eval(ctx, t, t_delim, &ctx->env->tokens, &v);
+		if (err) return err;
+		ctx->indent--;
+		jbc_emit(ctx, "}");
+		t = t_delim;
+	}
+
+	return JBAS_OK;
+}
+
+/**
+	Translates the entire program
+*/
+static jbas_error jbc_translate(jbas_env *env, FILE *out, const char *filename)
+{
+	jbc_ctx ctx = {.env = env};
+	char *body = NULL;
+	size_t body_size = 0;
+	jbas_error err = JBAS_ALLOC;
+
+	ctx.tree = malloc(sizeof(*ctx.tree));
+	ctx.values = malloc(JBAS_EXPR_MAX_NODES * sizeof(*ctx.values));
+	ctx.items = malloc(JBC_MAX_TUPLE_ITEMS * sizeof(*ctx.items));
+	ctx.used = calloc(env->symbol_manager.max_count, 1);
+	ctx.f = open_memstream(&body, &body_size);
+
+	if (ctx.tree && ctx.values && ctx.items && ctx.used && ctx.f)
+	{
+		ctx.indent = 1;
+		err = jbc_block(&ctx, jbas_token_list_begin(env->tokens), NULL);
+	}
+	if (ctx.f) fclose(ctx.f);
+
+	if (!err)
+	{
+		fprintf(out, "// Translated from %s by jbc\n", filename);
+		fprintf(out, "#include <jbasic/jbcrt.h>\n\n");
+
+		// Symbols
+		jbas_symbol_manager *sm = &env->symbol_manager;
+		for (int i = 0; i < sm->max_count; i++)
+		{
+			jbas_symbol *sym = &sm->symbol_storage[i];
+			if (!sm->is_used[i] || !ctx.used[i]) continue;
+
+			if (ctx.used[i] & JBC_USED_CFUN)
+				fprintf(out, "static jbc_cfun f%d = {.name = \"%s\"};\n", i, sym->res->cfun ? sym->name->str : "");
+			else if (sym->type == JBAS_TYPE_INT_ARRAY || sym->type == JBAS_TYPE_FLOAT_ARRAY)
+				fprintf(out, "static jbc_array v%d; // %s\n", i, sym->name->str);
+			else if (sym->type == JBAS_TYPE_POLY)
+				fprintf(out, "static jbc_value v%d = {.type = JBC_UNSET}; // %s\n", i, sym->name->str);
+			else
+				fprintf(out, "static %s v%d; // %s\n", jbc_c_type(sym->type), i, sym->name->str);
+		}
+
+		fprintf(out, "\nint main(void)\n{\n\tjbc_init();\n\n");
+		fwrite(body, 1, body_size, out);
+		fprintf(out, "\n\tjbc_exit();\n\treturn EXIT_SUCCESS;\n}\n");
+	}
+
+	free(body);
+	free(ctx.tree);
+	free(ctx.values);
+	free(ctx.items);
+	free(ctx.used);
+	return err;
+}
+
+
+// This is POSIX only <3
+#include <dlfcn.h>
+
+/**
+	Binds names of the C functions from JBASLIB (the functions themselves
+	are loaded by the translated program)
+*/
+static void dl_load(jbas_env *env)
+{
+	const char *libname = getenv("JBASLIB");
+	if (!libname) return;
+
+	void *handle = dlopen(libname, RTLD_LAZY);
+	if (!handle)
+	{
+		perror("could not load dynamic library");
+		jbas_env_destroy(env);
+		exit(EXIT_FAILURE);
+	}
+
+	int *abi = dlsym(handle, "jbas_abi_version");
+	if (!abi || *abi != JBAS_ABI_VERSION)
+	{
+		fprintf(stderr, "%s: built for a different interpreter version (ABI %d, expected %d)\n",
+			libname, abi ? *abi : 0, JBAS_ABI_VERSION);
+		jbas_env_destroy(env);
+		exit(EXIT_FAILURE);
+	}
+
+	jbas_cres *cres = dlsym(handle, "jbas_symbols");
+	int *crescnt = dlsym(handle, "jbas_symbol_count");
+	if (cres && crescnt && jbas_symbol_import(env, cres, *crescnt))
+	{
+		fprintf(stderr, "failed to create symbol during symbol import...\n");
+		exit(EXIT_FAILURE);
+	}
+
+	dlclose(handle);
+}
+
+int main(int argc, char *argv[])
+{
+	// Look for switches
+	const char *out_name = NULL;
+	for (int i = 2; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-o") && i + 1 < argc) out_name = argv[++i];
+		else argc = 0;
+	}
+
+	// Help message
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: %s FILENAME [-o OUTPUT]\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	jbas_env env;
+	jbas_env_init(&env, 100000, 10000, 10000, 10000, 10000);
+	dl_load(&env);
+
+	// Open file
+	FILE *f = fopen(argv[1], "rt");
+	if (!f)
+	{
+		perror("could not open input file!");
+		exit(EXIT_FAILURE);
+	}
+
+	// Read
+	size_t len = 10000;
+	char *line = malloc(len);
+	while (getline(&line, &len, f) > 0)
+	{
+		jbas_error err = jbas_tokenize_string(&env, line);
+		if (err)
+		{
+			fprintf(stderr, "tokenize error %d: %s\n", err, env.error_reason);
+			jbas_env_destroy(&env);
+			exit(EXIT_FAILURE);
+		}
+	}
+	free(line);
+	fclose(f);
+
+	// Types decide how the symbols are stored
+	jbas_error err = jbas_infer_types(&env);
+
+	// Translate
+	FILE *out = out_name ? fopen(out_name, "wt") : stdout;
+	if (!out)
+	{
+		perror("could not open output file!");
+		exit(EXIT_FAILURE);
+	}
+	if (!err) err = jbc_translate(&env, out, argv[1]);
+	if (out != stdout) fclose(out);
+
+	if (err)
+	{
+		fprintf(stderr, "translation error %d: %s\n", err, env.error_reason);
+		if (out_name) remove(out_name);
+		jbas_env_destroy(&env);
+		exit(EXIT_FAILURE);
+	}
+
+	jbas_env_destroy(&env);
+	return EXIT_SUCCESS;
+}
@@ -1,8 +1,25 @@
 #include <jbasic/jbasic.h>
 #include <jbasic/debug.h>
+#include <jbasic/opt.h>
+#include <jbasic/infer.h>
+#include <jbasic/jit.h>
+#include <jbasic/image.h>
+#include <jbasic/checkpoint.h>
+#include <jbasic/profile.h>
+#include "jbi_serve.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <time.h>
+#include <fcntl.h>
+#include <signal.h>
 
 
 // This is POSIX only <3
@@ -24,6 +41,16 @@ void *dl_load(jbas_env *env, int debug)
 			exit(EXIT_FAILURE);
 		}
 
+		// Libraries built against a different jbas_env layout would crash
+		int *abi = dlsym(handle, "jbas_abi_version");
+		if (!abi || *abi != JBAS_ABI_VERSION)
+		{
+			fprintf(stderr, "%s: built for a different interpreter version (ABI %d, expected %d)\n",
+				libname, abi ? *abi : 0, JBAS_ABI_VERSION);
+			jbas_env_destroy(env);
+			exit(EXIT_FAILURE);
+		}
+
 		// Load symbol list
 		jbas_cres *cres = dlsym(handle, "jbas_symbols");
 		if (!cres)
@@ -41,84 +68,499 @@ void *dl_load(jbas_env *env, int debug)
 		}
 
 		// Import all resources
-		for (int i = 0; i < *crescnt; i++)
+		if (debug)
+			for (int i = 0; i < *crescnt; i++)
+				fprintf(stderr, "importing %s...\n", cres[i].name);
+
+		if (jbas_symbol_import(env, cres, *crescnt))
 		{
-			if (debug) fprintf(stderr, "importing %s...\n", cres[i].name);
+			fprintf(stderr, "failed to create symbol during symbol import...\n");
+			exit(EXIT_FAILURE);
+		}
+	}
 
-			// Create/get symbol
-			jbas_symbol *sym = NULL;
-			jbas_error err = jbas_symbol_create(env, &sym, cres[i].name, NULL);
-			if (err == JBAS_OK || err == JBAS_SYMBOL_COLLISION)
-			{
-				// Create jbas resource
-				jbas_error err = jbas_resource_create(&env->resource_manager, &sym->res);
-				if (err)
-				{
-					fprintf(stderr, "failed to create resource during symbol import...\n");
-					exit(EXIT_FAILURE);
-				}
+	return handle;
+}
 
-				sym->res->type = JBAS_RESOURCE_CFUN;
-				sym->res->cfun = cres[i].cfun;
 
-			}
-			else
-			{
-				fprintf(stderr, "failed to create symbol during symbol import...\n");
-				exit(EXIT_FAILURE);
-			}
+// -------------------------------------- PROGRAM CACHE
+
+/*
+	Images of the programs that have been run are cached in
+	$XDG_CACHE_HOME/jbasic (~/.cache/jbasic by default). They're named
+	after a hash of the source, the symbols imported from JBASLIB and
+	the switches that change the image, so stale entries are never hit.
+*/
+
+/**
+	64-bit FNV-1a hash
+*/
+static uint64_t cache_hash(uint64_t h, const void *data, size_t size)
+{
+	const unsigned char *p = data;
+	if (!h) h = 0xcbf29ce484222325ull;
+	for (size_t i = 0; i < size; i++)
+		h = (h ^ p[i]) * 0x100000001b3ull;
+	return h;
+}
+
+/**
+	Returns path of the cache directory (created if needed) or NULL
+*/
+static const char *cache_dir(void)
+{
+	static char path[PATH_MAX];
+	const char *base = getenv("XDG_CACHE_HOME");
+	const char *home = getenv("HOME");
+	int len;
+
+	if (base && *base) len = snprintf(path, sizeof(path), "%s", base);
+	else if (home && *home) len = snprintf(path, sizeof(path), "%s/.cache", home);
+	else return NULL;
+	if (len < 0 || len >= sizeof(path)) return NULL;
+	if (mkdir(path, 0700) && errno != EEXIST) return NULL;
+
+	len = snprintf(path + len, sizeof(path) - len, "/jbasic") + len;
+	if (len >= sizeof(path)) return NULL;
+	if (mkdir(path, 0700) && errno != EEXIST) return NULL;
+	return path;
+}
 
+/**
+	Builds path of the cache entry for the program. Has to be called
+	before the program is loaded, when the only symbols are the imported ones.
+*/
+static bool cache_entry_path(jbas_env *env, const char *filename, int optimize, char *path, size_t size)
+{
+	const char *dir = cache_dir();
+	if (!dir) return false;
+
+	FILE *f = fopen(filename, "rb");
+	if (!f) return false;
+
+	char buf[4096];
+	size_t n;
+	uint64_t h = 0;
+	while ((n = fread(buf, 1, sizeof(buf), f)))
+		h = cache_hash(h, buf, n);
+	fclose(f);
+
+	jbas_symbol_manager *sm = &env->symbol_manager;
+	for (int i = 0; i < sm->max_count; i++)
+		if (sm->is_used[i])
+			h = cache_hash(h, sm->symbol_storage[i].name->str, sm->symbol_storage[i].name->length + 1);
+
+	int version = JBAS_IMAGE_VERSION;
+	h = cache_hash(h, &version, sizeof(version));
+	h = cache_hash(h, &optimize, sizeof(optimize));
+
+	return snprintf(path, size, "%s/%016" PRIx64 ".jbx", dir, h) < size;
+}
+
+/**
+	Prints the counters of the environment next to the sizes it has been
+	initialized with
+*/
+static void print_stats(const jbas_env *env, FILE *f)
+{
+	jbas_env_stats s;
+	jbas_env_get_stats(env, &s);
+
+	fprintf(f, "statements:  %" PRIu64 "\n", s.statements);
+	fprintf(f, "C calls:     %" PRIu64 "\n", s.cfun_calls);
+	fprintf(f, "tokens:      %" PRIu64 " taken, %" PRIu64 " returned, %d in use, %d at peak (of %d)\n",
+		s.tokens_taken, s.tokens_returned, s.tokens_used, s.tokens_peak, env->token_pool.pool_size);
+	fprintf(f, "resources:   %" PRIu64 " created, %" PRIu64 " deleted, %d in use, %d at peak (of %d)\n",
+		s.resources_created, s.resources_deleted, s.resources_used, s.resources_peak, env->resource_manager.max_count);
+	fprintf(f, "gc:          %" PRIu64 " runs, %" PRIu64 " resources collected\n", s.gc_runs, s.gc_collected);
+	fprintf(f, "arrays:      %" PRIu64 " bytes allocated\n", s.array_bytes);
+	fprintf(f, "texts:       %d in use (of %d)\n", s.texts_used, env->text_manager.max_count);
+	fprintf(f, "symbols:     %d in use (of %d)\n", s.symbols_used, env->symbol_manager.max_count);
+	fprintf(f, "memos:       %d in use (of %d)\n", s.memos_used, env->memo_manager.max_count);
+}
+
+/**
+	Reads the whole program (NULL on failure)
+*/
+static char *read_source(const char *filename)
+{
+	FILE *f = fopen(filename, "rb");
+	if (!f) return NULL;
+
+	char *s = NULL;
+	size_t len = 0, size = 0, n;
+	do
+	{
+		if (len + 4096 + 1 > size)
+		{
+			size = 2 * size + 4096 + 1;
+			char *p = realloc(s, size);
+			if (!p) break;
+			s = p;
 		}
+		n = fread(s + len, 1, size - len - 1, f);
+		len += n;
+	} while (n);
+	fclose(f);
 
+	if (s) s[len] = 0;
+	return s;
+}
+
+/**
+	Writes the image to a temporary file first, so other processes
+	never see a partially written entry
+*/
+static jbas_error cache_store(jbas_env *env, const char *path)
+{
+	char tmp[PATH_MAX];
+	if (snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path) >= sizeof(tmp)) return JBAS_IO_ERROR;
+
+	int fd = mkstemp(tmp);
+	if (fd < 0) return JBAS_IO_ERROR;
+
+	FILE *f = fdopen(fd, "wb");
+	if (!f)
+	{
+		close(fd);
+		remove(tmp);
+		return JBAS_IO_ERROR;
 	}
 
-	return handle;
+	jbas_error err = jbas_image_write(env, f);
+	if (fclose(f) && !err) err = JBAS_IO_ERROR;
+	if (!err && rename(tmp, path)) err = JBAS_IO_ERROR;
+	if (err) remove(tmp);
+	return err;
+}
+
+/**
+	Counts (or removes) the cache entries
+*/
+static int cache_scan(bool clear, off_t *total_size)
+{
+	const char *dir = cache_dir();
+	DIR *d = dir ? opendir(dir) : NULL;
+	if (!d) return 0;
+
+	int count = 0;
+	struct dirent *e;
+	if (total_size) *total_size = 0;
+	while ((e = readdir(d)))
+	{
+		if (e->d_name[0] == '.' || !strstr(e->d_name, ".jbx")) continue;
+
+		char path[PATH_MAX];
+		struct stat st;
+		if (snprintf(path, sizeof(path), "%s/%s", dir, e->d_name) >= sizeof(path)) continue;
+		if (clear && remove(path)) continue;
+		if (!clear && total_size && !stat(path, &st)) *total_size += st.st_size;
+		count++;
+	}
+
+	closedir(d);
+	return count;
+}
+
+// --------------------------------------
+
+static jbas_env *checkpoint_env;
+static const char *checkpoint_path;
+static int checkpoint_debug;
+
+static void checkpoint_alarm(int sig)
+{
+	(void) sig;
+	if (checkpoint_env) checkpoint_env->checkpoint_pending = 1;
+}
+
+/**
+	Writes the checkpoint next to the old one and replaces it once
+	the new one is complete. Failed checkpoints don't stop the program.
+*/
+static jbas_error checkpoint_store(jbas_env *env)
+{
+	char tmp[PATH_MAX];
+	if (snprintf(tmp, sizeof(tmp), "%s.tmp", checkpoint_path) >= sizeof(tmp)) return JBAS_IO_ERROR;
+	int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) return JBAS_IO_ERROR;
+
+	struct timespec t0, t1;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	jbas_error err = jbas_env_checkpoint(env, fd);
+	if (!err && fsync(fd)) err = JBAS_IO_ERROR;
+	if (close(fd) && !err) err = JBAS_IO_ERROR;
+	if (!err && rename(tmp, checkpoint_path)) err = JBAS_IO_ERROR;
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	if (!err && checkpoint_debug)
+		fprintf(stderr, "checkpoint: %s written in %.1f ms\n", checkpoint_path,
+			(t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6);
+
+	if (err)
+	{
+		fprintf(stderr, "checkpoint error %d: %s\n", err, err == JBAS_IO_ERROR ? strerror(errno) : env->error_reason);
+		remove(tmp);
+	}
+	return JBAS_OK;
+}
+
+/**
+	Requests a checkpoint every `interval` seconds
+*/
+static void checkpoint_start(jbas_env *env, const char *path, int interval, int debug)
+{
+	checkpoint_env = env;
+	checkpoint_path = path;
+	checkpoint_debug = debug;
+	env->checkpoint_handler = checkpoint_store;
+
+	// Restarted, so that the program input is not interrupted
+	struct sigaction sa = {.sa_handler = checkpoint_alarm, .sa_flags = SA_RESTART};
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGALRM, &sa, NULL);
+
+	struct itimerval it = {.it_interval = {interval, 0}, .it_value = {interval, 0}};
+	setitimer(ITIMER_REAL, &it, NULL);
 }
 
+// --------------------------------------
+
 
 int main(int argc, char *argv[])
 {
-	// Look for debug switch
-	int debug = argc > 2 && !strcmp(argv[2], "-debug"); 
+	// Look for switches
+	int debug = 0, optimize = 1, opt_report = 0, jit = 0, use_cache = 1, clear_cache = 0, checkpoint_every = 10, threads = 0, jobs = 0, arena = 0, profile = 0, sample_every = 1000, stats = 0;
+	int64_t budget = -1;
+	size_t memory_limit = 0;
+	char **inputs = malloc(argc * sizeof(char*));
+	int input_count = 0;
+	if (!inputs)
+	{
+		perror("jbi");
+		exit(EXIT_FAILURE);
+	}
+	const char *filename = NULL, *image_out = NULL, *checkpoint_out = NULL, *restore = NULL, *serve = NULL, *client = NULL, *sample_out = NULL;
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-debug")) debug = 1;
+		else if (!strcmp(argv[i], "-jit")) jit = JBAS_JIT_DEFAULT_THRESHOLD;
+		else if (!strncmp(argv[i], "-jit=", 5) && atoi(argv[i] + 5) > 0) jit = atoi(argv[i] + 5);
+		else if (!strcmp(argv[i], "-noopt")) optimize = 0;
+		else if (!strcmp(argv[i], "-opt-report")) opt_report = 1;
+		else if (!strcmp(argv[i], "-c") && i + 1 < argc) image_out = argv[++i];
+		else if (!strcmp(argv[i], "-nocache")) use_cache = 0;
+		else if (!strcmp(argv[i], "-clear-cache")) clear_cache = 1;
+		else if (!strcmp(argv[i], "-checkpoint") && i + 1 < argc) checkpoint_out = argv[++i];
+		else if (!strcmp(argv[i], "-checkpoint-every") && i + 1 < argc && atoi(argv[i + 1]) > 0) checkpoint_every = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-restore") && i + 1 < argc) restore = argv[++i];
+		else if (!strcmp(argv[i], "-threads") && i + 1 < argc && atoi(argv[i + 1]) > 0) threads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-budget") && i + 1 < argc && atoll(argv[i + 1]) > 0) budget = atoll(argv[++i]);
+		else if (!strcmp(argv[i], "-memory-limit") && i + 1 < argc && atoi(argv[i + 1]) > 0) memory_limit = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-arena")) arena = 1;
+		else if (!strcmp(argv[i], "-profile")) profile = 1;
+		else if (!strcmp(argv[i], "-stats")) stats = 1;
+		else if (!strcmp(argv[i], "-sample") && i + 1 < argc) sample_out = argv[++i];
+		else if (!strcmp(argv[i], "-sample-every") && i + 1 < argc && atoi(argv[i + 1]) > 0) sample_every = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-j") && i + 1 < argc && atoi(argv[i + 1]) > 0) jobs = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--serve") && i + 1 < argc) serve = argv[++i];
+		else if (!strcmp(argv[i], "--client") && i + 1 < argc) client = argv[++i];
+		else if (argv[i][0] != '-' && !filename) filename = argv[i];
+		else if (argv[i][0] != '-') inputs[input_count++] = argv[i];
+		else filename = NULL, argc = 0;
+	}
+
+	// Inputs are for the batch mode only, which doesn't take checkpoints
+	if (input_count && (!jobs || image_out || checkpoint_out || restore)) filename = NULL;
+	if (jobs && !input_count) filename = NULL;
+
+	// Clear the cache (and exit if there's nothing to run)
+	if (argc && clear_cache)
+	{
+		int removed = cache_scan(true, NULL);
+		if (debug) fprintf(stderr, "cache: removed %d entries\n", removed);
+		if (!filename) return EXIT_SUCCESS;
+	}
+
+	if (argc && client && filename && !input_count)
+		return client_main(client, filename);
 
 	// Help message
-	if (argc < 2)
+	if (!filename && !(argc && serve && !input_count))
+	{
+		fprintf(stderr, "Usage: %s FILENAME [-c IMAGE] [-debug] [-noopt] [-opt-report] [-jit[=N]] [-nocache] [-clear-cache]\n"
+			"\t[-checkpoint FILE] [-checkpoint-every SECONDS] [-restore FILE] [-threads N] [-budget STEPS]\n"
+			"\t[-memory-limit MB] [-arena] [-profile] [-sample FILE] [-sample-every MICROSECONDS] [-stats]\n"
+			"       %s -j N FILENAME INPUT... [-jit[=N]] [-noopt] [-nocache] [-threads N] [-budget STEPS] [-memory-limit MB]\n"
+			"       %s --serve SOCKET [-j N] [-jit[=N]] [-noopt] [-threads N] [-budget STEPS] [-memory-limit MB] [-debug]\n"
+			"       %s --client SOCKET FILENAME\n", argv[0], argv[0], argv[0], argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	// All memory of a single run can be freed at once at the end
+	jbas_allocator allocator = jbas_libc_allocator;
+	if (arena && jbas_arena_allocator_init(&allocator, 1 << 20))
 	{
-		fprintf(stderr, "Usage: %s FILENAME [-debug]\n", argv[0]);
+		fprintf(stderr, "could not create the arena\n");
 		exit(EXIT_FAILURE);
 	}
 
 	jbas_env env;
-	jbas_env_init(&env, 100000, 10000, 10000, 10000);
+	if (jbas_env_init_with_allocator(&env, &allocator, 100000, 10000, 10000, 10000, 10000))
+	{
+		fprintf(stderr, "could not create the environment\n");
+		exit(EXIT_FAILURE);
+	}
+	env.jit_threshold = jit;
+	env.thread_count = threads;
+	env.budget = budget;
+	env.memory.limit = memory_limit << 20;
+
+	// The tables are charged up front, the limit has to leave room for the program
+	if (env.memory.limit && env.memory.limit <= env.memory.used)
+	{
+		fprintf(stderr, "-memory-limit %zu MB is below the %.1f MB taken by the environment's tables\n",
+			memory_limit, env.memory.used / 1048576.0);
+		jbas_env_destroy(&env);
+		exit(EXIT_FAILURE);
+	}
 
 	// Import C resources
 	void *handle = dl_load(&env, debug);
 
-	// Open file
-	FILE *f = fopen(argv[1], "rt");
-	if (!f)
+	if (serve)
 	{
-		perror("could not open input file!");
-		exit(EXIT_FAILURE);
+		free(inputs);
+		return serve_main(&env, serve, jobs, optimize ? JBAS_OPT_ALL : 0, debug);
 	}
 
-	// Read
-	size_t len = 10000;
-	char *line = malloc(len);
-	while (getline(&line, &len, f) > 0)
+	// Precompiled images are already optimized and have the types inferred
+	bool image = jbas_image_probe(filename);
+	if (image)
 	{
-		jbas_error err = jbas_tokenize_string(&env, line);
+		jbas_error err = jbas_image_load(&env, filename);
 		if (err)
 		{
-			fprintf(stderr, "tokenize error %d: %s\n", err, env.error_reason);
+			fprintf(stderr, "image load error %d: %s\n", err, env.error_reason);
 			jbas_env_destroy(&env);
 			exit(EXIT_FAILURE);
 		}
 	}
-	free(line);
 
-	// Close file
-	fclose(f);
+	// Look the program up in the cache. The optimizer report and
+	// explicitly written images need the program to be processed
+	char cache_path[PATH_MAX];
+	bool cache_miss = false;
+	if (!image && use_cache && !image_out && !opt_report
+		&& cache_entry_path(&env, filename, optimize, cache_path, sizeof(cache_path)))
+	{
+		jbas_error err = access(cache_path, R_OK) ? JBAS_IO_ERROR : jbas_image_load(&env, cache_path);
+		image = !err;
+		cache_miss = !image;
+
+		// Missing and rejected entries leave the environment untouched
+		if (err && err != JBAS_IO_ERROR && err != JBAS_BAD_IMAGE)
+		{
+			fprintf(stderr, "image load error %d: %s\n", err, env.error_reason);
+			jbas_env_destroy(&env);
+			exit(EXIT_FAILURE);
+		}
+
+		if (debug)
+		{
+			off_t size;
+			int count = cache_scan(false, &size);
+			fprintf(stderr, "cache %s: %s (%d entries, %lld bytes)\n",
+				image ? "hit" : "miss", cache_path, count, (long long) size);
+		}
+	}
+
+	if (!image)
+	{
+		// Open file
+		FILE *f = fopen(filename, "rt");
+		if (!f)
+		{
+			perror("could not open input file!");
+			exit(EXIT_FAILURE);
+		}
+
+		// Read
+		size_t len = 10000;
+		char *line = malloc(len);
+		while (getline(&line, &len, f) > 0)
+		{
+			jbas_error err = jbas_tokenize_string(&env, line);
+			if (err)
+			{
+				fprintf(stderr, "tokenize error %d: %s\n", err, env.error_reason);
+				jbas_env_destroy(&env);
+				exit(EXIT_FAILURE);
+			}
+		}
+		free(line);
+
+		// Close file
+		fclose(f);
+	}
+
+	// Optimize
+	if (optimize && !image)
+	{
+		jbas_error err = jbas_optimize(&env, JBAS_OPT_ALL, opt_report ? stderr : NULL);
+		if (err)
+		{
+			fprintf(stderr, "optimizer error %d: %s\n", err, env.error_reason);
+			jbas_env_destroy(&env);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	// Infer symbol types
+	if (!image)
+	{
+		jbas_error infer_err = jbas_infer_types(&env);
+		if (infer_err)
+		{
+			fprintf(stderr, "type inference error %d\n", infer_err);
+			jbas_env_destroy(&env);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	// Store the processed program in the cache
+	if (cache_miss)
+	{
+		jbas_error err = cache_store(&env, cache_path);
+		if (err && debug) fprintf(stderr, "cache: could not store %s\n", cache_path);
+	}
+
+	// Write the image instead of running the program
+	if (image_out)
+	{
+		FILE *out = fopen(image_out, "wb");
+		if (!out)
+		{
+			perror("could not open output file!");
+			jbas_env_destroy(&env);
+			exit(EXIT_FAILURE);
+		}
+
+		jbas_error err = jbas_image_write(&env, out);
+		if (fclose(out) && !err) err = JBAS_IO_ERROR;
+		if (err)
+		{
+			fprintf(stderr, "image write error %d: %s\n", err, env.error_reason);
+			remove(image_out);
+			jbas_env_destroy(&env);
+			exit(EXIT_FAILURE);
+		}
+
+		if (handle) dlclose(handle);
+		jbas_env_destroy(&env);
+		return EXIT_SUCCESS;
+	}
 
 	// Debug dump
 	if (debug)
@@ -127,14 +569,90 @@ int main(int argc, char *argv[])
 		printf("\n\n\n");
 	}
 
+	// Run over all the inputs
+	if (jobs)
+	{
+		int failed = batch_main(&env, inputs, input_count, jobs);
+		free(inputs);
+		if (handle) dlclose(handle);
+		jbas_env_destroy(&env);
+		return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+	free(inputs);
+
+	// Continue from a checkpoint
+	if (restore)
+	{
+		int fd = open(restore, O_RDONLY);
+		jbas_error err = fd < 0 ? JBAS_IO_ERROR : jbas_env_restore(&env, fd, NULL, 0);
+		if (fd >= 0) close(fd);
+		if (err)
+		{
+			fprintf(stderr, "restore error %d: %s\n", err, fd < 0 ? strerror(errno) : env.error_reason);
+			jbas_env_destroy(&env);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (checkpoint_out)
+		checkpoint_start(&env, checkpoint_out, checkpoint_every, debug);
+
+	jbas_profile prof;
+	if (profile)
+	{
+		jbas_profile_init(&prof);
+		env.profile = &prof;
+	}
+
+	jbas_sampler sampler;
+	if (sample_out)
+	{
+		jbas_error err = jbas_sampler_start(&sampler, &env, sample_every);
+		if (err)
+		{
+			fprintf(stderr, "could not start the sampler (error %d)\n", err);
+			jbas_env_destroy(&env);
+			exit(EXIT_FAILURE);
+		}
+	}
+
 	// Run
 	jbas_error err = jbas_run(&env);
+	if (sample_out) jbas_sampler_stop(&sampler);
+
+	// Per-line profile and samples (quoting the source unless an image has been run)
+	char *source = (profile || sample_out) && !jbas_image_probe(filename) ? read_source(filename) : NULL;
+	if (profile)
+	{
+		fflush(stdout);
+		jbas_profile_report(&prof, stderr, source);
+		env.profile = NULL;
+		jbas_profile_destroy(&prof);
+	}
+
+	if (sample_out)
+	{
+		FILE *out = fopen(sample_out, "w");
+		jbas_error serr = out ? jbas_sampler_write(&sampler, out, source) : JBAS_IO_ERROR;
+		if (out && fclose(out) && !serr) serr = JBAS_IO_ERROR;
+		if (serr) fprintf(stderr, "could not write the samples to %s\n", sample_out);
+		else if (debug) fprintf(stderr, "sampler: %" PRIu64 " samples written to %s\n", sampler.samples, sample_out);
+		jbas_sampler_destroy(&sampler);
+	}
+	free(source);
+
+	if (stats)
+	{
+		fflush(stdout);
+		print_stats(&env, stderr);
+	}
 
 	// Symbol table dump
 	if (debug)
 	{
 		printf("\n\n\n");
 		jbas_debug_dump_symbol_table(stderr, &env);
+		fprintf(stderr, "memory: %zu bytes used, %zu bytes at peak\n", env.memory.used, env.memory.peak);
 		// printf("\n\n\n");
 		// jbas_debug_dump_resource_manager(stderr, &env.resource_manager);
 		// jbas_resource_manager_garbage_collect(&env.resource_manager, NULL);
@@ -0,0 +1,761 @@
+#include "jbi_serve.h"
+#include <jbasic/image.h>
+#include <jbasic/program.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// -------------------------------------- BATCH MODE
+
+/*
+	`jbi -j N script inputs...` runs the program over every input file.
+	The program is processed once and its image is linked into one
+	environment per thread. Outputs are printed in the order of the inputs.
+*/
+
+typedef struct batch_result
+{
+	char *output;
+	size_t size;
+	jbas_error err;
+	const char *error_reason;
+	double ms;      //!< Latency
+	bool done;
+} batch_result;
+
+typedef struct batch
+{
+	char **inputs;
+	int count;
+	int next;       //!< Next input to be taken
+	int64_t budget; //!< Instruction budget of every run (-1 = no limit)
+	batch_result *results;
+	pthread_mutex_t lock;
+	pthread_cond_t done;
+} batch;
+
+typedef struct batch_worker
+{
+	batch *b;
+	jbas_env env;
+	pthread_t thread;
+} batch_worker;
+
+/**
+	Sets up an environment of a batch or server worker like `tmpl` - with
+	the same table sizes, settings and C functions
+*/
+static jbas_error worker_env_init(jbas_env *env, const jbas_env *tmpl)
+{
+	jbas_error err = jbas_env_init(env,
+		tmpl->token_pool.pool_size,
+		tmpl->text_manager.max_count,
+		tmpl->symbol_manager.max_count,
+		tmpl->resource_manager.max_count,
+		tmpl->memo_manager.max_count);
+	env->jit_threshold = tmpl->jit_threshold;
+	env->thread_count = tmpl->thread_count;
+	env->memory.limit = tmpl->memory.limit;
+
+	const jbas_symbol_manager *sm = &tmpl->symbol_manager;
+	for (int i = 0; !err && i < sm->max_count; i++)
+	{
+		jbas_symbol *sym = &sm->symbol_storage[i];
+		if (!sm->is_used[i] || !sym->res || sym->res->type != JBAS_RESOURCE_CFUN) continue;
+
+		jbas_cres cres = {.name = sym->name->str, .cfun = sym->res->cfun};
+		err = jbas_symbol_import(env, &cres, 1);
+	}
+	return err;
+}
+
+static double elapsed_ms(const struct timespec *t0, const struct timespec *t1)
+{
+	return (t1->tv_sec - t0->tv_sec) * 1e3 + (t1->tv_nsec - t0->tv_nsec) / 1e6;
+}
+
+/**
+	Runs the program over one input with the output kept in memory
+*/
+static void batch_run(jbas_env *env, const char *input, int64_t budget, batch_result *r)
+{
+	struct timespec t0, t1;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	env->input = fopen(input, "rt");
+	env->output = open_memstream(&r->output, &r->size);
+	if (!env->input || !env->output)
+	{
+		r->err = JBAS_IO_ERROR;
+		r->error_reason = strerror(errno);
+	}
+	else
+	{
+		env->budget = budget;
+		r->err = jbas_run(env);
+		r->error_reason = env->error_reason;
+	}
+
+	if (env->input) fclose(env->input);
+	if (env->output) fclose(env->output);
+	jbas_env_reset(env);
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	r->ms = elapsed_ms(&t0, &t1);
+}
+
+static void *batch_thread(void *arg)
+{
+	batch_worker *w = arg;
+	batch *b = w->b;
+
+	for (;;)
+	{
+		pthread_mutex_lock(&b->lock);
+		int k = b->next++;
+		pthread_mutex_unlock(&b->lock);
+		if (k >= b->count) break;
+
+		batch_result r = {0};
+		batch_run(&w->env, b->inputs[k], b->budget, &r);
+
+		pthread_mutex_lock(&b->lock);
+		b->results[k] = r;
+		b->results[k].done = true;
+		pthread_cond_broadcast(&b->done);
+		pthread_mutex_unlock(&b->lock);
+	}
+
+	return NULL;
+}
+
+static int batch_cmp(const void *a, const void *b)
+{
+	double x = *(const double*) a, y = *(const double*) b;
+	return (x > y) - (x < y);
+}
+
+/**
+	Nearest-rank percentile of sorted values
+*/
+static double batch_percentile(const double *v, int n, double p)
+{
+	int k = (int) ceil(p * n) - 1;
+	return v[k < 0 ? 0 : k];
+}
+
+/**
+	Runs the program in `env` over the inputs on `jobs` threads and
+	reports the throughput and latencies. Returns the number of failed inputs.
+*/
+int batch_main(jbas_env *env, char **inputs, int count, int jobs)
+{
+	char *image = NULL;
+	size_t size = 0;
+	FILE *f = open_memstream(&image, &size);
+	jbas_error err = f ? jbas_image_write(env, f) : JBAS_ALLOC;
+	if (f && fclose(f) && !err) err = JBAS_IO_ERROR;
+	if (err)
+	{
+		fprintf(stderr, "image write error %d: %s\n", err, env->error_reason);
+		free(image);
+		return count;
+	}
+
+	if (jobs > count) jobs = count;
+	batch b = {.inputs = inputs, .count = count, .budget = env->budget};
+	b.results = calloc(count, sizeof(batch_result));
+	batch_worker *workers = calloc(jobs, sizeof(batch_worker));
+	double *ms = malloc(count * sizeof(double));
+	if (!b.results || !workers || !ms)
+	{
+		perror("batch");
+		exit(EXIT_FAILURE);
+	}
+	pthread_mutex_init(&b.lock, NULL);
+	pthread_cond_init(&b.done, NULL);
+
+	// Every worker gets the program and the C functions
+	for (int i = 0; i < jobs; i++)
+	{
+		batch_worker *w = &workers[i];
+		w->b = &b;
+		err = worker_env_init(&w->env, env);
+		if (!err) err = jbas_image_load_memory(&w->env, image, size);
+		if (err)
+		{
+			fprintf(stderr, "image load error %d: %s\n", err, w->env.error_reason);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	struct timespec t0, t1;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (int i = 0; i < jobs; i++)
+		if (pthread_create(&workers[i].thread, NULL, batch_thread, &workers[i]))
+		{
+			perror("could not start a batch thread");
+			exit(EXIT_FAILURE);
+		}
+
+	// Outputs in the order of the inputs
+	int failed = 0;
+	for (int k = 0; k < count; k++)
+	{
+		pthread_mutex_lock(&b.lock);
+		while (!b.results[k].done)
+			pthread_cond_wait(&b.done, &b.lock);
+		pthread_mutex_unlock(&b.lock);
+
+		batch_result *r = &b.results[k];
+		fwrite(r->output, 1, r->size, stdout);
+		fflush(stdout);
+		if (r->err)
+		{
+			fprintf(stderr, "%s: run error %d: %s\n", inputs[k], r->err, r->error_reason);
+			failed++;
+		}
+
+		ms[k] = r->ms;
+		free(r->output);
+	}
+
+	for (int i = 0; i < jobs; i++)
+	{
+		pthread_join(workers[i].thread, NULL);
+		jbas_env_destroy(&workers[i].env);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	double total = elapsed_ms(&t0, &t1);
+	qsort(ms, count, sizeof(double), batch_cmp);
+	fprintf(stderr, "batch: %d inputs (%d failed) on %d threads in %.1f ms, %.1f inputs/s\n",
+		count, failed, jobs, total, total > 0 ? count * 1e3 / total : 0.0);
+	fprintf(stderr, "latency: p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+		batch_percentile(ms, count, 0.5), batch_percentile(ms, count, 0.9),
+		batch_percentile(ms, count, 0.99), ms[count - 1]);
+
+	pthread_mutex_destroy(&b.lock);
+	pthread_cond_destroy(&b.done);
+	free(b.results);
+	free(workers);
+	free(ms);
+	free(image);
+	return failed;
+}
+
+// -------------------------------------- SERVER
+
+/*
+	`jbi --serve SOCKET` keeps the compiled programs and warm environments
+	and runs the scripts for `jbi --client SOCKET script` over a UNIX domain
+	socket. Every connection carries one request - the script path and its
+	input - and one response with the output and the status. The programs
+	are recompiled when the script changes.
+
+	Request:  serve_request, char path[path_length], char input[input_size]
+	Response: serve_response, char error[error_length], char output[output_size]
+*/
+
+#define SERVE_REQUEST_MAGIC "JBRQ"
+#define SERVE_RESPONSE_MAGIC "JBRS"
+#define SERVE_MAX_INPUT (1u << 30)
+#define SERVE_ENV_SLOTS 4
+#define SERVE_IO_TIMEOUT 10 //!< Seconds a stalled client may hold a worker for
+
+typedef struct serve_request
+{
+	char magic[4];
+	uint32_t path_length;
+	uint64_t input_size;
+} serve_request;
+
+typedef struct serve_response
+{
+	char magic[4];
+	int32_t status;        //!< jbas_error of the run
+	uint32_t error_length;
+	uint32_t reserved;
+	uint64_t output_size;
+} serve_response;
+
+/**
+	Compiled script. Entries replaced by a newer version are freed
+	once no environment uses them.
+*/
+typedef struct serve_program
+{
+	struct serve_program *next;
+	char *path;
+	struct timespec mtime;
+	off_t size;
+	jbas_program *program;
+	int refs;              //!< Environments linked to it (+1 while current)
+} serve_program;
+
+typedef struct server
+{
+	int fd;
+	jbas_env *env;         //!< Provides the C functions
+	int opt_flags;
+	int debug;
+	pthread_mutex_t lock;
+	serve_program *programs;
+} server;
+
+typedef struct serve_worker
+{
+	server *srv;
+	pthread_t thread;
+	struct
+	{
+		serve_program *prog;
+		jbas_env env;
+		unsigned long used; //!< For replacing the least recently used one
+	} slots[SERVE_ENV_SLOTS];
+	unsigned long clock;
+} serve_worker;
+
+static bool read_full(int fd, void *buf, size_t size)
+{
+	for (char *p = buf; size; )
+	{
+		ssize_t n = read(fd, p, size);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return false;
+		p += n;
+		size -= n;
+	}
+	return true;
+}
+
+static bool write_full(int fd, const void *buf, size_t size)
+{
+	for (const char *p = buf; size; )
+	{
+		ssize_t n = write(fd, p, size);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return false;
+		p += n;
+		size -= n;
+	}
+	return true;
+}
+
+static void serve_program_release(server *srv, serve_program *p)
+{
+	pthread_mutex_lock(&srv->lock);
+	if (!--p->refs)
+	{
+		jbas_program_destroy(p->program);
+		free(p->path);
+		free(p);
+	}
+	pthread_mutex_unlock(&srv->lock);
+}
+
+/**
+	Returns the current version of the script (compiled if needed) with
+	a reference taken, or NULL with `error` set
+*/
+static serve_program *serve_program_get(server *srv, const char *path, const char **error)
+{
+	struct stat st;
+	if (stat(path, &st))
+	{
+		*error = strerror(errno);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&srv->lock);
+	serve_program **link = &srv->programs, *p;
+	for (p = *link; p && strcmp(p->path, path); p = *link)
+		link = &p->next;
+
+	// Changed scripts are compiled again
+	if (p && (p->size != st.st_size || p->mtime.tv_sec != st.st_mtim.tv_sec || p->mtime.tv_nsec != st.st_mtim.tv_nsec))
+	{
+		*link = p->next;
+		if (!--p->refs)
+		{
+			jbas_program_destroy(p->program);
+			free(p->path);
+			free(p);
+		}
+		p = NULL;
+	}
+
+	// Compiled under the lock, the template environment is shared
+	if (!p)
+	{
+		FILE *f = fopen(path, "rb");
+		char *source = NULL;
+		size_t size = 0;
+		FILE *m = open_memstream(&source, &size);
+		if (f && m)
+		{
+			char buf[4096];
+			size_t n;
+			while ((n = fread(buf, 1, sizeof(buf), f)))
+				fwrite(buf, 1, n, m);
+		}
+		if (f) fclose(f);
+		if (m) fclose(m);
+
+		jbas_program *program = NULL;
+		jbas_error err = f && m ? jbas_compile(srv->env, source, srv->opt_flags, &program) : JBAS_IO_ERROR;
+		free(source);
+		if (err)
+		{
+			*error = err == JBAS_IO_ERROR && !srv->env->error_reason ? "could not read the script" : srv->env->error_reason;
+			if (!*error) *error = "compilation failed";
+			srv->env->error_reason = NULL;
+			pthread_mutex_unlock(&srv->lock);
+			return NULL;
+		}
+
+		p = calloc(1, sizeof(serve_program));
+		if (p) p->path = strdup(path);
+		if (!p || !p->path)
+		{
+			free(p);
+			jbas_program_destroy(program);
+			*error = "out of memory";
+			pthread_mutex_unlock(&srv->lock);
+			return NULL;
+		}
+
+		p->program = program;
+		p->mtime = st.st_mtim;
+		p->size = st.st_size;
+		p->refs = 1;
+		p->next = srv->programs;
+		srv->programs = p;
+		if (srv->debug) fprintf(stderr, "serve: compiled %s\n", path);
+	}
+
+	p->refs++;
+	pthread_mutex_unlock(&srv->lock);
+	return p;
+}
+
+/**
+	Returns a warm environment with the program linked. The least
+	recently used one is replaced if there is none.
+*/
+static jbas_env *serve_env_get(serve_worker *w, serve_program *p, const char **error)
+{
+	int slot = 0;
+	for (int i = 0; i < SERVE_ENV_SLOTS; i++)
+	{
+		if (w->slots[i].prog == p)
+		{
+			serve_program_release(w->srv, p);
+			w->slots[i].used = ++w->clock;
+			return &w->slots[i].env;
+		}
+		if (w->slots[i].used < w->slots[slot].used) slot = i;
+	}
+
+	if (w->slots[slot].prog)
+	{
+		jbas_env_destroy(&w->slots[slot].env);
+		serve_program_release(w->srv, w->slots[slot].prog);
+		w->slots[slot].prog = NULL;
+	}
+
+	jbas_env *env = &w->slots[slot].env;
+	jbas_error err = worker_env_init(env, w->srv->env);
+	if (!err) err = jbas_link(env, p->program);
+	if (err)
+	{
+		*error = env->error_reason ? env->error_reason : "could not set up the environment";
+		jbas_env_destroy(env);
+		serve_program_release(w->srv, p);
+		return NULL;
+	}
+
+	w->slots[slot].prog = p;
+	w->slots[slot].used = ++w->clock;
+	return env;
+}
+
+/**
+	Reads one request from the connection, runs it and sends the response
+*/
+static void serve_connection(serve_worker *w, int fd)
+{
+	struct timespec t0, t1;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	serve_request rq;
+	if (!read_full(fd, &rq, sizeof(rq)) || memcmp(rq.magic, SERVE_REQUEST_MAGIC, 4)
+		|| !rq.path_length || rq.path_length >= PATH_MAX || rq.input_size > SERVE_MAX_INPUT)
+		return;
+
+	char path[PATH_MAX];
+	char *input = malloc(rq.input_size + 1);
+	if (!input || !read_full(fd, path, rq.path_length) || !read_full(fd, input, rq.input_size))
+	{
+		free(input);
+		return;
+	}
+	path[rq.path_length] = 0;
+
+	serve_response rs = {.magic = SERVE_RESPONSE_MAGIC};
+	const char *error = NULL;
+	char *output = NULL;
+	size_t output_size = 0;
+
+	jbas_env *env = NULL;
+	serve_program *p = serve_program_get(w->srv, path, &error);
+	if (p) env = serve_env_get(w, p, &error);
+	if (env)
+	{
+		// fmemopen() doesn't take empty buffers
+		env->input = rq.input_size ? fmemopen(input, rq.input_size, "r") : fopen("/dev/null", "r");
+		env->output = open_memstream(&output, &output_size);
+		env->budget = w->srv->env->budget;
+		if (env->input && env->output)
+			rs.status = jbas_run(env);
+		else
+			rs.status = JBAS_ALLOC;
+
+		if (rs.status) error = env->error_reason ? env->error_reason : "run failed";
+		if (env->input) fclose(env->input);
+		if (env->output) fclose(env->output);
+		jbas_env_reset(env);
+	}
+	else
+		rs.status = JBAS_IO_ERROR;
+
+	rs.error_length = rs.status && error ? strlen(error) : 0;
+	rs.output_size = output_size;
+	bool sent = write_full(fd, &rs, sizeof(rs))
+		&& write_full(fd, error, rs.error_length)
+		&& write_full(fd, output, output_size);
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	if (w->srv->debug)
+		fprintf(stderr, "serve: %s status %d in %.3f ms%s\n", path, rs.status, elapsed_ms(&t0, &t1),
+			sent ? "" : " (client gone)");
+
+	free(output);
+	free(input);
+}
+
+static void *serve_thread(void *arg)
+{
+	serve_worker *w = arg;
+	for (;;)
+	{
+		int fd = accept(w->srv->fd, NULL, NULL);
+		if (fd < 0)
+		{
+			if (errno == EINTR || errno == ECONNABORTED) continue;
+			perror("accept");
+			break;
+		}
+
+		// A client that stops reading or writing must not hold up the worker
+		struct timeval timeout = {.tv_sec = SERVE_IO_TIMEOUT};
+		setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+		serve_connection(w, fd);
+		close(fd);
+	}
+
+	return NULL;
+}
+
+static const char *serve_socket_path;
+
+/**
+	Removes the socket when the server is killed by SIGTERM or SIGINT
+*/
+static void serve_signal(int sig)
+{
+	unlink(serve_socket_path);
+	signal(sig, SIG_DFL);
+	raise(sig);
+}
+
+/**
+	Removes the socket left behind by a server that's gone. Returns false
+	when the path isn't a socket or a server still listens there.
+*/
+static bool serve_remove_stale(const char *socket_path, const struct sockaddr_un *addr)
+{
+	struct stat st;
+	if (lstat(socket_path, &st))
+		return errno == ENOENT;
+
+	if (!S_ISSOCK(st.st_mode))
+	{
+		fprintf(stderr, "%s exists and isn't a socket\n", socket_path);
+		return false;
+	}
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	bool live = fd >= 0 && !connect(fd, (const struct sockaddr*) addr, sizeof(*addr));
+	if (fd >= 0) close(fd);
+	if (live)
+	{
+		fprintf(stderr, "a server is already listening on %s\n", socket_path);
+		return false;
+	}
+
+	return !unlink(socket_path) || errno == ENOENT;
+}
+
+/**
+	Serves requests on `jobs` threads until killed
+*/
+int serve_main(jbas_env *env, const char *socket_path, int jobs, int opt_flags, int debug)
+{
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	if (strlen(socket_path) >= sizeof(addr.sun_path))
+	{
+		fprintf(stderr, "socket path is too long\n");
+		return EXIT_FAILURE;
+	}
+	strcpy(addr.sun_path, socket_path);
+
+	if (!serve_remove_stale(socket_path, &addr))
+		return EXIT_FAILURE;
+
+	server srv = {.env = env, .opt_flags = opt_flags, .debug = debug};
+	srv.fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	// Only the owner may connect - the scripts run with the server's rights.
+	// Nobody can connect before listen(), so there's no window in between.
+	if (srv.fd < 0 || bind(srv.fd, (struct sockaddr*) &addr, sizeof(addr))
+		|| chmod(socket_path, 0600) || listen(srv.fd, 128))
+	{
+		perror("could not listen on the socket");
+		return EXIT_FAILURE;
+	}
+
+	// Clients going away must not kill the server
+	signal(SIGPIPE, SIG_IGN);
+	serve_socket_path = socket_path;
+	struct sigaction sa = {.sa_handler = serve_signal};
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGTERM, &sa, NULL);
+	sigaction(SIGINT, &sa, NULL);
+	pthread_mutex_init(&srv.lock, NULL);
+
+	if (jobs <= 0) jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	if (jobs <= 0) jobs = 1;
+	serve_worker *workers = calloc(jobs, sizeof(serve_worker));
+	if (!workers)
+	{
+		perror("serve");
+		return EXIT_FAILURE;
+	}
+
+	if (debug) fprintf(stderr, "serve: listening on %s with %d threads\n", socket_path, jobs);
+	for (int i = 0; i < jobs; i++)
+	{
+		workers[i].srv = &srv;
+		if (i && pthread_create(&workers[i].thread, NULL, serve_thread, &workers[i]))
+		{
+			perror("could not start a server thread");
+			return EXIT_FAILURE;
+		}
+	}
+
+	// The main thread is the first worker, so this only returns on errors
+	serve_thread(&workers[0]);
+	close(srv.fd);
+	unlink(socket_path);
+	return EXIT_FAILURE;
+}
+
+/**
+	Sends the script path and the standard input to the server, prints
+	the output and returns the exit status
+*/
+int client_main(const char *socket_path, const char *filename)
+{
+	char path[PATH_MAX];
+	if (!realpath(filename, path))
+	{
+		perror("could not find the script");
+		return EXIT_FAILURE;
+	}
+
+	char *input = NULL;
+	size_t input_size = 0;
+	FILE *m = open_memstream(&input, &input_size);
+	char buf[4096];
+	size_t n;
+	while (m && (n = fread(buf, 1, sizeof(buf), stdin)))
+		fwrite(buf, 1, n, m);
+	if (!m || fclose(m) || input_size > SERVE_MAX_INPUT)
+	{
+		fprintf(stderr, "could not read the input\n");
+		return EXIT_FAILURE;
+	}
+
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	if (strlen(socket_path) >= sizeof(addr.sun_path))
+	{
+		fprintf(stderr, "socket path is too long\n");
+		return EXIT_FAILURE;
+	}
+	strcpy(addr.sun_path, socket_path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, (struct sockaddr*) &addr, sizeof(addr)))
+	{
+		perror("could not connect to the server");
+		return EXIT_FAILURE;
+	}
+
+	serve_request rq = {.magic = SERVE_REQUEST_MAGIC, .path_length = strlen(path), .input_size = input_size};
+	serve_response rs;
+	bool ok = write_full(fd, &rq, sizeof(rq)) && write_full(fd, path, rq.path_length)
+		&& write_full(fd, input, input_size) && read_full(fd, &rs, sizeof(rs))
+		&& !memcmp(rs.magic, SERVE_RESPONSE_MAGIC, 4);
+	free(input);
+
+	char *error = ok ? malloc(rs.error_length + 1) : NULL;
+	ok = ok && error && read_full(fd, error, rs.error_length);
+
+	// The output is passed through as it comes
+	for (uint64_t left = ok ? rs.output_size : 0; ok && left; )
+	{
+		size_t chunk = left < sizeof(buf) ? left : sizeof(buf);
+		ok = read_full(fd, buf, chunk) && fwrite(buf, 1, chunk, stdout) == chunk;
+		left -= chunk;
+	}
+	close(fd);
+
+	if (!ok)
+	{
+		fprintf(stderr, "bad response from the server\n");
+		free(error);
+		return EXIT_FAILURE;
+	}
+
+	if (rs.status)
+	{
+		error[rs.error_length] = 0;
+		fprintf(stderr, "run error %d: %s\n", rs.status, error);
+	}
+	free(error);
+	return rs.status ? EXIT_FAILURE : EXIT_SUCCESS;
+}
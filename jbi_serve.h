@@ -0,0 +1,15 @@
+#ifndef JBI_SERVE_H
+#define JBI_SERVE_H
+
+#include <jbasic/jbasic.h>
+
+/*
+	Modes of jbi running many inputs: the batch mode (-j N), the server
+	(--serve) and its client (--client)
+*/
+
+int batch_main(jbas_env *env, char **inputs, int count, int jobs);
+int serve_main(jbas_env *env, const char *socket_path, int jobs, int opt_flags, int debug);
+int client_main(const char *socket_path, const char *filename);
+
+#endif
@@ -0,0 +1,165 @@
+#include <jbasic/jbasic.h>
+#include <jbasic/cast.h>
+#include <jbasic/alloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdalign.h>
+
+/*
+	Interpreter of the static profile (`make static`). Everything the
+	environment needs is carved out of one static buffer by a region
+	allocator - nothing is allocated from the heap, and there's no JIT,
+	no threads, no libm and no dynamic loading. GETCHAR and PUTCHAR are
+	built in. The sizes below can be changed with -D (see the makefile).
+
+	Usage: jbs FILENAME [-size]
+
+	-size prints the memory taken by every part of the environment
+	once the program has finished.
+*/
+
+#ifndef JBS_BUFFER_SIZE
+#define JBS_BUFFER_SIZE (256 * 1024)
+#endif
+
+#ifndef JBS_SOURCE_SIZE
+#define JBS_SOURCE_SIZE (16 * 1024)
+#endif
+
+#ifndef JBS_TOKENS
+#define JBS_TOKENS 2048
+#endif
+
+#ifndef JBS_TEXTS
+#define JBS_TEXTS 128
+#endif
+
+#ifndef JBS_SYMBOLS
+#define JBS_SYMBOLS 128
+#endif
+
+#ifndef JBS_RESOURCES
+#define JBS_RESOURCES 256
+#endif
+
+#ifndef JBS_MEMOS
+#define JBS_MEMOS 64
+#endif
+
+static alignas(max_align_t) unsigned char jbs_buffer[JBS_BUFFER_SIZE];
+static char jbs_source[JBS_SOURCE_SIZE];
+
+static jbas_error jbs_getchar(jbas_env *env, jbas_token *args, jbas_token *res)
+{
+	res->type = JBAS_TOKEN_NUMBER;
+	res->number_token.type = JBAS_NUM_INT;
+	res->number_token.i = getc(env->input);
+	return JBAS_OK;
+}
+
+static jbas_error jbs_putchar(jbas_env *env, jbas_token *args, jbas_token *res)
+{
+	jbas_error err = jbas_token_to_number_type(env, args, JBAS_NUM_INT);
+	if (err)
+	{
+		JBAS_ERROR_REASON(env, "PUTCHAR bad argument!");
+		return err;
+	}
+
+	int c = args->number_token.i;
+	putc(c, env->output);
+
+	res->type = JBAS_TOKEN_NUMBER;
+	res->number_token.type = JBAS_NUM_INT;
+	res->number_token.i = c;
+	return JBAS_OK;
+}
+
+static const jbas_cres jbs_symbols[] = {
+	{.name = "GETCHAR", .cfun = jbs_getchar},
+	{.name = "PUTCHAR", .cfun = jbs_putchar},
+};
+
+/**
+	Prints the footprint of the environment and of the buffer
+*/
+static void jbs_report(const char *filename, const jbas_env *env, const jbas_region *region)
+{
+	jbas_footprint fp;
+	jbas_env_footprint(env, &fp);
+
+	fprintf(stderr, "%s:\n", filename);
+	fprintf(stderr, "  tokens     %8zu  (%d)\n", fp.tokens, env->token_pool.pool_size);
+	fprintf(stderr, "  texts      %8zu  (%d)\n", fp.texts, env->text_manager.max_count);
+	fprintf(stderr, "  symbols    %8zu  (%d)\n", fp.symbols, env->symbol_manager.max_count);
+	fprintf(stderr, "  resources  %8zu  (%d)\n", fp.resources, env->resource_manager.max_count);
+	fprintf(stderr, "  arrays     %8zu\n", fp.arrays);
+	fprintf(stderr, "  memos      %8zu  (%d)\n", fp.memos, env->memo_manager.max_count);
+	fprintf(stderr, "  total      %8zu\n", fp.total);
+	fprintf(stderr, "  buffer     %8zu used, %zu at peak, %zu available\n", region->used, region->peak, region->size);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *filename = NULL;
+	int size_report = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-size")) size_report = 1;
+		else if (argv[i][0] != '-' && !filename) filename = argv[i];
+		else filename = NULL, argc = 0;
+	}
+
+	if (!filename)
+	{
+		fprintf(stderr, "Usage: %s FILENAME [-size]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	FILE *f = fopen(filename, "r");
+	if (!f)
+	{
+		perror("could not open input file!");
+		return EXIT_FAILURE;
+	}
+
+	size_t len = fread(jbs_source, 1, sizeof(jbs_source), f);
+	fclose(f);
+	if (len == sizeof(jbs_source))
+	{
+		fprintf(stderr, "the program doesn't fit into %d bytes\n", JBS_SOURCE_SIZE);
+		return EXIT_FAILURE;
+	}
+	jbs_source[len] = 0;
+
+	jbas_region region;
+	jbas_allocator allocator;
+	jbas_region_allocator_init(&allocator, &region, jbs_buffer, sizeof(jbs_buffer));
+
+	jbas_env env;
+	jbas_error err = jbas_env_init_with_allocator(&env, &allocator, JBS_TOKENS, JBS_TEXTS, JBS_SYMBOLS, JBS_RESOURCES, JBS_MEMOS);
+	if (err)
+	{
+		fprintf(stderr, "the environment doesn't fit into %d bytes\n", JBS_BUFFER_SIZE);
+		return EXIT_FAILURE;
+	}
+
+	err = jbas_symbol_import(&env, jbs_symbols, sizeof(jbs_symbols) / sizeof(jbs_symbols[0]));
+	if (!err)
+	{
+		err = jbas_tokenize_string(&env, jbs_source);
+		if (err) fprintf(stderr, "tokenize error %d: %s\n", err, env.error_reason);
+	}
+
+	if (!err)
+	{
+		err = jbas_run(&env);
+		if (err) fprintf(stderr, "run error %d: %s\n", err, env.error_reason);
+	}
+
+	fflush(stdout);
+	if (size_report) jbs_report(filename, &env, &region);
+	jbas_env_destroy(&env);
+	return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
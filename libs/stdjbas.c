@@ -1,11 +1,111 @@
 #include <jbasic/defs.h>
 #include <jbasic/jbasic.h>
 #include <jbasic/cast.h>
+#include <jbasic/sched.h>
+#include <jbasic/resource.h>
+#include <jbasic/symbol.h>
 #include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define STDJBAS_CHUNK 4096 //!< Max. bytes transferred by one FREAD/FWRITE
+
+static void stdjbas_int_result(jbas_token *res, jbas_int i)
+{
+	res->type = JBAS_TOKEN_NUMBER;
+	res->number_token.type = JBAS_NUM_INT;
+	res->number_token.i = i;
+}
+
+/**
+	Splits the call arguments into exactly `count` tokens
+*/
+static jbas_error stdjbas_args(jbas_env *env, jbas_token *args, jbas_token **argv, int count)
+{
+	int n = 0;
+	if (args->type != JBAS_TOKEN_TUPLE)
+		argv[n++] = args;
+	else
+		for (jbas_token *t = jbas_token_list_begin(args->tuple_token.tokens); t; t = t->r, n++)
+			if (n < count) argv[n] = t;
+
+	if (n != count)
+	{
+		JBAS_ERROR_REASON(env, "wrong number of arguments");
+		return JBAS_BAD_CALL;
+	}
+	return JBAS_OK;
+}
+
+static jbas_error stdjbas_int_arg(jbas_env *env, jbas_token *t, jbas_int *i)
+{
+	jbas_error err = jbas_token_to_number_type(env, t, JBAS_NUM_INT);
+	if (err)
+	{
+		JBAS_ERROR_REASON(env, "expected a number");
+		return err;
+	}
+	*i = t->number_token.i;
+	return JBAS_OK;
+}
+
+static jbas_error stdjbas_array_arg(jbas_env *env, jbas_token *t, jbas_resource **array)
+{
+	jbas_resource *res = NULL;
+	if (t->type == JBAS_TOKEN_SYMBOL) res = t->symbol_token.sym->res;
+	else if (t->type == JBAS_TOKEN_RESOURCE) res = t->resource_token.res;
+
+	if (!res || res->type != JBAS_RESOURCE_INT_ARRAY)
+	{
+		JBAS_ERROR_REASON(env, "expected an IDIM array");
+		return JBAS_TYPE_MISMATCH;
+	}
+	*array = res;
+	return JBAS_OK;
+}
+
+/**
+	Parses (fd, array, count) of FREAD/FWRITE - count is limited by the
+	array size and STDJBAS_CHUNK
+*/
+static jbas_error stdjbas_io_args(jbas_env *env, jbas_token *args, int *fd, jbas_int **buf, size_t *count)
+{
+	jbas_token *argv[3];
+	jbas_resource *array;
+	jbas_int f, n;
+	jbas_error err = stdjbas_args(env, args, argv, 3);
+	if (!err) err = stdjbas_int_arg(env, argv[0], &f);
+	if (!err) err = stdjbas_array_arg(env, argv[1], &array);
+	if (!err) err = stdjbas_int_arg(env, argv[2], &n);
+	if (err) return err;
+
+	// Only the descriptors opened by FOPEN of this environment can be used
+	*fd = jbas_env_owns_fd(env, f) ? f : -1;
+	*buf = array->iptr;
+	*count = n < 0 ? 0 : n;
+	if (*count > array->size) *count = array->size;
+	if (*count > STDJBAS_CHUNK) *count = STDJBAS_CHUNK;
+	return JBAS_OK;
+}
+
+/**
+	read() returns 0 for a FIFO that hasn't been opened by any writer
+	yet, that's not the end of the file. Once a writer has come and gone,
+	poll() reports a hangup.
+*/
+static bool stdjbas_no_writer_yet(int fd)
+{
+	struct stat st;
+	struct pollfd p = {.fd = fd, .events = POLLIN};
+	return !fstat(fd, &st) && S_ISFIFO(st.st_mode) && poll(&p, 1, 0) == 0;
+}
 
 jbas_error stdjbas_hw(jbas_env *env, jbas_token *args, jbas_token *res)
 {
-	puts("Hello world! (from stdjbas)");
+	fputs("Hello world! (from stdjbas)\n", env->output);
 	res->type = JBAS_TOKEN_NUMBER;
 	res->number_token.type = JBAS_NUM_INT;
 	res->number_token.i = 0;
@@ -14,9 +114,19 @@ jbas_error stdjbas_hw(jbas_env *env, jbas_token *args, jbas_token *res)
 
 jbas_error stdjbas_getchar(jbas_env *env, jbas_token *args, jbas_token *res)
 {
+	int c;
+
+	// Non-blocking input without data suspends the run
+	while ((c = getc(env->input)) == EOF && ferror(env->input) && (errno == EAGAIN || errno == EWOULDBLOCK))
+	{
+		clearerr(env->input);
+		jbas_error err = jbas_sched_wait_fd(env, fileno(env->input), POLLIN);
+		if (err) return err;
+	}
+
 	res->type = JBAS_TOKEN_NUMBER;
 	res->number_token.type = JBAS_NUM_INT;
-	res->number_token.i = getchar();
+	res->number_token.i = c;
 	return JBAS_OK;
 }
 
@@ -30,7 +140,7 @@ jbas_error stdjbas_putchar(jbas_env *env, jbas_token *args, jbas_token *res)
 	}
 
 	int c = args->number_token.i;
-	putchar(c);
+	putc(c, env->output);
 
 	res->type = JBAS_TOKEN_NUMBER;
 	res->number_token.type = JBAS_NUM_INT;
@@ -38,10 +148,132 @@ jbas_error stdjbas_putchar(jbas_env *env, jbas_token *args, jbas_token *res)
 	return JBAS_OK;
 }
 
+/**
+	FOPEN("path", mode) - opens a file, pipe or FIFO for non-blocking I/O.
+	Mode 0 reads, 1 writes (creates/truncates), 2 appends.
+	Returns the descriptor or -1. The descriptor belongs to the environment
+	(see jbas_env_add_fd()) - it's closed when the environment is reset.
+*/
+jbas_error stdjbas_fopen(jbas_env *env, jbas_token *args, jbas_token *res)
+{
+	static const int flags[] = {O_RDONLY, O_WRONLY | O_CREAT | O_TRUNC, O_WRONLY | O_CREAT | O_APPEND};
+
+	jbas_token *argv[2];
+	jbas_int mode;
+	jbas_error err = stdjbas_args(env, args, argv, 2);
+	if (!err) err = stdjbas_int_arg(env, argv[1], &mode);
+	if (err) return err;
+	if (argv[0]->type != JBAS_TOKEN_STRING || mode < 0 || mode > 2)
+	{
+		JBAS_ERROR_REASON(env, "FOPEN expects a path and mode 0, 1 or 2");
+		return JBAS_BAD_CALL;
+	}
+
+	// Opening a FIFO without a reader for writing fails - wait for one
+	int fd;
+	while ((fd = open(argv[0]->string_token.txt->str, flags[mode] | O_NONBLOCK | O_CLOEXEC, 0666)) < 0
+		&& (errno == ENXIO || errno == EINTR))
+	{
+		if (errno == EINTR) continue;
+		err = jbas_sched_wait_fd(env, -1, POLLOUT);
+		if (err) return err;
+	}
+
+	if (fd >= 0 && jbas_env_add_fd(env, fd))
+	{
+		close(fd);
+		fd = -1;
+	}
+
+	stdjbas_int_result(res, fd);
+	return JBAS_OK;
+}
+
+/**
+	FREAD(fd, array, n) - reads up to n bytes into the IDIM array.
+	Returns the number of bytes, 0 at the end of the file or -1 (also
+	for descriptors not opened by FOPEN).
+*/
+jbas_error stdjbas_fread(jbas_env *env, jbas_token *args, jbas_token *res)
+{
+	int fd;
+	jbas_int *buf;
+	size_t count;
+	jbas_error err = stdjbas_io_args(env, args, &fd, &buf, &count);
+	if (err) return err;
+
+	unsigned char data[STDJBAS_CHUNK];
+	ssize_t n = fd < 0 ? -1 : 0;
+	while (fd >= 0 && count && (n = read(fd, data, count)) <= 0)
+	{
+		if (!n && !stdjbas_no_writer_yet(fd)) break;
+		if (n < 0 && errno == EINTR) continue;
+		if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) break;
+
+		err = jbas_sched_wait_fd(env, fd, POLLIN);
+		if (err) return err;
+	}
+
+	for (ssize_t i = 0; i < n; i++)
+		buf[i] = data[i];
+
+	stdjbas_int_result(res, n);
+	return JBAS_OK;
+}
+
+/**
+	FWRITE(fd, array, n) - writes up to n bytes from the IDIM array
+	(the low 8 bits of the elements). Returns the number of bytes or -1
+	(also for descriptors not opened by FOPEN).
+*/
+jbas_error stdjbas_fwrite(jbas_env *env, jbas_token *args, jbas_token *res)
+{
+	int fd;
+	jbas_int *buf;
+	size_t count;
+	jbas_error err = stdjbas_io_args(env, args, &fd, &buf, &count);
+	if (err) return err;
+
+	unsigned char data[STDJBAS_CHUNK];
+	for (size_t i = 0; i < count; i++)
+		data[i] = buf[i];
+
+	ssize_t n = fd < 0 ? -1 : 0;
+	while (fd >= 0 && count && (n = write(fd, data, count)) < 0)
+	{
+		if (errno == EINTR) continue;
+		if (errno != EAGAIN && errno != EWOULDBLOCK) break;
+
+		err = jbas_sched_wait_fd(env, fd, POLLOUT);
+		if (err) return err;
+	}
+
+	stdjbas_int_result(res, n);
+	return JBAS_OK;
+}
+
+/**
+	FCLOSE(fd) - returns 0 or -1 (also for descriptors not opened by FOPEN)
+*/
+jbas_error stdjbas_fclose(jbas_env *env, jbas_token *args, jbas_token *res)
+{
+	jbas_int fd;
+	jbas_error err = stdjbas_int_arg(env, args, &fd);
+	if (err) return err;
+
+	stdjbas_int_result(res, jbas_env_close_fd(env, fd));
+	return JBAS_OK;
+}
+
+int jbas_abi_version = JBAS_ABI_VERSION;
 
 jbas_cres jbas_symbols[] = {
 	{.name = "HWTEST", .cfun = stdjbas_hw},
 	{.name = "GETCHAR", .cfun = stdjbas_getchar},
 	{.name = "PUTCHAR", .cfun = stdjbas_putchar},
+	{.name = "FOPEN", .cfun = stdjbas_fopen},
+	{.name = "FREAD", .cfun = stdjbas_fread},
+	{.name = "FWRITE", .cfun = stdjbas_fwrite},
+	{.name = "FCLOSE", .cfun = stdjbas_fclose},
 };
 int jbas_symbol_count = (sizeof(jbas_symbols) / sizeof(jbas_symbols[0]));
\ No newline at end of file
@@ -0,0 +1,195 @@
+#include <jbasic/alloc.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdalign.h>
+#include <stdint.h>
+
+static void *jbas_libc_alloc(void *ctx, size_t size)
+{
+	return calloc(1, size);
+}
+
+static void *jbas_libc_realloc(void *ctx, void *ptr, size_t old_size, size_t size)
+{
+	return realloc(ptr, size);
+}
+
+static void jbas_libc_free(void *ctx, void *ptr, size_t size)
+{
+	free(ptr);
+}
+
+const jbas_allocator jbas_libc_allocator = {
+	.alloc = jbas_libc_alloc,
+	.realloc = jbas_libc_realloc,
+	.free = jbas_libc_free,
+};
+
+/**
+	Chunk of the bump arena
+*/
+typedef struct jbas_arena_chunk
+{
+	struct jbas_arena_chunk *next;
+	size_t size, used;
+	max_align_t data[];
+} jbas_arena_chunk;
+
+typedef struct jbas_arena
+{
+	jbas_arena_chunk *chunks; //!< The current chunk first
+	size_t chunk_size;
+	void *last;               //!< The last block (can grow in place)
+} jbas_arena;
+
+static size_t jbas_arena_round(size_t size)
+{
+	return (size + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+}
+
+static void *jbas_arena_alloc(void *ctx, size_t size)
+{
+	jbas_arena *arena = ctx;
+	size = jbas_arena_round(size);
+	if (!size) return NULL;
+
+	jbas_arena_chunk *c = arena->chunks;
+	if (!c || c->size - c->used < size)
+	{
+		// Big blocks get a chunk of their own
+		size_t chunk_size = size > arena->chunk_size ? size : arena->chunk_size;
+		c = calloc(1, sizeof(jbas_arena_chunk) + chunk_size);
+		if (!c) return NULL;
+		c->size = chunk_size;
+		c->next = arena->chunks;
+		arena->chunks = c;
+	}
+
+	void *p = (char*) c->data + c->used;
+	c->used += size;
+	arena->last = p;
+	return p;
+}
+
+static void *jbas_arena_realloc(void *ctx, void *ptr, size_t old_size, size_t size)
+{
+	jbas_arena *arena = ctx;
+	jbas_arena_chunk *c = arena->chunks;
+	old_size = jbas_arena_round(old_size);
+
+	// The last block grows or shrinks in place
+	if (ptr == arena->last && c)
+	{
+		size_t start = (char*) ptr - (char*) c->data;
+		size_t new_size = jbas_arena_round(size);
+		if (new_size && new_size <= c->size - start)
+		{
+			// Freed bytes are zeroed again, so alloc() keeps returning zeroed memory
+			if (new_size < old_size) memset((char*) ptr + new_size, 0, old_size - new_size);
+			c->used = start + new_size;
+			return ptr;
+		}
+	}
+
+	void *p = jbas_arena_alloc(ctx, size);
+	if (p) memcpy(p, ptr, old_size < size ? old_size : size);
+	return p;
+}
+
+static void jbas_arena_free(void *ctx, void *ptr, size_t size)
+{
+	// Everything is freed at once by jbas_arena_destroy()
+}
+
+static void jbas_arena_destroy(void *ctx)
+{
+	jbas_arena *arena = ctx;
+	for (jbas_arena_chunk *c = arena->chunks, *next; c; c = next)
+	{
+		next = c->next;
+		free(c);
+	}
+	free(arena);
+}
+
+/**
+	Sets up a bump arena taking memory from the system in `chunk_size`
+	byte chunks (bigger blocks get a chunk of their own). Blocks are
+	never freed one by one - the whole arena is freed by `destroy`.
+*/
+jbas_error jbas_arena_allocator_init(jbas_allocator *a, size_t chunk_size)
+{
+	jbas_arena *arena = calloc(1, sizeof(jbas_arena));
+	if (!arena) return JBAS_ALLOC;
+	arena->chunk_size = jbas_arena_round(chunk_size ? chunk_size : 1);
+
+	*a = (jbas_allocator){
+		.alloc = jbas_arena_alloc,
+		.realloc = jbas_arena_realloc,
+		.free = jbas_arena_free,
+		.destroy = jbas_arena_destroy,
+		.ctx = arena,
+	};
+	return JBAS_OK;
+}
+
+static void *jbas_region_alloc(void *ctx, size_t size)
+{
+	jbas_region *region = ctx;
+	size_t start = jbas_arena_round(region->used);
+	if (start > region->size || size > region->size - start) return NULL;
+
+	void *p = region->buffer + start;
+	memset(p, 0, size);
+	region->used = start + size;
+	region->last = start;
+	if (region->used > region->peak) region->peak = region->used;
+	return p;
+}
+
+static void *jbas_region_realloc(void *ctx, void *ptr, size_t old_size, size_t size)
+{
+	jbas_region *region = ctx;
+	size_t start = (unsigned char*) ptr - region->buffer;
+
+	// The most recent block is resized in place
+	if (start == region->last)
+	{
+		if (size > region->size - start) return NULL;
+		region->used = start + size;
+		if (region->used > region->peak) region->peak = region->used;
+		return ptr;
+	}
+
+	void *p = jbas_region_alloc(ctx, size);
+	if (p) memcpy(p, ptr, old_size < size ? old_size : size);
+	return p;
+}
+
+static void jbas_region_free(void *ctx, void *ptr, size_t size)
+{
+	jbas_region *region = ctx;
+	size_t start = (unsigned char*) ptr - region->buffer;
+
+	// Only the most recent block can be given back
+	if (start == region->last)
+	{
+		region->used = start;
+		region->last = SIZE_MAX;
+	}
+}
+
+/**
+	Sets up an allocator handing out memory from `buffer` (`size` bytes,
+	aligned for any type). Nothing is ever taken from the system.
+*/
+void jbas_region_allocator_init(jbas_allocator *a, jbas_region *region, void *buffer, size_t size)
+{
+	*region = (jbas_region){.buffer = buffer, .size = size, .last = SIZE_MAX};
+	*a = (jbas_allocator){
+		.alloc = jbas_region_alloc,
+		.realloc = jbas_region_realloc,
+		.free = jbas_region_free,
+		.ctx = region,
+	};
+}
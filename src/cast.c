@@ -2,6 +2,9 @@
 #include <jbasic/jbasic.h>
 #include <jbasic/paren.h>
 #include <jbasic/resource.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
 
 /**
 	Replaces symbol with resource it has attached
@@ -124,9 +127,9 @@ void jbas_number_cast(jbas_number_token *n, jbas_number_type t)
 {
 	if (n->type == t) return;
 	if (t == JBAS_NUM_INT && n->type == JBAS_NUM_FLOAT)
-		n->i = n->f;
+		n->i = JBAS_FLOAT_TO_INT(n->f);
 	else if (t == JBAS_NUM_FLOAT && (n->type == JBAS_NUM_INT || n->type == JBAS_NUM_BOOL))
-		n->f = n->i;
+		n->f = JBAS_FLOAT_FROM_INT(n->i);
 	else if (t == JBAS_NUM_BOOL)
 	{
 		if (n->type == JBAS_NUM_FLOAT)
@@ -174,4 +177,73 @@ bool jbas_can_cast_to_number(jbas_token *t)
 {
 	return t->type == JBAS_TOKEN_NUMBER;
 	// || (t->type == JBAS_TOKEN_SYMBOL && t->symbol_token.sym->resource && t->symbol_token.sym->resource->type == JBAS_RESOURCE_NUMBER);
-}
\ No newline at end of file
+}
+
+#ifdef JBAS_FIXED
+
+/**
+	Reads a decimal number (with an optional exponent) as Q16.16 without
+	using floats. Values out of the range fail with JBAS_CAST_FAILED.
+*/
+jbas_error jbas_float_parse(const char *s, jbas_float *f)
+{
+	bool neg = *s == '-';
+	if (*s == '-' || *s == '+') s++;
+
+	// Up to 12 significant digits of the mantissa (m * 10^exp)
+	int64_t m = 0;
+	int exp = 0, digits = 0;
+	bool point = false;
+	for (; isdigit(*s) || (*s == '.' && !point); s++)
+	{
+		if (*s == '.') point = true;
+		else if (digits < 12)
+		{
+			m = m * 10 + (*s - '0');
+			if (m) digits++;
+			if (point) exp--;
+		}
+		else if (!point) exp++;
+	}
+	if (*s == 'e' || *s == 'E') exp += atoi(s + 1);
+
+	int64_t v = m * JBAS_FIXED_ONE;
+	for (; exp > 0 && v <= INT32_MAX; exp--) v *= 10;
+	int64_t div = 1;
+	for (; exp < 0 && div <= v; exp++) div *= 10;
+	v = exp < 0 ? 0 : (v + div / 2) / div;
+
+	if (v > JBAS_FIXED_MAX) return JBAS_CAST_FAILED;
+	*f = neg ? -v : v;
+	return JBAS_OK;
+}
+
+/**
+	Prints the number like printf("%f") would
+*/
+int jbas_float_format(char *buf, size_t size, jbas_float f)
+{
+	int64_t v = f;
+	bool neg = v < 0;
+	if (neg) v = -v;
+
+	int64_t whole = v / JBAS_FIXED_ONE;
+	int64_t frac = (v % JBAS_FIXED_ONE * 1000000 + JBAS_FIXED_ONE / 2) / JBAS_FIXED_ONE;
+	if (frac >= 1000000) whole++, frac -= 1000000;
+	return snprintf(buf, size, "%s%lld.%06lld", neg ? "-" : "", (long long) whole, (long long) frac);
+}
+
+#else
+
+jbas_error jbas_float_parse(const char *s, jbas_float *f)
+{
+	*f = strtof(s, NULL);
+	return JBAS_OK;
+}
+
+int jbas_float_format(char *buf, size_t size, jbas_float f)
+{
+	return snprintf(buf, size, "%f", f);
+}
+
+#endif
@@ -0,0 +1,511 @@
+#include <jbasic/checkpoint.h>
+#include <jbasic/jbasic.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/**
+	FNV-1a hash
+*/
+static uint64_t jbas_checkpoint_hash(uint64_t h, const void *data, size_t size)
+{
+	const unsigned char *p = data;
+	for (size_t i = 0; i < size; i++)
+		h = (h ^ p[i]) * 0x100000001b3ull;
+	return h;
+}
+
+/**
+	Hashes a token and its sublists. Only the things that identify
+	the program are used - memos and JIT/SELECT data are left out.
+*/
+static uint64_t jbas_checkpoint_hash_token(uint64_t h, const jbas_token *t)
+{
+	int32_t v[2] = {t->type, -1};
+	const jbas_text *txt = NULL;
+	const jbas_token *list = NULL;
+
+	switch (t->type)
+	{
+		case JBAS_TOKEN_KEYWORD:
+			v[1] = t->keyword_token.kw - jbas_keywords;
+			break;
+
+		case JBAS_TOKEN_OPERATOR:
+			v[1] = t->operator_token.op - jbas_operators;
+			break;
+
+		case JBAS_TOKEN_NUMBER:
+			v[1] = t->number_token.type;
+			h = jbas_checkpoint_hash(h, &t->number_token.i, sizeof(t->number_token.i));
+			break;
+
+		case JBAS_TOKEN_SYMBOL:
+			txt = t->symbol_token.sym->name;
+			break;
+
+		case JBAS_TOKEN_STRING:
+			txt = t->string_token.txt;
+			break;
+
+		case JBAS_TOKEN_PAREN:
+			list = t->paren_token.tokens;
+			break;
+
+		case JBAS_TOKEN_TUPLE:
+			list = t->tuple_token.tokens;
+			break;
+
+		default:
+			break;
+	}
+
+	h = jbas_checkpoint_hash(h, v, sizeof(v));
+	if (txt) h = jbas_checkpoint_hash(h, txt->str, txt->length + 1);
+
+	if (list)
+	{
+		for (const jbas_token *u = jbas_token_list_begin((jbas_token*) list); u; u = u->r)
+			h = jbas_checkpoint_hash_token(h, u);
+		h = jbas_checkpoint_hash(h, "", 1);
+	}
+
+	return h;
+}
+
+/**
+	Fingerprint of the program. The main list is walked backwards, because
+	the running blocks are cut off from the rest of it (see jbas_run_block()).
+*/
+static uint64_t jbas_checkpoint_fingerprint(jbas_env *env)
+{
+	uint64_t h = 0xcbf29ce484222325ull;
+	for (const jbas_token *t = env->tokens; t; t = t->l)
+		h = jbas_checkpoint_hash_token(h, t);
+	return h;
+}
+
+/**
+	Returns size of the array contents in bytes
+*/
+static size_t jbas_checkpoint_data_size(const jbas_resource *res)
+{
+	if (res->type == JBAS_RESOURCE_INT_ARRAY) return res->size * sizeof(int);
+	if (res->type == JBAS_RESOURCE_FLOAT_ARRAY) return res->size * sizeof(jbas_float);
+	return 0;
+}
+
+/**
+	Writes the checkpoint records. `map` maps resource manager indices
+	to the record indices.
+*/
+static jbas_error jbas_checkpoint_write(jbas_env *env, FILE *f, int *map, jbas_resource **order)
+{
+	jbas_symbol_manager *sm = &env->symbol_manager;
+	jbas_checkpoint_header h = {
+		.magic = JBAS_CHECKPOINT_MAGIC,
+		.version = JBAS_CHECKPOINT_VERSION,
+		.fingerprint = jbas_checkpoint_fingerprint(env),
+		.position = -1,
+	};
+
+	// The instruction (counted from the end, the list may be cut)
+	if (env->position)
+	{
+		h.position = 0;
+		for (jbas_token *t = env->position->l; t; t = t->l)
+			h.position++;
+	}
+
+	// Resources bound to symbols (shared ones are stored once)
+	for (int i = 0; i < sm->used_count; i++)
+	{
+		jbas_symbol *sym = &sm->symbol_storage[sm->used_slots[i]];
+		jbas_resource *res = sym->res;
+		if (!res) continue;
+
+		if (res->type == JBAS_RESOURCE_INT_PTR || res->type == JBAS_RESOURCE_FLOAT_PTR || res->type == JBAS_RESOURCE_STRING)
+		{
+			JBAS_ERROR_REASON(env, "only numbers, arrays and C functions can be checkpointed");
+			return JBAS_UNSUPPORTED;
+		}
+
+		h.symbol_count++;
+		if (map[res->rm_index] < 0)
+		{
+			map[res->rm_index] = h.resource_count;
+			order[h.resource_count++] = res;
+		}
+	}
+
+	fwrite(&h, sizeof(h), 1, f);
+
+	for (uint32_t i = 0; i < h.resource_count; i++)
+	{
+		jbas_resource *res = order[i];
+		jbas_checkpoint_resource r = {.type = res->type};
+		if (res->type == JBAS_RESOURCE_NUMBER)
+		{
+			r.number_type = res->number.type;
+			r.i = res->number.i;
+		}
+		else
+			r.size = jbas_checkpoint_data_size(res) ? res->size : 0;
+
+		// Arrays go straight from their buffers
+		fwrite(&r, sizeof(r), 1, f);
+		if (r.size) fwrite(res->data, jbas_checkpoint_data_size(res), 1, f);
+	}
+
+	for (int i = 0; i < sm->used_count; i++)
+	{
+		jbas_symbol *sym = &sm->symbol_storage[sm->used_slots[i]];
+		if (!sym->res) continue;
+
+		jbas_checkpoint_symbol s = {
+			.name_length = sym->name->length,
+			.resource = map[sym->res->rm_index],
+		};
+		fwrite(&s, sizeof(s), 1, f);
+		fwrite(sym->name->str, sym->name->length, 1, f);
+	}
+
+	return JBAS_OK;
+}
+
+/**
+	Writes a checkpoint of the environment to the file descriptor (at its
+	current offset). Called by env->checkpoint_handler, env->position is
+	the instruction the program continues from. Outside of jbas_run() the
+	checkpoint restarts the program with the current variables.
+*/
+jbas_error jbas_env_checkpoint(jbas_env *env, int fd)
+{
+	int dup_fd = dup(fd);
+	FILE *f = dup_fd < 0 ? NULL : fdopen(dup_fd, "wb");
+	if (!f)
+	{
+		if (dup_fd >= 0) close(dup_fd);
+		JBAS_ERROR_REASON(env, "could not open the checkpoint file");
+		return JBAS_IO_ERROR;
+	}
+
+	jbas_resource_manager *rm = &env->resource_manager;
+	int *map = malloc(rm->max_count * sizeof(int));
+	jbas_resource **order = malloc(rm->max_count * sizeof(jbas_resource*));
+
+	jbas_error err = JBAS_ALLOC;
+	if (map && order)
+	{
+		for (int i = 0; i < rm->max_count; i++)
+			map[i] = -1;
+		err = jbas_checkpoint_write(env, f, map, order);
+	}
+
+	if (!err && (fflush(f) || ferror(f)))
+	{
+		JBAS_ERROR_REASON(env, "could not write the checkpoint");
+		err = JBAS_IO_ERROR;
+	}
+
+	fclose(f);
+	free(map);
+	free(order);
+	return err;
+}
+
+/**
+	Checkpoint contents read before the environment is touched
+*/
+typedef struct jbas_checkpoint_state
+{
+	jbas_checkpoint_header header;
+	jbas_checkpoint_resource *resources;
+	void **data;                        //!< Array buffers
+	jbas_error (**cfun)(jbas_env *env, jbas_token *arg, jbas_token *res);
+	jbas_checkpoint_symbol *symbols;
+	char **names;
+} jbas_checkpoint_state;
+
+/**
+	Array buffers are allocated by the environment's allocator, so they
+	can be adopted by the resources
+*/
+static void jbas_checkpoint_state_destroy(jbas_env *env, jbas_checkpoint_state *st)
+{
+	for (uint32_t i = 0; st->data && i < st->header.resource_count; i++)
+	{
+		size_t elem = st->resources[i].type == JBAS_RESOURCE_INT_ARRAY ? sizeof(int) : sizeof(jbas_float);
+		jbas_free(&env->allocator, st->data[i], st->resources[i].size * elem);
+	}
+	for (uint32_t i = 0; st->names && i < st->header.symbol_count; i++)
+		free(st->names[i]);
+	free(st->resources);
+	free(st->data);
+	free(st->cfun);
+	free(st->symbols);
+	free(st->names);
+}
+
+/**
+	Reads and validates all the records. `avail` is the number of bytes
+	left in the file (SIZE_MAX if unknown) and guards the allocations.
+*/
+static jbas_error jbas_checkpoint_read(jbas_env *env, FILE *f, size_t avail, jbas_checkpoint_state *st)
+{
+	jbas_checkpoint_header *h = &st->header;
+	if (fread(h, sizeof(*h), 1, f) != 1 || memcmp(h->magic, JBAS_CHECKPOINT_MAGIC, 4) || h->version != JBAS_CHECKPOINT_VERSION)
+	{
+		JBAS_ERROR_REASON(env, "not a checkpoint or an incompatible version");
+		h->resource_count = h->symbol_count = 0;
+		return JBAS_BAD_CHECKPOINT;
+	}
+	avail -= avail == SIZE_MAX ? 0 : sizeof(*h);
+
+	if (h->fingerprint != jbas_checkpoint_fingerprint(env))
+	{
+		JBAS_ERROR_REASON(env, "the checkpoint has been taken from a different program");
+		return JBAS_BAD_CHECKPOINT;
+	}
+
+	if (avail != SIZE_MAX && ((size_t) h->resource_count * sizeof(jbas_checkpoint_resource) > avail
+		|| (size_t) h->symbol_count * sizeof(jbas_checkpoint_symbol) > avail))
+	{
+		JBAS_ERROR_REASON(env, "truncated checkpoint");
+		h->resource_count = h->symbol_count = 0;
+		return JBAS_BAD_CHECKPOINT;
+	}
+
+	st->resources = calloc(h->resource_count + 1, sizeof(*st->resources));
+	st->data = calloc(h->resource_count + 1, sizeof(*st->data));
+	st->cfun = calloc(h->resource_count + 1, sizeof(*st->cfun));
+	st->symbols = calloc(h->symbol_count + 1, sizeof(*st->symbols));
+	st->names = calloc(h->symbol_count + 1, sizeof(*st->names));
+	if (!st->resources || !st->data || !st->cfun || !st->symbols || !st->names)
+		return JBAS_ALLOC;
+
+	for (uint32_t i = 0; i < h->resource_count; i++)
+	{
+		jbas_checkpoint_resource *r = &st->resources[i];
+		if (fread(r, sizeof(*r), 1, f) != 1)
+		{
+			JBAS_ERROR_REASON(env, "truncated checkpoint");
+			return JBAS_BAD_CHECKPOINT;
+		}
+
+		size_t elem = 0;
+		if (r->type == JBAS_RESOURCE_INT_ARRAY) elem = sizeof(int);
+		else if (r->type == JBAS_RESOURCE_FLOAT_ARRAY) elem = sizeof(jbas_float);
+		else if (r->type != JBAS_RESOURCE_NUMBER && r->type != JBAS_RESOURCE_CFUN)
+		{
+			JBAS_ERROR_REASON(env, "bad resource type in checkpoint");
+			return JBAS_BAD_CHECKPOINT;
+		}
+
+		if (r->type == JBAS_RESOURCE_NUMBER && (r->number_type < JBAS_NUM_BOOL || r->number_type > JBAS_NUM_FLOAT))
+		{
+			JBAS_ERROR_REASON(env, "bad number type in checkpoint");
+			return JBAS_BAD_CHECKPOINT;
+		}
+
+		if (!elem) continue;
+		if (r->size > SIZE_MAX / elem || (avail != SIZE_MAX && r->size * elem > avail))
+		{
+			JBAS_ERROR_REASON(env, "truncated checkpoint");
+			return JBAS_BAD_CHECKPOINT;
+		}
+
+		st->data[i] = jbas_alloc(&env->allocator, r->size * elem);
+		if (!st->data[i]) return JBAS_ALLOC;
+		if (r->size && fread(st->data[i], r->size * elem, 1, f) != 1)
+		{
+			JBAS_ERROR_REASON(env, "truncated checkpoint");
+			return JBAS_BAD_CHECKPOINT;
+		}
+	}
+
+	for (uint32_t i = 0; i < h->symbol_count; i++)
+	{
+		jbas_checkpoint_symbol *s = &st->symbols[i];
+		if (fread(s, sizeof(*s), 1, f) != 1 || s->resource < 0 || (uint32_t) s->resource >= h->resource_count
+			|| !s->name_length || (avail != SIZE_MAX && s->name_length > avail))
+		{
+			JBAS_ERROR_REASON(env, "bad symbol record in checkpoint");
+			return JBAS_BAD_CHECKPOINT;
+		}
+
+		st->names[i] = malloc(s->name_length + 1);
+		if (!st->names[i]) return JBAS_ALLOC;
+		if (fread(st->names[i], s->name_length, 1, f) != 1)
+		{
+			JBAS_ERROR_REASON(env, "truncated checkpoint");
+			return JBAS_BAD_CHECKPOINT;
+		}
+		st->names[i][s->name_length] = 0;
+	}
+
+	return JBAS_OK;
+}
+
+/**
+	Finds the C functions by the names of the symbols they are bound to -
+	in the provided list first, then among the functions already bound
+	in the environment.
+*/
+static jbas_error jbas_checkpoint_resolve(jbas_env *env, jbas_checkpoint_state *st, const jbas_cres *cres, int count)
+{
+	for (uint32_t i = 0; i < st->header.symbol_count; i++)
+	{
+		int r = st->symbols[i].resource;
+		if (st->resources[r].type != JBAS_RESOURCE_CFUN || st->cfun[r]) continue;
+
+		for (int j = 0; j < count && !st->cfun[r]; j++)
+			if (!strcmp(cres[j].name, st->names[i]))
+				st->cfun[r] = cres[j].cfun;
+	}
+
+	for (uint32_t i = 0; i < st->header.symbol_count; i++)
+	{
+		int r = st->symbols[i].resource;
+		if (st->resources[r].type != JBAS_RESOURCE_CFUN || st->cfun[r]) continue;
+
+		jbas_symbol *sym = NULL;
+		const char *name = st->names[i];
+		jbas_symbol_lookup(&env->symbol_manager, &sym, name, name + strlen(name));
+		if (sym && sym->res && sym->res->type == JBAS_RESOURCE_CFUN)
+			st->cfun[r] = sym->res->cfun;
+	}
+
+	for (uint32_t i = 0; i < st->header.resource_count; i++)
+	{
+		if (st->resources[i].type == JBAS_RESOURCE_CFUN && !st->cfun[i])
+		{
+			JBAS_ERROR_REASON(env, "C function from the checkpoint is not available");
+			return JBAS_BAD_CHECKPOINT;
+		}
+	}
+
+	return JBAS_OK;
+}
+
+/**
+	Creates the resources and binds the symbols
+*/
+static jbas_error jbas_checkpoint_bind(jbas_env *env, jbas_checkpoint_state *st, jbas_resource **res)
+{
+	for (uint32_t i = 0; i < st->header.resource_count; i++)
+	{
+		jbas_checkpoint_resource *r = &st->resources[i];
+		jbas_error err = jbas_resource_create(&env->resource_manager, &res[i]);
+		if (err) return err;
+
+		res[i]->type = r->type;
+		switch (r->type)
+		{
+			case JBAS_RESOURCE_NUMBER:
+				res[i]->number.type = r->number_type;
+				res[i]->number.i = r->i;
+				break;
+
+			case JBAS_RESOURCE_CFUN:
+				res[i]->cfun = st->cfun[i];
+				break;
+
+			default:
+				res[i]->size = r->size;
+				err = jbas_memory_charge(env->resource_manager.memory, jbas_resource_array_bytes(res[i]));
+				if (err)
+				{
+					res[i]->size = 0;
+					JBAS_ERROR_REASON(env, "checkpointed arrays exceed the memory limit");
+					return err;
+				}
+				res[i]->data = st->data[i];
+				st->data[i] = NULL;
+				break;
+		}
+	}
+
+	for (uint32_t i = 0; i < st->header.symbol_count; i++)
+	{
+		jbas_symbol *sym = NULL;
+		const char *name = st->names[i];
+		jbas_error err = jbas_symbol_create(env, &sym, name, name + strlen(name));
+		if (err && err != JBAS_SYMBOL_COLLISION) return err;
+
+		jbas_resource_remove_ref(sym->res);
+		sym->res = res[st->symbols[i].resource];
+		jbas_resource_add_ref(sym->res);
+	}
+
+	// The resources are referenced by the symbols only
+	for (uint32_t i = 0; i < st->header.resource_count; i++)
+		jbas_resource_remove_ref(res[i]);
+
+	return JBAS_OK;
+}
+
+/**
+	Restores a checkpoint written by jbas_env_checkpoint() into an
+	environment holding the same program. The current variables are
+	discarded and the next jbas_run() continues from the checkpointed
+	instruction. C functions are looked up in `cres` (may be NULL) and
+	then among the ones already imported into the environment.
+	The environment is left reset on errors.
+*/
+jbas_error jbas_env_restore(jbas_env *env, int fd, const jbas_cres *cres, int count)
+{
+	int dup_fd = dup(fd);
+	FILE *f = dup_fd < 0 ? NULL : fdopen(dup_fd, "rb");
+	if (!f)
+	{
+		if (dup_fd >= 0) close(dup_fd);
+		JBAS_ERROR_REASON(env, "could not open the checkpoint file");
+		return JBAS_IO_ERROR;
+	}
+
+	// Bytes left in regular files
+	size_t avail = SIZE_MAX;
+	struct stat st_file;
+	off_t offset = lseek(fd, 0, SEEK_CUR);
+	if (!fstat(fd, &st_file) && S_ISREG(st_file.st_mode) && offset >= 0)
+		avail = st_file.st_size > offset ? st_file.st_size - offset : 0;
+
+	jbas_checkpoint_state st = {0};
+	jbas_error err = jbas_checkpoint_read(env, f, avail, &st);
+	fclose(f);
+	if (!err) err = jbas_checkpoint_resolve(env, &st, cres, count);
+
+	// The instruction to continue from
+	jbas_token *at = NULL;
+	if (!err && st.header.position >= 0)
+	{
+		at = jbas_token_list_begin(env->tokens);
+		for (int32_t i = 0; at && i < st.header.position; i++)
+			at = at->r;
+
+		if (!at)
+		{
+			JBAS_ERROR_REASON(env, "checkpoint position is out of the program");
+			err = JBAS_BAD_CHECKPOINT;
+		}
+	}
+
+	if (!err)
+	{
+		jbas_env_reset(env);
+		jbas_resource **res = calloc(st.header.resource_count + 1, sizeof(jbas_resource*));
+		err = res ? jbas_checkpoint_bind(env, &st, res) : JBAS_ALLOC;
+		free(res);
+
+		if (err)
+		{
+			const char *reason = env->error_reason;
+			jbas_env_reset(env);
+			env->error_reason = reason;
+		}
+		else env->position = at;
+	}
+
+	jbas_checkpoint_state_destroy(env, &st);
+	return err;
+}
@@ -1,5 +1,7 @@
 #include <jbasic/debug.h>
 #include <jbasic/jbasic.h>
+#include <jbasic/infer.h>
+#include <jbasic/cast.h>
 
 #define JBAS_COLOR_RED "\x1b[31m"
 #define JBAS_COLOR_GREEN "\x1b[32m"
@@ -38,7 +40,11 @@ void jbas_debug_dump_token(FILE *f, jbas_token *token)
 			else if (token->number_token.type == JBAS_NUM_BOOL)
 				fprintf(f, JBAS_COLOR_RED "%s" JBAS_COLOR_RESET, token->number_token.i ? "TRUE" : "FALSE");
 			else
-				fprintf(f, JBAS_COLOR_RED "%f" JBAS_COLOR_RESET, token->number_token.f);
+			{
+				char buf[32];
+				jbas_float_format(buf, sizeof(buf), token->number_token.f);
+				fprintf(f, JBAS_COLOR_RED "%s" JBAS_COLOR_RESET, buf);
+			}
 			break;
 
 		case JBAS_TOKEN_OPERATOR:
@@ -52,7 +58,7 @@ void jbas_debug_dump_token(FILE *f, jbas_token *token)
 		case JBAS_TOKEN_PAREN:
 			fprintf(f, JBAS_COLOR_CYAN "(" JBAS_COLOR_RESET);
 			jbas_debug_dump_token_list(f, token->paren_token.tokens);
-			fprintf(f, JBAS_COLOR_CYAN " )" JBAS_COLOR_RESET);
+			fprintf(f, JBAS_COLOR_CYAN " )%s" JBAS_COLOR_RESET, token->paren_token.memo ? "$" : "");
 			break;
 
 		case JBAS_TOKEN_SYMBOL:
@@ -109,7 +115,11 @@ void jbas_debug_dump_resource(FILE *f, jbas_resource *res)
 						break;
 
 					case JBAS_NUM_FLOAT:
-						fprintf(f, "%f", n->f);
+						{
+							char buf[32];
+							jbas_float_format(buf, sizeof(buf), n->f);
+							fprintf(f, "%s", buf);
+						}
 						break;
 
 				}
@@ -144,7 +154,7 @@ void jbas_debug_dump_resource(FILE *f, jbas_resource *res)
 
 void jbas_debug_dump_symbol(FILE *f, jbas_symbol *sym)
 {
-	fprintf(f, "`%s` = ", sym->name->str);
+	fprintf(f, "`%s` (%s) = ", sym->name->str, jbas_symbol_type_str(sym->type));
 	jbas_debug_dump_resource(f, sym->res);
 }
 
@@ -170,4 +180,65 @@ void jbas_debug_dump_resource_manager(FILE *f, jbas_resource_manager *rm)
 		jbas_debug_dump_resource(f, rm->refs[i]);
 		fprintf(f, "\n");
 	}
-}
\ No newline at end of file
+}
+/**
+	Prints tokens in [begin, end) as plain source code (no colors)
+*/
+void jbas_debug_print_code(FILE *f, jbas_token *begin, jbas_token *end)
+{
+	for (jbas_token *t = begin; t && t != end; t = t->r)
+	{
+		if (t != begin) fprintf(f, " ");
+
+		switch (t->type)
+		{
+			case JBAS_TOKEN_KEYWORD:
+				fprintf(f, "%s", t->keyword_token.kw->str);
+				break;
+
+			case JBAS_TOKEN_STRING:
+				fprintf(f, "'%s'", t->string_token.txt->str);
+				break;
+
+			case JBAS_TOKEN_NUMBER:
+				if (t->number_token.type == JBAS_NUM_INT)
+					fprintf(f, "%d", t->number_token.i);
+				else if (t->number_token.type == JBAS_NUM_BOOL)
+					fprintf(f, "%s", t->number_token.i ? "TRUE" : "FALSE");
+				else
+				{
+					// Keep the decimal point, so floats can be told apart
+					char buf[64];
+#ifdef JBAS_FIXED
+					jbas_float_format(buf, sizeof(buf), t->number_token.f);
+#else
+					snprintf(buf, sizeof(buf), "%g", t->number_token.f);
+#endif
+					fprintf(f, "%s%s", buf, strpbrk(buf, ".en") ? "" : ".0");
+				}
+				break;
+
+			case JBAS_TOKEN_OPERATOR:
+				fprintf(f, "%s", t->operator_token.op->str);
+				break;
+
+			case JBAS_TOKEN_DELIMITER:
+				fprintf(f, ";");
+				break;
+
+			case JBAS_TOKEN_PAREN:
+				fprintf(f, "(");
+				jbas_debug_print_code(f, jbas_token_list_begin(t->paren_token.tokens), NULL);
+				fprintf(f, ")");
+				break;
+
+			case JBAS_TOKEN_SYMBOL:
+				fprintf(f, "%s", t->symbol_token.sym->name->str);
+				break;
+
+			default:
+				fprintf(f, "?");
+				break;
+		}
+	}
+}
@@ -0,0 +1,363 @@
+#include <jbasic/expr.h>
+#include <jbasic/jbasic.h>
+#include <limits.h>
+
+static jbas_error jbas_expr_parse_binary(jbas_expr_tree *tree, jbas_token **pos, jbas_token *end, jbas_token **list, int min_level, jbas_expr **result);
+
+static jbas_error jbas_expr_new(jbas_expr_tree *tree, jbas_expr_type type, jbas_token *token, jbas_token **list, jbas_expr **e)
+{
+	if (tree->node_count >= JBAS_EXPR_MAX_NODES) return JBAS_EVAL_OVERFLOW;
+
+	jbas_expr *n = &tree->nodes[tree->node_count++];
+	n->type = type;
+	n->token = token;
+	n->op = token->type == JBAS_TOKEN_OPERATOR ? token->operator_token.op : NULL;
+	n->begin = n->end = token;
+	n->list = list;
+	n->a = n->b = n->parent = NULL;
+	*e = n;
+	return JBAS_OK;
+}
+
+/**
+	Parses entire token list (parentheses contents)
+*/
+static jbas_error jbas_expr_parse_list(jbas_expr_tree *tree, jbas_token **list, jbas_expr **result)
+{
+	jbas_token *pos = jbas_token_list_begin(*list);
+	*result = NULL;
+	if (!pos) return JBAS_OK;
+
+	jbas_error err = jbas_expr_parse_binary(tree, &pos, NULL, list, 0, result);
+	if (err) return err;
+	if (pos) return JBAS_SYNTAX_ERROR;
+	return JBAS_OK;
+}
+
+/**
+	Parses an operand with all its prefix and call operators
+*/
+static jbas_error jbas_expr_parse_operand(jbas_expr_tree *tree, jbas_token **pos, jbas_token *end, jbas_token **list, jbas_expr **result)
+{
+	jbas_token *t = *pos;
+	jbas_expr *e;
+	jbas_error err;
+
+	if (!t || t == end) return JBAS_OPERAND_MISSING;
+
+	// Prefix operators (binary operators can fall back to prefix ones)
+	if (t->type == JBAS_TOKEN_OPERATOR)
+	{
+		const jbas_operator *op = t->operator_token.op;
+		if (op->type != JBAS_OP_UNARY_PREFIX)
+		{
+			if (op->fallback && op->fallback->type == JBAS_OP_UNARY_PREFIX)
+				op = op->fallback;
+			else
+				return JBAS_SYNTAX_ERROR;
+		}
+
+		err = jbas_expr_new(tree, JBAS_EXPR_UNARY, t, list, &e);
+		if (err) return err;
+		e->op = op;
+
+		*pos = t->r;
+		err = jbas_expr_parse_operand(tree, pos, end, list, &e->a);
+		if (err) return err;
+		e->a->parent = e;
+		e->end = e->a->end;
+		*result = e;
+		return JBAS_OK;
+	}
+
+	// The operand itself
+	switch (t->type)
+	{
+		case JBAS_TOKEN_SYMBOL:
+		case JBAS_TOKEN_NUMBER:
+		case JBAS_TOKEN_STRING:
+		case JBAS_TOKEN_TUPLE:
+		case JBAS_TOKEN_RESOURCE:
+			err = jbas_expr_new(tree, JBAS_EXPR_OPERAND, t, list, &e);
+			if (err) return err;
+			break;
+
+		case JBAS_TOKEN_PAREN:
+			err = jbas_expr_new(tree, JBAS_EXPR_PAREN, t, list, &e);
+			if (err) return err;
+			err = jbas_expr_parse_list(tree, &t->paren_token.tokens, &e->a);
+			if (err) return err;
+			if (e->a) e->a->parent = e;
+			break;
+
+		default:
+			return JBAS_SYNTAX_ERROR;
+	}
+	t = t->r;
+
+	// Call operators
+	while (t && t != end && t->type == JBAS_TOKEN_PAREN)
+	{
+		jbas_expr *c;
+		err = jbas_expr_new(tree, JBAS_EXPR_CALL, t, list, &c);
+		if (err) return err;
+		c->begin = e->begin;
+		c->a = e;
+		e->parent = c;
+
+		err = jbas_expr_parse_list(tree, &t->paren_token.tokens, &c->b);
+		if (err) return err;
+		if (c->b) c->b->parent = c;
+
+		e = c;
+		t = t->r;
+	}
+
+	*pos = t;
+	*result = e;
+	return JBAS_OK;
+}
+
+/**
+	Precedence climbing - parses binary operators with level >= min_level
+*/
+static jbas_error jbas_expr_parse_binary(jbas_expr_tree *tree, jbas_token **pos, jbas_token *end, jbas_token **list, int min_level, jbas_expr **result)
+{
+	jbas_expr *lhs;
+	jbas_error err = jbas_expr_parse_operand(tree, pos, end, list, &lhs);
+	if (err) return err;
+
+	while (*pos && *pos != end && jbas_is_binary_operator(*pos))
+	{
+		const jbas_operator *op = (*pos)->operator_token.op;
+		if (op->level < min_level) break;
+
+		jbas_expr *e;
+		err = jbas_expr_new(tree, JBAS_EXPR_BINARY, *pos, list, &e);
+		if (err) return err;
+
+		*pos = (*pos)->r;
+		err = jbas_expr_parse_binary(tree, pos, end, list, op->type == JBAS_OP_BINARY_RL ? op->level : op->level + 1, &e->b);
+		if (err) return err;
+
+		e->a = lhs;
+		e->begin = lhs->begin;
+		e->end = e->b->end;
+		e->a->parent = e->b->parent = e;
+		lhs = e;
+	}
+
+	*result = lhs;
+	return JBAS_OK;
+}
+
+/**
+	Builds expression tree for tokens in range [begin, end).
+	`list` is the handle of the list containing the tokens.
+*/
+jbas_error jbas_expr_parse(jbas_expr_tree *tree, jbas_token *begin, jbas_token *end, jbas_token **list)
+{
+	tree->node_count = 0;
+	tree->root = NULL;
+	if (!begin || begin == end) return JBAS_OK;
+
+	jbas_token *pos = begin;
+	jbas_error err = jbas_expr_parse_binary(tree, &pos, end, list, 0, &tree->root);
+	if (err) return err;
+	if (pos != end) return JBAS_SYNTAX_ERROR;
+	return JBAS_OK;
+}
+
+/**
+	True if the expression is an assignment
+*/
+bool jbas_expr_is_assign(const jbas_expr *e)
+{
+	return e && e->type == JBAS_EXPR_BINARY && e->op->type == JBAS_OP_BINARY_RL;
+}
+
+/**
+	True if the expression is a tuple - `a, b` (the values are assigned
+	or passed one by one, so its parts aren't expressions of their own)
+*/
+bool jbas_expr_is_tuple(const jbas_expr *e)
+{
+	return e && e->type == JBAS_EXPR_BINARY && !strcmp(e->op->str, ",");
+}
+
+/**
+	Skips parentheses without memos - `((a))` is the same expression as `a`
+*/
+const jbas_expr *jbas_expr_strip(const jbas_expr *e)
+{
+	while (e && e->type == JBAS_EXPR_PAREN && !e->token->paren_token.memo && e->a)
+		e = e->a;
+	return e;
+}
+
+/**
+	Hashes operand token. Strings, tuples etc. are only equal to themselves.
+*/
+static unsigned int jbas_expr_operand_hash(const jbas_token *t)
+{
+	switch (t->type)
+	{
+		case JBAS_TOKEN_NUMBER:
+			if (t->number_token.type == JBAS_NUM_FLOAT)
+			{
+				uint32_t bits;
+				_Static_assert(sizeof(jbas_float) == sizeof(bits), "jbas_float is hashed as 32 bits");
+				memcpy(&bits, &t->number_token.f, sizeof(jbas_float));
+				return bits * 3u + JBAS_NUM_FLOAT;
+			}
+			return (unsigned int) t->number_token.i * 3u + t->number_token.type;
+
+		case JBAS_TOKEN_SYMBOL:
+			return (unsigned int)(uintptr_t) t->symbol_token.sym;
+
+		default:
+			return (unsigned int)(uintptr_t) t;
+	}
+}
+
+static bool jbas_expr_operand_equal(const jbas_token *t1, const jbas_token *t2)
+{
+	if (t1->type != t2->type) return false;
+	switch (t1->type)
+	{
+		case JBAS_TOKEN_NUMBER:
+			if (t1->number_token.type != t2->number_token.type) return false;
+			if (t1->number_token.type == JBAS_NUM_FLOAT)
+				return !memcmp(&t1->number_token.f, &t2->number_token.f, sizeof(jbas_float));
+			return t1->number_token.i == t2->number_token.i;
+
+		case JBAS_TOKEN_SYMBOL:
+			return t1->symbol_token.sym == t2->symbol_token.sym;
+
+		default:
+			return t1 == t2;
+	}
+}
+
+/**
+	Structural hash of an expression. Parentheses with memos are
+	hashed by the memo identity.
+*/
+unsigned int jbas_expr_hash(const jbas_expr *e)
+{
+	e = jbas_expr_strip(e);
+	if (!e) return 0;
+
+	unsigned int h = e->type + 1;
+	switch (e->type)
+	{
+		case JBAS_EXPR_OPERAND:
+			return h * 31u + jbas_expr_operand_hash(e->token);
+
+		case JBAS_EXPR_PAREN:
+			return h * 31u + (unsigned int)(uintptr_t) e->token->paren_token.memo;
+
+		case JBAS_EXPR_UNARY:
+		case JBAS_EXPR_BINARY:
+			h = h * 31u + (unsigned int)(uintptr_t) e->op;
+			// Fall through
+
+		case JBAS_EXPR_CALL:
+			h = h * 31u + jbas_expr_hash(e->a);
+			return h * 31u + jbas_expr_hash(e->b);
+	}
+
+	return h;
+}
+
+/**
+	True if the expressions are structurally identical
+*/
+bool jbas_expr_equal(const jbas_expr *e1, const jbas_expr *e2)
+{
+	e1 = jbas_expr_strip(e1);
+	e2 = jbas_expr_strip(e2);
+	if (!e1 || !e2) return e1 == e2;
+	if (e1->type != e2->type) return false;
+
+	switch (e1->type)
+	{
+		case JBAS_EXPR_OPERAND:
+			return jbas_expr_operand_equal(e1->token, e2->token);
+
+		case JBAS_EXPR_PAREN:
+			return e1->token->paren_token.memo == e2->token->paren_token.memo
+				&& (e1->token->paren_token.memo || e1 == e2);
+
+		case JBAS_EXPR_UNARY:
+		case JBAS_EXPR_BINARY:
+			if (e1->op != e2->op) return false;
+			// Fall through
+
+		case JBAS_EXPR_CALL:
+			return jbas_expr_equal(e1->a, e2->a) && jbas_expr_equal(e1->b, e2->b);
+	}
+
+	return false;
+}
+
+/**
+	Returns number of nodes in the expression
+*/
+int jbas_expr_size(const jbas_expr *e)
+{
+	if (!e) return 0;
+	return 1 + jbas_expr_size(e->a) + jbas_expr_size(e->b);
+}
+
+/**
+	Evaluates integer expression consisting of +, -, * and parentheses
+	with `var` substituted by `value`. Other symbols have to hold integers.
+	Fails if the expression contains anything else or if any intermediate
+	result does not fit in jbas_int. Memos are ignored.
+*/
+bool jbas_expr_eval_int(const jbas_expr *e, const jbas_symbol *var, int64_t value, int64_t *result)
+{
+	int64_t a, b;
+	if (!e) return false;
+
+	switch (e->type)
+	{
+		case JBAS_EXPR_OPERAND:
+			if (e->token->type == JBAS_TOKEN_NUMBER && e->token->number_token.type == JBAS_NUM_INT)
+				*result = e->token->number_token.i;
+			else if (e->token->type == JBAS_TOKEN_SYMBOL && e->token->symbol_token.sym == var)
+				*result = value;
+			else if (e->token->type == JBAS_TOKEN_SYMBOL)
+			{
+				const jbas_resource *res = e->token->symbol_token.sym->res;
+				if (!res || res->type != JBAS_RESOURCE_NUMBER || res->number.type != JBAS_NUM_INT) return false;
+				*result = res->number.i;
+			}
+			else
+				return false;
+			break;
+
+		case JBAS_EXPR_PAREN:
+			if (!jbas_expr_eval_int(e->a, var, value, result)) return false;
+			break;
+
+		case JBAS_EXPR_UNARY:
+			if (strcmp(e->op->str, "-") || !jbas_expr_eval_int(e->a, var, value, &a)) return false;
+			*result = -a;
+			break;
+
+		case JBAS_EXPR_BINARY:
+			if (!jbas_expr_eval_int(e->a, var, value, &a) || !jbas_expr_eval_int(e->b, var, value, &b)) return false;
+			if (!strcmp(e->op->str, "+")) *result = a + b;
+			else if (!strcmp(e->op->str, "-")) *result = a - b;
+			else if (!strcmp(e->op->str, "*")) *result = a * b;
+			else return false;
+			break;
+
+		default:
+			return false;
+	}
+
+	return *result >= INT_MIN && *result <= INT_MAX;
+}
@@ -0,0 +1,542 @@
+#include <jbasic/image.h>
+#include <jbasic/jbasic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+	Image writer state - maps the storage slots to image indices
+*/
+typedef struct jbas_image_ctx
+{
+	jbas_env *env;
+	int *text_map;
+	int *symbol_map;
+	int *token_map;
+	jbas_token **order; //!< Tokens in the order they are written
+	int token_count;
+} jbas_image_ctx;
+
+/**
+	Numbers all tokens of the list (and its sublists) in preorder
+*/
+static jbas_error jbas_image_collect(jbas_image_ctx *ctx, jbas_token *list)
+{
+	jbas_token_pool *pool = &ctx->env->token_pool;
+
+	for (jbas_token *t = jbas_token_list_begin(list); t; t = t->r)
+	{
+		if (t < pool->tokens || t >= pool->tokens + pool->pool_size)
+		{
+			JBAS_ERROR_REASON(ctx->env, "token does not come from the token pool");
+			return JBAS_UNSUPPORTED;
+		}
+
+		ctx->token_map[t - pool->tokens] = ctx->token_count;
+		ctx->order[ctx->token_count++] = t;
+
+		jbas_error err = JBAS_OK;
+		if (t->type == JBAS_TOKEN_PAREN)
+			err = jbas_image_collect(ctx, t->paren_token.tokens);
+		else if (t->type == JBAS_TOKEN_TUPLE)
+			err = jbas_image_collect(ctx, t->tuple_token.tokens);
+		if (err) return err;
+	}
+
+	return JBAS_OK;
+}
+
+/**
+	Returns image index of the first token of the list or -1 for empty lists
+*/
+static int32_t jbas_image_list_index(jbas_image_ctx *ctx, jbas_token *list)
+{
+	if (!list) return -1;
+	return ctx->token_map[jbas_token_list_begin(list) - ctx->env->token_pool.tokens];
+}
+
+/**
+	Converts a token into its image representation
+*/
+static jbas_error jbas_image_token_convert(jbas_image_ctx *ctx, jbas_token *t, jbas_image_token *it)
+{
+	jbas_env *env = ctx->env;
+
+	it->type = t->type;
+	it->line = t->line;
+	it->r = t->r ? ctx->token_map[t->r - env->token_pool.tokens] : -1;
+	it->index = -1;
+	it->extra = -1;
+	it->i = 0;
+
+	switch (t->type)
+	{
+		case JBAS_TOKEN_KEYWORD:
+			it->index = t->keyword_token.kw - jbas_keywords;
+			break;
+
+		case JBAS_TOKEN_OPERATOR:
+			it->index = t->operator_token.op - jbas_operators;
+			break;
+
+		case JBAS_TOKEN_SYMBOL:
+			it->index = ctx->symbol_map[t->symbol_token.sym - env->symbol_manager.symbol_storage];
+			break;
+
+		case JBAS_TOKEN_STRING:
+			it->index = ctx->text_map[t->string_token.txt - env->text_manager.text_storage];
+			break;
+
+		case JBAS_TOKEN_NUMBER:
+			it->extra = t->number_token.type;
+			if (t->number_token.type == JBAS_NUM_FLOAT) it->f = t->number_token.f;
+			else it->i = t->number_token.i;
+			break;
+
+		case JBAS_TOKEN_PAREN:
+			it->index = jbas_image_list_index(ctx, t->paren_token.tokens);
+			if (t->paren_token.memo)
+				it->extra = jbas_memo_id(&env->memo_manager, t->paren_token.memo);
+			break;
+
+		case JBAS_TOKEN_TUPLE:
+			it->index = jbas_image_list_index(ctx, t->tuple_token.tokens);
+			break;
+
+		case JBAS_TOKEN_DELIMITER:
+			break;
+
+		default:
+			JBAS_ERROR_REASON(env, "resources cannot be stored in an image");
+			return JBAS_UNSUPPORTED;
+	}
+
+	return JBAS_OK;
+}
+
+static jbas_error jbas_image_write_tables(jbas_image_ctx *ctx, FILE *f)
+{
+	jbas_env *env = ctx->env;
+	jbas_text_manager *tm = &env->text_manager;
+	jbas_symbol_manager *sm = &env->symbol_manager;
+	jbas_memo_manager *mm = &env->memo_manager;
+	jbas_image_header h = {.magic = JBAS_IMAGE_MAGIC, .version = JBAS_IMAGE_VERSION};
+
+	// Number the texts and the symbols
+	for (int i = 0; i < tm->max_count; i++)
+	{
+		if (!tm->is_used[i]) continue;
+		ctx->text_map[i] = h.text_count++;
+		h.blob_size += tm->text_storage[i].length;
+	}
+
+	for (int i = 0; i < sm->max_count; i++)
+		if (sm->is_used[i])
+			ctx->symbol_map[i] = h.symbol_count++;
+
+	// Number the tokens
+	jbas_error err = jbas_image_collect(ctx, env->tokens);
+	if (err) return err;
+	h.token_count = ctx->token_count;
+	h.memo_count = mm->memo_count;
+	h.root = jbas_image_list_index(ctx, env->tokens);
+
+	fwrite(&h, sizeof(h), 1, f);
+
+	// Texts
+	uint32_t offset = 0;
+	for (int i = 0; i < tm->max_count; i++)
+	{
+		if (!tm->is_used[i]) continue;
+		jbas_image_text it = {.offset = offset, .length = tm->text_storage[i].length};
+		fwrite(&it, sizeof(it), 1, f);
+		offset += it.length;
+	}
+
+	// Symbols
+	for (int i = 0; i < sm->max_count; i++)
+	{
+		if (!sm->is_used[i]) continue;
+		jbas_image_symbol is = {
+			.name = ctx->text_map[sm->symbol_storage[i].name - tm->text_storage],
+			.type = sm->symbol_storage[i].type,
+		};
+		fwrite(&is, sizeof(is), 1, f);
+	}
+
+	// Memos
+	for (int i = 0; i < mm->memo_count; i++)
+	{
+		int32_t kind = mm->memo_storage[i].kind;
+		fwrite(&kind, sizeof(kind), 1, f);
+	}
+
+	// Tokens
+	for (int i = 0; i < ctx->token_count; i++)
+	{
+		jbas_image_token it;
+		err = jbas_image_token_convert(ctx, ctx->order[i], &it);
+		if (err) return err;
+		fwrite(&it, sizeof(it), 1, f);
+	}
+
+	// Text contents
+	for (int i = 0; i < tm->max_count; i++)
+		if (tm->is_used[i])
+			fwrite(tm->text_storage[i].str, 1, tm->text_storage[i].length, f);
+
+	return JBAS_OK;
+}
+
+/**
+	Writes the program loaded into the environment as an image.
+	It should be called after the optimizer and the type inference have run
+	and before the program is executed.
+*/
+jbas_error jbas_image_write(jbas_env *env, FILE *f)
+{
+	jbas_image_ctx ctx = {.env = env};
+	ctx.text_map = calloc(env->text_manager.max_count, sizeof(int));
+	ctx.symbol_map = calloc(env->symbol_manager.max_count, sizeof(int));
+	ctx.token_map = calloc(env->token_pool.pool_size, sizeof(int));
+	ctx.order = calloc(env->token_pool.pool_size, sizeof(jbas_token*));
+
+	jbas_error err = JBAS_ALLOC;
+	if (ctx.text_map && ctx.symbol_map && ctx.token_map && ctx.order)
+		err = jbas_image_write_tables(&ctx, f);
+
+	if (!err && (fflush(f) || ferror(f)))
+	{
+		JBAS_ERROR_REASON(env, "could not write the image");
+		err = JBAS_IO_ERROR;
+	}
+
+	free(ctx.text_map);
+	free(ctx.symbol_map);
+	free(ctx.token_map);
+	free(ctx.order);
+	return err;
+}
+
+/**
+	Checks whether the token fields hold valid image indices
+*/
+static bool jbas_image_token_valid(const jbas_image_header *h, const jbas_image_token *it)
+{
+	if (it->r < -1 || it->r >= (int32_t) h->token_count || it->line < 0) return false;
+
+	switch (it->type)
+	{
+		case JBAS_TOKEN_KEYWORD:
+			return it->index >= 0 && it->index < JBAS_KEYWORD_COUNT;
+
+		case JBAS_TOKEN_OPERATOR:
+			return it->index >= 0 && it->index < JBAS_OPERATOR_COUNT;
+
+		case JBAS_TOKEN_SYMBOL:
+			return it->index >= 0 && it->index < (int32_t) h->symbol_count;
+
+		case JBAS_TOKEN_STRING:
+			return it->index >= 0 && it->index < (int32_t) h->text_count;
+
+		case JBAS_TOKEN_NUMBER:
+			return it->extra >= JBAS_NUM_BOOL && it->extra <= JBAS_NUM_FLOAT;
+
+		case JBAS_TOKEN_PAREN:
+			if (it->extra < -1 || it->extra >= (int32_t) h->memo_count) return false;
+			// fallthrough
+		case JBAS_TOKEN_TUPLE:
+			return it->index >= -1 && it->index < (int32_t) h->token_count;
+
+		case JBAS_TOKEN_DELIMITER:
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+/**
+	Pointers to the tables of a mapped image
+*/
+typedef struct jbas_image_view
+{
+	const jbas_image_header *h;
+	const jbas_image_text *texts;
+	const jbas_image_symbol *symbols;
+	const int32_t *memos;
+	const jbas_image_token *tokens;
+	const char *blob;
+} jbas_image_view;
+
+/**
+	Checks the whole image before anything is created in the environment,
+	so a rejected image leaves the environment untouched
+*/
+static jbas_error jbas_image_validate(jbas_env *env, const char *data, size_t size, jbas_image_view *v)
+{
+	const jbas_image_header *h = (const jbas_image_header*) data;
+	if (size < sizeof(*h) || memcmp(h->magic, JBAS_IMAGE_MAGIC, 4) || h->version != JBAS_IMAGE_VERSION)
+	{
+		JBAS_ERROR_REASON(env, "not a JBasic image or unsupported image version");
+		return JBAS_BAD_IMAGE;
+	}
+
+	uint64_t expected = sizeof(*h)
+		+ (uint64_t) h->text_count * sizeof(jbas_image_text)
+		+ (uint64_t) h->symbol_count * sizeof(jbas_image_symbol)
+		+ (uint64_t) h->memo_count * sizeof(int32_t)
+		+ (uint64_t) h->token_count * sizeof(jbas_image_token)
+		+ h->blob_size;
+	if (expected != size || h->token_count > INT32_MAX || h->root < -1 || h->root >= (int32_t) h->token_count)
+	{
+		JBAS_ERROR_REASON(env, "image size does not match its header");
+		return JBAS_BAD_IMAGE;
+	}
+
+	v->h = h;
+	v->texts = (const jbas_image_text*)(h + 1);
+	v->symbols = (const jbas_image_symbol*)(v->texts + h->text_count);
+	v->memos = (const int32_t*)(v->symbols + h->symbol_count);
+	v->tokens = (const jbas_image_token*)(v->memos + h->memo_count);
+	v->blob = (const char*)(v->tokens + h->token_count);
+
+	for (uint32_t i = 0; i < h->text_count; i++)
+	{
+		const jbas_image_text *it = &v->texts[i];
+		if ((uint64_t) it->offset + it->length > h->blob_size || memchr(v->blob + it->offset, 0, it->length))
+		{
+			JBAS_ERROR_REASON(env, "bad text in the image");
+			return JBAS_BAD_IMAGE;
+		}
+	}
+
+	for (uint32_t i = 0; i < h->symbol_count; i++)
+	{
+		const jbas_image_symbol *is = &v->symbols[i];
+		if (is->name < 0 || is->name >= (int32_t) h->text_count
+			|| is->type < JBAS_TYPE_NONE || is->type > JBAS_TYPE_POLY)
+		{
+			JBAS_ERROR_REASON(env, "bad symbol in the image");
+			return JBAS_BAD_IMAGE;
+		}
+	}
+
+	for (uint32_t i = 0; i < h->memo_count; i++)
+	{
+		if (v->memos[i] != JBAS_MEMO_VALUE && v->memos[i] != JBAS_MEMO_BOUNDS)
+		{
+			JBAS_ERROR_REASON(env, "bad memo in the image");
+			return JBAS_BAD_IMAGE;
+		}
+	}
+
+	for (uint32_t i = 0; i < h->token_count; i++)
+	{
+		if (!jbas_image_token_valid(h, &v->tokens[i]))
+		{
+			JBAS_ERROR_REASON(env, "bad token in the image");
+			return JBAS_BAD_IMAGE;
+		}
+	}
+
+	// Every token can be preceded by at most one token (or parentheses),
+	// so the lists cannot form cycles
+	bool *linked = calloc(h->token_count + 1, sizeof(bool));
+	if (!linked) return JBAS_ALLOC;
+
+	jbas_error err = JBAS_OK;
+	if (h->root >= 0) linked[h->root] = true;
+	for (uint32_t i = 0; !err && i < h->token_count; i++)
+	{
+		const jbas_image_token *it = &v->tokens[i];
+		int32_t child = -1;
+		if (it->type == JBAS_TOKEN_PAREN || it->type == JBAS_TOKEN_TUPLE)
+			child = it->index;
+
+		if (it->r >= 0)
+		{
+			if (linked[it->r]) err = JBAS_BAD_IMAGE;
+			linked[it->r] = true;
+		}
+
+		if (child >= 0)
+		{
+			if (linked[child]) err = JBAS_BAD_IMAGE;
+			linked[child] = true;
+		}
+	}
+
+	free(linked);
+	if (err) JBAS_ERROR_REASON(env, "bad token links in the image");
+	return err;
+}
+
+/**
+	Rebuilds the program from a validated image
+*/
+static jbas_error jbas_image_link(jbas_env *env, const jbas_image_view *v)
+{
+	const jbas_image_header *h = v->h;
+	jbas_text **texts = calloc(h->text_count + 1, sizeof(jbas_text*));
+	jbas_symbol **syms = calloc(h->symbol_count + 1, sizeof(jbas_symbol*));
+	jbas_memo **memos = calloc(h->memo_count + 1, sizeof(jbas_memo*));
+	jbas_token **tokens = calloc(h->token_count + 1, sizeof(jbas_token*));
+	jbas_error err = JBAS_OK;
+	if (!texts || !syms || !memos || !tokens) err = JBAS_ALLOC;
+
+	// Texts
+	for (uint32_t i = 0; !err && i < h->text_count; i++)
+	{
+		const char *s = v->blob + v->texts[i].offset;
+		err = jbas_text_lookup_create(&env->text_manager, s, s + v->texts[i].length, &texts[i]);
+	}
+
+	// Symbols - the ones imported from C are already there
+	for (uint32_t i = 0; !err && i < h->symbol_count; i++)
+	{
+		err = jbas_symbol_create(env, &syms[i], texts[v->symbols[i].name]->str, NULL);
+		if (err == JBAS_SYMBOL_COLLISION) err = JBAS_OK;
+		if (!err) syms[i]->type = v->symbols[i].type;
+	}
+
+	// Memos
+	for (uint32_t i = 0; !err && i < h->memo_count; i++)
+	{
+		err = jbas_memo_create(&env->memo_manager, &memos[i]);
+		if (!err) memos[i]->kind = v->memos[i];
+	}
+
+	// Get all tokens from the pool first, so they can be linked in one pass
+	for (uint32_t i = 0; !err && i < h->token_count; i++)
+	{
+		err = jbas_token_pool_get(&env->token_pool, &tokens[i]);
+		if (!err) *tokens[i] = (jbas_token){.type = v->tokens[i].type, .line = v->tokens[i].line};
+	}
+
+	for (uint32_t i = 0; !err && i < h->token_count; i++)
+	{
+		const jbas_image_token *it = &v->tokens[i];
+		jbas_token *t = tokens[i];
+
+		if (it->r >= 0)
+		{
+			t->r = tokens[it->r];
+			t->r->l = t;
+		}
+
+		switch (it->type)
+		{
+			case JBAS_TOKEN_KEYWORD:
+				t->keyword_token.kw = &jbas_keywords[it->index];
+				t->keyword_token.data = NULL;
+				break;
+
+			case JBAS_TOKEN_OPERATOR:
+				t->operator_token.op = &jbas_operators[it->index];
+				break;
+
+			case JBAS_TOKEN_SYMBOL:
+				t->symbol_token.sym = syms[it->index];
+				break;
+
+			case JBAS_TOKEN_STRING:
+				t->string_token.txt = texts[it->index];
+				break;
+
+			case JBAS_TOKEN_NUMBER:
+				t->number_token.type = it->extra;
+				if (it->extra == JBAS_NUM_FLOAT) t->number_token.f = it->f;
+				else t->number_token.i = it->i;
+				break;
+
+			case JBAS_TOKEN_PAREN:
+				t->paren_token.memo = it->extra >= 0 ? memos[it->extra] : NULL;
+				break;
+		}
+	}
+
+	// Sublists are referenced through their last element, so they can only
+	// be attached once all the tokens are linked
+	for (uint32_t i = 0; !err && i < h->token_count; i++)
+	{
+		jbas_token *t = tokens[i];
+		int32_t child = v->tokens[i].index;
+		if (t->type == JBAS_TOKEN_PAREN)
+			t->paren_token.tokens = child >= 0 ? jbas_token_list_end(tokens[child]) : NULL;
+		else if (t->type == JBAS_TOKEN_TUPLE)
+			t->tuple_token.tokens = child >= 0 ? jbas_token_list_end(tokens[child]) : NULL;
+	}
+
+	if (!err)
+		env->tokens = h->root >= 0 ? jbas_token_list_end(tokens[h->root]) : NULL;
+
+	free(texts);
+	free(syms);
+	free(memos);
+	free(tokens);
+	return err;
+}
+
+/**
+	Loads an image from memory. The image is only read and it is not
+	referenced once the function returns. See jbas_image_load().
+*/
+jbas_error jbas_image_load_memory(jbas_env *env, const void *data, size_t size)
+{
+	jbas_image_view v;
+	jbas_error err = jbas_image_validate(env, data, size, &v);
+	if (!err) err = jbas_image_link(env, &v);
+	return err;
+}
+
+/**
+	Loads an image written by jbas_image_write() into an environment without
+	a program. C resources should be imported before the image is loaded.
+	If JBAS_BAD_IMAGE is returned, the environment has not been modified.
+*/
+jbas_error jbas_image_load(jbas_env *env, const char *path)
+{
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st))
+	{
+		if (fd >= 0) close(fd);
+		JBAS_ERROR_REASON(env, "could not open the image");
+		return JBAS_IO_ERROR;
+	}
+
+	if (!st.st_size)
+	{
+		close(fd);
+		JBAS_ERROR_REASON(env, "empty image");
+		return JBAS_BAD_IMAGE;
+	}
+
+	void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+	{
+		JBAS_ERROR_REASON(env, "could not map the image");
+		return JBAS_IO_ERROR;
+	}
+
+	jbas_error err = jbas_image_load_memory(env, data, st.st_size);
+	munmap(data, st.st_size);
+	return err;
+}
+
+/**
+	True if the file starts with the image magic
+*/
+bool jbas_image_probe(const char *path)
+{
+	FILE *f = fopen(path, "rb");
+	if (!f) return false;
+
+	char magic[4];
+	bool ok = fread(magic, 1, sizeof(magic), f) == sizeof(magic) && !memcmp(magic, JBAS_IMAGE_MAGIC, 4);
+	fclose(f);
+	return ok;
+}
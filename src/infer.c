@@ -0,0 +1,295 @@
+#include <jbasic/infer.h>
+#include <jbasic/jbasic.h>
+#include <string.h>
+
+/**
+	Least upper bound of two types
+*/
+static jbas_symbol_type jbas_infer_join(jbas_symbol_type a, jbas_symbol_type b)
+{
+	if (a == JBAS_TYPE_NONE) return b;
+	if (b == JBAS_TYPE_NONE || a == b) return a;
+	return JBAS_TYPE_POLY;
+}
+
+static bool jbas_infer_is_number(jbas_symbol_type t)
+{
+	return t == JBAS_TYPE_BOOL || t == JBAS_TYPE_INT || t == JBAS_TYPE_FLOAT;
+}
+
+static jbas_symbol_type jbas_infer_number_type(jbas_number_type t)
+{
+	switch (t)
+	{
+		case JBAS_NUM_BOOL: return JBAS_TYPE_BOOL;
+		case JBAS_NUM_INT: return JBAS_TYPE_INT;
+		case JBAS_NUM_FLOAT: return JBAS_TYPE_FLOAT;
+		default: return JBAS_TYPE_POLY;
+	}
+}
+
+/**
+	Type of values the expression results in, based on the types
+	currently assigned to the symbols. JBAS_TYPE_NONE means that
+	the expression cannot yield any value (yet).
+*/
+jbas_symbol_type jbas_infer_expr_type(const jbas_expr *e)
+{
+	if (!e) return JBAS_TYPE_POLY;
+
+	switch (e->type)
+	{
+		case JBAS_EXPR_OPERAND:
+			if (e->token->type == JBAS_TOKEN_NUMBER)
+				return jbas_infer_number_type(e->token->number_token.type);
+			if (e->token->type == JBAS_TOKEN_SYMBOL)
+				return e->token->symbol_token.sym->type;
+			return JBAS_TYPE_POLY;
+
+		case JBAS_EXPR_PAREN:
+			// Tuples
+			if (e->a && e->a->type == JBAS_EXPR_BINARY && e->a->op->level == 1)
+				return JBAS_TYPE_POLY;
+			return jbas_infer_expr_type(e->a);
+
+		case JBAS_EXPR_UNARY:
+		{
+			if (!strcmp(e->op->str, "!") || !strcmp(e->op->str, "NOT"))
+				return JBAS_TYPE_BOOL;
+
+			// Negation keeps the type, PRINT and INPUT return the operand
+			jbas_symbol_type t = jbas_infer_expr_type(e->a);
+			if (!strcmp(e->op->str, "-") && t != JBAS_TYPE_NONE && !jbas_infer_is_number(t))
+				return JBAS_TYPE_POLY;
+			return t;
+		}
+
+		case JBAS_EXPR_BINARY:
+		{
+			switch (e->op->level)
+			{
+				// Assignment (array elements keep their type)
+				case 0:
+					if (e->a->type == JBAS_EXPR_CALL) return jbas_infer_expr_type(e->a);
+					return jbas_infer_expr_type(e->b);
+
+				// Comma
+				case 1:
+					return JBAS_TYPE_POLY;
+
+				// Logical operators and comparisons
+				case 2:
+				case 3:
+					return JBAS_TYPE_BOOL;
+			}
+
+			// Arithmetic - the same as jbas_number_type_promotion()
+			jbas_symbol_type ta = jbas_infer_expr_type(e->a);
+			jbas_symbol_type tb = jbas_infer_expr_type(e->b);
+			if (ta == JBAS_TYPE_NONE || tb == JBAS_TYPE_NONE) return JBAS_TYPE_NONE;
+			if (!jbas_infer_is_number(ta) || !jbas_infer_is_number(tb)) return JBAS_TYPE_POLY;
+			return ta >= tb ? ta : tb;
+		}
+
+		case JBAS_EXPR_CALL:
+			// Array elements
+			if (e->a->type == JBAS_EXPR_OPERAND && e->a->token->type == JBAS_TOKEN_SYMBOL)
+			{
+				switch (e->a->token->symbol_token.sym->type)
+				{
+					case JBAS_TYPE_NONE: return JBAS_TYPE_NONE;
+					case JBAS_TYPE_INT_ARRAY: return JBAS_TYPE_INT;
+					case JBAS_TYPE_FLOAT_ARRAY: return JBAS_TYPE_FLOAT;
+					default: return JBAS_TYPE_POLY;
+				}
+			}
+			return JBAS_TYPE_POLY;
+	}
+
+	return JBAS_TYPE_POLY;
+}
+
+/**
+	Binds symbol to a value of given type. Returns true if the
+	type of the symbol has changed.
+*/
+static bool jbas_infer_bind(jbas_symbol *sym, jbas_symbol_type type)
+{
+	jbas_symbol_type t = jbas_infer_join(sym->type, type);
+	if (t == sym->type) return false;
+	sym->type = t;
+	return true;
+}
+
+/**
+	Makes all symbols in range [begin, end) (including parentheses contents) polymorphic
+*/
+static bool jbas_infer_poly_all(jbas_token *begin, jbas_token *end)
+{
+	bool changed = false;
+	for (jbas_token *t = begin; t && t != end; t = t->r)
+	{
+		if (t->type == JBAS_TOKEN_SYMBOL)
+			changed |= jbas_infer_bind(t->symbol_token.sym, JBAS_TYPE_POLY);
+		else if (t->type == JBAS_TOKEN_PAREN)
+			changed |= jbas_infer_poly_all(jbas_token_list_begin(t->paren_token.tokens), NULL);
+	}
+
+	return changed;
+}
+
+/**
+	Flattens a comma separated list
+*/
+static int jbas_infer_tuple(const jbas_expr *e, const jbas_expr **items, int max_count)
+{
+	if (e->type == JBAS_EXPR_BINARY && e->op->level == 1)
+	{
+		int n = jbas_infer_tuple(e->a, items, max_count);
+		if (n < 0 || n >= max_count) return -1;
+		items[n] = e->b;
+		return n + 1;
+	}
+
+	if (max_count < 1) return -1;
+	items[0] = e;
+	return 1;
+}
+
+/**
+	Handles a single assignment. Returns true if any type has changed.
+*/
+static bool jbas_infer_assign(const jbas_expr *lhs, const jbas_expr *rhs)
+{
+	if (lhs->type == JBAS_EXPR_OPERAND && lhs->token->type == JBAS_TOKEN_SYMBOL)
+		return jbas_infer_bind(lhs->token->symbol_token.sym, jbas_infer_expr_type(rhs));
+
+	// Array element write - the symbol is not rebound
+	if (lhs->type == JBAS_EXPR_CALL)
+		return false;
+
+	// Tuple assignment is done elementwise
+	if (lhs->type == JBAS_EXPR_PAREN && lhs->a && rhs->type == JBAS_EXPR_PAREN && rhs->a)
+	{
+		const jbas_expr *litems[JBAS_EXPR_MAX_NODES], *ritems[JBAS_EXPR_MAX_NODES];
+		int lcount = jbas_infer_tuple(lhs->a, litems, JBAS_EXPR_MAX_NODES);
+		int rcount = jbas_infer_tuple(rhs->a, ritems, JBAS_EXPR_MAX_NODES);
+		if (lcount > 1 && lcount == rcount)
+		{
+			bool changed = false;
+			for (int i = 0; i < lcount; i++)
+				changed |= jbas_infer_assign(litems[i], ritems[i]);
+			return changed;
+		}
+	}
+
+	return jbas_infer_poly_all(lhs->begin, lhs->end->r);
+}
+
+/**
+	Visits all assignments in instruction [begin, end)
+*/
+static bool jbas_infer_stmt(jbas_env *env, jbas_expr_tree *tree, jbas_token *begin, jbas_token *end)
+{
+	// If the instruction cannot be understood, nothing is known about the symbols
+	if (jbas_expr_parse(tree, begin, end, &env->tokens))
+		return jbas_infer_poly_all(begin, end);
+
+	bool changed = false;
+	for (int i = 0; i < tree->node_count; i++)
+	{
+		jbas_expr *e = &tree->nodes[i];
+		if (jbas_expr_is_assign(e))
+			changed |= jbas_infer_assign(e->a, e->b);
+	}
+
+	return changed;
+}
+
+/**
+	Single pass over the entire program. Returns true if any type has changed.
+*/
+static bool jbas_infer_pass(jbas_env *env, jbas_expr_tree *tree)
+{
+	bool changed = false;
+	jbas_token *t = jbas_token_list_begin(env->tokens);
+	while (t)
+	{
+		if (t->type == JBAS_TOKEN_DELIMITER)
+		{
+			t = t->r;
+			continue;
+		}
+
+		if (t->type == JBAS_TOKEN_KEYWORD)
+		{
+			jbas_keyword_id id = t->keyword_token.kw->id;
+
+			// Conditions and selectors are ordinary instructions
+			if (id == JBAS_KW_WHILE || id == JBAS_KW_IF || id == JBAS_KW_SELECT || id == JBAS_KW_ELSE || id == JBAS_KW_END)
+			{
+				t = t->r;
+				continue;
+			}
+
+			// PARALLEL FOR counts with integers
+			jbas_token *u = t->r;
+			if (id == JBAS_KW_PARALLEL && u && u->type == JBAS_TOKEN_KEYWORD && u->keyword_token.kw->id == JBAS_KW_FOR
+				&& u->r && u->r->type == JBAS_TOKEN_SYMBOL)
+				changed |= jbas_infer_bind(u->r->symbol_token.sym, JBAS_TYPE_INT);
+
+			if ((id == JBAS_KW_IDIM || id == JBAS_KW_FDIM) && t->r && t->r->type == JBAS_TOKEN_SYMBOL)
+				changed |= jbas_infer_bind(t->r->symbol_token.sym, id == JBAS_KW_IDIM ? JBAS_TYPE_INT_ARRAY : JBAS_TYPE_FLOAT_ARRAY);
+
+			// Other keywords do not bind symbols
+			while (t && t->type != JBAS_TOKEN_DELIMITER)
+				t = t->r;
+			continue;
+		}
+
+		jbas_token *delim = t;
+		while (delim && delim->type != JBAS_TOKEN_DELIMITER)
+			delim = delim->r;
+		changed |= jbas_infer_stmt(env, tree, t, delim);
+		t = delim;
+	}
+
+	return changed;
+}
+
+/**
+	Infers types of all symbols in the program. Symbols bound before
+	the program is loaded (e.g. C functions) are polymorphic.
+*/
+jbas_error jbas_infer_types(jbas_env *env)
+{
+	jbas_symbol_manager *sm = &env->symbol_manager;
+	for (int i = 0; i < sm->max_count; i++)
+		if (sm->is_used[i])
+			sm->symbol_storage[i].type = sm->symbol_storage[i].res ? JBAS_TYPE_POLY : JBAS_TYPE_NONE;
+
+	jbas_expr_tree *tree = malloc(sizeof(*tree));
+	if (!tree) return JBAS_ALLOC;
+
+	// The lattice is finite and types only go up - this terminates
+	while (jbas_infer_pass(env, tree));
+
+	free(tree);
+	return JBAS_OK;
+}
+
+const char *jbas_symbol_type_str(jbas_symbol_type type)
+{
+	switch (type)
+	{
+		case JBAS_TYPE_NONE: return "NONE";
+		case JBAS_TYPE_BOOL: return "BOOL";
+		case JBAS_TYPE_INT: return "INT";
+		case JBAS_TYPE_FLOAT: return "FLOAT";
+		case JBAS_TYPE_INT_ARRAY: return "INT ARRAY";
+		case JBAS_TYPE_FLOAT_ARRAY: return "FLOAT ARRAY";
+		case JBAS_TYPE_POLY: return "POLY";
+	}
+
+	return "???";
+}
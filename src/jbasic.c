@@ -3,6 +3,10 @@
 #include <jbasic/cast.h>
 #include <jbasic/kw.h>
 #include <jbasic/debug.h>
+#include <jbasic/pool.h>
+#include <jbasic/profile.h>
+#include <stdarg.h>
+#include <unistd.h>
 
 /**
 	Returns true or false depending on whether the character
@@ -48,7 +52,7 @@ int jbas_printf(jbas_env *env, const char *format, ...)
 {
 	va_list ap;
 	va_start(ap, format);
-	int ret = vfprintf(stdout, format, ap);
+	int ret = vfprintf(env->output, format, ap);
 	va_end(ap);
 	return ret;
 }
@@ -149,6 +153,16 @@ jbas_error jbas_eval_instruction(jbas_env *env, jbas_token *begin, jbas_token **
 		return JBAS_OK;
 	}
 
+	// The instruction is run again after it would block - the C functions
+	// it has called return the same results again
+	if (env->call_results_at != begin)
+	{
+		env->call_results_at = begin;
+		env->call_result_count = 0;
+		env->call_results_lost = false;
+	}
+	env->call_result_next = 0;
+
 	// Create a deep copy of the entire instruction
 	jbas_token *t, *expr = NULL;
 	for (t = begin; t && t->type != JBAS_TOKEN_DELIMITER; t = t->r)
@@ -181,6 +195,15 @@ jbas_error jbas_eval_instruction(jbas_env *env, jbas_token *begin, jbas_token **
 	fprintf(stderr, "\n");
 	#endif
 
+	// Only an instruction that would block is run again
+	if (eval_err != JBAS_WOULD_BLOCK)
+		env->call_results_at = NULL;
+	else if (env->call_results_lost)
+	{
+		JBAS_ERROR_REASON(env, "the C functions called before the one that would block cannot be called again");
+		eval_err = JBAS_UNSUPPORTED;
+	}
+
 	// Eval error
 	if (eval_err)
 	{
@@ -216,6 +239,24 @@ jbas_error jbas_eval_instruction(jbas_env *env, jbas_token *begin, jbas_token **
 	return JBAS_OK;
 }
 
+/**
+	Takes one step from the instruction budget. Once it's used up, the run
+	is suspended at `at` (an instruction, or a loop going on).
+*/
+jbas_error jbas_charge_budget(jbas_env *env, jbas_token *at)
+{
+	if (env->budget < 0) return JBAS_OK;
+	if (!env->budget)
+	{
+		JBAS_ERROR_REASON(env, "instruction budget exhausted");
+		env->position = at;
+		return JBAS_BUDGET_EXHAUSTED;
+	}
+
+	env->budget--;
+	return JBAS_OK;
+}
+
 /**
 	Executes either an enitre block or a single instruction.
 */
@@ -232,18 +273,53 @@ jbas_error jbas_run_step(jbas_env *env, jbas_token *begin, jbas_token **next)
 		return JBAS_OK;
 	}
 
-	// Handle keywords
-	if (begin->type == JBAS_TOKEN_KEYWORD)
+	// Requested checkpoint (taken between instructions only)
+	if (env->checkpoint_pending && env->checkpoint_handler)
 	{
-		return jbas_eval_keyword(env, begin, next);
+		env->checkpoint_pending = 0;
+		env->position = begin;
+		jbas_error err = env->checkpoint_handler(env);
+		env->position = NULL;
+		if (err) return err;
 	}
-	else
+
+	// Requested yield - jbas_run() continues from here
+	if (env->yield_pending)
 	{
-		// Handle normal instruction and discard the result
-		return jbas_eval_instruction(env, begin, next, NULL);
+		env->yield_pending = 0;
+		env->position = begin;
+		return JBAS_YIELD;
 	}
 
-	return JBAS_OK;
+	jbas_error err = jbas_charge_budget(env, begin);
+	if (err) return err;
+	env->statement_count++;
+
+#ifndef JBAS_STATIC
+	if (env->profile)
+	{
+		err = jbas_profile_enter(env->profile, env, begin->line);
+		if (err) return err;
+	}
+#endif
+
+	// Handle keywords, or normal instructions (the result is discarded)
+	jbas_token *outer = env->current;
+	env->current = begin;
+	if (begin->type == JBAS_TOKEN_KEYWORD)
+		err = jbas_eval_keyword(env, begin, next);
+	else
+		err = jbas_eval_instruction(env, begin, next, NULL);
+	env->current = outer;
+
+#ifndef JBAS_STATIC
+	if (env->profile) jbas_profile_leave(env->profile, env);
+#endif
+
+	// The innermost instruction is run again once it can go on
+	if (err == JBAS_WOULD_BLOCK && !env->position)
+		env->position = begin;
+	return err;
 }
 
 /**
@@ -268,11 +344,35 @@ jbas_error jbas_run_block(jbas_env *env, jbas_token *begin, jbas_token *end, jba
 
 
 /**
-	Runs entire loaded program
+	Runs entire loaded program. A run suspended with JBAS_YIELD,
+	JBAS_WOULD_BLOCK or JBAS_BUDGET_EXHAUSTED is continued by the next call.
 */
 jbas_error jbas_run(jbas_env *env)
 {
-	return jbas_run_block(env, jbas_token_list_begin(env->tokens), NULL, NULL);
+	// Remember the pool state for jbas_env_reset()
+	if (!env->token_pool.mark_stack)
+	{
+		jbas_error err = jbas_token_pool_mark(&env->token_pool);
+		if (err) return err;
+	}
+
+	// Continue a suspended run (its blocks are still on env->frames)
+	// or a restored checkpoint (the blocks are found in the program)
+	jbas_token *t, *at = env->position;
+	jbas_error err = JBAS_OK;
+	env->position = NULL;
+	if (at && env->suspended)
+		err = jbas_resume_suspended(env, at, &t);
+	else
+	{
+		t = jbas_token_list_begin(env->tokens);
+		if (at) err = jbas_resume(env, t, at, &t);
+	}
+
+	if (!err) err = jbas_run_block(env, t, NULL, NULL);
+	env->suspended = jbas_is_suspension(err);
+	if (!env->suspended) env->frame_count = 0, env->call_results_at = NULL;
+	return err;
 }
 
 /**
@@ -285,7 +385,7 @@ jbas_error jbas_get_token(jbas_env *env, const char *const str, const char **nex
 {
 	const char *s = str;
 	bool ok = false;
-	jbas_token token;
+	jbas_token token = {.line = env->line};
 
 	// Skip preceding whitespace
 	while (*s && isspace(*s) && *s != '\n') s++;
@@ -308,6 +408,7 @@ jbas_error jbas_get_token(jbas_env *env, const char *const str, const char **nex
 	{
 		*next = s + 1;
 		token.type = JBAS_TOKEN_DELIMITER;
+		if (*s == '\n') env->line++;
 		ok = true;
 	}
 
@@ -317,6 +418,7 @@ jbas_error jbas_get_token(jbas_env *env, const char *const str, const char **nex
 		*next = s + 1;
 		token.type = JBAS_TOKEN_PAREN;
 		token.paren_token.tokens = NULL;
+		token.paren_token.memo = NULL;
 
 		jbas_error err = jbas_token_list_push_back_from_pool(*(lists[*level - 1]),
 			&env->token_pool,
@@ -366,8 +468,11 @@ jbas_error jbas_get_token(jbas_env *env, const char *const str, const char **nex
 		token.number_token.type = is_int ? JBAS_NUM_INT : JBAS_NUM_FLOAT;
 		if (is_int)
 			sscanf(s, "%d", &token.number_token.i);
-		else
-			sscanf(s, "%f", &token.number_token.f);
+		else if (jbas_float_parse(s, &token.number_token.f))
+		{
+			JBAS_ERROR_REASON(env, "the number is out of the FLOAT range");
+			return JBAS_CAST_FAILED;
+		}
 
 		*next = num_end;
 		token.type = JBAS_TOKEN_NUMBER;
@@ -389,6 +494,8 @@ jbas_error jbas_get_token(jbas_env *env, const char *const str, const char **nex
 
 		*next = str_end + 1;
 		token.type = JBAS_TOKEN_STRING;
+		for (const char *c = s; c < str_end; c++)
+			if (*c == '\n') env->line++;
 
 		jbas_error err = jbas_text_create(
 			&env->text_manager,
@@ -422,6 +529,7 @@ jbas_error jbas_get_token(jbas_env *env, const char *const str, const char **nex
 		{
 			token.type = JBAS_TOKEN_KEYWORD;
 			token.keyword_token.kw = kw;
+			token.keyword_token.data = NULL;
 			ok = true;
 		}
 
@@ -520,31 +628,252 @@ jbas_error jbas_tokenize_string(jbas_env *env, const char *str)
 
 
 
-jbas_error jbas_env_init(jbas_env *env, int token_count, int text_count, int symbol_count, int resource_count)
+jbas_error jbas_env_init(jbas_env *env, int token_count, int text_count, int symbol_count, int resource_count, int memo_count)
+{
+	return jbas_env_init_with_allocator(env, &jbas_libc_allocator, token_count, text_count, symbol_count, resource_count, memo_count);
+}
+
+/**
+	Bytes of the fixed-size tables of the environment (the token pool has
+	two stacks) - the part of jbas_env_footprint() that doesn't change
+*/
+static void jbas_env_table_bytes(const jbas_env *env, jbas_footprint *fp)
 {
+	fp->tokens = (size_t) env->token_pool.pool_size * (sizeof(jbas_token) + 2 * sizeof(jbas_token*));
+	fp->texts = (size_t) env->text_manager.max_count * (sizeof(jbas_text) + sizeof(int) + sizeof(bool));
+	fp->symbols = (size_t) env->symbol_manager.max_count * (sizeof(jbas_symbol) + sizeof(bool) + 3 * sizeof(int));
+	fp->resources = (size_t) env->resource_manager.max_count * sizeof(jbas_resource*);
+	fp->arrays = 0;
+	fp->memos = (size_t) env->memo_manager.max_count * sizeof(jbas_memo);
+	fp->total = fp->tokens + fp->texts + fp->symbols + fp->resources + fp->arrays + fp->memos;
+}
+
+/**
+	Initializes the environment taking all its memory from `allocator`
+	(copied into env->allocator). Its `destroy` is called by
+	jbas_env_destroy().
+*/
+jbas_error jbas_env_init_with_allocator(jbas_env *env, const jbas_allocator *allocator,
+	int token_count, int text_count, int symbol_count, int resource_count, int memo_count)
+{
+	env->allocator = *allocator;
 	env->tokens = NULL;
+	env->line = 1;
+	env->profile = NULL;
+	env->current = NULL;
+	env->statement_count = env->cfun_calls = env->array_bytes = 0;
+	env->program = NULL;
 	env->error_reason = NULL;
+	env->jit_threshold = 0;
+	env->input = stdin;
+	env->output = stdout;
+	env->checkpoint_pending = 0;
+	env->checkpoint_handler = NULL;
+	env->position = NULL;
+	env->thread_count = 0;
+	env->pool = NULL;
+	env->yield_pending = 0;
+	env->task = NULL;
+	env->budget = -1;
+	env->memory = (jbas_memory){0};
+	env->fd_count = env->fd_shared = 0;
+	env->frames = NULL;
+	env->frame_count = env->frame_size = 0;
+	env->suspended = false;
+	env->call_results_at = NULL;
 	jbas_error err;
 
-	err = jbas_token_pool_init(&env->token_pool, token_count);
+	err = jbas_token_pool_init(&env->token_pool, token_count, &env->allocator);
 	if (err) return err;
 
-	err = jbas_text_manager_init(&env->text_manager, text_count);
+	err = jbas_text_manager_init(&env->text_manager, text_count, &env->allocator);
 	if (err) return err;
 
-	err = jbas_symbol_manager_init(&env->symbol_manager, symbol_count);
+	err = jbas_symbol_manager_init(&env->symbol_manager, symbol_count, &env->allocator);
 	if (err) return err;
 
-	err = jbas_resource_manager_init(&env->resource_manager, resource_count);
+	err = jbas_resource_manager_init(&env->resource_manager, resource_count, &env->allocator);
 	if (err) return err;
 
+	err = jbas_memo_manager_init(&env->memo_manager, memo_count, &env->allocator);
+	if (err) return err;
+
+	// The tables have a fixed size, the strings, resources and arrays are charged as they're made
+	jbas_footprint fp;
+	jbas_env_table_bytes(env, &fp);
+	env->memory.used = env->memory.peak = fp.total;
+	env->text_manager.memory = &env->memory;
+	env->resource_manager.memory = &env->memory;
+
+	return JBAS_OK;
+}
+
+/**
+	Makes the environment the owner of a descriptor opened by a C function
+	(e.g. FOPEN). Only such descriptors can be used by the program and they
+	are closed by jbas_env_reset() and jbas_env_destroy(), so a program
+	that doesn't close them (or fails) doesn't leak them into the host.
+*/
+jbas_error jbas_env_add_fd(jbas_env *env, int fd)
+{
+	if (env->fd_count == JBAS_MAX_FDS)
+	{
+		JBAS_ERROR_REASON(env, "too many open descriptors (see JBAS_MAX_FDS)");
+		return JBAS_IO_ERROR;
+	}
+
+	env->fds[env->fd_count++] = fd;
 	return JBAS_OK;
 }
 
+bool jbas_env_owns_fd(const jbas_env *env, int fd)
+{
+	for (int i = 0; i < env->fd_count; i++)
+		if (env->fds[i] == fd) return true;
+	return false;
+}
+
+/**
+	Closes a descriptor of the environment. Returns -1 for the ones it
+	doesn't own (and the shared ones), otherwise what close() returns.
+*/
+int jbas_env_close_fd(jbas_env *env, int fd)
+{
+	for (int i = env->fd_shared; i < env->fd_count; i++)
+		if (env->fds[i] == fd)
+		{
+			env->fds[i] = env->fds[--env->fd_count];
+			return close(fd);
+		}
+	return -1;
+}
+
+/**
+	Closes all the descriptors the environment owns
+*/
+static void jbas_env_close_fds(jbas_env *env)
+{
+	for (int i = env->fd_shared; i < env->fd_count; i++)
+		close(env->fds[i]);
+	env->fd_count = env->fd_shared = 0;
+}
+
+/**
+	Prepares the environment for another run of the program. Variables
+	are unbound and their resources deleted and all tokens taken from the
+	pool since the first jbas_run() are returned. Descriptors opened by
+	the program are closed. The program, the texts,
+	the C functions and the caches in the program (SELECT tables, compiled
+	loops) are kept. The cost depends on the amount of live data only.
+*/
+void jbas_env_reset(jbas_env *env)
+{
+	// Unbind the variables
+	jbas_symbol_manager *sm = &env->symbol_manager;
+	for (int i = 0; i < sm->used_count; i++)
+	{
+		jbas_symbol *sym = &sm->symbol_storage[sm->used_slots[i]];
+		if (sym->res && sym->res->type != JBAS_RESOURCE_CFUN)
+			sym->res = NULL;
+	}
+
+	jbas_resource_manager_reset(&env->resource_manager);
+	jbas_token_pool_rewind(&env->token_pool);
+	jbas_memo_invalidate_all(&env->memo_manager);
+	jbas_env_close_fds(env);
+	env->error_reason = NULL;
+	env->position = NULL;
+	env->frame_count = 0;
+	env->suspended = false;
+	env->call_results_at = NULL;
+	env->yield_pending = 0;
+}
+
+/**
+	Computes how much memory the parts of the environment hold from its
+	allocator right now (without the allocator's own overhead). The mark
+	stack of the token pool is counted before the first jbas_run() takes
+	it, like in env->memory.
+*/
+void jbas_env_footprint(const jbas_env *env, jbas_footprint *fp)
+{
+	jbas_env_table_bytes(env, fp);
+
+	const jbas_text_manager *tm = &env->text_manager;
+	for (int i = 0; i < tm->max_count; i++)
+		if (tm->is_used[i]) fp->texts += tm->text_storage[i].length + 1;
+
+	const jbas_resource_manager *rm = &env->resource_manager;
+#ifdef JBAS_STATIC
+	fp->resources += (size_t) rm->max_count * sizeof(jbas_resource);
+#else
+	fp->resources += (size_t) rm->ref_count * sizeof(jbas_resource);
+#endif
+	for (int i = 0; i < rm->ref_count; i++)
+		if (rm->refs[i]->data) fp->arrays += jbas_resource_array_bytes(rm->refs[i]);
+
+	fp->total = fp->tokens + fp->texts + fp->symbols + fp->resources + fp->arrays + fp->memos;
+}
+
+/**
+	Reads the counters of the environment
+*/
+void jbas_env_get_stats(const jbas_env *env, jbas_env_stats *stats)
+{
+	const jbas_token_pool *pool = &env->token_pool;
+	const jbas_resource_manager *rm = &env->resource_manager;
+	*stats = (jbas_env_stats){
+		.statements = env->statement_count,
+		.cfun_calls = env->cfun_calls,
+		.tokens_taken = pool->taken,
+		.tokens_returned = pool->returned,
+		.tokens_used = pool->pool_size - pool->unused_count,
+		.tokens_peak = pool->pool_size - pool->min_count,
+		.resources_created = rm->created,
+		.resources_deleted = rm->deleted,
+		.resources_used = rm->ref_count,
+		.resources_peak = rm->peak_count,
+		.gc_runs = rm->gc_runs,
+		.gc_collected = rm->collected,
+		.array_bytes = env->array_bytes,
+		.texts_used = env->text_manager.max_count - env->text_manager.free_slot_count,
+		.symbols_used = env->symbol_manager.used_count,
+		.memos_used = env->memo_manager.memo_count,
+	};
+}
+
+/**
+	Clears the counters - the peaks start from what's in use now
+*/
+void jbas_env_reset_stats(jbas_env *env)
+{
+	jbas_token_pool *pool = &env->token_pool;
+	jbas_resource_manager *rm = &env->resource_manager;
+	env->statement_count = env->cfun_calls = env->array_bytes = 0;
+	pool->taken = pool->returned = 0;
+	pool->min_count = pool->unused_count;
+	rm->created = rm->deleted = rm->gc_runs = rm->collected = 0;
+	rm->peak_count = rm->ref_count;
+}
+
 void jbas_env_destroy(jbas_env *env)
 {
+	jbas_pool_destroy(env->pool);
+	env->pool = NULL;
+	jbas_env_close_fds(env);
+
+	for (jbas_token *t = jbas_token_list_begin(env->tokens); t; t = t->r)
+		jbas_keyword_token_destroy(env, t);
+
 	jbas_token_pool_destroy(&env->token_pool);
 	jbas_text_manager_destroy(&env->text_manager);
 	jbas_symbol_manager_destroy(&env->symbol_manager);
 	jbas_resource_manager_destroy(&env->resource_manager);
+	jbas_memo_manager_destroy(&env->memo_manager);
+	jbas_free(&env->allocator, env->frames, env->frame_size * sizeof(jbas_frame));
+	env->frames = NULL;
+	env->frame_count = env->frame_size = 0;
+
+	if (env->allocator.destroy) env->allocator.destroy(env->allocator.ctx);
+	env->allocator.destroy = NULL;
 }
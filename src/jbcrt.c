@@ -0,0 +1,266 @@
+#include <jbasic/jbcrt.h>
+#include <jbasic/cast.h>
+#include <jbasic/resource.h>
+#include <string.h>
+#include <dlfcn.h>
+
+static jbas_env jbc_env;
+static void *jbc_lib;
+
+void jbc_init(void)
+{
+	// Only C functions use the environment
+	if (jbas_env_init(&jbc_env, 1000, 100, 100, 100, 1))
+		jbc_fail(JBAS_ALLOC, "could not initialize environment");
+}
+
+void jbc_exit(void)
+{
+	jbas_env_destroy(&jbc_env);
+	if (jbc_lib) dlclose(jbc_lib);
+}
+
+/**
+	Reports a run error the same way jbi does
+*/
+_Noreturn void jbc_fail(jbas_error err, const char *reason)
+{
+	fflush(stdout);
+	fprintf(stderr, "run error %d: %s\n", err, reason ? reason : "(null)");
+	exit(EXIT_FAILURE);
+}
+
+jbc_value jbc_fail_value(jbas_error err, const char *reason)
+{
+	jbc_fail(err, reason);
+}
+
+/**
+	Reads value of a polymorphic symbol
+*/
+jbc_value jbc_get(const jbc_value *v)
+{
+	if (v->type == JBC_UNSET)
+		jbc_fail(JBAS_CAST_FAILED, "src/cast.c: could not convert token to number");
+	return *v;
+}
+
+jbc_value jbc_cast(jbc_value v, jbas_number_type type)
+{
+	jbas_number_token n = {.type = v.type, .i = v.i};
+	if (v.type == JBAS_NUM_FLOAT) n.f = v.f;
+	jbas_number_cast(&n, type);
+	if (type == JBAS_NUM_FLOAT) return jbc_float(n.f);
+	return (jbc_value){.type = type, .i = n.i};
+}
+
+/**
+	Arithmetic on two tagged values - see jbas_binary_math_op()
+*/
+jbc_value jbc_math(jbc_math_op op, jbc_value a, jbc_value b)
+{
+	jbas_number_type type = jbas_number_type_promotion(a.type, b.type);
+	a = jbc_cast(a, type);
+	b = jbc_cast(b, type);
+
+	if (type == JBAS_NUM_FLOAT)
+	{
+		switch (op)
+		{
+			case JBC_ADD: return jbc_float(a.f + b.f);
+			case JBC_SUB: return jbc_float(a.f - b.f);
+			case JBC_MUL: return jbc_float(a.f * b.f);
+			case JBC_DIV: return jbc_float(a.f / b.f);
+			case JBC_REM:
+			case JBC_MOD: return jbc_float(fmodf(a.f, b.f));
+		}
+	}
+
+	jbc_value r = {.type = type};
+	switch (op)
+	{
+		case JBC_ADD: r.i = a.i + b.i; break;
+		case JBC_SUB: r.i = a.i - b.i; break;
+		case JBC_MUL: r.i = a.i * b.i; break;
+		case JBC_DIV: r.i = a.i / b.i; break;
+		case JBC_REM: r.i = a.i % b.i; break;
+		case JBC_MOD: r.i = jbc_mod(a.i, b.i); break;
+	}
+	return r;
+}
+
+jbas_int jbc_cmp(jbc_cmp_op op, jbc_value a, jbc_value b)
+{
+	jbas_number_type type = jbas_number_type_promotion(a.type, b.type);
+	a = jbc_cast(a, type);
+	b = jbc_cast(b, type);
+
+	bool less, greater, eq;
+	if (type == JBAS_NUM_FLOAT)
+		less = a.f < b.f, greater = b.f < a.f, eq = a.f == b.f;
+	else
+		less = a.i < b.i, greater = b.i < a.i, eq = a.i == b.i;
+
+	switch (op)
+	{
+		case JBC_EQ: return eq;
+		case JBC_NEQ: return !eq;
+		case JBC_LESS: return less;
+		case JBC_GREATER: return greater;
+		case JBC_LEQ: return less || eq;
+		case JBC_GEQ: return greater || eq;
+	}
+
+	return 0;
+}
+
+jbc_value jbc_neg(jbc_value v)
+{
+	if (v.type == JBAS_NUM_FLOAT) v.f = -v.f;
+	else v.i = -v.i;
+	return v;
+}
+
+/**
+	Prints a number - see jbas_op_print()
+*/
+void jbc_print_value(jbc_value v)
+{
+	if (v.type == JBAS_NUM_INT)
+		printf("%d", v.i);
+	else if (v.type == JBAS_NUM_BOOL)
+		printf(v.i ? "TRUE" : "FALSE");
+	else
+		printf("%f", v.f);
+}
+
+void jbc_print_symbol(const jbc_value *v)
+{
+	if (v->type == JBC_UNSET) printf("<NULL>");
+	else jbc_print_value(*v);
+}
+
+void jbc_print_string(const char *s)
+{
+	printf("%s", s);
+}
+
+/**
+	Resizes an array - see jbas_kw_idim()
+*/
+static void jbc_dim(jbc_array *a, jbas_int size, size_t elem_size, const char *reason)
+{
+	void *p = realloc(a->ptr, (size_t) size * elem_size);
+	if (!p) jbc_fail(JBAS_ALLOC, reason);
+	a->ptr = p;
+	a->size = size;
+}
+
+void jbc_idim(jbc_array *a, jbas_int size)
+{
+	jbc_dim(a, size, sizeof(jbas_int), "src/kw.c: realloc() error in IDIM");
+}
+
+void jbc_fdim(jbc_array *a, jbas_int size)
+{
+	jbc_dim(a, size, sizeof(jbas_float), "src/kw.c: realloc() error in FDIM");
+}
+
+/**
+	Looks the function up in the library pointed to by JBASLIB
+*/
+static void jbc_resolve(jbc_cfun *f)
+{
+	const char *libname = getenv("JBASLIB");
+	if (!jbc_lib && libname)
+	{
+		jbc_lib = dlopen(libname, RTLD_NOW);
+		if (!jbc_lib)
+		{
+			perror("could not load dynamic library");
+			exit(EXIT_FAILURE);
+		}
+
+		int *abi = dlsym(jbc_lib, "jbas_abi_version");
+		if (!abi || *abi != JBAS_ABI_VERSION)
+			jbc_fail(JBAS_BAD_CALL, "JBASLIB has been built for a different interpreter version");
+	}
+
+	jbas_cres *cres = jbc_lib ? dlsym(jbc_lib, "jbas_symbols") : NULL;
+	int *crescnt = jbc_lib ? dlsym(jbc_lib, "jbas_symbol_count") : NULL;
+	for (int i = 0; cres && crescnt && i < *crescnt; i++)
+		if (!jbas_namecmp(f->name, NULL, cres[i].name, NULL))
+			f->cfun = cres[i].cfun;
+
+	if (!f->cfun)
+		jbc_fail(JBAS_BAD_CALL, "src/op.c: no resource to be called?");
+}
+
+#define JBC_MAX_ARGS 16
+
+/**
+	Calls a C function. Multiple arguments are passed as a tuple
+	and no arguments as number 0 (like empty parentheses). Arrays are
+	passed as resources wrapping their buffers and strings as string
+	tokens, so the function sees them like in the interpreter.
+*/
+jbc_value jbc_call(jbc_cfun *f, int argc, const jbc_arg *argv)
+{
+	if (!f->cfun) jbc_resolve(f);
+	if (argc > JBC_MAX_ARGS) jbc_fail(JBAS_BAD_CALL, "too many C function arguments");
+
+	jbas_token args = {.type = JBAS_TOKEN_NUMBER, .number_token = {.type = JBAS_NUM_INT, .i = 0}};
+	jbas_token ret = {.type = JBAS_TOKEN_NUMBER, .number_token = {.type = JBAS_NUM_INT, .i = 0}};
+	jbas_resource arrays[JBC_MAX_ARGS];
+	jbas_text texts[JBC_MAX_ARGS];
+	for (int i = 0; i < argc; i++)
+	{
+		jbas_token n = {.type = JBAS_TOKEN_NUMBER};
+		switch (argv[i].type)
+		{
+			case JBC_ARG_NUMBER:
+				n.number_token = (jbas_number_token){.type = argv[i].value.type, .i = argv[i].value.i};
+				if (argv[i].value.type == JBAS_NUM_FLOAT) n.number_token.f = argv[i].value.f;
+				break;
+
+			// Not managed by the resource manager, the reference keeps it alive during the call
+			case JBC_ARG_INT_ARRAY:
+			case JBC_ARG_FLOAT_ARRAY:
+				arrays[i] = (jbas_resource){
+					.rm_index = -1,
+					.type = argv[i].type == JBC_ARG_INT_ARRAY ? JBAS_RESOURCE_INT_ARRAY : JBAS_RESOURCE_FLOAT_ARRAY,
+					.ref_count = 1,
+					.size = argv[i].array->size,
+					.data = argv[i].array->ptr,
+				};
+				n = (jbas_token){.type = JBAS_TOKEN_RESOURCE, .resource_token = {.res = &arrays[i]}};
+				break;
+
+			case JBC_ARG_STRING:
+				texts[i] = (jbas_text){.str = (char*) argv[i].str, .length = strlen(argv[i].str)};
+				n = (jbas_token){.type = JBAS_TOKEN_STRING, .string_token = {.txt = &texts[i]}};
+				break;
+		}
+
+		if (argc == 1)
+			args = n;
+		else
+		{
+			if (!i) args = (jbas_token){.type = JBAS_TOKEN_TUPLE};
+			jbas_error err = jbas_token_list_push_back_from_pool(args.tuple_token.tokens, &jbc_env.token_pool, &n, &args.tuple_token.tokens);
+			if (err) jbc_fail(err, "could not create C function arguments");
+		}
+	}
+
+	jbas_error err = f->cfun(&jbc_env, &args, &ret);
+	if (args.type == JBAS_TOKEN_TUPLE)
+		jbas_token_list_destroy(args.tuple_token.tokens, &jbc_env.token_pool);
+	if (err) jbc_fail(err, jbc_env.error_reason);
+
+	err = jbas_token_to_number(&jbc_env, &ret);
+	if (err) jbc_fail(JBAS_UNSUPPORTED, "C function did not return a number");
+
+	jbc_value v = {.type = ret.number_token.type, .i = ret.number_token.i};
+	if (v.type == JBAS_NUM_FLOAT) v.f = ret.number_token.f;
+	return v;
+}
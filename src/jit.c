@@ -0,0 +1,1126 @@
+#include <jbasic/jit.h>
+#include <jbasic/jbasic.h>
+#include <jbasic/expr.h>
+#include <jbasic/memo.h>
+#include <stdlib.h>
+#include <string.h>
+
+// FLOAT values are compiled to SSE code, so the fixed point build has no JIT
+#if defined(__x86_64__) && !defined(JBAS_FIXED)
+#include <sys/mman.h>
+#define JBAS_JIT_X86_64
+#endif
+
+#define JBAS_JIT_DONE (-1)     //!< Returned by the compiled code when the loop ends
+
+typedef int (*jbas_jit_fun)(int64_t *frame);
+
+/**
+	Jump to the deoptimization stub of an instruction
+*/
+typedef struct jbas_jit_fixup
+{
+	size_t pos;
+	int deopt;
+} jbas_jit_fixup;
+
+typedef struct jbas_jit_ctx
+{
+	jbas_env *env;
+	jbas_jit_loop *loop;
+
+	unsigned char *code;
+	size_t size, capacity;
+	bool alloc_failed;
+
+	jbas_jit_fixup *fixups;
+	int fixup_count;
+	int deopt; //!< Deoptimization point of the code being compiled
+
+	jbas_expr_tree tree;
+} jbas_jit_ctx;
+
+/**
+	Right operand of an arithmetic operation - a constant, a scalar
+	in the frame or a value in ECX
+*/
+typedef struct jbas_jit_operand
+{
+	enum {JBAS_JIT_IMM, JBAS_JIT_MEM, JBAS_JIT_ECX} kind;
+	int32_t value; //!< Constant or frame offset
+} jbas_jit_operand;
+
+
+static void jbas_jit_emit(jbas_jit_ctx *ctx, const void *bytes, size_t n)
+{
+	if (ctx->alloc_failed) return;
+	if (ctx->size + n > ctx->capacity)
+	{
+		size_t capacity = ctx->capacity ? ctx->capacity : 1024;
+		while (capacity < ctx->size + n) capacity *= 2;
+		unsigned char *code = realloc(ctx->code, capacity);
+		if (!code)
+		{
+			ctx->alloc_failed = true;
+			return;
+		}
+		ctx->code = code;
+		ctx->capacity = capacity;
+	}
+
+	memcpy(ctx->code + ctx->size, bytes, n);
+	ctx->size += n;
+}
+
+#define JBAS_JIT_CODE(ctx, s) jbas_jit_emit((ctx), (s), sizeof(s) - 1)
+
+static void jbas_jit_imm32(jbas_jit_ctx *ctx, int32_t v)
+{
+	jbas_jit_emit(ctx, &v, sizeof(v));
+}
+
+/**
+	Emits a jump with 32-bit displacement and returns position of the displacement
+*/
+static size_t jbas_jit_jump(jbas_jit_ctx *ctx, const char *opcode)
+{
+	jbas_jit_emit(ctx, opcode, strlen(opcode));
+	size_t pos = ctx->size;
+	jbas_jit_imm32(ctx, 0);
+	return pos;
+}
+
+static void jbas_jit_patch(jbas_jit_ctx *ctx, size_t pos, size_t target)
+{
+	if (ctx->alloc_failed) return;
+	int32_t rel = (int32_t) target - (int32_t) (pos + 4);
+	memcpy(ctx->code + pos, &rel, sizeof(rel));
+}
+
+/**
+	Conditional jump to the deoptimization stub of the current instruction
+*/
+static void jbas_jit_deopt_jump(jbas_jit_ctx *ctx, const char *opcode)
+{
+	size_t pos = jbas_jit_jump(ctx, opcode);
+	jbas_jit_fixup *f = realloc(ctx->fixups, (ctx->fixup_count + 1) * sizeof(*f));
+	if (!f)
+	{
+		ctx->alloc_failed = true;
+		return;
+	}
+	ctx->fixups = f;
+	f[ctx->fixup_count++] = (jbas_jit_fixup){.pos = pos, .deopt = ctx->deopt};
+}
+
+/**
+	Registers the instruction (or a block keyword) the interpreter resumes from
+	if the following code fails
+*/
+static jbas_error jbas_jit_deopt_point(jbas_jit_ctx *ctx, jbas_token *t)
+{
+	jbas_jit_loop *loop = ctx->loop;
+	jbas_token **deopt = realloc(loop->deopt, (loop->deopt_count + 1) * sizeof(*deopt));
+	if (!deopt) return JBAS_ALLOC;
+	loop->deopt = deopt;
+	ctx->deopt = loop->deopt_count;
+	deopt[loop->deopt_count++] = t;
+	return JBAS_OK;
+}
+
+/**
+	Returns frame slot of the symbol. Scalars take one slot (value and
+	number type, FLOAT values are kept as their bits), arrays take two
+	(pointer and size).
+*/
+static jbas_error jbas_jit_symbol(jbas_jit_ctx *ctx, jbas_symbol *sym, int *slot)
+{
+	jbas_jit_loop *loop = ctx->loop;
+	for (int i = 0; i < loop->symbol_count; i++)
+		if (loop->symbols[i] == sym)
+		{
+			*slot = loop->slots[i];
+			return JBAS_OK;
+		}
+
+	// Only numeric scalars and arrays
+	int size;
+	switch (sym->type)
+	{
+		case JBAS_TYPE_BOOL:
+		case JBAS_TYPE_INT:
+		case JBAS_TYPE_FLOAT:
+			size = 1;
+			break;
+
+		case JBAS_TYPE_POLY:
+			if (sym->res && sym->res->type != JBAS_RESOURCE_NUMBER) return JBAS_UNSUPPORTED;
+			size = 1;
+			break;
+
+		case JBAS_TYPE_INT_ARRAY:
+		case JBAS_TYPE_FLOAT_ARRAY:
+			size = 2;
+			break;
+
+		default:
+			return JBAS_UNSUPPORTED;
+	}
+
+	jbas_symbol **symbols = realloc(loop->symbols, (loop->symbol_count + 1) * sizeof(*symbols));
+	if (!symbols) return JBAS_ALLOC;
+	loop->symbols = symbols;
+	int *slots = realloc(loop->slots, (loop->symbol_count + 1) * sizeof(*slots));
+	if (!slots) return JBAS_ALLOC;
+	loop->slots = slots;
+
+	symbols[loop->symbol_count] = sym;
+	*slot = slots[loop->symbol_count++] = loop->slot_count;
+	loop->slot_count += size;
+	return JBAS_OK;
+}
+
+static bool jbas_jit_is_op(const jbas_expr *e, const char *str)
+{
+	return e->op && !strcmp(e->op->str, str);
+}
+
+static bool jbas_jit_is_array(const jbas_symbol *sym)
+{
+	return sym->type == JBAS_TYPE_INT_ARRAY || sym->type == JBAS_TYPE_FLOAT_ARRAY;
+}
+
+/**
+	Tells whether the compiled expression results in a FLOAT (in XMM0)
+	rather than in an integer (in EAX)
+*/
+static bool jbas_jit_is_float(const jbas_expr *e)
+{
+	if (!e) return false;
+
+	switch (e->type)
+	{
+		case JBAS_EXPR_OPERAND:
+			if (e->token->type == JBAS_TOKEN_NUMBER) return e->token->number_token.type == JBAS_NUM_FLOAT;
+			return e->token->type == JBAS_TOKEN_SYMBOL && e->token->symbol_token.sym->type == JBAS_TYPE_FLOAT;
+
+		case JBAS_EXPR_PAREN:
+			return jbas_jit_is_float(e->a);
+
+		case JBAS_EXPR_CALL:
+			return e->a->type == JBAS_EXPR_OPERAND && e->a->token->type == JBAS_TOKEN_SYMBOL
+				&& e->a->token->symbol_token.sym->type == JBAS_TYPE_FLOAT_ARRAY;
+
+		case JBAS_EXPR_UNARY:
+			return jbas_jit_is_op(e, "-") && jbas_jit_is_float(e->a);
+
+		case JBAS_EXPR_BINARY:
+			// Comparisons and logical operators result in BOOL
+			if (e->op->level <= 3) return false;
+			return jbas_jit_is_float(e->a) || jbas_jit_is_float(e->b);
+	}
+
+	return false;
+}
+
+/**
+	Type of arithmetic operation result. POLY means BOOL or INT - only known at run time.
+*/
+static jbas_symbol_type jbas_jit_math_type(jbas_symbol_type a, jbas_symbol_type b)
+{
+	if (a == JBAS_TYPE_INT || b == JBAS_TYPE_INT) return JBAS_TYPE_INT;
+	if (a == JBAS_TYPE_BOOL && b == JBAS_TYPE_BOOL) return JBAS_TYPE_BOOL;
+	return JBAS_TYPE_POLY;
+}
+
+static jbas_error jbas_jit_expr(jbas_jit_ctx *ctx, const jbas_expr *e, jbas_symbol_type *type);
+
+/**
+	Constants and scalars can be used directly as the right operand
+*/
+static jbas_error jbas_jit_right(jbas_jit_ctx *ctx, const jbas_expr *e, jbas_jit_operand *op, jbas_symbol_type *type)
+{
+	e = jbas_expr_strip(e);
+	if (e->type == JBAS_EXPR_OPERAND && e->token->type == JBAS_TOKEN_NUMBER && e->token->number_token.type != JBAS_NUM_FLOAT)
+	{
+		op->kind = JBAS_JIT_IMM;
+		op->value = e->token->number_token.i;
+		*type = e->token->number_token.type == JBAS_NUM_BOOL ? JBAS_TYPE_BOOL : JBAS_TYPE_INT;
+		return JBAS_OK;
+	}
+
+	if (e->type == JBAS_EXPR_OPERAND && e->token->type == JBAS_TOKEN_SYMBOL && !jbas_jit_is_array(e->token->symbol_token.sym))
+	{
+		int slot;
+		jbas_error err = jbas_jit_symbol(ctx, e->token->symbol_token.sym, &slot);
+		if (err) return err;
+		op->kind = JBAS_JIT_MEM;
+		op->value = 8 * slot;
+		*type = e->token->symbol_token.sym->type;
+		return JBAS_OK;
+	}
+
+	// push rax; <b>; mov ecx, eax; pop rax
+	op->kind = JBAS_JIT_ECX;
+	JBAS_JIT_CODE(ctx, "\x50");
+	jbas_error err = jbas_jit_expr(ctx, e, type);
+	if (err) return err;
+	JBAS_JIT_CODE(ctx, "\x89\xC1\x58");
+	return JBAS_OK;
+}
+
+/**
+	Emits instruction with the right operand. `imm`, `mem` and `ecx` are
+	opcodes of the immediate, [rbx + disp32] and ECX variants.
+*/
+static void jbas_jit_alu(jbas_jit_ctx *ctx, const jbas_jit_operand *op, const char *imm, const char *mem, const char *ecx)
+{
+	switch (op->kind)
+	{
+		case JBAS_JIT_IMM:
+			jbas_jit_emit(ctx, imm, strlen(imm));
+			jbas_jit_imm32(ctx, op->value);
+			break;
+
+		case JBAS_JIT_MEM:
+			jbas_jit_emit(ctx, mem, strlen(mem));
+			jbas_jit_imm32(ctx, op->value);
+			break;
+
+		case JBAS_JIT_ECX:
+			jbas_jit_emit(ctx, ecx, strlen(ecx));
+			break;
+	}
+}
+
+/**
+	Converts the value of given type to FLOAT in XMM0
+*/
+static void jbas_jit_to_float(jbas_jit_ctx *ctx, jbas_symbol_type type)
+{
+	// cvtsi2ss xmm0, eax
+	if (type != JBAS_TYPE_FLOAT) JBAS_JIT_CODE(ctx, "\xF3\x0F\x2A\xC0");
+}
+
+/**
+	Converts the value of given type to INT in EAX (truncated, like JBAS_FLOAT_TO_INT)
+*/
+static void jbas_jit_to_int(jbas_jit_ctx *ctx, jbas_symbol_type type)
+{
+	// cvttss2si eax, xmm0
+	if (type == JBAS_TYPE_FLOAT) JBAS_JIT_CODE(ctx, "\xF3\x0F\x2C\xC0");
+}
+
+/**
+	Converts EAX to BOOL
+*/
+static void jbas_jit_to_bool(jbas_jit_ctx *ctx)
+{
+	// test eax, eax; setne al; movzx eax, al
+	JBAS_JIT_CODE(ctx, "\x85\xC0\x0F\x95\xC0\x0F\xB6\xC0");
+}
+
+/**
+	Computes address of an array element. The index ends up in RAX.
+	Indices out of range trigger deoptimization.
+*/
+static jbas_error jbas_jit_element(jbas_jit_ctx *ctx, const jbas_expr *e, int *slot)
+{
+	const jbas_expr *f = e->a;
+	if (f->type != JBAS_EXPR_OPERAND || f->token->type != JBAS_TOKEN_SYMBOL) return JBAS_UNSUPPORTED;
+	jbas_symbol *sym = f->token->symbol_token.sym;
+	if (!jbas_jit_is_array(sym)) return JBAS_UNSUPPORTED;
+
+	jbas_error err = jbas_jit_symbol(ctx, sym, slot);
+	if (err) return err;
+
+	// Empty parentheses are 0
+	jbas_symbol_type type;
+	if (e->b)
+	{
+		err = jbas_jit_expr(ctx, e->b, &type);
+		if (err) return err;
+		jbas_jit_to_int(ctx, type);
+	}
+	else
+		JBAS_JIT_CODE(ctx, "\x31\xC0");
+
+	// test eax, eax; js deopt; cmp rax, [rbx + size]; jae deopt
+	JBAS_JIT_CODE(ctx, "\x85\xC0");
+	jbas_jit_deopt_jump(ctx, "\x0F\x88");
+	JBAS_JIT_CODE(ctx, "\x48\x3B\x83");
+	jbas_jit_imm32(ctx, 8 * (*slot + 1));
+	jbas_jit_deopt_jump(ctx, "\x0F\x83");
+
+	// mov rcx, [rbx + pointer]
+	JBAS_JIT_CODE(ctx, "\x48\x8B\x8B");
+	jbas_jit_imm32(ctx, 8 * *slot);
+	return JBAS_OK;
+}
+
+/**
+	AND and OR - just like in the interpreter, only the parentheses
+	on the right are evaluated lazily
+*/
+static jbas_error jbas_jit_logic(jbas_jit_ctx *ctx, const jbas_expr *e, jbas_symbol_type *type)
+{
+	bool is_and = jbas_jit_is_op(e, "&&") || jbas_jit_is_op(e, "AND");
+	jbas_symbol_type t;
+	jbas_error err;
+
+	// The operators see raw tokens (and only integers are converted to BOOL here)
+	for (const jbas_expr *o = e->a; o; o = o == e->a ? e->b : NULL)
+		if (o->type == JBAS_EXPR_UNARY || o->type == JBAS_EXPR_CALL || jbas_jit_is_float(o))
+			return JBAS_UNSUPPORTED;
+
+	*type = JBAS_TYPE_BOOL;
+	err = jbas_jit_expr(ctx, e->a, &t);
+	if (err) return err;
+	jbas_jit_to_bool(ctx);
+
+	// Binary operators on the right have already been evaluated
+	if (e->b->type == JBAS_EXPR_BINARY)
+	{
+		JBAS_JIT_CODE(ctx, "\x50");
+		err = jbas_jit_expr(ctx, e->b, &t);
+		if (err) return err;
+		jbas_jit_to_bool(ctx);
+
+		// mov ecx, eax; pop rax; and/or eax, ecx
+		JBAS_JIT_CODE(ctx, "\x89\xC1\x58");
+		if (is_and) JBAS_JIT_CODE(ctx, "\x21\xC8");
+		else JBAS_JIT_CODE(ctx, "\x09\xC8");
+		return JBAS_OK;
+	}
+
+	size_t skip = jbas_jit_jump(ctx, is_and ? "\x0F\x84" : "\x0F\x85");
+	err = jbas_jit_expr(ctx, e->b, &t);
+	if (err) return err;
+	jbas_jit_to_bool(ctx);
+	jbas_jit_patch(ctx, skip, ctx->size);
+	return JBAS_OK;
+}
+
+/**
+	Puts the right operand of a FLOAT operation to XMM1, the left one
+	stays in XMM0. Constants and scalars are loaded directly.
+*/
+static jbas_error jbas_jit_float_right(jbas_jit_ctx *ctx, const jbas_expr *e)
+{
+	e = jbas_expr_strip(e);
+	if (e->type == JBAS_EXPR_OPERAND && e->token->type == JBAS_TOKEN_NUMBER)
+	{
+		// mov eax, imm32; movd xmm1, eax
+		const jbas_number_token *n = &e->token->number_token;
+		jbas_float f = n->type == JBAS_NUM_FLOAT ? n->f : JBAS_FLOAT_FROM_INT(n->i);
+		JBAS_JIT_CODE(ctx, "\xB8");
+		jbas_jit_emit(ctx, &f, sizeof(f));
+		JBAS_JIT_CODE(ctx, "\x66\x0F\x6E\xC8");
+		return JBAS_OK;
+	}
+
+	if (e->type == JBAS_EXPR_OPERAND && e->token->type == JBAS_TOKEN_SYMBOL && !jbas_jit_is_array(e->token->symbol_token.sym))
+	{
+		jbas_symbol *sym = e->token->symbol_token.sym;
+		int slot;
+		jbas_error err = jbas_jit_symbol(ctx, sym, &slot);
+		if (err) return err;
+
+		// movss xmm1, [rbx + value] or cvtsi2ss xmm1, [rbx + value]
+		if (sym->type == JBAS_TYPE_FLOAT) JBAS_JIT_CODE(ctx, "\xF3\x0F\x10\x8B");
+		else JBAS_JIT_CODE(ctx, "\xF3\x0F\x2A\x8B");
+		jbas_jit_imm32(ctx, 8 * slot);
+		return JBAS_OK;
+	}
+
+	// movd eax, xmm0; push rax; <b>; movaps xmm1, xmm0; pop rax; movd xmm0, eax
+	jbas_symbol_type type;
+	JBAS_JIT_CODE(ctx, "\x66\x0F\x7E\xC0\x50");
+	jbas_error err = jbas_jit_expr(ctx, e, &type);
+	if (err) return err;
+	jbas_jit_to_float(ctx, type);
+	JBAS_JIT_CODE(ctx, "\x0F\x28\xC8\x58\x66\x0F\x6E\xC0");
+	return JBAS_OK;
+}
+
+/**
+	Arithmetic and comparisons with a FLOAT operand - the other one is
+	converted, like in jbas_binary_math_op(). % and MOD stay interpreted.
+*/
+static jbas_error jbas_jit_float_binary(jbas_jit_ctx *ctx, const jbas_expr *e, jbas_symbol_type *type)
+{
+	static const struct
+	{
+		const char *str;
+		const char *code;
+		bool cmp;
+	} ops[] =
+	{
+		// addss/subss/mulss/divss xmm0, xmm1
+		{"+",  "\xF3\x0F\x58\xC1"},
+		{"-",  "\xF3\x0F\x5C\xC1"},
+		{"*",  "\xF3\x0F\x59\xC1"},
+		{"/",  "\xF3\x0F\x5E\xC1"},
+
+		// ucomiss; setcc al - unordered operands (NaN) only compare unequal, like in C,
+		// hence < and <= are > and >= with the operands swapped
+		{"==", "\x0F\x2E\xC1\x0F\x94\xC0\x0F\x9B\xC1\x20\xC8", true}, // sete al; setnp cl; and al, cl
+		{"!=", "\x0F\x2E\xC1\x0F\x95\xC0\x0F\x9A\xC1\x08\xC8", true}, // setne al; setp cl; or al, cl
+		{"<",  "\x0F\x2E\xC8\x0F\x97\xC0", true},
+		{">",  "\x0F\x2E\xC1\x0F\x97\xC0", true},
+		{"<=", "\x0F\x2E\xC8\x0F\x93\xC0", true},
+		{">=", "\x0F\x2E\xC1\x0F\x93\xC0", true},
+	};
+
+	for (int i = 0; i < sizeof(ops) / sizeof(ops[0]); i++)
+		if (jbas_jit_is_op(e, ops[i].str))
+		{
+			jbas_symbol_type ta;
+			jbas_error err = jbas_jit_expr(ctx, e->a, &ta);
+			if (err) return err;
+			jbas_jit_to_float(ctx, ta);
+			err = jbas_jit_float_right(ctx, e->b);
+			if (err) return err;
+
+			// movzx eax, al
+			jbas_jit_emit(ctx, ops[i].code, strlen(ops[i].code));
+			if (ops[i].cmp) JBAS_JIT_CODE(ctx, "\x0F\xB6\xC0");
+			*type = ops[i].cmp ? JBAS_TYPE_BOOL : JBAS_TYPE_FLOAT;
+			return JBAS_OK;
+		}
+
+	return JBAS_UNSUPPORTED;
+}
+
+/**
+	Binary arithmetic operators and comparisons
+*/
+static jbas_error jbas_jit_binary(jbas_jit_ctx *ctx, const jbas_expr *e, jbas_symbol_type *type)
+{
+	static const struct
+	{
+		const char *str;
+		const char *imm, *mem, *ecx;
+	} alu[] =
+	{
+		{"+", "\x05",     "\x03\x83",     "\x01\xC8"},
+		{"-", "\x2D",     "\x2B\x83",     "\x29\xC8"},
+		{"*", "\x69\xC0", "\x0F\xAF\x83", "\x0F\xAF\xC1"},
+	};
+
+	static const struct
+	{
+		const char *str;
+		const char *setcc;
+	} cmp[] =
+	{
+		{"==", "\x0F\x94\xC0"},
+		{"!=", "\x0F\x95\xC0"},
+		{"<",  "\x0F\x9C\xC0"},
+		{">",  "\x0F\x9F\xC0"},
+		{"<=", "\x0F\x9E\xC0"},
+		{">=", "\x0F\x9D\xC0"},
+	};
+
+	if (!e->op->eval_args) return jbas_jit_logic(ctx, e, type);
+	if (jbas_jit_is_float(e->a) || jbas_jit_is_float(e->b)) return jbas_jit_float_binary(ctx, e, type);
+
+	jbas_symbol_type ta, tb;
+	jbas_jit_operand b;
+	jbas_error err = jbas_jit_expr(ctx, e->a, &ta);
+	if (!err) err = jbas_jit_right(ctx, e->b, &b, &tb);
+	if (err) return err;
+
+	for (int i = 0; i < sizeof(alu) / sizeof(alu[0]); i++)
+		if (jbas_jit_is_op(e, alu[i].str))
+		{
+			jbas_jit_alu(ctx, &b, alu[i].imm, alu[i].mem, alu[i].ecx);
+			*type = jbas_jit_math_type(ta, tb);
+			return JBAS_OK;
+		}
+
+	for (int i = 0; i < sizeof(cmp) / sizeof(cmp[0]); i++)
+		if (jbas_jit_is_op(e, cmp[i].str))
+		{
+			// cmp eax, b; setcc al; movzx eax, al
+			jbas_jit_alu(ctx, &b, "\x3D", "\x3B\x83", "\x39\xC8");
+			jbas_jit_emit(ctx, cmp[i].setcc, 3);
+			JBAS_JIT_CODE(ctx, "\x0F\xB6\xC0");
+			*type = JBAS_TYPE_BOOL;
+			return JBAS_OK;
+		}
+
+	// Division - mov ecx, b; cdq; idiv ecx
+	bool is_div = jbas_jit_is_op(e, "/"), is_rem = jbas_jit_is_op(e, "%"), is_mod = jbas_jit_is_op(e, "mod");
+	if (!is_div && !is_rem && !is_mod) return JBAS_UNSUPPORTED;
+	jbas_jit_alu(ctx, &b, "\xB9", "\x8B\x8B", "");
+	JBAS_JIT_CODE(ctx, "\x99\xF7\xF9");
+
+	// The remainder is in EDX - (a % b + b) % b for mod
+	if (!is_div) JBAS_JIT_CODE(ctx, "\x89\xD0");
+	if (is_mod) JBAS_JIT_CODE(ctx, "\x01\xC8\x99\xF7\xF9\x89\xD0");
+	*type = jbas_jit_math_type(ta, tb);
+	return JBAS_OK;
+}
+
+/**
+	Compiles expression - the value ends up in EAX, or in XMM0 if it's
+	a FLOAT (see jbas_jit_is_float())
+*/
+static jbas_error jbas_jit_expr(jbas_jit_ctx *ctx, const jbas_expr *e, jbas_symbol_type *type)
+{
+	jbas_error err;
+	int slot;
+
+	switch (e->type)
+	{
+		case JBAS_EXPR_OPERAND:
+			if (e->token->type == JBAS_TOKEN_NUMBER)
+			{
+				const jbas_number_token *n = &e->token->number_token;
+				*type = n->type == JBAS_NUM_FLOAT ? JBAS_TYPE_FLOAT : n->type == JBAS_NUM_BOOL ? JBAS_TYPE_BOOL : JBAS_TYPE_INT;
+				JBAS_JIT_CODE(ctx, "\xB8");
+				jbas_jit_imm32(ctx, n->i);
+
+				// movd xmm0, eax
+				if (n->type == JBAS_NUM_FLOAT) JBAS_JIT_CODE(ctx, "\x66\x0F\x6E\xC0");
+				return JBAS_OK;
+			}
+
+			if (e->token->type == JBAS_TOKEN_SYMBOL)
+			{
+				jbas_symbol *sym = e->token->symbol_token.sym;
+				if (jbas_jit_is_array(sym)) return JBAS_UNSUPPORTED;
+				err = jbas_jit_symbol(ctx, sym, &slot);
+				if (err) return err;
+				*type = sym->type;
+
+				// mov eax, [rbx + value] or movss xmm0, [rbx + value]
+				if (sym->type == JBAS_TYPE_FLOAT) JBAS_JIT_CODE(ctx, "\xF3\x0F\x10\x83");
+				else JBAS_JIT_CODE(ctx, "\x8B\x83");
+				jbas_jit_imm32(ctx, 8 * slot);
+				return JBAS_OK;
+			}
+
+			return JBAS_UNSUPPORTED;
+
+		// Memos are ignored - the values are simply computed
+		case JBAS_EXPR_PAREN:
+			if (e->a) return jbas_jit_expr(ctx, e->a, type);
+			*type = JBAS_TYPE_INT;
+			JBAS_JIT_CODE(ctx, "\x31\xC0");
+			return JBAS_OK;
+
+		// mov eax, [rcx + rax * 4] or movss xmm0, [rcx + rax * 4]
+		case JBAS_EXPR_CALL:
+			err = jbas_jit_element(ctx, e, &slot);
+			if (err) return err;
+			*type = jbas_jit_is_float(e) ? JBAS_TYPE_FLOAT : JBAS_TYPE_INT;
+			if (*type == JBAS_TYPE_FLOAT) JBAS_JIT_CODE(ctx, "\xF3\x0F\x10\x04\x81");
+			else JBAS_JIT_CODE(ctx, "\x8B\x04\x81");
+			return JBAS_OK;
+
+		case JBAS_EXPR_UNARY:
+			err = jbas_jit_expr(ctx, e->a, type);
+			if (err) return err;
+
+			// neg eax or flip the sign bit - movd eax, xmm0; xor eax, 0x80000000; movd xmm0, eax
+			if (jbas_jit_is_op(e, "-"))
+			{
+				if (*type == JBAS_TYPE_FLOAT) JBAS_JIT_CODE(ctx, "\x66\x0F\x7E\xC0\x35\x00\x00\x00\x80\x66\x0F\x6E\xC0");
+				else JBAS_JIT_CODE(ctx, "\xF7\xD8");
+				return JBAS_OK;
+			}
+
+			// test eax, eax; sete al; movzx eax, al
+			if (*type != JBAS_TYPE_FLOAT && (jbas_jit_is_op(e, "!") || jbas_jit_is_op(e, "NOT")))
+			{
+				JBAS_JIT_CODE(ctx, "\x85\xC0\x0F\x94\xC0\x0F\xB6\xC0");
+				*type = JBAS_TYPE_BOOL;
+				return JBAS_OK;
+			}
+
+			return JBAS_UNSUPPORTED;
+
+		case JBAS_EXPR_BINARY:
+			if (e->op->type == JBAS_OP_BINARY_RL || jbas_jit_is_op(e, ",")) return JBAS_UNSUPPORTED;
+			return jbas_jit_binary(ctx, e, type);
+	}
+
+	return JBAS_UNSUPPORTED;
+}
+
+static jbas_token *jbas_jit_find_delimiter(jbas_token *t)
+{
+	while (t && t->type != JBAS_TOKEN_DELIMITER)
+		t = t->r;
+	return t;
+}
+
+/**
+	Compiles an assignment to a scalar or an array element
+*/
+static jbas_error jbas_jit_instruction(jbas_jit_ctx *ctx, jbas_token *begin, jbas_token *end)
+{
+	jbas_error err = jbas_expr_parse(&ctx->tree, begin, end, &ctx->env->tokens);
+	if (err) return JBAS_UNSUPPORTED;
+
+	const jbas_expr *e = ctx->tree.root;
+	if (!e || e->type != JBAS_EXPR_BINARY || e->op->type != JBAS_OP_BINARY_RL) return JBAS_UNSUPPORTED;
+	err = jbas_jit_deopt_point(ctx, begin);
+	if (err) return err;
+
+	jbas_symbol_type type;
+	int slot;
+	err = jbas_jit_expr(ctx, e->b, &type);
+	if (err) return err;
+
+	// The value is converted to the type of the array elements
+	// push rax; <element>; pop rdx; mov [rcx + rax * 4], edx
+	if (e->a->type == JBAS_EXPR_CALL)
+	{
+		if (jbas_jit_is_float(e->a))
+		{
+			// movd eax, xmm0
+			jbas_jit_to_float(ctx, type);
+			JBAS_JIT_CODE(ctx, "\x66\x0F\x7E\xC0");
+		}
+		else
+			jbas_jit_to_int(ctx, type);
+
+		JBAS_JIT_CODE(ctx, "\x50");
+		err = jbas_jit_element(ctx, e->a, &slot);
+		if (err) return err;
+		JBAS_JIT_CODE(ctx, "\x5A\x89\x14\x81");
+		return JBAS_OK;
+	}
+
+	if (e->a->type != JBAS_EXPR_OPERAND || e->a->token->type != JBAS_TOKEN_SYMBOL) return JBAS_UNSUPPORTED;
+	jbas_symbol *sym = e->a->token->symbol_token.sym;
+	if (jbas_jit_is_array(sym)) return JBAS_UNSUPPORTED;
+	err = jbas_jit_symbol(ctx, sym, &slot);
+	if (err) return err;
+
+	// Typed symbols keep their type, tagged ones get the type of the value
+	// (but never FLOAT - the compiled code reads them as integers)
+	if (sym->type == JBAS_TYPE_POLY ? type == JBAS_TYPE_POLY || type == JBAS_TYPE_FLOAT : type != sym->type)
+		return JBAS_UNSUPPORTED;
+
+	// mov [rbx + value], eax or movss [rbx + value], xmm0
+	if (type == JBAS_TYPE_FLOAT) JBAS_JIT_CODE(ctx, "\xF3\x0F\x11\x83");
+	else JBAS_JIT_CODE(ctx, "\x89\x83");
+	jbas_jit_imm32(ctx, 8 * slot);
+
+	// mov dword [rbx + type], imm32
+	if (sym->type == JBAS_TYPE_POLY)
+	{
+		JBAS_JIT_CODE(ctx, "\xC7\x83");
+		jbas_jit_imm32(ctx, 8 * slot + 4);
+		jbas_jit_imm32(ctx, type == JBAS_TYPE_BOOL ? JBAS_NUM_BOOL : JBAS_NUM_INT);
+	}
+
+	return JBAS_OK;
+}
+
+/**
+	Compiles IF/WHILE condition and returns the body
+*/
+static jbas_error jbas_jit_condition(jbas_jit_ctx *ctx, jbas_token *kw, jbas_token **body)
+{
+	jbas_token *t_delim = jbas_jit_find_delimiter(kw->r);
+	if (!t_delim) return JBAS_UNSUPPORTED;
+	*body = t_delim->r;
+
+	jbas_error err = jbas_expr_parse(&ctx->tree, kw->r, t_delim, &ctx->env->tokens);
+	if (err || !ctx->tree.root) return JBAS_UNSUPPORTED;
+	err = jbas_jit_deopt_point(ctx, kw);
+	if (err) return err;
+
+	jbas_symbol_type type;
+	err = jbas_jit_expr(ctx, ctx->tree.root, &type);
+	if (err) return err;
+	if (type == JBAS_TYPE_FLOAT) return JBAS_UNSUPPORTED;
+
+	// test eax, eax
+	JBAS_JIT_CODE(ctx, "\x85\xC0");
+	return JBAS_OK;
+}
+
+/**
+	Finds ELSE belonging to the IF
+*/
+static jbas_token *jbas_jit_find_else(jbas_token *t_if, jbas_token *t_end)
+{
+	int level = 0;
+	for (jbas_token *t = t_if->r; t && t != t_end; t = t->r)
+	{
+		if (!level && t->type == JBAS_TOKEN_KEYWORD && t->keyword_token.kw->id == JBAS_KW_ELSE)
+			return t;
+		level += jbas_block_level_diff(t);
+	}
+
+	return NULL;
+}
+
+static jbas_error jbas_jit_block(jbas_jit_ctx *ctx, jbas_token *begin, jbas_token *end);
+
+static jbas_error jbas_jit_if(jbas_jit_ctx *ctx, jbas_token *t_if, jbas_token *t_end)
+{
+	jbas_token *t_body;
+	jbas_error err = jbas_jit_condition(ctx, t_if, &t_body);
+	if (err) return err;
+	jbas_token *t_else = jbas_jit_find_else(t_if, t_end);
+
+	size_t to_else = jbas_jit_jump(ctx, "\x0F\x84");
+	err = jbas_jit_block(ctx, t_body, t_else ? t_else : t_end);
+	if (err) return err;
+
+	if (t_else)
+	{
+		size_t to_end = jbas_jit_jump(ctx, "\xE9");
+		jbas_jit_patch(ctx, to_else, ctx->size);
+		err = jbas_jit_block(ctx, t_else->r, t_end);
+		if (err) return err;
+		jbas_jit_patch(ctx, to_end, ctx->size);
+	}
+	else
+		jbas_jit_patch(ctx, to_else, ctx->size);
+
+	return JBAS_OK;
+}
+
+/**
+	Budget steps of one iteration - the way back and the instructions
+	directly in the body (nested loops charge their own iterations)
+*/
+static int32_t jbas_jit_loop_steps(jbas_token *t_body, jbas_token *t_end)
+{
+	int32_t steps = 1;
+	int level = 0;
+	bool start = true;
+	for (jbas_token *t = t_body; t && t != t_end; t = t->r)
+	{
+		if (t->type == JBAS_TOKEN_DELIMITER)
+		{
+			start = true;
+			continue;
+		}
+
+		if (start && !level) steps++;
+		start = false;
+		level += jbas_block_level_diff(t);
+	}
+
+	return steps;
+}
+
+static jbas_error jbas_jit_while(jbas_jit_ctx *ctx, jbas_token *t_while, jbas_token *t_end)
+{
+	size_t top = ctx->size;
+	jbas_token *t_body;
+	jbas_error err = jbas_jit_condition(ctx, t_while, &t_body);
+	if (err) return err;
+
+	size_t to_end = jbas_jit_jump(ctx, "\x0F\x84");
+
+	// Requested checkpoints and yields hand the loop back to the interpreter
+	// mov rax, &env->checkpoint_pending; cmp dword [rax], 0; jne deopt
+	volatile sig_atomic_t *pending = &ctx->env->checkpoint_pending;
+	JBAS_JIT_CODE(ctx, "\x48\xB8");
+	jbas_jit_emit(ctx, &pending, sizeof(pending));
+	JBAS_JIT_CODE(ctx, "\x83\x38\x00");
+	jbas_jit_deopt_jump(ctx, "\x0F\x85");
+
+	volatile sig_atomic_t *yield = &ctx->env->yield_pending;
+	JBAS_JIT_CODE(ctx, "\x48\xB8");
+	jbas_jit_emit(ctx, &yield, sizeof(yield));
+	JBAS_JIT_CODE(ctx, "\x83\x38\x00");
+	jbas_jit_deopt_jump(ctx, "\x0F\x85");
+
+	// The instruction budget is charged once per iteration; when there's
+	// not enough left, the interpreter uses up the rest
+	// mov rax, &env->budget; mov rcx, [rax]; test rcx, rcx; js skip
+	// sub rcx, steps; jl deopt; mov [rax], rcx; skip:
+	int64_t *budget = &ctx->env->budget;
+	JBAS_JIT_CODE(ctx, "\x48\xB8");
+	jbas_jit_emit(ctx, &budget, sizeof(budget));
+	JBAS_JIT_CODE(ctx, "\x48\x8B\x08\x48\x85\xC9\x78\x10\x48\x81\xE9");
+	jbas_jit_imm32(ctx, jbas_jit_loop_steps(t_body, t_end));
+	jbas_jit_deopt_jump(ctx, "\x0F\x8C");
+	JBAS_JIT_CODE(ctx, "\x48\x89\x08");
+
+	err = jbas_jit_block(ctx, t_body, t_end);
+	if (err) return err;
+	jbas_jit_patch(ctx, jbas_jit_jump(ctx, "\xE9"), top);
+	jbas_jit_patch(ctx, to_end, ctx->size);
+	return JBAS_OK;
+}
+
+/**
+	Compiles block [begin, end) - see jbas_run_block()
+*/
+static jbas_error jbas_jit_block(jbas_jit_ctx *ctx, jbas_token *begin, jbas_token *end)
+{
+	jbas_error err;
+	jbas_token *t = begin;
+	while (t && t != end)
+	{
+		if (t->type == JBAS_TOKEN_DELIMITER)
+		{
+			t = t->r;
+			continue;
+		}
+
+		if (t->type != JBAS_TOKEN_KEYWORD)
+		{
+			jbas_token *t_delim = jbas_jit_find_delimiter(t);
+			err = jbas_jit_instruction(ctx, t, t_delim);
+			if (err) return err;
+			t = t_delim;
+			continue;
+		}
+
+		jbas_token *t_end;
+		switch (t->keyword_token.kw->id)
+		{
+			case JBAS_KW_NOP:
+			case JBAS_KW_END:
+				t = t->r;
+				break;
+
+			case JBAS_KW_IF:
+			case JBAS_KW_WHILE:
+				err = jbas_get_block_end(ctx->env, t, &t_end);
+				if (!err) err = t->keyword_token.kw->id == JBAS_KW_IF ? jbas_jit_if(ctx, t, t_end) : jbas_jit_while(ctx, t, t_end);
+				if (err) return err;
+				t = t_end;
+				break;
+
+			// The compiled code does not use memos (see jbas_jit_run())
+			case JBAS_KW_INVALIDATE:
+				for (t = t->r; t && t->type == JBAS_TOKEN_PAREN; t = t->r);
+				break;
+
+			case JBAS_KW_STEP:
+				for (int i = 0; t && i < 4; i++) t = t->r;
+				break;
+
+			case JBAS_KW_CHECK:
+				t = jbas_jit_find_delimiter(t);
+				break;
+
+			default:
+				return JBAS_UNSUPPORTED;
+		}
+	}
+
+	return JBAS_OK;
+}
+
+/**
+	Compiles the loop. The code is called with the frame pointer in RDI
+	and returns JBAS_JIT_DONE or index of the deoptimization point.
+*/
+static jbas_error jbas_jit_compile(jbas_env *env, jbas_token *t_loop, jbas_jit_loop *loop)
+{
+#ifdef JBAS_JIT_X86_64
+	jbas_token *t_end;
+	jbas_error err = jbas_get_block_end(env, t_loop, &t_end);
+	if (err) return err;
+
+	jbas_jit_ctx *ctx = calloc(1, sizeof(*ctx));
+	if (!ctx) return JBAS_ALLOC;
+	ctx->env = env;
+	ctx->loop = loop;
+
+	// push rbx; push rbp; mov rbp, rsp; mov rbx, rdi
+	JBAS_JIT_CODE(ctx, "\x53\x55\x48\x89\xE5\x48\x89\xFB");
+	err = jbas_jit_while(ctx, t_loop, t_end);
+
+	// mov eax, JBAS_JIT_DONE
+	JBAS_JIT_CODE(ctx, "\xB8");
+	jbas_jit_imm32(ctx, JBAS_JIT_DONE);
+
+	// mov rsp, rbp; pop rbp; pop rbx; ret
+	size_t exit = ctx->size;
+	JBAS_JIT_CODE(ctx, "\x48\x89\xEC\x5D\x5B\xC3");
+
+	// Deoptimization stubs - mov eax, index; jmp exit
+	for (int i = 0; i < ctx->fixup_count; i++)
+	{
+		jbas_jit_patch(ctx, ctx->fixups[i].pos, ctx->size);
+		JBAS_JIT_CODE(ctx, "\xB8");
+		jbas_jit_imm32(ctx, ctx->fixups[i].deopt);
+		jbas_jit_patch(ctx, jbas_jit_jump(ctx, "\xE9"), exit);
+	}
+
+	if (!err && ctx->alloc_failed) err = JBAS_ALLOC;
+	if (!err) loop->frame = malloc((loop->slot_count + 1) * sizeof(*loop->frame));
+	if (!err && !loop->frame) err = JBAS_ALLOC;
+
+	// Make it executable
+	if (!err)
+	{
+		void *code = mmap(NULL, ctx->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (code == MAP_FAILED) err = JBAS_ALLOC;
+		else
+		{
+			memcpy(code, ctx->code, ctx->size);
+			if (mprotect(code, ctx->size, PROT_READ | PROT_EXEC))
+			{
+				munmap(code, ctx->size);
+				err = JBAS_ALLOC;
+			}
+			else
+			{
+				loop->code = code;
+				loop->code_size = ctx->size;
+			}
+		}
+	}
+
+	free(ctx->code);
+	free(ctx->fixups);
+	free(ctx);
+	return err;
+#else
+	return JBAS_UNSUPPORTED;
+#endif
+}
+
+/**
+	Loads the symbols into the frame. Returns false if their types
+	do not match the compiled code.
+*/
+static bool jbas_jit_load(jbas_jit_loop *loop)
+{
+	for (int i = 0; i < loop->symbol_count; i++)
+	{
+		jbas_symbol *sym = loop->symbols[i];
+		jbas_resource *res = sym->res;
+		int64_t *slot = &loop->frame[loop->slots[i]];
+
+		if (sym->type == JBAS_TYPE_INT_ARRAY)
+		{
+			if (!res || res->type != JBAS_RESOURCE_INT_ARRAY) return false;
+			slot[0] = (intptr_t) res->iptr;
+			slot[1] = res->size;
+			continue;
+		}
+
+		if (sym->type == JBAS_TYPE_FLOAT_ARRAY)
+		{
+			if (!res || res->type != JBAS_RESOURCE_FLOAT_ARRAY) return false;
+			slot[0] = (intptr_t) res->fptr;
+			slot[1] = res->size;
+			continue;
+		}
+
+		// FLOAT symbols hold FLOAT values, the others never do
+		if (!res || res->type != JBAS_RESOURCE_NUMBER) return false;
+		if ((sym->type == JBAS_TYPE_FLOAT) != (res->number.type == JBAS_NUM_FLOAT)) return false;
+		if (sym->type == JBAS_TYPE_BOOL && res->number.type != JBAS_NUM_BOOL) return false;
+		if (sym->type == JBAS_TYPE_INT && res->number.type != JBAS_NUM_INT) return false;
+		*slot = (uint32_t) res->number.i | (uint64_t) res->number.type << 32;
+	}
+
+	return true;
+}
+
+static void jbas_jit_store(jbas_jit_loop *loop)
+{
+	for (int i = 0; i < loop->symbol_count; i++)
+	{
+		jbas_symbol *sym = loop->symbols[i];
+		if (jbas_jit_is_array(sym)) continue;
+
+		int64_t slot = loop->frame[loop->slots[i]];
+		sym->res->number.i = (int32_t) slot;
+		sym->res->number.type = (jbas_number_type) (slot >> 32);
+	}
+}
+
+/**
+	Continues interpretation of the loop body from given instruction.
+	The loop itself is continued by the caller.
+*/
+static jbas_error jbas_jit_resume(jbas_env *env, jbas_token *t_loop, jbas_token *at)
+{
+	if (at == t_loop) return JBAS_OK;
+
+	jbas_token *t, *t_end;
+	jbas_error err = jbas_get_block_end(env, t_loop, &t_end);
+	if (err) return err;
+
+	// The body is run inside the loop's frame, like the interpreted one
+	err = jbas_frame_push(env, t_loop, t_end, t_end);
+	if (err) return err;
+	err = jbas_resume(env, t_loop->r, at, &t);
+	if (!err && t != t_end) err = jbas_run_block(env, t, t_end, NULL);
+	if (!jbas_is_suspension(err)) env->frame_count--;
+	return err;
+}
+
+/**
+	Called by the WHILE keyword before each iteration. Once the loop
+	is hot, it's compiled and the rest of the iterations is executed by the
+	compiled code. `done` is set if the loop has been finished.
+*/
+jbas_error jbas_jit_run(jbas_env *env, jbas_token *t_loop, bool *done)
+{
+	*done = false;
+	jbas_jit_loop *loop = t_loop->keyword_token.data;
+	if (!loop)
+	{
+		loop = calloc(1, sizeof(*loop));
+		if (!loop) return JBAS_ALLOC;
+		t_loop->keyword_token.data = loop;
+	}
+
+	if (loop->failed) return JBAS_OK;
+	if (loop->count < env->jit_threshold)
+	{
+		loop->count++;
+		return JBAS_OK;
+	}
+
+	// Compile (once)
+	if (!loop->code)
+	{
+		jbas_error err = jbas_jit_compile(env, t_loop, loop);
+		if (err)
+		{
+			loop->failed = true;
+			return err == JBAS_ALLOC ? err : JBAS_OK;
+		}
+	}
+
+	// The symbols have to be of the types the code has been compiled for
+	if (!jbas_jit_load(loop)) return JBAS_OK;
+	int ret = ((jbas_jit_fun) loop->code)(loop->frame);
+	jbas_jit_store(loop);
+
+	// The memos have not been updated by the compiled code
+	jbas_memo_invalidate_all(&env->memo_manager);
+
+	if (ret == JBAS_JIT_DONE)
+	{
+		*done = true;
+		return JBAS_OK;
+	}
+
+	return jbas_jit_resume(env, t_loop, loop->deopt[ret]);
+}
+
+void jbas_jit_loop_destroy(jbas_jit_loop *loop)
+{
+	if (!loop) return;
+#ifdef JBAS_JIT_X86_64
+	if (loop->code) munmap(loop->code, loop->code_size);
+#endif
+	free(loop->symbols);
+	free(loop->slots);
+	free(loop->frame);
+	free(loop->deopt);
+	free(loop);
+}
@@ -1,9 +1,56 @@
 #include <jbasic/kw.h>
 #include <jbasic/jbasic.h>
 #include <jbasic/cast.h>
+#include <jbasic/memo.h>
+#include <jbasic/expr.h>
+#include <jbasic/jit.h>
+#include <jbasic/pool.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <stdio.h>
 
+/**
+	Returns true for the errors a run is suspended with - it's continued
+	by the next jbas_run()
+*/
+bool jbas_is_suspension(jbas_error err)
+{
+	return err == JBAS_YIELD || err == JBAS_WOULD_BLOCK || err == JBAS_BUDGET_EXHAUSTED;
+}
+
+/**
+	Pushes a frame of a block onto env->frames
+*/
+jbas_error jbas_frame_push(jbas_env *env, jbas_token *kw, jbas_token *stop, jbas_token *end)
+{
+	if (env->frame_count == env->frame_size)
+	{
+		int size = env->frame_size ? 2 * env->frame_size : 16;
+		jbas_frame *frames = jbas_realloc(&env->allocator, env->frames,
+			env->frame_size * sizeof(jbas_frame), size * sizeof(jbas_frame));
+		if (!frames) return JBAS_ALLOC;
+		env->frames = frames;
+		env->frame_size = size;
+	}
+
+	env->frames[env->frame_count++] = (jbas_frame){.kw = kw, .stop = stop, .end = end};
+	return JBAS_OK;
+}
+
+/**
+	Runs a branch of the block opened by `kw` with the block's frame
+	pushed. A suspended run leaves the frame there.
+*/
+static jbas_error jbas_run_nested(jbas_env *env, jbas_token *kw, jbas_token *begin, jbas_token *stop, jbas_token *end)
+{
+	jbas_error err = jbas_frame_push(env, kw, stop, end);
+	if (err) return err;
+
+	err = jbas_run_block(env, begin, stop, NULL);
+	if (!jbas_is_suspension(err)) env->frame_count--;
+	return err;
+}
+
 /**
 	Executes an if statement
 */
@@ -43,8 +90,8 @@ static jbas_error jbas_kw_if(jbas_env *env, jbas_token *begin, jbas_token **next
 	int level = 0;
 	for (t = begin->r; t && (level || !(t->type == JBAS_TOKEN_KEYWORD && t->keyword_token.kw->id == JBAS_KW_ELSE)); t = t->r)
 	{
-		level += t->type == JBAS_TOKEN_KEYWORD && t->keyword_token.kw->id == JBAS_KW_IF;
-		level -= t->type == JBAS_TOKEN_KEYWORD && t->keyword_token.kw->id == JBAS_KW_ENDIF;
+		// Nested blocks of any kind (CASE ELSE inside SELECT is not ours)
+		level += jbas_block_level_diff(t);
 		
 		// No ELSE
 		if (level < 0)
@@ -58,12 +105,12 @@ static jbas_error jbas_kw_if(jbas_env *env, jbas_token *begin, jbas_token **next
 	// The actual if statement :')
 	if (cond_true)
 	{
-		err = jbas_run_block(env, t_true, t_else ? t_else : t_end, NULL);
+		err = jbas_run_nested(env, begin, t_true, t_else ? t_else : t_end, t_end);
 		if (err) return err;
 	}
 	else if (t_else)
 	{
-		err = jbas_run_block(env, t_else->r, t_end, NULL);
+		err = jbas_run_nested(env, begin, t_else->r, t_end, t_end);
 		if (err) return err;
 	}
 	
@@ -80,6 +127,17 @@ static jbas_error jbas_kw_while(jbas_env *env, jbas_token *begin, jbas_token **n
 
 	while (1)
 	{
+#ifndef JBAS_STATIC
+		// Hot loops are handed over to the JIT compiler
+		if (env->jit_threshold)
+		{
+			bool done;
+			err = jbas_jit_run(env, begin, &done);
+			if (err) return err;
+			if (done) break;
+		}
+#endif
+
 		// Evaluate the condition
 		jbas_token *t_cond = begin->r;
 		jbas_token *t_cond_result = NULL;
@@ -106,22 +164,20 @@ static jbas_error jbas_kw_while(jbas_env *env, jbas_token *begin, jbas_token **n
 		if (!cond_true) break;
 
 		// Run the loop
-		err = jbas_run_block(env, t_body->r, t_end, NULL);
-		if (err) return err;	
+		err = jbas_run_nested(env, begin, t_body->r, t_end, t_end);
+		if (err) return err;
+
+		// Going back costs a step too, so empty loops can't run forever
+		err = jbas_charge_budget(env, begin);
+		if (err) return err;
 	}
 
 	*next = t_end;
 	return JBAS_OK;
 }
 
-static jbas_error jbas_kw_generic_dim(jbas_env *env, jbas_token *begin, jbas_token **next)
+static jbas_error jbas_kw_generic_dim(jbas_env *env, jbas_token *begin, jbas_token **next, size_t *size)
 {
-	jbas_token *t, *end;
-
-	// Look for a delimiter
-	for (t = begin; t && t->type != JBAS_TOKEN_DELIMITER; t = t->r);
-	*next = end = t;
-
 	// Next token must be a symbol
 	jbas_token *sym = begin->r;
 	if (!sym || sym->type != JBAS_TOKEN_SYMBOL)
@@ -132,14 +188,22 @@ static jbas_error jbas_kw_generic_dim(jbas_env *env, jbas_token *begin, jbas_tok
 
 	// Another one must be a dimension (or dimensions)
 	jbas_token *dim = sym->r;
-	if (!dim)
+	if (!dim || dim->type == JBAS_TOKEN_DELIMITER)
 	{
 		JBAS_ERROR_REASON(env, "DIM requires dimension(s)");
 		return JBAS_BAD_DIM;
 	}
 	
+	// Evaluate the dimension (the program is left as it is, so it's
+	// evaluated again next time)
+	jbas_token *result = NULL;
+	jbas_error err = jbas_eval_instruction(env, dim, next, &result);
+	if (err) return err;
+
 	// Convert dimension to int
-	jbas_error err = jbas_token_to_number_type(env, dim, JBAS_NUM_INT);
+	err = result ? jbas_token_to_number_type(env, result, JBAS_NUM_INT) : JBAS_CAST_FAILED;
+	if (!err) *size = result->number_token.i;
+	jbas_token_list_destroy(result, &env->token_pool);
 	if (err)
 	{
 		JBAS_ERROR_REASON(env, "DIM requires integer dimension(s)");
@@ -149,15 +213,26 @@ static jbas_error jbas_kw_generic_dim(jbas_env *env, jbas_token *begin, jbas_tok
 	return JBAS_OK;
 }
 
+/**
+	Accounts an array buffer changing its size from `old_bytes` to `new_bytes`
+*/
+static jbas_error jbas_dim_charge(jbas_env *env, size_t old_bytes, size_t new_bytes)
+{
+	jbas_memory *m = env->resource_manager.memory;
+	if (new_bytes > old_bytes) return jbas_memory_charge(m, new_bytes - old_bytes);
+	jbas_memory_release(m, old_bytes - new_bytes);
+	return JBAS_OK;
+}
+
 static jbas_error jbas_kw_idim(jbas_env *env, jbas_token *begin, jbas_token **next)
 {
-	jbas_error err = jbas_kw_generic_dim(env, begin, next);
+	size_t size;
+	jbas_error err = jbas_kw_generic_dim(env, begin, next, &size);
 	if (err) return err;
 
 	// The symbol and the new size
 	jbas_symbol *sym = begin->r->symbol_token.sym;
 	jbas_resource *res = sym->res;
-	size_t size = begin->r->r->number_token.i;
 
 	// If the symbol holds some resource (that isn't an int array), drop it
 	if (res && res->type != JBAS_RESOURCE_INT_ARRAY)
@@ -177,28 +252,38 @@ static jbas_error jbas_kw_idim(jbas_env *env, jbas_token *begin, jbas_token **ne
 		res->size = 0;
 	}
 
-	// Allocate/resize the resource buffer
-	int *arr = realloc(res->iptr, size * sizeof(int));
+	// Allocate/resize the resource buffer (within the memory limit)
+	size_t old_bytes = res->size * sizeof(int);
+	err = jbas_dim_charge(env, old_bytes, size * sizeof(int));
+	if (err)
+	{
+		JBAS_ERROR_REASON(env, "IDIM exceeds the memory limit");
+		return err;
+	}
+
+	int *arr = jbas_realloc(&env->allocator, res->iptr, old_bytes, size * sizeof(int));
 	if (!arr)
 	{
-		JBAS_ERROR_REASON(env, "realloc() error in IDIM");
+		jbas_dim_charge(env, size * sizeof(int), old_bytes);
+		JBAS_ERROR_REASON(env, "allocation error in IDIM");
 		return JBAS_ALLOC;
 	}
 	res->iptr = arr;
 	res->size = size;
+	env->array_bytes += size * sizeof(int);
 
 	return JBAS_OK;
 }
 
 static jbas_error jbas_kw_fdim(jbas_env *env, jbas_token *begin, jbas_token **next)
 {
-	jbas_error err = jbas_kw_generic_dim(env, begin, next);
+	size_t size;
+	jbas_error err = jbas_kw_generic_dim(env, begin, next, &size);
 	if (err) return err;
 
 	// The symbol and the new size
 	jbas_symbol *sym = begin->r->symbol_token.sym;
 	jbas_resource *res = sym->res;
-	size_t size = begin->r->r->number_token.i;
 
 	// If the symbol hold some resource (that isn't an int array), drop it
 	if (res && res->type != JBAS_RESOURCE_FLOAT_ARRAY)
@@ -218,19 +303,774 @@ static jbas_error jbas_kw_fdim(jbas_env *env, jbas_token *begin, jbas_token **ne
 		res->size = 0;
 	}
 
-	// Allocate/resize the resource buffer
-	float *arr = realloc(res->fptr, size * sizeof(float));
+	// Allocate/resize the resource buffer (within the memory limit)
+	size_t old_bytes = res->size * sizeof(jbas_float);
+	err = jbas_dim_charge(env, old_bytes, size * sizeof(jbas_float));
+	if (err)
+	{
+		JBAS_ERROR_REASON(env, "FDIM exceeds the memory limit");
+		return err;
+	}
+
+	jbas_float *arr = jbas_realloc(&env->allocator, res->fptr, old_bytes, size * sizeof(jbas_float));
 	if (!arr)
 	{
-		JBAS_ERROR_REASON(env, "realloc() error in FDIM");
+		jbas_dim_charge(env, size * sizeof(jbas_float), old_bytes);
+		JBAS_ERROR_REASON(env, "allocation error in FDIM");
 		return JBAS_ALLOC;
 	}
 	res->fptr = arr;
 	res->size = size;
+	env->array_bytes += size * sizeof(jbas_float);
+
+	return JBAS_OK;
+}
+
+/**
+	Invalidates memos attached to the following parentheses.
+	Inserted by the optimizer in front of loops.
+*/
+static jbas_error jbas_kw_invalidate(jbas_env *env, jbas_token *begin, jbas_token **next)
+{
+	jbas_token *t;
+	for (t = begin->r; t && t->type == JBAS_TOKEN_PAREN; t = t->r)
+		t->paren_token.memo->valid = false;
+
+	*next = t;
+	return JBAS_OK;
+}
+
+/**
+	`$STEP (memo) step coef` - updates memo holding `i * coef` after
+	`i` has been incremented by `step`. Inserted by the optimizer right
+	after the increment instruction.
+*/
+static jbas_error jbas_kw_step(jbas_env *env, jbas_token *begin, jbas_token **next)
+{
+	jbas_token *t_memo = begin->r;
+	jbas_token *t_step = t_memo->r;
+	jbas_token *t_coef = t_step->r;
+	jbas_memo *memo = t_memo->paren_token.memo;
+	*next = t_coef->r;
+
+	if (!memo->valid) return JBAS_OK;
+
+	// Get the coefficient value
+	jbas_number_token coef;
+	if (t_coef->type == JBAS_TOKEN_NUMBER)
+		coef = t_coef->number_token;
+	else
+	{
+		jbas_resource *res = t_coef->symbol_token.sym->res;
+		if (!res || res->type != JBAS_RESOURCE_NUMBER)
+		{
+			memo->valid = false;
+			return JBAS_OK;
+		}
+		coef = res->number;
+	}
+
+	// Only integer products can be updated incrementally (floats would accumulate errors)
+	if (memo->value.type == JBAS_NUM_INT && coef.type != JBAS_NUM_FLOAT)
+		memo->value.i += t_step->number_token.i * coef.i;
+	else
+		memo->valid = false;
+
+	return JBAS_OK;
+}
+
+/**
+	Evaluates array index (or loop bound) stored in parentheses for $CHECK
+*/
+static bool jbas_check_eval(jbas_token *paren, jbas_symbol *var, int64_t value, int64_t *result)
+{
+	jbas_expr_tree tree;
+	jbas_token **list = &paren->paren_token.tokens;
+	if (jbas_expr_parse(&tree, jbas_token_list_begin(*list), NULL, list)) return false;
+	return jbas_expr_eval_int(tree.root, var, value, result);
+}
+
+/**
+	`$CHECK i step cmp (n) [phase array (index)]...` - tries to prove
+	that array indices stay in range during the following `WHILE i cmp n`
+	loop. The indices are affine functions of `i`, so it's enough to check
+	the extreme values of `i`. `phase` tells whether the index is evaluated
+	before (0) or after (1) `i` is incremented or in the loop condition (2).
+	Inserted by the optimizer in front of loops.
+*/
+static jbas_error jbas_kw_check(jbas_env *env, jbas_token *begin, jbas_token **next)
+{
+	jbas_token *t = begin->r;
+	jbas_symbol *var = t->symbol_token.sym;
+	int64_t step = t->r->number_token.i;
+	const char *cmp = t->r->r->operator_token.op->str;
+	jbas_token *t_bound = t->r->r->r;
+
+	// Range of `i` in the loop body
+	int64_t i0 = 0, n = 0, lo, hi;
+	bool ok = var->res && var->res->type == JBAS_RESOURCE_NUMBER && var->res->number.type == JBAS_NUM_INT
+		&& jbas_check_eval(t_bound, NULL, 0, &n);
+	if (ok) i0 = var->res->number.i;
+	if (step > 0)
+	{
+		lo = i0;
+		hi = strcmp(cmp, "<") ? n : n - 1;
+	}
+	else
+	{
+		lo = strcmp(cmp, ">") ? n : n + 1;
+		hi = i0;
+	}
+
+	for (t = t_bound->r; t && t->type != JBAS_TOKEN_DELIMITER; t = t->r->r->r)
+	{
+		jbas_token *t_array = t->r, *t_index = t->r->r;
+		jbas_memo *memo = t_index->paren_token.memo;
+		memo->valid = false;
+		if (!ok) continue;
+
+		jbas_resource *res = t_array->symbol_token.sym->res;
+		if (!res || (res->type != JBAS_RESOURCE_INT_ARRAY && res->type != JBAS_RESOURCE_FLOAT_ARRAY)) continue;
+		if (res->size > INT_MAX) continue;
+
+		// Values of `i` when the index is evaluated
+		int64_t a = lo, b = hi;
+		switch (t->number_token.i)
+		{
+			case 1:
+				a += step;
+				b += step;
+				break;
+
+			// The condition is evaluated with the initial value too
+			case 2:
+				if (step > 0) b = (hi + step > i0) ? hi + step : i0;
+				else a = (lo + step < i0) ? lo + step : i0;
+				break;
+		}
+
+		// The body is never executed
+		if (a > b)
+		{
+			memo->value.i = 0;
+			memo->valid = true;
+			continue;
+		}
+
+		int64_t fa, fb;
+		if (a < INT_MIN || b > INT_MAX) continue;
+		if (!jbas_check_eval(t_index, var, a, &fa) || !jbas_check_eval(t_index, var, b, &fb)) continue;
+		if (fa > fb)
+		{
+			int64_t tmp = fa;
+			fa = fb;
+			fb = tmp;
+		}
+
+		if (fa >= 0 && fb < (int64_t) res->size)
+		{
+			memo->value.i = res->size;
+			memo->valid = true;
+		}
+	}
+
+	*next = t;
+	return JBAS_OK;
+}
+
+
+/**
+	Range of constant CASE labels
+*/
+typedef struct jbas_select_range
+{
+	int64_t lo, hi;
+	int clause;
+} jbas_select_range;
+
+/**
+	Compiled SELECT statement. It's built on the first execution and
+	cached in the SELECT keyword token.
+*/
+typedef struct jbas_select
+{
+	jbas_token *end;           //!< Token following END
+	jbas_token **clauses;      //!< CASE keywords
+	bool *dynamic;             //!< Clause has labels that need to be evaluated
+	int clause_count;
+	int else_clause;           //!< CASE ELSE (clause_count if there's none)
+
+	jbas_select_range *ranges; //!< Disjoint ranges of constant labels - sorted
+	int range_count;
+	int range_capacity;
+
+	int *jump;                 //!< Jump table (NULL if the labels are sparse)
+	int64_t jump_min;
+	int jump_size;
+} jbas_select;
+
+#define JBAS_SELECT_MAX_JUMP 4096
+
+/**
+	The tables are allocated by the environment's allocator
+*/
+static void jbas_select_destroy(jbas_env *env, jbas_select *sel)
+{
+	if (!sel) return;
+	jbas_free(&env->allocator, sel->clauses, sel->clause_count * sizeof(*sel->clauses));
+	jbas_free(&env->allocator, sel->dynamic, (sel->clause_count + 1) * sizeof(*sel->dynamic));
+	jbas_free(&env->allocator, sel->ranges, sel->range_capacity * sizeof(*sel->ranges));
+	jbas_free(&env->allocator, sel->jump, sel->jump_size * sizeof(*sel->jump));
+	jbas_free(&env->allocator, sel, sizeof(*sel));
+}
+
+static bool jbas_select_is_op(const jbas_token *t, const char *str)
+{
+	return t && t->type == JBAS_TOKEN_OPERATOR && !strcmp(t->operator_token.op->str, str);
+}
+
+static bool jbas_select_is_kw(const jbas_token *t, jbas_keyword_id id)
+{
+	return t && t->type == JBAS_TOKEN_KEYWORD && t->keyword_token.kw->id == id;
+}
+
+/**
+	Reads an integer literal (possibly negative) spanning the entire range [begin, end)
+*/
+static bool jbas_select_const(jbas_token *begin, jbas_token *end, int64_t *value)
+{
+	bool neg = jbas_select_is_op(begin, "-");
+	if (neg) begin = begin->r;
+	if (!begin || begin == end || begin->r != end) return false;
+	if (begin->type != JBAS_TOKEN_NUMBER || begin->number_token.type != JBAS_NUM_INT) return false;
+	*value = neg ? -(int64_t) begin->number_token.i : begin->number_token.i;
+	return true;
+}
+
+/**
+	Finds end of a CASE label - a comma, TO or a delimiter
+*/
+static jbas_token *jbas_select_label_end(jbas_token *t)
+{
+	while (t && t->type != JBAS_TOKEN_DELIMITER && !jbas_select_is_op(t, ",") && !jbas_select_is_kw(t, JBAS_KW_TO))
+		t = t->r;
+	return t;
+}
+
+static int jbas_select_range_cmp(const void *a, const void *b)
+{
+	int64_t x = *(const int64_t*) a, y = *(const int64_t*) b;
+	return (x > y) - (x < y);
+}
+
+/**
+	Turns (possibly overlapping) label ranges into sorted disjoint ranges.
+	Where they overlap, the first clause wins.
+*/
+static jbas_error jbas_select_build_ranges(jbas_env *env, jbas_select *sel, const jbas_select_range *raw, int raw_count)
+{
+	int64_t *points = jbas_alloc(&env->allocator, 2 * raw_count * sizeof(*points));
+	sel->ranges = jbas_alloc(&env->allocator, 2 * raw_count * sizeof(*sel->ranges));
+	if (sel->ranges) sel->range_capacity = 2 * raw_count;
+	if (!points || !sel->ranges)
+	{
+		jbas_free(&env->allocator, points, 2 * raw_count * sizeof(*points));
+		return JBAS_ALLOC;
+	}
+
+	for (int i = 0; i < raw_count; i++)
+	{
+		points[2 * i] = raw[i].lo;
+		points[2 * i + 1] = raw[i].hi + 1;
+	}
+	qsort(points, 2 * raw_count, sizeof(*points), jbas_select_range_cmp);
+
+	// Each pair of neighbouring points delimits a range covered by the same labels
+	for (int k = 0; k + 1 < 2 * raw_count; k++)
+	{
+		int64_t lo = points[k], hi = points[k + 1] - 1;
+		if (hi < lo) continue;
+
+		int clause = sel->clause_count;
+		for (int i = 0; i < raw_count; i++)
+			if (raw[i].lo <= lo && lo <= raw[i].hi && raw[i].clause < clause)
+				clause = raw[i].clause;
+		if (clause == sel->clause_count) continue;
+
+		jbas_select_range *last = sel->range_count ? &sel->ranges[sel->range_count - 1] : NULL;
+		if (last && last->clause == clause && last->hi + 1 == lo)
+			last->hi = hi;
+		else
+			sel->ranges[sel->range_count++] = (jbas_select_range){.lo = lo, .hi = hi, .clause = clause};
+	}
+
+	jbas_free(&env->allocator, points, 2 * raw_count * sizeof(*points));
+
+	// Dense labels get a jump table
+	if (!sel->range_count) return JBAS_OK;
+	int64_t span = sel->ranges[sel->range_count - 1].hi - sel->ranges[0].lo + 1;
+	if (span > JBAS_SELECT_MAX_JUMP || span > 8 * sel->range_count) return JBAS_OK;
+
+	sel->jump = jbas_alloc(&env->allocator, span * sizeof(*sel->jump));
+	if (!sel->jump) return JBAS_ALLOC;
+	sel->jump_min = sel->ranges[0].lo;
+	sel->jump_size = span;
+	for (int i = 0; i < span; i++)
+		sel->jump[i] = sel->clause_count;
+	for (int i = 0; i < sel->range_count; i++)
+		for (int64_t v = sel->ranges[i].lo; v <= sel->ranges[i].hi; v++)
+			sel->jump[v - sel->jump_min] = sel->ranges[i].clause;
 
 	return JBAS_OK;
 }
 
+/**
+	Finds all CASE clauses of the SELECT block and sorts out the constant labels
+*/
+static jbas_error jbas_select_compile(jbas_env *env, jbas_token *begin, jbas_select *sel)
+{
+	jbas_error err = jbas_get_block_end(env, begin, &sel->end);
+	if (err) return err;
+
+	// Selector
+	jbas_token *t = begin->r;
+	while (t && t != sel->end && t->type != JBAS_TOKEN_DELIMITER) t = t->r;
+	if (!t || t == sel->end)
+	{
+		JBAS_ERROR_REASON(env, "SELECT requires an expression");
+		return JBAS_SYNTAX_ERROR;
+	}
+
+	// CASE keywords at the SELECT level
+	int level = 0;
+	for (t = t->r; t && t != sel->end; t = t->r)
+	{
+		if (!level && jbas_select_is_kw(t, JBAS_KW_CASE))
+		{
+			jbas_token **clauses = jbas_realloc(&env->allocator, sel->clauses,
+				sel->clause_count * sizeof(*clauses), (sel->clause_count + 1) * sizeof(*clauses));
+			if (!clauses) return JBAS_ALLOC;
+			sel->clauses = clauses;
+			sel->clauses[sel->clause_count++] = t;
+		}
+		else if (!level && !sel->clause_count && t->type != JBAS_TOKEN_DELIMITER)
+		{
+			JBAS_ERROR_REASON(env, "SELECT body must begin with CASE");
+			return JBAS_SYNTAX_ERROR;
+		}
+
+		level += jbas_block_level_diff(t);
+	}
+
+	sel->else_clause = sel->clause_count;
+	sel->dynamic = jbas_alloc(&env->allocator, (sel->clause_count + 1) * sizeof(*sel->dynamic));
+	if (!sel->dynamic) return JBAS_ALLOC;
+
+	// Constant labels
+	jbas_select_range *raw = NULL;
+	int raw_count = 0, raw_size = 0;
+	for (int i = 0; i < sel->clause_count && !err; i++)
+	{
+		jbas_token *c = sel->clauses[i]->r;
+		if (jbas_select_is_kw(c, JBAS_KW_ELSE))
+		{
+			if (i != sel->clause_count - 1)
+			{
+				JBAS_ERROR_REASON(env, "CASE ELSE has to be the last one");
+				err = JBAS_SYNTAX_ERROR;
+			}
+			sel->else_clause = i;
+			break;
+		}
+
+		int first = raw_count;
+		while (!err)
+		{
+			jbas_token *e = jbas_select_label_end(c);
+			jbas_select_range r = {.clause = i};
+			if (c == e)
+			{
+				JBAS_ERROR_REASON(env, "missing CASE label");
+				err = JBAS_SYNTAX_ERROR;
+				break;
+			}
+
+			bool is_const = jbas_select_const(c, e, &r.lo);
+			r.hi = r.lo;
+			if (jbas_select_is_kw(e, JBAS_KW_TO))
+			{
+				c = e->r;
+				e = jbas_select_label_end(c);
+				if (c == e || jbas_select_is_kw(e, JBAS_KW_TO))
+				{
+					JBAS_ERROR_REASON(env, "bad CASE range");
+					err = JBAS_SYNTAX_ERROR;
+					break;
+				}
+				is_const = is_const && jbas_select_const(c, e, &r.hi);
+			}
+
+			if (!is_const) sel->dynamic[i] = true;
+			else if (r.lo <= r.hi)
+			{
+				if (raw_count == raw_size)
+				{
+					jbas_select_range *p = jbas_realloc(&env->allocator, raw, raw_size * sizeof(*raw), (raw_size + 1) * sizeof(*raw));
+					if (p) raw = p, raw_size++;
+				}
+
+				if (raw_count < raw_size) raw[raw_count++] = r;
+				else err = JBAS_ALLOC;
+			}
+
+			if (!jbas_select_is_op(e, ",")) break;
+			c = e->r;
+		}
+
+		// Clauses with any non-constant label are tested as a whole
+		if (sel->dynamic[i]) raw_count = first;
+	}
+
+	if (!err) err = jbas_select_build_ranges(env, sel, raw, raw_count);
+	jbas_free(&env->allocator, raw, raw_size * sizeof(*raw));
+	return err;
+}
+
+/**
+	Evaluates range [begin, end) of tokens to a number
+*/
+static jbas_error jbas_select_eval(jbas_env *env, jbas_token *begin, jbas_token *end, jbas_number_token *n)
+{
+	// Create fake list end - just like jbas_run_block()
+	if (end && end->l) end->l->r = NULL;
+	jbas_token *next, *res;
+	jbas_error err = jbas_eval_instruction(env, begin, &next, &res);
+	if (end && end->l) end->l->r = end;
+	if (err) return err;
+
+	err = jbas_token_to_number(env, res);
+	if (!err) *n = res->number_token;
+	jbas_token_list_destroy(res, &env->token_pool);
+	return err;
+}
+
+static int jbas_select_cmp(const jbas_number_token *a, const jbas_number_token *b)
+{
+	if (a->type == JBAS_NUM_FLOAT || b->type == JBAS_NUM_FLOAT)
+	{
+		jbas_float x = a->type == JBAS_NUM_FLOAT ? a->f : JBAS_FLOAT_FROM_INT(a->i);
+		jbas_float y = b->type == JBAS_NUM_FLOAT ? b->f : JBAS_FLOAT_FROM_INT(b->i);
+		return (x > y) - (x < y);
+	}
+
+	return (a->i > b->i) - (a->i < b->i);
+}
+
+/**
+	Evaluates labels of a CASE clause one by one and compares them with the value
+*/
+static jbas_error jbas_select_test(jbas_env *env, jbas_token *kw, const jbas_number_token *x, bool *match)
+{
+	*match = false;
+	for (jbas_token *c = kw->r; !*match; c = c->r)
+	{
+		jbas_number_token lo, hi;
+		jbas_token *e = jbas_select_label_end(c);
+		jbas_error err = jbas_select_eval(env, c, e, &lo);
+		if (err) return err;
+		hi = lo;
+
+		if (jbas_select_is_kw(e, JBAS_KW_TO))
+		{
+			c = e->r;
+			e = jbas_select_label_end(c);
+			err = jbas_select_eval(env, c, e, &hi);
+			if (err) return err;
+		}
+
+		*match = jbas_select_cmp(&lo, x) <= 0 && jbas_select_cmp(x, &hi) <= 0;
+		if (!jbas_select_is_op(e, ",")) break;
+		c = e;
+	}
+
+	return JBAS_OK;
+}
+
+/**
+	Looks up clause of an integer value among the constant labels
+*/
+static int jbas_select_lookup(const jbas_select *sel, int64_t v)
+{
+	if (sel->jump)
+	{
+		if (v < sel->jump_min || v - sel->jump_min >= sel->jump_size) return sel->clause_count;
+		return sel->jump[v - sel->jump_min];
+	}
+
+	int lo = 0, hi = sel->range_count - 1;
+	while (lo <= hi)
+	{
+		int mid = (lo + hi) / 2;
+		if (v < sel->ranges[mid].lo) hi = mid - 1;
+		else if (v > sel->ranges[mid].hi) lo = mid + 1;
+		else return sel->ranges[mid].clause;
+	}
+
+	return sel->clause_count;
+}
+
+/**
+	Executes a SELECT statement. Constant integer labels are looked up
+	in a jump table or with a binary search, the rest is tested in order.
+*/
+static jbas_error jbas_kw_select(jbas_env *env, jbas_token *begin, jbas_token **next)
+{
+	jbas_error err;
+	jbas_select *sel = begin->keyword_token.data;
+	if (!sel)
+	{
+		sel = jbas_alloc(&env->allocator, sizeof(*sel));
+		if (!sel) return JBAS_ALLOC;
+		err = jbas_select_compile(env, begin, sel);
+		if (err)
+		{
+			jbas_select_destroy(env, sel);
+			return err;
+		}
+		begin->keyword_token.data = sel;
+	}
+
+	// Evaluate the selector
+	jbas_token *t_cond_result = NULL;
+	jbas_token *t_body = NULL;
+	err = jbas_eval_instruction(env, begin->r, &t_body, &t_cond_result);
+	if (err) return err;
+	err = jbas_token_to_number(env, t_cond_result);
+	jbas_number_token x = t_cond_result->number_token;
+	jbas_token_list_destroy(t_cond_result, &env->token_pool);
+	if (err)
+	{
+		JBAS_ERROR_REASON(env, "SELECT expression has to be a number");
+		return err;
+	}
+
+	// Floats are compared with all the labels in order
+	int clause = sel->clause_count;
+	if (x.type != JBAS_NUM_FLOAT)
+		clause = jbas_select_lookup(sel, x.i);
+
+	// Earlier clauses with non-constant labels take precedence
+	for (int i = 0; i < clause && i < sel->else_clause; i++)
+	{
+		if (!sel->dynamic[i] && x.type != JBAS_NUM_FLOAT) continue;
+
+		bool match;
+		err = jbas_select_test(env, sel->clauses[i], &x, &match);
+		if (err) return err;
+		if (match)
+		{
+			clause = i;
+			break;
+		}
+	}
+
+	if (clause == sel->clause_count)
+		clause = sel->else_clause;
+
+	// Run the clause body
+	if (clause < sel->clause_count)
+	{
+		jbas_token *t;
+		for (t = sel->clauses[clause]; t && t->type != JBAS_TOKEN_DELIMITER; t = t->r);
+		jbas_token *t_next = clause + 1 < sel->clause_count ? sel->clauses[clause + 1] : sel->end;
+		if (t)
+		{
+			err = jbas_run_nested(env, begin, t->r, t_next, sel->end);
+			if (err) return err;
+		}
+	}
+
+	*next = sel->end;
+	return JBAS_OK;
+}
+
+/**
+	Parses PARALLEL FOR header into `par`
+*/
+static jbas_error jbas_parallel_parse_header(jbas_env *env, jbas_token *kw, jbas_parallel *par)
+{
+	// FOR variable = from TO to
+	jbas_token *t = kw->r;
+	if (!jbas_select_is_kw(t, JBAS_KW_FOR) || !t->r || t->r->type != JBAS_TOKEN_SYMBOL || !jbas_select_is_op(t->r->r, "="))
+	{
+		JBAS_ERROR_REASON(env, "PARALLEL has to be followed by `FOR variable = a TO b`");
+		return JBAS_SYNTAX_ERROR;
+	}
+	par->var = t->r->symbol_token.sym;
+	par->from = t->r->r->r;
+
+	for (t = par->from; t && t->type != JBAS_TOKEN_DELIMITER && !jbas_select_is_kw(t, JBAS_KW_TO); t = t->r);
+	par->from_end = t;
+	par->to = t ? t->r : NULL;
+	for (t = par->to; t && t->type != JBAS_TOKEN_DELIMITER && !jbas_select_is_kw(t, JBAS_KW_REDUCE); t = t->r);
+	par->to_end = t;
+	if (par->from == par->from_end || !jbas_select_is_kw(par->from_end, JBAS_KW_TO) || par->to == par->to_end)
+	{
+		JBAS_ERROR_REASON(env, "PARALLEL FOR requires both bounds");
+		return JBAS_SYNTAX_ERROR;
+	}
+
+	// REDUCE + variable
+	while (jbas_select_is_kw(t, JBAS_KW_REDUCE))
+	{
+		if (!jbas_select_is_op(t->r, "+") || !t->r->r || t->r->r->type != JBAS_TOKEN_SYMBOL)
+		{
+			JBAS_ERROR_REASON(env, "REDUCE has to be followed by `+ variable`");
+			return JBAS_SYNTAX_ERROR;
+		}
+
+		jbas_symbol **reduce = jbas_realloc(&env->allocator, par->reduce,
+			par->reduce_count * sizeof(*reduce), (par->reduce_count + 1) * sizeof(*reduce));
+		if (!reduce) return JBAS_ALLOC;
+		par->reduce = reduce;
+		par->reduce[par->reduce_count++] = t->r->r->symbol_token.sym;
+		t = t->r->r->r;
+	}
+
+	if (!t || t->type != JBAS_TOKEN_DELIMITER)
+	{
+		JBAS_ERROR_REASON(env, "unexpected tokens in PARALLEL FOR header");
+		return JBAS_SYNTAX_ERROR;
+	}
+	par->body = t->r;
+	jbas_error err = jbas_get_block_end(env, kw, &par->end);
+	if (err) return err;
+
+	// The arrays are shared - they cannot be reallocated
+	for (t = par->body; t != par->end; t = t->r)
+		if (jbas_select_is_kw(t, JBAS_KW_IDIM) || jbas_select_is_kw(t, JBAS_KW_FDIM))
+		{
+			JBAS_ERROR_REASON(env, "arrays cannot be dimensioned inside PARALLEL FOR");
+			return JBAS_UNSUPPORTED;
+		}
+
+	// The list may be cut after the keyword, but not before it
+	for (t = kw->l; t; t = t->l)
+		par->position++;
+
+	return JBAS_OK;
+}
+
+/**
+	Returns parsed PARALLEL FOR header (kept in the keyword token)
+*/
+jbas_error jbas_parallel_parse(jbas_env *env, jbas_token *kw, jbas_parallel **result)
+{
+	if (!kw->keyword_token.data)
+	{
+		jbas_parallel *par = jbas_alloc(&env->allocator, sizeof(*par));
+		if (!par) return JBAS_ALLOC;
+
+		jbas_error err = jbas_parallel_parse_header(env, kw, par);
+		if (err)
+		{
+			jbas_parallel_destroy(env, par);
+			return err;
+		}
+		kw->keyword_token.data = par;
+	}
+
+	*result = kw->keyword_token.data;
+	return JBAS_OK;
+}
+
+void jbas_parallel_destroy(jbas_env *env, jbas_parallel *par)
+{
+	if (!par) return;
+	jbas_free(&env->allocator, par->reduce, par->reduce_count * sizeof(*par->reduce));
+	jbas_free(&env->allocator, par, sizeof(*par));
+}
+
+/**
+	Evaluates the bounds and runs the loop. A resumed loop (see
+	jbas_resume()) continues after the current value of the variable.
+*/
+static jbas_error jbas_parallel_exec(jbas_env *env, jbas_token *kw, bool resume, jbas_token **next)
+{
+	jbas_parallel *par;
+	jbas_error err = jbas_parallel_parse(env, kw, &par);
+	if (err) return err;
+
+	// Evaluate the bounds
+	jbas_number_token from, to;
+	err = jbas_select_eval(env, par->from, par->from_end, &from);
+	if (!err) err = jbas_select_eval(env, par->to, par->to_end, &to);
+	if (err)
+	{
+		JBAS_ERROR_REASON(env, "PARALLEL FOR bounds have to be numbers");
+		return err;
+	}
+	jbas_number_cast(&from, JBAS_NUM_INT);
+	jbas_number_cast(&to, JBAS_NUM_INT);
+
+	if (resume)
+	{
+		jbas_resource *res = par->var->res;
+		if (!res || res->type != JBAS_RESOURCE_NUMBER)
+		{
+			JBAS_ERROR_REASON(env, "PARALLEL FOR variable has to hold a number");
+			return JBAS_TYPE_MISMATCH;
+		}
+		from = res->number;
+		jbas_number_cast(&from, JBAS_NUM_INT);
+		from.i++;
+	}
+
+	// The serial loop can be suspended
+	err = jbas_frame_push(env, kw, par->end, par->end);
+	if (err) return err;
+	err = jbas_pool_run(env, par, from.i, to.i);
+	if (!jbas_is_suspension(err)) env->frame_count--;
+	if (err) return err;
+
+	*next = par->end;
+	return JBAS_OK;
+}
+
+/**
+	PARALLEL FOR - see jbasic/pool.h
+*/
+static jbas_error jbas_kw_parallel(jbas_env *env, jbas_token *begin, jbas_token **next)
+{
+	return jbas_parallel_exec(env, begin, false, next);
+}
+
+/**
+	FOR and REDUCE only make sense in PARALLEL FOR headers
+*/
+static jbas_error jbas_kw_for(jbas_env *env, jbas_token *begin, jbas_token **next)
+{
+	JBAS_ERROR_REASON(env, "FOR and REDUCE can only be used in PARALLEL FOR");
+	return JBAS_SYNTAX_ERROR;
+}
+
+/**
+	Frees data cached in a keyword token
+*/
+void jbas_keyword_token_destroy(jbas_env *env, jbas_token *t)
+{
+	if (t->type != JBAS_TOKEN_KEYWORD) return;
+	if (t->keyword_token.kw->id == JBAS_KW_SELECT)
+		jbas_select_destroy(env, t->keyword_token.data);
+#ifndef JBAS_STATIC
+	else if (t->keyword_token.kw->id == JBAS_KW_WHILE)
+		jbas_jit_loop_destroy(t->keyword_token.data);
+#endif
+	else if (t->keyword_token.kw->id == JBAS_KW_PARALLEL)
+		jbas_parallel_destroy(env, t->keyword_token.data);
+	t->keyword_token.data = NULL;
+}
+
 
 /**
 	The keyword table
@@ -247,6 +1087,18 @@ const jbas_keyword jbas_keywords[JBAS_KEYWORD_COUNT] =
 	{ 0, "IDIM",   JBAS_KW_IDIM,   jbas_kw_idim,   NULL},
 	{ 0, "FDIM",   JBAS_KW_FDIM,   jbas_kw_fdim,   NULL},
 
+	{ 1, "SELECT", JBAS_KW_SELECT, jbas_kw_select, NULL},
+	{ 0, "CASE",   JBAS_KW_CASE,   NULL,           NULL},
+	{ 0, "TO",     JBAS_KW_TO,     NULL,           NULL},
+
+	{ 1, "PARALLEL", JBAS_KW_PARALLEL, jbas_kw_parallel, NULL},
+	{ 0, "FOR",      JBAS_KW_FOR,      jbas_kw_for,      NULL},
+	{ 0, "REDUCE",   JBAS_KW_REDUCE,   jbas_kw_for,      NULL},
+
+	// These cannot be typed in - '$' is not a name character
+	{ 0, "$INVALIDATE", JBAS_KW_INVALIDATE, jbas_kw_invalidate, NULL},
+	{ 0, "$STEP",       JBAS_KW_STEP,       jbas_kw_step,       NULL},
+	{ 0, "$CHECK",      JBAS_KW_CHECK,      jbas_kw_check,      NULL},
 };
 
 /**
@@ -317,4 +1169,116 @@ jbas_error jbas_eval_keyword(jbas_env *env, jbas_token *token, jbas_token **next
 	}
 
 	return JBAS_OK;
-}
\ No newline at end of file
+}
+/**
+	Finds where the part of an IF or SELECT block containing given
+	instruction ends (at ELSE or the next CASE). For other blocks
+	the block end is returned.
+*/
+static jbas_token *jbas_resume_stop(jbas_token *kw, jbas_token *t, jbas_token *t_end)
+{
+	jbas_keyword_id id = kw->keyword_token.kw->id;
+	if (id != JBAS_KW_IF && id != JBAS_KW_SELECT) return t_end;
+
+	int level = 0;
+	for (; t && t != t_end; t = t->r)
+	{
+		if (!level && t->type == JBAS_TOKEN_KEYWORD)
+		{
+			jbas_keyword_id u = t->keyword_token.kw->id;
+			if ((id == JBAS_KW_IF && u == JBAS_KW_ELSE) || (id == JBAS_KW_SELECT && u == JBAS_KW_CASE))
+				return t;
+		}
+
+		level += jbas_block_level_diff(t);
+		if (level < 0) break;
+	}
+
+	return t_end;
+}
+
+/**
+	Finishes the blocks on env->frames from `base` up from the inside out,
+	starting at `at` in the innermost one. The WHILE and PARALLEL FOR
+	loops among them are continued. `next` is set to the token after the
+	outermost finished block (or to `at` if there are none). The frames
+	of the blocks being run are kept on the stack, so the run can be
+	suspended again.
+*/
+static jbas_error jbas_resume_frames(jbas_env *env, int base, jbas_token *at, jbas_token **next)
+{
+	jbas_token *t = at;
+	for (int d = env->frame_count - 1; d >= base; d--)
+	{
+		// Frames found in the program don't know where they end yet
+		jbas_frame *f = &env->frames[d];
+		jbas_error err = f->end ? JBAS_OK : jbas_get_block_end(env, f->kw, &f->end);
+		if (err) return err;
+		if (!f->stop) f->stop = jbas_resume_stop(f->kw, t, f->end);
+		jbas_token *kw = f->kw, *t_stop = f->stop, *t_end = f->end;
+
+		// The rest of the branch or clause
+		env->frame_count = d + 1;
+		if (t != t_stop)
+		{
+			err = jbas_run_block(env, t, t_stop, NULL);
+			if (err) return err;
+		}
+		env->frame_count = d;
+
+		// The loops go on
+		jbas_token *t_next;
+		if (kw->keyword_token.kw->id == JBAS_KW_WHILE)
+			err = jbas_eval_keyword(env, kw, &t_next);
+		else if (kw->keyword_token.kw->id == JBAS_KW_PARALLEL)
+			err = jbas_parallel_exec(env, kw, true, &t_next);
+		if (err) return err;
+
+		t = t_end;
+	}
+
+	*next = t;
+	return JBAS_OK;
+}
+
+/**
+	Continues execution from an instruction inside a block when there are
+	no frames of the blocks around it (e.g. a restored checkpoint or a
+	compiled loop handing the control back) - the blocks opened between
+	`begin` and `at` are found in the program and finished from the inside
+	out, see jbas_resume_frames().
+*/
+jbas_error jbas_resume(jbas_env *env, jbas_token *begin, jbas_token *at, jbas_token **next)
+{
+	int base = env->frame_count;
+	jbas_error err = JBAS_OK;
+	for (jbas_token *t = begin; !err && t != at; t = t->r)
+	{
+		if (!t)
+		{
+			JBAS_ERROR_REASON(env, "resumed instruction is not a part of the program");
+			err = JBAS_SYNTAX_ERROR;
+			break;
+		}
+
+		int diff = jbas_block_level_diff(t);
+		if (diff < 0 && env->frame_count > base) env->frame_count--;
+		if (diff > 0) err = jbas_frame_push(env, t, NULL, NULL);
+	}
+
+	if (!err) err = jbas_resume_frames(env, base, at, next);
+	if (!jbas_is_suspension(err)) env->frame_count = base;
+	return err;
+}
+
+/**
+	Continues a suspended run from `at` - the blocks around it are the
+	frames the run has left on env->frames, so it only takes as long as
+	the nesting is deep.
+*/
+jbas_error jbas_resume_suspended(jbas_env *env, jbas_token *at, jbas_token **next)
+{
+	jbas_error err = jbas_resume_frames(env, 0, at, next);
+	if (!jbas_is_suspension(err)) env->frame_count = 0;
+	return err;
+}
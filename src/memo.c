@@ -0,0 +1,51 @@
+#include <jbasic/memo.h>
+#include <stdlib.h>
+
+jbas_error jbas_memo_manager_init(jbas_memo_manager *mm, int max_count, const jbas_allocator *allocator)
+{
+	mm->max_count = max_count;
+	mm->memo_count = 0;
+	mm->allocator = allocator;
+	mm->memo_storage = jbas_alloc(allocator, max_count * sizeof(jbas_memo));
+
+	if (!mm->memo_storage)
+		return JBAS_ALLOC;
+
+	return JBAS_OK;
+}
+
+void jbas_memo_manager_destroy(jbas_memo_manager *mm)
+{
+	jbas_free(mm->allocator, mm->memo_storage, mm->max_count * sizeof(jbas_memo));
+}
+
+/**
+	Creates a new (invalid) memo
+*/
+jbas_error jbas_memo_create(jbas_memo_manager *mm, jbas_memo **memo)
+{
+	if (mm->memo_count >= mm->max_count) return JBAS_MEMO_MANAGER_OVERFLOW;
+
+	jbas_memo *m = &mm->memo_storage[mm->memo_count++];
+	m->kind = JBAS_MEMO_VALUE;
+	m->valid = false;
+	*memo = m;
+	return JBAS_OK;
+}
+
+/**
+	Returns index of the memo (used as its name in reports and dumps)
+*/
+int jbas_memo_id(jbas_memo_manager *mm, jbas_memo *memo)
+{
+	return memo - mm->memo_storage;
+}
+
+/**
+	Invalidates all memos
+*/
+void jbas_memo_invalidate_all(jbas_memo_manager *mm)
+{
+	for (int i = 0; i < mm->memo_count; i++)
+		mm->memo_storage[i].valid = false;
+}
@@ -62,6 +62,13 @@ static jbas_error jbas_op_assign(jbas_env *env, jbas_token *a, jbas_token *b, jb
 	jbas_symbol *asym = a->symbol_token.sym;
 	jbas_resource *dest;
 
+	// An unbound symbol can't be read (like in any other expression)
+	if (b->type == JBAS_TOKEN_SYMBOL && !b->symbol_token.sym->res)
+	{
+		JBAS_ERROR_REASON(env, "could not convert token to number");
+		return JBAS_CAST_FAILED;
+	}
+
 	// Decrement reference count on the resource currently kept in the dest. variable
 	if (asym->res)
 	{
@@ -74,7 +81,11 @@ static jbas_error jbas_op_assign(jbas_env *env, jbas_token *a, jbas_token *b, jb
 	}
 
 	// If there's no destination resource, create it
-	if (!asym->res) jbas_resource_create(&env->resource_manager, &asym->res);
+	if (!asym->res)
+	{
+		jbas_error err = jbas_resource_create(&env->resource_manager, &asym->res);
+		if (err) return err;
+	}
 	dest = asym->res;
 
 	
@@ -376,7 +387,7 @@ static jbas_error jbas_op_add(jbas_env *env, jbas_token *a, jbas_token *b, jbas_
 	if (err) return err;
 
 	if (res->number_token.type == JBAS_NUM_FLOAT)
-		res->number_token.f = a->number_token.f + b->number_token.f;
+		res->number_token.f = JBAS_FLOAT_ADD(a->number_token.f, b->number_token.f);
 	else
 		res->number_token.i = a->number_token.i + b->number_token.i;
 
@@ -391,7 +402,7 @@ static jbas_error jbas_op_sub(jbas_env *env, jbas_token *a, jbas_token *b, jbas_
 		if (err) return err;
 
 		if (res->number_token.type == JBAS_NUM_FLOAT)
-			res->number_token.f = a->number_token.f - b->number_token.f;	
+			res->number_token.f = JBAS_FLOAT_SUB(a->number_token.f, b->number_token.f);	
 		else
 			res->number_token.i = a->number_token.i - b->number_token.i;
 	}
@@ -419,7 +430,7 @@ static jbas_error jbas_op_mul(jbas_env *env, jbas_token *a, jbas_token *b, jbas_
 	if (err) return err;
 
 	if (res->number_token.type == JBAS_NUM_FLOAT)
-		res->number_token.f = a->number_token.f * b->number_token.f;
+		res->number_token.f = JBAS_FLOAT_MUL(a->number_token.f, b->number_token.f);
 	else
 		res->number_token.i = a->number_token.i * b->number_token.i;
 
@@ -432,7 +443,7 @@ static jbas_error jbas_op_div(jbas_env *env, jbas_token *a, jbas_token *b, jbas_
 	if (err) return err;
 
 	if (res->number_token.type == JBAS_NUM_FLOAT)
-		res->number_token.f = a->number_token.f / b->number_token.f;
+		res->number_token.f = JBAS_FLOAT_DIV(a->number_token.f, b->number_token.f);
 	else
 		res->number_token.i = a->number_token.i / b->number_token.i;
 
@@ -445,7 +456,7 @@ static jbas_error jbas_op_rem(jbas_env *env, jbas_token *a, jbas_token *b, jbas_
 	if (err) return err;
 
 	if (res->number_token.type == JBAS_NUM_FLOAT)
-		res->number_token.f = fmodf(a->number_token.f, b->number_token.f);
+		res->number_token.f = JBAS_FLOAT_MOD(a->number_token.f, b->number_token.f);
 	else
 		res->number_token.i = a->number_token.i % b->number_token.i;
 
@@ -463,7 +474,7 @@ static jbas_error jbas_op_mod(jbas_env *env, jbas_token *a, jbas_token *b, jbas_
 	if (err) return err;
 
 	if (res->number_token.type == JBAS_NUM_FLOAT)
-		res->number_token.f = fmodf(a->number_token.f, b->number_token.f);
+		res->number_token.f = JBAS_FLOAT_MOD(a->number_token.f, b->number_token.f);
 	else
 	{
 		res->number_token.i = real_mod(a->number_token.i, b->number_token.i);
@@ -525,7 +536,11 @@ static jbas_error jbas_op_print(jbas_env *env, jbas_token *a, jbas_token *b, jba
 				else if (n->type == JBAS_NUM_BOOL)
 					jbas_printf(env, n->i ? "TRUE" : "FALSE");
 				else
-					jbas_printf(env, "%f", n->f);
+				{
+					char buf[32];
+					jbas_float_format(buf, sizeof(buf), n->f);
+					jbas_printf(env, "%s", buf);
+				}
 			}
 			break;
 
@@ -561,7 +576,7 @@ static jbas_error jbas_op_input(jbas_env *env, jbas_token *a, jbas_token *b, jba
 /**
 	Alternative minus sign operation
 */
-static const jbas_operator jbas_op_neg_def = {.str = "-", .level = 6, .type = JBAS_OP_UNARY_PREFIX, .fallback = 0, .eval_args = 1, .handler = jbas_op_sub};
+static const jbas_operator jbas_op_neg_def = {.str = "-", .level = 6, .type = JBAS_OP_UNARY_PREFIX, .fallback = 0, .eval_args = 1, .pure = 1, .handler = jbas_op_sub};
 
 /**
 	Operator table
@@ -569,39 +584,39 @@ static const jbas_operator jbas_op_neg_def = {.str = "-", .level = 6, .type = JB
 const jbas_operator jbas_operators[JBAS_OPERATOR_COUNT] = 
 {
 	// Assignment operators
-	{.str = "=",   .level = 0, .type = JBAS_OP_BINARY_RL, .fallback = 0, .eval_args = 1, .handler = jbas_op_assign},
+	{.str = "=",   .level = 0, .type = JBAS_OP_BINARY_RL, .fallback = 0, .eval_args = 1, .pure = 0, .handler = jbas_op_assign},
 	
 	// Commas for making tuples
-	{.str = ",",   .level = 1, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 1, .handler = jbas_op_comma},
+	{.str = ",",   .level = 1, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 1, .pure = 0, .handler = jbas_op_comma},
 
 	// Binary logical operators
-	{.str = "&&",  .level = 2, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 0, .handler = jbas_op_and},
-	{.str = "||",  .level = 2, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 0, .handler = jbas_op_or},
-	{.str = "AND", .level = 2, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 0, .handler = jbas_op_and},
-	{.str = "OR",  .level = 2, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 0, .handler = jbas_op_or},
+	{.str = "&&",  .level = 2, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 0, .pure = 1, .handler = jbas_op_and},
+	{.str = "||",  .level = 2, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 0, .pure = 1, .handler = jbas_op_or},
+	{.str = "AND", .level = 2, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 0, .pure = 1, .handler = jbas_op_and},
+	{.str = "OR",  .level = 2, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 0, .pure = 1, .handler = jbas_op_or},
 
 	// Comparison operators
-	{.str = "==",  .level = 3, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 1, .handler = jbas_op_eq},
-	{.str = "!=",  .level = 3, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 1, .handler = jbas_op_neq},
-	{.str = "<",   .level = 3, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 1, .handler = jbas_op_less},
-	{.str = ">",   .level = 3, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 1, .handler = jbas_op_greater},
-	{.str = "<=",  .level = 3, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 1, .handler = jbas_op_leq},
-	{.str = ">=",  .level = 3, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 1, .handler = jbas_op_geq},
+	{.str = "==",  .level = 3, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 1, .pure = 1, .handler = jbas_op_eq},
+	{.str = "!=",  .level = 3, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 1, .pure = 1, .handler = jbas_op_neq},
+	{.str = "<",   .level = 3, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 1, .pure = 1, .handler = jbas_op_less},
+	{.str = ">",   .level = 3, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 1, .pure = 1, .handler = jbas_op_greater},
+	{.str = "<=",  .level = 3, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 1, .pure = 1, .handler = jbas_op_leq},
+	{.str = ">=",  .level = 3, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 1, .pure = 1, .handler = jbas_op_geq},
 
 	// Mathematical operators
-	{.str = "+",     .level = 4, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 1, .handler = jbas_op_add},
-	{.str = "-",     .level = 4, .type = JBAS_OP_BINARY_LR, .fallback = &jbas_op_neg_def, .eval_args = 1, .handler = jbas_op_sub},
-	{.str = "*",     .level = 5, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 1, .handler = jbas_op_mul},
-	{.str = "/",     .level = 5, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 1, .handler = jbas_op_div},
-	{.str = "%",     .level = 5, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 1, .handler = jbas_op_rem},
-	{.str = "mod",   .level = 5, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 1, .handler = jbas_op_mod},
+	{.str = "+",     .level = 4, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 1, .pure = 1, .handler = jbas_op_add},
+	{.str = "-",     .level = 4, .type = JBAS_OP_BINARY_LR, .fallback = &jbas_op_neg_def, .eval_args = 1, .pure = 1, .handler = jbas_op_sub},
+	{.str = "*",     .level = 5, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 1, .pure = 1, .handler = jbas_op_mul},
+	{.str = "/",     .level = 5, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 1, .pure = 1, .handler = jbas_op_div},
+	{.str = "%",     .level = 5, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 1, .pure = 1, .handler = jbas_op_rem},
+	{.str = "mod",   .level = 5, .type = JBAS_OP_BINARY_LR, .fallback = 0, .eval_args = 1, .pure = 1, .handler = jbas_op_mod},
 
 	// Unary prefix operators
-	{.str = "!",       .level = 6, .type = JBAS_OP_UNARY_PREFIX, .fallback = 0, .eval_args = 1, .handler = jbas_op_not},
-	{.str = "NOT",     .level = 6, .type = JBAS_OP_UNARY_PREFIX, .fallback = 0, .eval_args = 1, .handler = jbas_op_not},
-	{.str = "PRINT",   .level = 6, .type = JBAS_OP_UNARY_PREFIX, .fallback = 0, .eval_args = 1, .handler = jbas_op_print},
-	{.str = "PRINTLN", .level = 6, .type = JBAS_OP_UNARY_PREFIX, .fallback = 0, .eval_args = 1, .handler = jbas_op_println},
-	{.str = "INPUT",   .level = 6, .type = JBAS_OP_UNARY_PREFIX, .fallback = 0, .eval_args = 1, .handler = jbas_op_input},
+	{.str = "!",       .level = 6, .type = JBAS_OP_UNARY_PREFIX, .fallback = 0, .eval_args = 1, .pure = 1, .handler = jbas_op_not},
+	{.str = "NOT",     .level = 6, .type = JBAS_OP_UNARY_PREFIX, .fallback = 0, .eval_args = 1, .pure = 1, .handler = jbas_op_not},
+	{.str = "PRINT",   .level = 6, .type = JBAS_OP_UNARY_PREFIX, .fallback = 0, .eval_args = 1, .pure = 0, .handler = jbas_op_print},
+	{.str = "PRINTLN", .level = 6, .type = JBAS_OP_UNARY_PREFIX, .fallback = 0, .eval_args = 1, .pure = 0, .handler = jbas_op_println},
+	{.str = "INPUT",   .level = 6, .type = JBAS_OP_UNARY_PREFIX, .fallback = 0, .eval_args = 1, .pure = 0, .handler = jbas_op_input},
 };
 
 int jbas_is_operator_char(char c)
@@ -898,6 +913,10 @@ jbas_error jbas_eval_call_operator(jbas_env *env, jbas_token *fun, jbas_token *a
 	jbas_error err = jbas_symbol_to_resource(env, fun);
 	if (err) return err;
 
+	// Index proven to be in range at loop entry (see $CHECK)
+	jbas_memo *bounds = args->type == JBAS_TOKEN_PAREN ? args->paren_token.memo : NULL;
+	if (bounds && (bounds->kind != JBAS_MEMO_BOUNDS || !bounds->valid)) bounds = NULL;
+
 	// Eval arguments
 	err = jbas_eval_paren(env, args);
 	if (err) return err;
@@ -918,8 +937,24 @@ jbas_error jbas_eval_call_operator(jbas_env *env, jbas_token *fun, jbas_token *a
 			// Call a C function
 			case JBAS_RESOURCE_CFUN:
 				{
+					// Already called before the instruction would block
+					if (env->call_result_next < env->call_result_count)
+					{
+						ret = (jbas_token){.type = JBAS_TOKEN_NUMBER, .number_token = env->call_results[env->call_result_next++]};
+						break;
+					}
+
+					env->cfun_calls++;
 					jbas_error err = res->cfun(env, args, &ret);
-					if (err) return err;		
+					if (err) return err;
+
+					if (ret.type == JBAS_TOKEN_NUMBER && env->call_result_count < JBAS_MAX_CALL_RESULTS)
+					{
+						env->call_results[env->call_result_count++] = ret.number_token;
+						env->call_result_next++;
+					}
+					else
+						env->call_results_lost = true;
 				}
 				break;
 
@@ -935,13 +970,15 @@ jbas_error jbas_eval_call_operator(jbas_env *env, jbas_token *fun, jbas_token *a
 						return JBAS_BAD_INDEX;
 					}
 
+					// The checks can be skipped if the index has been proven to be in range
 					int n = args->number_token.i;
-					if (n < 0)
+					bool checked = bounds && res->size >= (size_t) bounds->value.i;
+					if (!checked && n < 0)
 					{
 						JBAS_ERROR_REASON(env, "invalid array index (negative)");
 						return JBAS_BAD_INDEX;
 					}
-					if (n >= res->size)
+					if (!checked && n >= res->size)
 					{
 						JBAS_ERROR_REASON(env, "invalid array index (out of bounds)");
 						return JBAS_BAD_INDEX;
@@ -0,0 +1,1153 @@
+#include <jbasic/opt.h>
+#include <jbasic/jbasic.h>
+#include <jbasic/expr.h>
+#include <jbasic/memo.h>
+#include <jbasic/debug.h>
+
+/**
+	Instruction as seen by the optimizer
+*/
+typedef struct jbas_opt_stmt
+{
+	jbas_token *begin, *end; //!< Instruction tokens - [begin, end)
+	int loop;                //!< Innermost loop containing the instruction (-1 if none)
+	bool top;                //!< Executed exactly once per iteration of the loop
+	bool is_expr;            //!< Plain instruction or a condition (not a keyword)
+	jbas_token *kw;          //!< IF keyword if the instruction is its condition
+	int region;              //!< Straight-line code region (-1 if not part of any)
+	jbas_symbol **assigned;  //!< Symbols (re)bound by the instruction
+	int assigned_count;
+} jbas_opt_stmt;
+
+/**
+	WHILE loop as seen by the optimizer
+*/
+typedef struct jbas_opt_loop
+{
+	jbas_token *kw, *end; //!< WHILE keyword and the token following its END
+	int parent;
+	int first, last;      //!< Instructions inside the loop (including the condition)
+
+	jbas_symbol *ivar;    //!< Induction variable (`i = i + step` executed once per iteration)
+	jbas_int step;
+	int ivar_stmt;
+
+	jbas_token **memos;   //!< Memo parentheses to be invalidated on loop entry
+	int memo_count;
+	jbas_token **steps;   //!< Induction memos and their coefficients (pairs)
+	int step_count;
+} jbas_opt_loop;
+
+typedef struct jbas_opt_ctx
+{
+	jbas_env *env;
+	FILE *report;
+	int flags;
+
+	jbas_opt_stmt *stmts;
+	int stmt_count;
+	jbas_opt_loop *loops;
+	int loop_count;
+	int region;
+
+	unsigned char *sym_flags;  //!< JBAS_OPT_SYM_* flags indexed by symbol storage index
+	jbas_expr_tree *tree;      //!< Scratch tree
+} jbas_opt_ctx;
+
+#define JBAS_OPT_SYM_DIM   1 //!< Symbol is IDIMed or FDIMed somewhere
+#define JBAS_OPT_SYM_BOUND 2 //!< Symbol is assigned to somewhere
+
+/**
+	Appends an element to a dynamic array
+*/
+static jbas_error jbas_opt_push(void **arr, int *count, size_t size, const void *elem)
+{
+	char *p = realloc(*arr, (*count + 1) * size);
+	if (!p) return JBAS_ALLOC;
+	memcpy(p + *count * size, elem, size);
+	*arr = p;
+	(*count)++;
+	return JBAS_OK;
+}
+
+static jbas_error jbas_opt_add_assigned(jbas_opt_stmt *s, jbas_symbol *sym)
+{
+	return jbas_opt_push((void**) &s->assigned, &s->assigned_count, sizeof(sym), &sym);
+}
+
+/**
+	Marks all symbols in range [begin, end) (including parentheses contents) as assigned
+*/
+static jbas_error jbas_opt_assign_all(jbas_opt_stmt *s, jbas_token *begin, jbas_token *end)
+{
+	for (jbas_token *t = begin; t && t != end; t = t->r)
+	{
+		jbas_error err = JBAS_OK;
+		if (t->type == JBAS_TOKEN_SYMBOL)
+			err = jbas_opt_add_assigned(s, t->symbol_token.sym);
+		else if (t->type == JBAS_TOKEN_PAREN)
+			err = jbas_opt_assign_all(s, jbas_token_list_begin(t->paren_token.tokens), NULL);
+		if (err) return err;
+	}
+
+	return JBAS_OK;
+}
+
+/**
+	Determines which symbols are assigned by the instruction
+*/
+static jbas_error jbas_opt_find_assigned(jbas_opt_ctx *ctx, jbas_opt_stmt *s)
+{
+	// DIM rebinds the symbol
+	if (!s->is_expr)
+	{
+		int id = s->begin->keyword_token.kw->id;
+		if ((id == JBAS_KW_IDIM || id == JBAS_KW_FDIM) && s->begin->r && s->begin->r->type == JBAS_TOKEN_SYMBOL)
+			return jbas_opt_add_assigned(s, s->begin->r->symbol_token.sym);
+
+		// PARALLEL FOR binds the loop and REDUCE variables
+		if (id == JBAS_KW_PARALLEL)
+			return jbas_opt_assign_all(s, s->begin->r, s->end);
+
+		// CASE labels are evaluated too
+		if (id == JBAS_KW_CASE)
+			for (jbas_token *t = s->begin->r; t && t != s->end; t = t->r)
+				if (t->type != JBAS_TOKEN_SYMBOL && t->type != JBAS_TOKEN_NUMBER && t->type != JBAS_TOKEN_KEYWORD
+					&& !(t->type == JBAS_TOKEN_OPERATOR && (t->operator_token.op->pure || !strcmp(t->operator_token.op->str, ","))))
+					return jbas_opt_assign_all(s, s->begin->r, s->end);
+		return JBAS_OK;
+	}
+
+	// If the instruction cannot be understood, assume it assigns everything
+	jbas_expr_tree tree;
+	if (jbas_expr_parse(&tree, s->begin, s->end, &ctx->env->tokens))
+		return jbas_opt_assign_all(s, s->begin, s->end);
+
+	for (int i = 0; i < tree.node_count; i++)
+	{
+		jbas_expr *e = &tree.nodes[i];
+		if (!jbas_expr_is_assign(e)) continue;
+
+		jbas_error err = JBAS_OK;
+		if (e->a->type == JBAS_EXPR_OPERAND && e->a->token->type == JBAS_TOKEN_SYMBOL)
+			err = jbas_opt_add_assigned(s, e->a->token->symbol_token.sym);
+		else if (e->a->type == JBAS_EXPR_CALL)
+			; // Array element write - the symbol is not rebound
+		else
+			err = jbas_opt_assign_all(s, e->a->begin, e->a->end->r);
+		if (err) return err;
+	}
+
+	return JBAS_OK;
+}
+
+static jbas_error jbas_opt_add_stmt(jbas_opt_ctx *ctx, jbas_token *begin, jbas_token *end, int loop, bool top, bool is_expr)
+{
+	jbas_opt_stmt s = {.begin = begin, .end = end, .loop = loop, .top = top, .is_expr = is_expr};
+	s.region = is_expr ? ctx->region : -1;
+	jbas_error err = jbas_opt_find_assigned(ctx, &s);
+	if (!err) err = jbas_opt_push((void**) &ctx->stmts, &ctx->stmt_count, sizeof(s), &s);
+	if (err) free(s.assigned);
+	return err;
+}
+
+static jbas_token *jbas_opt_find_delimiter(jbas_token *t, jbas_token *end)
+{
+	while (t && t != end && t->type != JBAS_TOKEN_DELIMITER)
+		t = t->r;
+	return t;
+}
+
+/**
+	Builds list of instructions and loops in the block [begin, end)
+*/
+static jbas_error jbas_opt_scan_block(jbas_opt_ctx *ctx, jbas_token *begin, jbas_token *end, int loop, bool top)
+{
+	jbas_error err;
+	jbas_token *t = begin;
+	ctx->region++;
+	while (t && t != end)
+	{
+		if (t->type == JBAS_TOKEN_DELIMITER)
+		{
+			t = t->r;
+			continue;
+		}
+
+		jbas_keyword_id id = t->type == JBAS_TOKEN_KEYWORD ? t->keyword_token.kw->id : JBAS_KW_NOP;
+		if (t->type == JBAS_TOKEN_KEYWORD && (id == JBAS_KW_WHILE || id == JBAS_KW_IF || id == JBAS_KW_SELECT || id == JBAS_KW_PARALLEL))
+		{
+			jbas_token *t_end, *t_delim;
+			err = jbas_get_block_end(ctx->env, t, &t_end);
+			if (err) return err;
+			t_delim = jbas_opt_find_delimiter(t->r, t_end);
+			if (t_delim == t_end) return JBAS_SYNTAX_ERROR;
+
+			if (id == JBAS_KW_WHILE)
+			{
+				jbas_opt_loop l = {.kw = t, .end = t_end, .parent = loop, .first = ctx->stmt_count};
+				err = jbas_opt_push((void**) &ctx->loops, &ctx->loop_count, sizeof(l), &l);
+				if (err) return err;
+				int index = ctx->loop_count - 1;
+
+				// The condition is not a part of the preceding code region
+				err = jbas_opt_add_stmt(ctx, t->r, t_delim, index, false, true);
+				if (err) return err;
+				ctx->stmts[ctx->stmt_count - 1].region = -1;
+				err = jbas_opt_scan_block(ctx, t_delim->r, t_end, index, true);
+				if (err) return err;
+				ctx->loops[index].last = ctx->stmt_count - 1;
+			}
+			else if (id == JBAS_KW_PARALLEL)
+			{
+				// The body runs in other environments, any number of times
+				err = jbas_opt_add_stmt(ctx, t, t_delim, loop, top, false);
+				if (err) return err;
+				err = jbas_opt_scan_block(ctx, t_delim->r, t_end, loop, false);
+				if (err) return err;
+			}
+			else
+			{
+				// The condition (or the selector) ends the preceding code region
+				err = jbas_opt_add_stmt(ctx, t->r, t_delim, loop, top, true);
+				if (err) return err;
+				ctx->stmts[ctx->stmt_count - 1].kw = t;
+				err = jbas_opt_scan_block(ctx, t_delim->r, t_end, loop, false);
+				if (err) return err;
+			}
+
+			ctx->region++;
+			t = t_end;
+			continue;
+		}
+
+		// Ordinary instructions and other keywords
+		jbas_token *t_delim = jbas_opt_find_delimiter(t, end);
+		err = jbas_opt_add_stmt(ctx, t, t_delim, loop, top, t->type != JBAS_TOKEN_KEYWORD);
+		if (err) return err;
+		if (t->type == JBAS_TOKEN_KEYWORD) ctx->region++;
+		t = t_delim;
+	}
+
+	return JBAS_OK;
+}
+
+/**
+	Returns how many times the symbol is assigned inside the loop
+*/
+static int jbas_opt_assign_count(jbas_opt_ctx *ctx, int loop, jbas_symbol *sym)
+{
+	int n = 0;
+	for (int i = ctx->loops[loop].first; i <= ctx->loops[loop].last; i++)
+		for (int j = 0; j < ctx->stmts[i].assigned_count; j++)
+			n += ctx->stmts[i].assigned[j] == sym;
+	return n;
+}
+
+static bool jbas_opt_is_symbol(const jbas_expr *e)
+{
+	return e->type == JBAS_EXPR_OPERAND && e->token->type == JBAS_TOKEN_SYMBOL;
+}
+
+static bool jbas_opt_is_int(const jbas_expr *e)
+{
+	return e->type == JBAS_EXPR_OPERAND && e->token->type == JBAS_TOKEN_NUMBER
+		&& e->token->number_token.type == JBAS_NUM_INT;
+}
+
+/**
+	Looks for `i = i + k` or `i = i - k` instructions executed once per iteration.
+	The induction variable cannot be assigned anywhere else in the loop.
+*/
+static void jbas_opt_find_induction(jbas_opt_ctx *ctx, int loop)
+{
+	jbas_opt_loop *l = &ctx->loops[loop];
+	for (int i = l->first; i <= l->last; i++)
+	{
+		jbas_opt_stmt *s = &ctx->stmts[i];
+		if (s->loop != loop || !s->top || !s->is_expr) continue;
+
+		jbas_expr_tree tree;
+		if (jbas_expr_parse(&tree, s->begin, s->end, &ctx->env->tokens)) continue;
+
+		jbas_expr *e = tree.root;
+		if (!jbas_expr_is_assign(e) || !jbas_opt_is_symbol(e->a)) continue;
+		jbas_symbol *sym = e->a->token->symbol_token.sym;
+
+		jbas_expr *rhs = e->b;
+		if (rhs->type != JBAS_EXPR_BINARY || !jbas_opt_is_symbol(rhs->a) || !jbas_opt_is_int(rhs->b)) continue;
+		if (rhs->a->token->symbol_token.sym != sym) continue;
+
+		jbas_int k = rhs->b->token->number_token.i;
+		if (!strcmp(rhs->op->str, "-")) k = -k;
+		else if (strcmp(rhs->op->str, "+")) continue;
+
+		if (jbas_opt_assign_count(ctx, loop, sym) != 1) continue;
+		l->ivar = sym;
+		l->step = k;
+		l->ivar_stmt = i;
+		return;
+	}
+}
+
+/**
+	Returns true if the expression value does not change during loop execution
+*/
+static bool jbas_opt_is_invariant(jbas_opt_ctx *ctx, int loop, const jbas_expr *e)
+{
+	switch (e->type)
+	{
+		case JBAS_EXPR_OPERAND:
+			if (e->token->type == JBAS_TOKEN_NUMBER) return true;
+			if (e->token->type == JBAS_TOKEN_SYMBOL)
+			{
+				jbas_symbol *sym = e->token->symbol_token.sym;
+				if (sym->res && sym->res->type == JBAS_RESOURCE_CFUN) return false;
+				return !jbas_opt_assign_count(ctx, loop, sym);
+			}
+			return false;
+
+		// Memos created for outer loops do not change inside inner loops
+		case JBAS_EXPR_PAREN:
+			if (e->token->paren_token.memo) return true;
+			return e->a && jbas_opt_is_invariant(ctx, loop, e->a);
+
+		case JBAS_EXPR_UNARY:
+			return e->op->pure && jbas_opt_is_invariant(ctx, loop, e->a);
+
+		case JBAS_EXPR_BINARY:
+			return e->op->pure && jbas_opt_is_invariant(ctx, loop, e->a) && jbas_opt_is_invariant(ctx, loop, e->b);
+
+		default:
+			return false;
+	}
+}
+
+/**
+	Returns true if the expression is `i * c` where `i` is the loop's
+	induction variable and `c` is an invariant symbol or an integer.
+	The coefficient is returned through `coef`.
+*/
+static bool jbas_opt_is_induction(jbas_opt_ctx *ctx, int loop, const jbas_expr *e, jbas_token **coef)
+{
+	jbas_opt_loop *l = &ctx->loops[loop];
+	if (!(ctx->flags & JBAS_OPT_IND) || !l->ivar) return false;
+	if (e->type != JBAS_EXPR_BINARY || strcmp(e->op->str, "*")) return false;
+
+	for (int i = 0; i < 2; i++)
+	{
+		const jbas_expr *v = i ? e->b : e->a;
+		const jbas_expr *c = i ? e->a : e->b;
+		if (!jbas_opt_is_symbol(v) || v->token->symbol_token.sym != l->ivar) continue;
+		if (jbas_opt_is_int(c) || (jbas_opt_is_symbol(c) && jbas_opt_is_invariant(ctx, loop, c)))
+		{
+			*coef = c->token;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+	Attaches the memo to the expression. If the expression is not
+	in parentheses yet, it is wrapped in new ones.
+*/
+static jbas_error jbas_opt_wrap(jbas_opt_ctx *ctx, jbas_expr *e, jbas_memo *memo, jbas_token **paren)
+{
+	jbas_env *env = ctx->env;
+	jbas_token *p;
+
+	// Whole contents of parentheses - the parentheses can be used
+	if (e->type != JBAS_EXPR_PAREN && e->parent && e->parent->type == JBAS_EXPR_PAREN && e->parent->a == e)
+		e = e->parent;
+
+	if (e->type == JBAS_EXPR_PAREN)
+	{
+		p = e->token;
+	}
+	else
+	{
+		jbas_error err = jbas_token_pool_get(&env->token_pool, &p);
+		if (err) return err;
+		p->type = JBAS_TOKEN_PAREN;
+		p->paren_token.tokens = e->begin;
+
+		// Relink
+		p->l = e->begin->l;
+		p->r = e->end->r;
+		if (p->l) p->l->r = p;
+		if (p->r) p->r->l = p;
+		e->begin->l = NULL;
+		e->end->r = NULL;
+
+		// Update handles pointing into the wrapped expression
+		for (jbas_token *t = e->begin; t; t = t->r)
+			if (*e->list == t)
+				*e->list = p;
+		for (int i = 0; i < ctx->stmt_count; i++)
+			if (ctx->stmts[i].begin == e->begin)
+				ctx->stmts[i].begin = p;
+	}
+
+	p->paren_token.memo = memo;
+	*paren = p;
+	return JBAS_OK;
+}
+
+/**
+	Looks for a memo parentheses with contents equal to the expression
+*/
+static jbas_memo *jbas_opt_find_memo(jbas_opt_ctx *ctx, jbas_token **parens, int count, const jbas_expr *e)
+{
+	for (int i = 0; i < count; i++)
+	{
+		jbas_token **list = &parens[i]->paren_token.tokens;
+		if (jbas_expr_parse(ctx->tree, jbas_token_list_begin(*list), NULL, list)) continue;
+		if (jbas_expr_equal(ctx->tree->root, e))
+			return parens[i]->paren_token.memo;
+	}
+
+	return NULL;
+}
+
+static void jbas_opt_report_memo(jbas_opt_ctx *ctx, const char *prefix, const char *what, jbas_expr *e, jbas_memo *memo)
+{
+	if (!ctx->report) return;
+	fprintf(ctx->report, "opt: %s: %s `", prefix, what);
+	jbas_debug_print_code(ctx->report, e->begin, e->end->r);
+	fprintf(ctx->report, "` as $m%d\n", jbas_memo_id(&ctx->env->memo_manager, memo));
+}
+
+/**
+	Moves the expression out of the loop. If `coef` is not NULL,
+	the expression is an induction product updated by $STEP.
+	Identical expressions share the same memo.
+*/
+static jbas_error jbas_opt_hoist(jbas_opt_ctx *ctx, int loop, jbas_expr *e, jbas_token *coef)
+{
+	jbas_opt_loop *l = &ctx->loops[loop];
+	jbas_error err;
+	jbas_token *p;
+
+	jbas_memo *memo = jbas_opt_find_memo(ctx, l->memos, l->memo_count, e);
+	bool reused = memo != NULL;
+	if (!memo)
+	{
+		err = jbas_memo_create(&ctx->env->memo_manager, &memo);
+		if (err) return err;
+	}
+
+	char prefix[32];
+	snprintf(prefix, sizeof(prefix), "WHILE #%d", loop + 1);
+	jbas_opt_report_memo(ctx, prefix, coef ? "strength-reduced" : "hoisted", e, memo);
+
+	err = jbas_opt_wrap(ctx, e, memo, &p);
+	if (err || reused) return err;
+
+	// The memo has to be invalidated before each loop entry
+	err = jbas_opt_push((void**) &l->memos, &l->memo_count, sizeof(p), &p);
+	if (err || !coef) return err;
+	err = jbas_opt_push((void**) &l->steps, &l->step_count, sizeof(p), &p);
+	if (err) return err;
+	return jbas_opt_push((void**) &l->steps, &l->step_count, sizeof(coef), &coef);
+}
+
+/**
+	Looks for largest invariant subexpressions and induction expressions
+*/
+static jbas_error jbas_opt_licm_visit(jbas_opt_ctx *ctx, int loop, jbas_expr *e)
+{
+	jbas_error err;
+	jbas_token *coef;
+	if (!e) return JBAS_OK;
+
+	// Nothing is moved out of tuples, their parts are taken apart by the assignment
+	if (jbas_expr_is_tuple(e)) return JBAS_OK;
+
+	switch (e->type)
+	{
+		case JBAS_EXPR_PAREN:
+			if (e->token->paren_token.memo) return JBAS_OK;
+			if (jbas_expr_is_tuple(e->a)) return JBAS_OK;
+			if (e->a && (e->a->type == JBAS_EXPR_BINARY || e->a->type == JBAS_EXPR_UNARY))
+			{
+				if ((ctx->flags & JBAS_OPT_LICM) && jbas_opt_is_invariant(ctx, loop, e->a))
+					return jbas_opt_hoist(ctx, loop, e, NULL);
+			}
+			return jbas_opt_licm_visit(ctx, loop, e->a);
+
+		case JBAS_EXPR_BINARY:
+			// Assignment target is not a value (but array index is)
+			if (jbas_expr_is_assign(e))
+			{
+				if (e->a->type == JBAS_EXPR_CALL)
+				{
+					err = jbas_opt_licm_visit(ctx, loop, e->a->b);
+					if (err) return err;
+				}
+				return jbas_opt_licm_visit(ctx, loop, e->b);
+			}
+
+			if ((ctx->flags & JBAS_OPT_LICM) && e->op->pure && jbas_opt_is_invariant(ctx, loop, e))
+				return jbas_opt_hoist(ctx, loop, e, NULL);
+
+			if (jbas_opt_is_induction(ctx, loop, e, &coef))
+				return jbas_opt_hoist(ctx, loop, e, coef);
+
+			err = jbas_opt_licm_visit(ctx, loop, e->a);
+			if (err) return err;
+			return jbas_opt_licm_visit(ctx, loop, e->b);
+
+		case JBAS_EXPR_UNARY:
+			return jbas_opt_licm_visit(ctx, loop, e->a);
+
+		case JBAS_EXPR_CALL:
+			return jbas_opt_licm_visit(ctx, loop, e->b);
+
+		default:
+			return JBAS_OK;
+	}
+}
+
+/**
+	Inserts a token after `*after` and updates the pointer
+*/
+static jbas_error jbas_opt_insert(jbas_opt_ctx *ctx, jbas_token **after, jbas_token token)
+{
+	return jbas_token_list_insert_from_pool(*after, &ctx->env->token_pool, &token, after);
+}
+
+static const jbas_keyword *jbas_opt_keyword(jbas_keyword_id id)
+{
+	for (int i = 0; i < JBAS_KEYWORD_COUNT; i++)
+		if (jbas_keywords[i].id == id)
+			return &jbas_keywords[i];
+	return NULL;
+}
+
+/**
+	Creates a parentheses token referencing the same memo
+*/
+static jbas_token jbas_opt_memo_ref(jbas_token *p)
+{
+	jbas_token t = {.type = JBAS_TOKEN_PAREN};
+	t.paren_token.tokens = NULL;
+	t.paren_token.memo = p->paren_token.memo;
+	return t;
+}
+
+/**
+	Hoists invariant subexpressions out of the loop and replaces
+	induction expressions with incrementally updated values
+*/
+static jbas_error jbas_opt_licm(jbas_opt_ctx *ctx, int loop)
+{
+	jbas_error err;
+	jbas_env *env = ctx->env;
+	jbas_opt_loop *l = &ctx->loops[loop];
+
+	for (int i = l->first; i <= l->last; i++)
+	{
+		jbas_opt_stmt *s = &ctx->stmts[i];
+		if (!s->is_expr) continue;
+
+		jbas_expr_tree tree;
+		if (jbas_expr_parse(&tree, s->begin, s->end, &env->tokens)) continue;
+		err = jbas_opt_licm_visit(ctx, loop, tree.root);
+		if (err) return err;
+	}
+
+	l = &ctx->loops[loop];
+	if (!l->memo_count) return JBAS_OK;
+
+	// $INVALIDATE in front of the loop (the inserted instructions are profiled as the loop's line)
+	jbas_token kw = {.type = JBAS_TOKEN_KEYWORD, .line = l->kw->line};
+	kw.keyword_token.kw = jbas_opt_keyword(JBAS_KW_INVALIDATE);
+	jbas_token *t;
+	err = jbas_token_list_insert_before_from_pool(l->kw, &env->token_pool, &kw, &t);
+	if (err) return err;
+	for (int i = 0; i < l->memo_count; i++)
+	{
+		err = jbas_opt_insert(ctx, &t, jbas_opt_memo_ref(l->memos[i]));
+		if (err) return err;
+	}
+	err = jbas_opt_insert(ctx, &t, (jbas_token){.type = JBAS_TOKEN_DELIMITER});
+	if (err) return err;
+
+	// $STEP after the induction variable increment
+	t = ctx->stmts[l->ivar_stmt].end;
+	for (int i = 0; i < l->step_count; i += 2)
+	{
+		jbas_token step = {.type = JBAS_TOKEN_NUMBER, .number_token = {.type = JBAS_NUM_INT, .i = l->step}};
+		kw.keyword_token.kw = jbas_opt_keyword(JBAS_KW_STEP);
+		err = jbas_opt_insert(ctx, &t, kw);
+		if (!err) err = jbas_opt_insert(ctx, &t, jbas_opt_memo_ref(l->steps[i]));
+		if (!err) err = jbas_opt_insert(ctx, &t, step);
+		if (!err) err = jbas_opt_insert(ctx, &t, *l->steps[i + 1]);
+		if (!err) err = jbas_opt_insert(ctx, &t, (jbas_token){.type = JBAS_TOKEN_DELIMITER});
+		if (err) return err;
+	}
+
+	return JBAS_OK;
+}
+
+/**
+	Instruction analyzed for common subexpression elimination
+*/
+typedef struct jbas_opt_cse_stmt
+{
+	jbas_expr_tree tree;
+	bool parsed;
+	bool barrier;            //!< May call a C function (which can do anything)
+	bool late;               //!< All assignments happen after the rest is evaluated
+	jbas_symbol **kills;     //!< Symbols assigned (or array elements written)
+	int kill_count;
+	bool chosen[JBAS_EXPR_MAX_NODES]; //!< Nodes replaced with memos
+} jbas_opt_cse_stmt;
+
+/**
+	Occurrence of a subexpression in a code region
+*/
+typedef struct jbas_opt_occ
+{
+	jbas_expr *e;
+	int stmt;          //!< Instruction index in the region
+	unsigned int hash;
+	int size;
+	int epoch;         //!< Instruction since which all operands remain unchanged
+	int group;         //!< First equal occurrence in the same epoch
+} jbas_opt_occ;
+
+static int jbas_opt_sym_index(jbas_opt_ctx *ctx, jbas_symbol *sym)
+{
+	return sym - ctx->env->symbol_manager.symbol_storage;
+}
+
+/**
+	True if the symbol is an array that is never rebound, so reading
+	its elements has no side effects and only array writes change it
+*/
+static bool jbas_opt_is_array(jbas_opt_ctx *ctx, jbas_symbol *sym)
+{
+	if (sym->res && sym->res->type == JBAS_RESOURCE_CFUN) return false;
+	return ctx->sym_flags[jbas_opt_sym_index(ctx, sym)] == JBAS_OPT_SYM_DIM;
+}
+
+static bool jbas_opt_is_array_read(jbas_opt_ctx *ctx, const jbas_expr *e)
+{
+	return e->type == JBAS_EXPR_CALL && jbas_opt_is_symbol(e->a)
+		&& jbas_opt_is_array(ctx, e->a->token->symbol_token.sym);
+}
+
+/**
+	True if the expression always evaluates to the same number
+	unless one of its symbols (or array elements) changes
+*/
+static bool jbas_opt_is_pure(jbas_opt_ctx *ctx, const jbas_expr *e)
+{
+	switch (e->type)
+	{
+		case JBAS_EXPR_OPERAND:
+			if (e->token->type == JBAS_TOKEN_NUMBER) return true;
+			if (e->token->type == JBAS_TOKEN_SYMBOL)
+			{
+				jbas_symbol *sym = e->token->symbol_token.sym;
+				return !sym->res || sym->res->type != JBAS_RESOURCE_CFUN;
+			}
+			return false;
+
+		case JBAS_EXPR_PAREN:
+			if (e->token->paren_token.memo) return true;
+			return e->a && jbas_opt_is_pure(ctx, e->a);
+
+		case JBAS_EXPR_UNARY:
+			return e->op->pure && jbas_opt_is_pure(ctx, e->a);
+
+		case JBAS_EXPR_BINARY:
+			return e->op->pure && jbas_opt_is_pure(ctx, e->a) && jbas_opt_is_pure(ctx, e->b);
+
+		case JBAS_EXPR_CALL:
+			return jbas_opt_is_array_read(ctx, e) && e->b && jbas_opt_is_pure(ctx, e->b);
+	}
+
+	return false;
+}
+
+/**
+	True if any symbol in the expression is in the list
+*/
+static bool jbas_opt_uses_any(const jbas_expr *e, jbas_symbol **syms, int count)
+{
+	if (!e || !count) return false;
+	if (e->type == JBAS_EXPR_OPERAND && e->token->type == JBAS_TOKEN_SYMBOL)
+		for (int i = 0; i < count; i++)
+			if (syms[i] == e->token->symbol_token.sym)
+				return true;
+	return jbas_opt_uses_any(e->a, syms, count) || jbas_opt_uses_any(e->b, syms, count);
+}
+
+static jbas_error jbas_opt_add_kill(jbas_opt_cse_stmt *cs, jbas_symbol *sym)
+{
+	return jbas_opt_push((void**) &cs->kills, &cs->kill_count, sizeof(sym), &sym);
+}
+
+static jbas_error jbas_opt_kill_all(jbas_opt_cse_stmt *cs, const jbas_expr *e)
+{
+	jbas_error err = JBAS_OK;
+	if (!e) return err;
+	if (e->type == JBAS_EXPR_OPERAND && e->token->type == JBAS_TOKEN_SYMBOL)
+		err = jbas_opt_add_kill(cs, e->token->symbol_token.sym);
+	if (!err) err = jbas_opt_kill_all(cs, e->a);
+	if (!err) err = jbas_opt_kill_all(cs, e->b);
+	return err;
+}
+
+/**
+	Finds out what the instruction changes
+*/
+static jbas_error jbas_opt_cse_analyze(jbas_opt_ctx *ctx, jbas_opt_stmt *s, jbas_opt_cse_stmt *cs)
+{
+	jbas_error err;
+	cs->parsed = !jbas_expr_parse(&cs->tree, s->begin, s->end, &ctx->env->tokens);
+	cs->barrier = !cs->parsed;
+	if (!cs->parsed) return JBAS_OK;
+
+	int assign_count = 0;
+	for (int i = 0; i < cs->tree.node_count; i++)
+	{
+		jbas_expr *e = &cs->tree.nodes[i];
+
+		// Calls to anything but arrays
+		if (e->type == JBAS_EXPR_CALL && !jbas_opt_is_array_read(ctx, e))
+			cs->barrier = true;
+
+		if (!jbas_expr_is_assign(e)) continue;
+		assign_count++;
+		if (jbas_opt_is_symbol(e->a))
+			err = jbas_opt_add_kill(cs, e->a->token->symbol_token.sym);
+		else if (e->a->type == JBAS_EXPR_CALL && jbas_opt_is_symbol(e->a->a))
+			err = jbas_opt_add_kill(cs, e->a->a->token->symbol_token.sym);
+		else
+			err = jbas_opt_kill_all(cs, e->a);
+		if (err) return err;
+	}
+
+	cs->late = !assign_count || (assign_count == 1 && jbas_expr_is_assign(cs->tree.root));
+	return JBAS_OK;
+}
+
+/**
+	True if the node is inside a memo parentheses or a node that has been replaced
+*/
+static bool jbas_opt_cse_covered(jbas_opt_cse_stmt *cs, const jbas_expr *e)
+{
+	for (const jbas_expr *p = e; p; p = p->parent)
+	{
+		if (cs->chosen[p - cs->tree.nodes]) return true;
+		if (p != e && p->type == JBAS_EXPR_PAREN && p->token->paren_token.memo) return true;
+	}
+	return false;
+}
+
+/**
+	True if the node is a part of a tuple
+*/
+static bool jbas_opt_in_tuple(const jbas_expr *e)
+{
+	for (const jbas_expr *p = e->parent; p; p = p->parent)
+		if (jbas_expr_is_tuple(p)) return true;
+	return false;
+}
+
+static int jbas_opt_occ_cmp(const void *a, const void *b)
+{
+	const jbas_opt_occ *o1 = *(const jbas_opt_occ**) a;
+	const jbas_opt_occ *o2 = *(const jbas_opt_occ**) b;
+	if (o1->size != o2->size) return o2->size - o1->size;
+	return o1 < o2 ? -1 : o1 > o2;
+}
+
+/**
+	Eliminates common subexpressions in a straight-line code region.
+	Repeated expressions share a memo, which is invalidated at the
+	beginning of the region. An instruction assigning to a symbol
+	ends lifetime of all memos depending on it. C function calls end
+	lifetime of all memos.
+*/
+static jbas_error jbas_opt_cse_region(jbas_opt_ctx *ctx, int *stmts, int count)
+{
+	jbas_error err = JBAS_OK;
+	jbas_opt_cse_stmt *cs = calloc(count, sizeof(*cs));
+	jbas_opt_occ *occs = NULL, **order = NULL;
+	jbas_token **memos = NULL;
+	int occ_count = 0, memo_count = 0;
+	if (!cs) return JBAS_ALLOC;
+
+	for (int k = 0; k < count && !err; k++)
+		err = jbas_opt_cse_analyze(ctx, &ctx->stmts[stmts[k]], &cs[k]);
+
+	// Collect pure subexpressions
+	for (int k = 0; k < count && !err; k++)
+	{
+		if (cs[k].barrier) continue;
+		for (int i = 0; i < cs[k].tree.node_count && !err; i++)
+		{
+			jbas_expr *e = &cs[k].tree.nodes[i];
+
+			// Operations and array reads that are operands of other operations
+			bool candidate = e->type == JBAS_EXPR_BINARY
+				|| (jbas_opt_is_array_read(ctx, e) && e->parent
+					&& e->parent->type == JBAS_EXPR_BINARY && e->parent->op->pure);
+			if (!candidate || !jbas_opt_is_pure(ctx, e) || jbas_opt_in_tuple(e) || jbas_opt_cse_covered(&cs[k], e)) continue;
+
+			// Operands changed in the middle of the instruction
+			if (!cs[k].late && jbas_opt_uses_any(e, cs[k].kills, cs[k].kill_count)) continue;
+
+			jbas_opt_occ o = {.e = e, .stmt = k, .hash = jbas_expr_hash(e), .size = jbas_expr_size(e), .group = occ_count};
+			for (o.epoch = k; o.epoch > 0; o.epoch--)
+			{
+				jbas_opt_cse_stmt *prev = &cs[o.epoch - 1];
+				if (prev->barrier || jbas_opt_uses_any(e, prev->kills, prev->kill_count)) break;
+			}
+
+			for (int j = 0; j < occ_count; j++)
+				if (occs[j].hash == o.hash && occs[j].epoch == o.epoch && jbas_expr_equal(occs[j].e, e))
+				{
+					o.group = occs[j].group;
+					break;
+				}
+
+			err = jbas_opt_push((void**) &occs, &occ_count, sizeof(o), &o);
+		}
+	}
+
+	// Largest expressions first
+	if (!err && occ_count)
+	{
+		order = malloc(occ_count * sizeof(*order));
+		if (!order) err = JBAS_ALLOC;
+		for (int i = 0; i < occ_count && !err; i++)
+			order[i] = &occs[i];
+		if (!err) qsort(order, occ_count, sizeof(*order), jbas_opt_occ_cmp);
+	}
+
+	for (int i = 0; i < occ_count && !err; i++)
+	{
+		jbas_opt_occ *leader = order[i];
+		if (leader->group != leader - occs) continue;
+
+		// Count occurrences that are still evaluated
+		int n = 0;
+		for (int j = leader - occs; j < occ_count; j++)
+			n += occs[j].group == leader->group && !jbas_opt_cse_covered(&cs[occs[j].stmt], occs[j].e);
+		if (n < 2) continue;
+
+		jbas_memo *memo;
+		err = jbas_memo_create(&ctx->env->memo_manager, &memo);
+		if (err) break;
+
+		char prefix[32];
+		snprintf(prefix, sizeof(prefix), "CSE x%d", n);
+		jbas_opt_report_memo(ctx, prefix, "shared", leader->e, memo);
+
+		for (int j = leader - occs; j < occ_count && !err; j++)
+		{
+			jbas_opt_occ *o = &occs[j];
+			if (o->group != leader->group || jbas_opt_cse_covered(&cs[o->stmt], o->e)) continue;
+
+			jbas_token *p;
+			err = jbas_opt_wrap(ctx, o->e, memo, &p);
+			cs[o->stmt].chosen[o->e - cs[o->stmt].tree.nodes] = true;
+			if (!err && j == leader - occs)
+				err = jbas_opt_push((void**) &memos, &memo_count, sizeof(p), &p);
+		}
+	}
+
+	// $INVALIDATE at the beginning of the region
+	if (!err && memo_count)
+	{
+		jbas_opt_stmt *first = &ctx->stmts[stmts[0]];
+		jbas_token *at = first->kw ? first->kw : first->begin;
+		jbas_token kw = {.type = JBAS_TOKEN_KEYWORD, .line = at->line}, *t;
+		kw.keyword_token.kw = jbas_opt_keyword(JBAS_KW_INVALIDATE);
+		err = jbas_token_list_insert_before_from_pool(at, &ctx->env->token_pool, &kw, &t);
+		for (int i = 0; i < memo_count && !err; i++)
+			err = jbas_opt_insert(ctx, &t, jbas_opt_memo_ref(memos[i]));
+		if (!err) err = jbas_opt_insert(ctx, &t, (jbas_token){.type = JBAS_TOKEN_DELIMITER});
+	}
+
+	for (int k = 0; k < count; k++)
+		free(cs[k].kills);
+	free(cs);
+	free(occs);
+	free(order);
+	free(memos);
+	return err;
+}
+
+/**
+	Runs CSE on all straight-line code regions
+*/
+static jbas_error jbas_opt_cse(jbas_opt_ctx *ctx)
+{
+	jbas_error err = JBAS_OK;
+	int *stmts = malloc((ctx->stmt_count + 1) * sizeof(int));
+	if (!stmts) return JBAS_ALLOC;
+
+	for (int i = 0; i < ctx->stmt_count && !err; )
+	{
+		int region = ctx->stmts[i].region, count = 0;
+		if (region < 0)
+		{
+			i++;
+			continue;
+		}
+
+		while (i < ctx->stmt_count && ctx->stmts[i].region == region)
+			stmts[count++] = i++;
+		err = jbas_opt_cse_region(ctx, stmts, count);
+	}
+
+	free(stmts);
+	return err;
+}
+
+/**
+	Finds out which symbols are arrays and which are assigned
+*/
+static jbas_error jbas_opt_find_symbol_flags(jbas_opt_ctx *ctx)
+{
+	ctx->sym_flags = calloc(ctx->env->symbol_manager.max_count, 1);
+	if (!ctx->sym_flags) return JBAS_ALLOC;
+
+	for (int i = 0; i < ctx->stmt_count; i++)
+	{
+		jbas_opt_stmt *s = &ctx->stmts[i];
+		for (int j = 0; j < s->assigned_count; j++)
+			ctx->sym_flags[jbas_opt_sym_index(ctx, s->assigned[j])] |= s->is_expr ? JBAS_OPT_SYM_BOUND : JBAS_OPT_SYM_DIM;
+	}
+
+	return JBAS_OK;
+}
+
+/**
+	Array access with bounds checked in front of the loop
+*/
+typedef struct jbas_opt_access
+{
+	int phase;         //!< Index evaluated before (0) or after (1) the increment or in the condition (2)
+	jbas_token *array; //!< Array symbol
+	jbas_token *call;  //!< Call parentheses
+} jbas_opt_access;
+
+/**
+	True if the expression is an affine function of the loop counter
+	with loop-invariant integer coefficients. `dep` is set if it
+	depends on the counter.
+*/
+static bool jbas_opt_is_affine(jbas_opt_ctx *ctx, int loop, const jbas_expr *e, bool *dep)
+{
+	bool dep_a, dep_b;
+	*dep = false;
+
+	switch (e->type)
+	{
+		case JBAS_EXPR_OPERAND:
+			if (jbas_opt_is_int(e)) return true;
+			if (!jbas_opt_is_symbol(e)) return false;
+			if (e->token->symbol_token.sym == ctx->loops[loop].ivar) return *dep = true;
+			return jbas_opt_is_invariant(ctx, loop, e);
+
+		// Memos are ignored - contents are evaluated by $CHECK
+		case JBAS_EXPR_PAREN:
+			return e->a && jbas_opt_is_affine(ctx, loop, e->a, dep);
+
+		case JBAS_EXPR_UNARY:
+			return !strcmp(e->op->str, "-") && jbas_opt_is_affine(ctx, loop, e->a, dep);
+
+		case JBAS_EXPR_BINARY:
+			if (strcmp(e->op->str, "+") && strcmp(e->op->str, "-") && strcmp(e->op->str, "*")) return false;
+			if (!jbas_opt_is_affine(ctx, loop, e->a, &dep_a) || !jbas_opt_is_affine(ctx, loop, e->b, &dep_b)) return false;
+			if (dep_a && dep_b && !strcmp(e->op->str, "*")) return false;
+			*dep = dep_a || dep_b;
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+/**
+	Creates parentheses token containing copy of tokens [begin, end)
+*/
+static jbas_error jbas_opt_copy_paren(jbas_opt_ctx *ctx, jbas_token *begin, jbas_token *end, jbas_memo *memo, jbas_token *paren)
+{
+	jbas_token_pool *pool = &ctx->env->token_pool;
+	*paren = (jbas_token){.type = JBAS_TOKEN_PAREN};
+	paren->paren_token.tokens = NULL;
+	paren->paren_token.memo = memo;
+
+	for (jbas_token *t = begin; t && t != end; t = t->r)
+	{
+		jbas_token u = {.type = JBAS_TOKEN_DELIMITER};
+		jbas_error err = jbas_token_copy(&u, t, pool);
+		if (err) return err;
+		err = jbas_token_list_push_back_from_pool(paren->paren_token.tokens, pool, &u, &paren->paren_token.tokens);
+		if (err) return err;
+	}
+
+	return JBAS_OK;
+}
+
+/**
+	Looks for array accesses with indices that are affine functions of the
+	loop counter. Their range is checked once by $CHECK in front of the loop
+	and if it's fine, the checks are skipped inside the loop.
+*/
+static jbas_error jbas_opt_bounds(jbas_opt_ctx *ctx, int loop)
+{
+	jbas_opt_loop *l = &ctx->loops[loop];
+	jbas_env *env = ctx->env;
+	jbas_error err;
+	bool dep;
+	if (!l->ivar) return JBAS_OK;
+
+	// `WHILE i cmp n` with invariant `n`
+	jbas_expr_tree *cond = ctx->tree;
+	jbas_opt_stmt *s = &ctx->stmts[l->first];
+	if (jbas_expr_parse(cond, s->begin, s->end, &env->tokens)) return JBAS_OK;
+	jbas_expr *root = cond->root, *bound;
+	if (root->type != JBAS_EXPR_BINARY) return JBAS_OK;
+
+	const char *cmp = root->op->str;
+	if (jbas_opt_is_symbol(root->a) && root->a->token->symbol_token.sym == l->ivar)
+		bound = root->b;
+	else if (jbas_opt_is_symbol(root->b) && root->b->token->symbol_token.sym == l->ivar)
+	{
+		bound = root->a;
+		if (!strcmp(cmp, "<")) cmp = ">";
+		else if (!strcmp(cmp, ">")) cmp = "<";
+		else if (!strcmp(cmp, "<=")) cmp = ">=";
+		else if (!strcmp(cmp, ">=")) cmp = "<=";
+	}
+	else
+		return JBAS_OK;
+
+	if (l->step > 0 && strcmp(cmp, "<") && strcmp(cmp, "<=")) return JBAS_OK;
+	if (l->step < 0 && strcmp(cmp, ">") && strcmp(cmp, ">=")) return JBAS_OK;
+	if (!jbas_opt_is_affine(ctx, loop, bound, &dep) || dep) return JBAS_OK;
+
+	// Accesses to be checked
+	jbas_opt_access *acc = NULL;
+	int acc_count = 0;
+	err = JBAS_OK;
+	for (int i = l->first; i <= l->last && !err; i++)
+	{
+		s = &ctx->stmts[i];
+		if (!s->is_expr || i == l->ivar_stmt) continue;
+
+		jbas_expr_tree tree;
+		if (jbas_expr_parse(&tree, s->begin, s->end, &env->tokens)) continue;
+
+		for (int j = 0; j < tree.node_count && !err; j++)
+		{
+			jbas_expr *e = &tree.nodes[j];
+			if (e->type != JBAS_EXPR_CALL || !e->b || e->token->paren_token.memo) continue;
+			if (!jbas_opt_is_array_read(ctx, e) || !jbas_opt_is_invariant(ctx, loop, e->a)) continue;
+			if (!jbas_opt_is_affine(ctx, loop, e->b, &dep)) continue;
+
+			jbas_memo *memo;
+			err = jbas_memo_create(&env->memo_manager, &memo);
+			if (err) break;
+			memo->kind = JBAS_MEMO_BOUNDS;
+			e->token->paren_token.memo = memo;
+
+			char prefix[32];
+			snprintf(prefix, sizeof(prefix), "WHILE #%d", loop + 1);
+			jbas_opt_report_memo(ctx, prefix, "bounds checked on entry for", e, memo);
+
+			jbas_opt_access a = {.phase = i == l->first ? 2 : i > l->ivar_stmt, .array = e->a->token, .call = e->token};
+			err = jbas_opt_push((void**) &acc, &acc_count, sizeof(a), &a);
+		}
+	}
+
+	// $CHECK i step cmp (n) [phase array (index)]...
+	if (!err && acc_count)
+	{
+		jbas_token kw = {.type = JBAS_TOKEN_KEYWORD, .line = l->kw->line}, *t, paren;
+		kw.keyword_token.kw = jbas_opt_keyword(JBAS_KW_CHECK);
+		jbas_token ivar = {.type = JBAS_TOKEN_SYMBOL, .symbol_token = {.sym = l->ivar}};
+		jbas_token step = {.type = JBAS_TOKEN_NUMBER, .number_token = {.type = JBAS_NUM_INT, .i = l->step}};
+		jbas_token op = {.type = JBAS_TOKEN_OPERATOR, .operator_token = {.op = jbas_get_operator_by_str(cmp, cmp + strlen(cmp))}};
+
+		err = jbas_token_list_insert_before_from_pool(l->kw, &env->token_pool, &kw, &t);
+		if (!err) err = jbas_opt_insert(ctx, &t, ivar);
+		if (!err) err = jbas_opt_insert(ctx, &t, step);
+		if (!err) err = jbas_opt_insert(ctx, &t, op);
+		if (!err) err = jbas_opt_copy_paren(ctx, bound->begin, bound->end->r, NULL, &paren);
+		if (!err) err = jbas_opt_insert(ctx, &t, paren);
+
+		for (int i = 0; i < acc_count && !err; i++)
+		{
+			jbas_token phase = {.type = JBAS_TOKEN_NUMBER, .number_token = {.type = JBAS_NUM_INT, .i = acc[i].phase}};
+			jbas_token *call = acc[i].call;
+			err = jbas_opt_insert(ctx, &t, phase);
+			if (!err) err = jbas_opt_insert(ctx, &t, *acc[i].array);
+			if (!err) err = jbas_opt_copy_paren(ctx, jbas_token_list_begin(call->paren_token.tokens), NULL, call->paren_token.memo, &paren);
+			if (!err) err = jbas_opt_insert(ctx, &t, paren);
+		}
+
+		if (!err) err = jbas_opt_insert(ctx, &t, (jbas_token){.type = JBAS_TOKEN_DELIMITER});
+	}
+
+	free(acc);
+	return err;
+}
+
+/**
+	Optimizes the loaded program
+*/
+jbas_error jbas_optimize(jbas_env *env, int flags, FILE *report)
+{
+	jbas_opt_ctx ctx = {.env = env, .flags = flags, .report = report};
+	jbas_error err;
+
+	ctx.tree = malloc(sizeof(*ctx.tree));
+	if (!ctx.tree) return JBAS_ALLOC;
+
+	// If the program structure is broken, leave it as is.
+	// The error will be reported when it's run.
+	err = jbas_opt_scan_block(&ctx, jbas_token_list_begin(env->tokens), NULL, -1, false);
+	if (err && err != JBAS_ALLOC) err = JBAS_OK;
+	else if (!err)
+	{
+		// Outer loops first - memos created there are invariant in inner loops
+		for (int i = 0; i < ctx.loop_count && !err; i++)
+		{
+			jbas_opt_find_induction(&ctx, i);
+			if (flags & (JBAS_OPT_LICM | JBAS_OPT_IND))
+				err = jbas_opt_licm(&ctx, i);
+		}
+
+		// Hoisted memos are treated as constants by CSE
+		if (!err) err = jbas_opt_find_symbol_flags(&ctx);
+		if (!err && (flags & JBAS_OPT_CSE))
+			err = jbas_opt_cse(&ctx);
+		for (int i = 0; i < ctx.loop_count && !err && (flags & JBAS_OPT_BOUNDS); i++)
+			err = jbas_opt_bounds(&ctx, i);
+	}
+
+	for (int i = 0; i < ctx.stmt_count; i++)
+		free(ctx.stmts[i].assigned);
+	for (int i = 0; i < ctx.loop_count; i++)
+	{
+		free(ctx.loops[i].memos);
+		free(ctx.loops[i].steps);
+	}
+	free(ctx.stmts);
+	free(ctx.loops);
+	free(ctx.sym_flags);
+	free(ctx.tree);
+	return err;
+}
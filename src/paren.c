@@ -1,5 +1,7 @@
 #include <jbasic/paren.h>
 #include <jbasic/jbasic.h>
+#include <jbasic/cast.h>
+#include <jbasic/memo.h>
 
 bool jbas_is_paren(const jbas_token *t)
 {
@@ -26,6 +28,15 @@ jbas_error jbas_eval_paren(jbas_env *env, jbas_token *t)
 
 	if (!t || t->type != JBAS_TOKEN_PAREN) return JBAS_OK;
 
+	// Use the cached value if it's still valid
+	jbas_memo *memo = t->paren_token.memo;
+	if (memo && memo->kind != JBAS_MEMO_VALUE) memo = NULL;
+	if (memo && memo->valid)
+	{
+		jbas_token nt = {.type = JBAS_TOKEN_NUMBER, .number_token = memo->value};
+		return jbas_token_move(t, &nt, &env->token_pool);
+	}
+
 	// Evaluate contents
 	err = jbas_eval(env, jbas_token_list_begin(t->paren_token.tokens), &res);
 	if (err) return err;
@@ -34,7 +45,25 @@ jbas_error jbas_eval_paren(jbas_env *env, jbas_token *t)
 	// Ingenious workaround <3
 	if (res)
 	{
-		return jbas_token_move(t, res, &env->token_pool);
+		// The evaluation may have returned the token the list handle
+		// pointed to to the pool, the result is still in the list
+		t->paren_token.tokens = res;
+		err = jbas_token_move(t, res, &env->token_pool);
+		if (err) return err;
+
+		// Store the value in the memo
+		if (memo)
+		{
+			err = jbas_to_value(env, t);
+			if (err) return err;
+			if (t->type == JBAS_TOKEN_NUMBER)
+			{
+				memo->value = t->number_token;
+				memo->valid = true;
+			}
+		}
+
+		return JBAS_OK;
 	}
 	{
 		jbas_token zero = {.type = JBAS_TOKEN_NUMBER, .number_token = {.type = JBAS_NUM_INT, .i = 0}};
@@ -0,0 +1,616 @@
+#include <jbasic/pool.h>
+#include <jbasic/jbasic.h>
+#include <jbasic/cast.h>
+
+#ifndef JBAS_STATIC
+#include <jbasic/image.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+/**
+	A pool thread with its own environment holding a copy of the program
+*/
+typedef struct jbas_pool_worker
+{
+	struct jbas_pool *pool;
+	jbas_env env;
+	pthread_t thread;
+	bool started;
+
+	pthread_mutex_t lock; //!< Guards the range
+	int64_t lo, hi;       //!< Iterations left - [lo, hi)
+
+	jbas_parallel *par;   //!< The loop in the worker's program
+	jbas_symbol **map;    //!< Main environment symbol slots to the worker's symbols
+	void **borrowed;      //!< Array buffers of the main environment (sorted)
+	int borrowed_count;
+	jbas_error err;
+	const char *error_reason;
+} jbas_pool_worker;
+
+struct jbas_pool
+{
+	jbas_env *env;
+	jbas_pool_worker *workers;
+	int count;
+
+	pthread_mutex_t lock;
+	pthread_cond_t start, done;
+	unsigned generation; //!< Incremented for every job
+	int running;         //!< Threads still working on the job
+	bool quit;
+
+	jbas_parallel *par;  //!< Current loop in the main program
+	int64_t grain;       //!< Iterations taken at once
+	atomic_bool failed;
+};
+#endif
+
+/**
+	Binds a number to a symbol. A resource shared with other symbols
+	is left alone and a new one is created.
+*/
+static jbas_error jbas_pool_set_number(jbas_env *env, jbas_symbol *sym, jbas_number_token num)
+{
+	if (!sym->res || sym->res->type != JBAS_RESOURCE_NUMBER || sym->res->ref_count != 1)
+	{
+		jbas_resource_remove_ref(sym->res);
+		sym->res = NULL;
+		jbas_error err = jbas_resource_create(&env->resource_manager, &sym->res);
+		if (err) return err;
+		sym->res->type = JBAS_RESOURCE_NUMBER;
+	}
+
+	sym->res->number = num;
+	return JBAS_OK;
+}
+
+#ifndef JBAS_STATIC
+
+static int jbas_pool_ptrcmp(const void *a, const void *b)
+{
+	uintptr_t x = (uintptr_t) *(void**) a, y = (uintptr_t) *(void**) b;
+	return (x > y) - (x < y);
+}
+
+/**
+	Writes an image of the running program. The list may be cut by
+	jbas_run_block(), so the links are restored for the time of writing.
+*/
+static jbas_error jbas_pool_snapshot(jbas_env *env, char **image, size_t *size)
+{
+	int cut_count = 0;
+	for (jbas_token *t = env->tokens; t && t->l; t = t->l)
+		if (t->l->r != t) cut_count++;
+
+	jbas_token **cut = malloc((cut_count + 1) * sizeof(jbas_token*));
+	if (!cut) return JBAS_ALLOC;
+
+	cut_count = 0;
+	for (jbas_token *t = env->tokens; t && t->l; t = t->l)
+		if (t->l->r != t)
+		{
+			cut[cut_count++] = t->l;
+			t->l->r = t;
+		}
+
+	jbas_error err = JBAS_ALLOC;
+	FILE *f = open_memstream(image, size);
+	if (f)
+	{
+		err = jbas_image_write(env, f);
+		if (fclose(f) && !err) err = JBAS_IO_ERROR;
+	}
+
+	for (int i = 0; i < cut_count; i++)
+		cut[i]->r = NULL;
+	free(cut);
+	return err;
+}
+
+/**
+	Sets up the worker environment with the program image
+*/
+static jbas_error jbas_pool_worker_init(jbas_env *env, jbas_pool_worker *w, const char *image, size_t size)
+{
+	jbas_error err = jbas_env_init(&w->env,
+		env->token_pool.pool_size,
+		env->text_manager.max_count,
+		env->symbol_manager.max_count,
+		env->resource_manager.max_count,
+		env->memo_manager.max_count);
+
+	// Import the C functions bound in the environment
+	jbas_symbol_manager *sm = &env->symbol_manager;
+	for (int i = 0; !err && i < sm->max_count; i++)
+	{
+		jbas_symbol *sym = &sm->symbol_storage[i];
+		if (!sm->is_used[i] || !sym->res || sym->res->type != JBAS_RESOURCE_CFUN) continue;
+
+		jbas_cres cres = {.name = sym->name->str, .cfun = sym->res->cfun};
+		err = jbas_symbol_import(&w->env, &cres, 1);
+	}
+
+	if (!err) err = jbas_image_load_memory(&w->env, image, size);
+	if (!err) err = jbas_token_pool_mark(&w->env.token_pool);
+
+	// Nested loops run in the worker's thread
+	w->env.thread_count = 1;
+
+	w->map = calloc(sm->max_count, sizeof(jbas_symbol*));
+	w->borrowed = malloc((env->resource_manager.max_count + 1) * sizeof(void*));
+	if (!err && (!w->map || !w->borrowed)) err = JBAS_ALLOC;
+	return err;
+}
+
+/**
+	Frees the worker environment. Buffers borrowed from the main
+	environment are detached first, so they are not freed with it.
+*/
+static void jbas_pool_worker_release(jbas_pool_worker *w)
+{
+	jbas_resource_manager *rm = &w->env.resource_manager;
+	for (int i = 0; i < rm->ref_count; i++)
+	{
+		jbas_resource *res = rm->refs[i];
+		if (res->type != JBAS_RESOURCE_INT_ARRAY && res->type != JBAS_RESOURCE_FLOAT_ARRAY) continue;
+		if (bsearch(&res->data, w->borrowed, w->borrowed_count, sizeof(void*), jbas_pool_ptrcmp))
+			res->data = NULL;
+	}
+
+	w->borrowed_count = 0;
+	jbas_env_reset(&w->env);
+}
+
+/**
+	Copies the variables of the main environment into the worker
+*/
+static jbas_error jbas_pool_worker_bind(jbas_env *env, jbas_pool_worker *w)
+{
+	jbas_symbol_manager *sm = &env->symbol_manager;
+	for (int i = 0; i < sm->used_count; i++)
+	{
+		int slot = sm->used_slots[i];
+		jbas_symbol *msym = &sm->symbol_storage[slot];
+		if (!msym->res) continue;
+
+		// All symbols of the program exist in the worker
+		jbas_symbol *sym = w->map[slot];
+		if (!sym)
+		{
+			jbas_symbol_lookup(&w->env.symbol_manager, &sym, msym->name->str, msym->name->str + msym->name->length);
+			if (!sym) continue;
+			w->map[slot] = sym;
+		}
+
+		jbas_resource *mres = msym->res;
+		if (mres->type == JBAS_RESOURCE_CFUN && sym->res && sym->res->type == JBAS_RESOURCE_CFUN
+			&& sym->res->cfun == mres->cfun)
+			continue;
+
+		jbas_resource_remove_ref(sym->res);
+		sym->res = NULL;
+		jbas_error err = jbas_resource_create(&w->env.resource_manager, &sym->res);
+		if (err) return err;
+		jbas_resource_copy(sym->res, mres);
+
+		// The arrays are shared - the extra reference keeps them from the GC
+		if (mres->type == JBAS_RESOURCE_INT_ARRAY || mres->type == JBAS_RESOURCE_FLOAT_ARRAY)
+		{
+			jbas_resource_add_ref(sym->res);
+			w->borrowed[w->borrowed_count++] = mres->data;
+		}
+	}
+
+	qsort(w->borrowed, w->borrowed_count, sizeof(void*), jbas_pool_ptrcmp);
+	return JBAS_OK;
+}
+
+/**
+	Prepares the worker for the job - binds the variables and finds the loop
+*/
+static jbas_error jbas_pool_worker_prepare(jbas_pool *pool, jbas_pool_worker *w)
+{
+	jbas_env *env = pool->env;
+	w->env.input = env->input;
+	w->env.output = env->output;
+	w->env.jit_threshold = env->jit_threshold;
+
+	// The descriptors of the main environment can be used (but not closed)
+	memcpy(w->env.fds, env->fds, env->fd_count * sizeof(int));
+	w->env.fd_count = w->env.fd_shared = env->fd_count;
+
+	jbas_error err = jbas_pool_worker_bind(env, w);
+	if (err) return err;
+
+	jbas_token *kw = jbas_token_list_begin(w->env.tokens);
+	for (int32_t i = 0; kw && i < pool->par->position; i++)
+		kw = kw->r;
+	err = jbas_parallel_parse(&w->env, kw, &w->par);
+	if (err) return err;
+
+	// REDUCE variables start at zero
+	for (int i = 0; i < w->par->reduce_count; i++)
+	{
+		jbas_resource *mres = pool->par->reduce[i]->res;
+		jbas_number_token zero = {.type = mres->number.type == JBAS_NUM_FLOAT ? JBAS_NUM_FLOAT : JBAS_NUM_INT};
+		err = jbas_pool_set_number(&w->env, w->par->reduce[i], zero);
+		if (err) return err;
+	}
+
+	return JBAS_OK;
+}
+
+/**
+	Takes up to `grain` iterations from the worker's own range
+*/
+static int64_t jbas_pool_take(jbas_pool_worker *w, int64_t grain, int64_t *lo)
+{
+	pthread_mutex_lock(&w->lock);
+	int64_t n = w->hi - w->lo;
+	if (n > grain) n = grain;
+	if (n < 0) n = 0;
+	*lo = w->lo;
+	w->lo += n;
+	pthread_mutex_unlock(&w->lock);
+	return n;
+}
+
+/**
+	Moves the upper half of another worker's range to this worker
+*/
+static bool jbas_pool_steal(jbas_pool *pool, jbas_pool_worker *w)
+{
+	int index = w - pool->workers;
+	for (int k = 1; k < pool->count; k++)
+	{
+		jbas_pool_worker *v = &pool->workers[(index + k) % pool->count];
+
+		pthread_mutex_lock(&v->lock);
+		int64_t lo = 0, hi = 0;
+		if (v->hi - v->lo >= 2)
+		{
+			lo = v->lo + (v->hi - v->lo) / 2;
+			hi = v->hi;
+			v->hi = lo;
+		}
+		pthread_mutex_unlock(&v->lock);
+
+		if (lo != hi)
+		{
+			pthread_mutex_lock(&w->lock);
+			w->lo = lo;
+			w->hi = hi;
+			pthread_mutex_unlock(&w->lock);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+	Runs iterations until there are none left to take or to steal
+*/
+static jbas_error jbas_pool_work(jbas_pool *pool, jbas_pool_worker *w)
+{
+	jbas_parallel *par = w->par;
+	int64_t lo, n;
+
+	while (!atomic_load_explicit(&pool->failed, memory_order_relaxed))
+	{
+		n = jbas_pool_take(w, pool->grain, &lo);
+		if (!n)
+		{
+			if (!jbas_pool_steal(pool, w)) break;
+			continue;
+		}
+
+		for (int64_t i = lo; i < lo + n; i++)
+		{
+			jbas_number_token num = {.type = JBAS_NUM_INT, .i = i};
+			jbas_error err = jbas_pool_set_number(&w->env, par->var, num);
+			if (!err) err = jbas_run_block(&w->env, par->body, par->end, NULL);
+			if (err == JBAS_WOULD_BLOCK || err == JBAS_YIELD)
+			{
+				JBAS_ERROR_REASON(&w->env, "PARALLEL FOR threads cannot be suspended");
+				err = JBAS_UNSUPPORTED;
+			}
+			if (err) return err;
+		}
+	}
+
+	return JBAS_OK;
+}
+
+/**
+	Prepares the worker and runs its share of the job
+*/
+static void jbas_pool_job(jbas_pool *pool, jbas_pool_worker *w)
+{
+	w->env.error_reason = NULL;
+	w->err = jbas_pool_worker_prepare(pool, w);
+	if (!w->err) w->err = jbas_pool_work(pool, w);
+	w->error_reason = w->env.error_reason;
+
+	// Nothing is left for the others to steal
+	if (w->err)
+	{
+		atomic_store(&pool->failed, true);
+		pthread_mutex_lock(&w->lock);
+		w->lo = w->hi;
+		pthread_mutex_unlock(&w->lock);
+	}
+}
+
+static void *jbas_pool_thread(void *arg)
+{
+	jbas_pool_worker *w = arg;
+	jbas_pool *pool = w->pool;
+	unsigned generation = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	for (;;)
+	{
+		while (!pool->quit && pool->generation == generation)
+			pthread_cond_wait(&pool->start, &pool->lock);
+		if (pool->quit) break;
+		generation = pool->generation;
+		pthread_mutex_unlock(&pool->lock);
+
+		jbas_pool_job(pool, w);
+
+		pthread_mutex_lock(&pool->lock);
+		if (!--pool->running) pthread_cond_signal(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+
+/**
+	Creates the pool with copies of the running program
+*/
+static jbas_error jbas_pool_create(jbas_env *env, jbas_pool **result)
+{
+	int count = env->thread_count;
+	if (count <= 0) count = sysconf(_SC_NPROCESSORS_ONLN);
+	if (count <= 0) count = 1;
+
+	char *image = NULL;
+	size_t size = 0;
+	jbas_error err = jbas_pool_snapshot(env, &image, &size);
+	if (err)
+	{
+		free(image);
+		return err;
+	}
+
+	jbas_pool *pool = calloc(1, sizeof(jbas_pool));
+	jbas_pool_worker *workers = calloc(count, sizeof(jbas_pool_worker));
+	if (!pool || !workers)
+	{
+		free(pool);
+		free(workers);
+		free(image);
+		return JBAS_ALLOC;
+	}
+
+	pool->env = env;
+	pool->workers = workers;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+	atomic_init(&pool->failed, false);
+
+	// The environments are counted as soon as they are initialized
+	for (int i = 0; !err && i < count; i++)
+	{
+		jbas_pool_worker *w = &workers[i];
+		w->pool = pool;
+		pthread_mutex_init(&w->lock, NULL);
+		pool->count++;
+		err = jbas_pool_worker_init(env, w, image, size);
+	}
+	free(image);
+
+	// The calling thread works as the first worker
+	for (int i = 1; !err && i < count; i++)
+	{
+		if (pthread_create(&workers[i].thread, NULL, jbas_pool_thread, &workers[i]))
+		{
+			JBAS_ERROR_REASON(env, "could not start a PARALLEL FOR thread");
+			err = JBAS_ALLOC;
+		}
+		else
+			workers[i].started = true;
+	}
+
+	if (err)
+	{
+		jbas_pool_destroy(pool);
+		return err;
+	}
+
+	*result = pool;
+	return JBAS_OK;
+}
+
+/**
+	Adds the REDUCE + sums and sets the loop variable
+*/
+static jbas_error jbas_pool_merge(jbas_env *env, jbas_pool *pool, int64_t to)
+{
+	jbas_parallel *par = pool->par;
+
+	// The workers' instructions and calls count as the environment's own
+	for (int j = 0; j < pool->count; j++)
+	{
+		jbas_env *w = &pool->workers[j].env;
+		env->statement_count += w->statement_count;
+		env->cfun_calls += w->cfun_calls;
+		w->statement_count = w->cfun_calls = 0;
+	}
+
+	for (int i = 0; i < par->reduce_count; i++)
+	{
+		jbas_number_token sum = par->reduce[i]->res->number;
+		if (sum.type == JBAS_NUM_BOOL) sum.type = JBAS_NUM_INT;
+
+		for (int j = 0; j < pool->count; j++)
+		{
+			jbas_resource *res = pool->workers[j].par->reduce[i]->res;
+			if (!res || res->type != JBAS_RESOURCE_NUMBER)
+			{
+				JBAS_ERROR_REASON(env, "REDUCE + variable has to remain a number");
+				return JBAS_TYPE_MISMATCH;
+			}
+
+			jbas_number_token x = res->number;
+			if (sum.type == JBAS_NUM_FLOAT || x.type == JBAS_NUM_FLOAT)
+			{
+				jbas_number_cast(&sum, JBAS_NUM_FLOAT);
+				jbas_number_cast(&x, JBAS_NUM_FLOAT);
+				sum.f += x.f;
+			}
+			else
+				sum.i = (jbas_int)((unsigned) sum.i + (unsigned) x.i);
+		}
+
+		jbas_error err = jbas_pool_set_number(env, par->reduce[i], sum);
+		if (err) return err;
+	}
+
+	jbas_number_token end = {.type = JBAS_NUM_INT, .i = to + 1};
+	return jbas_pool_set_number(env, par->var, end);
+}
+
+#endif
+
+/**
+	Runs the iterations in the calling thread (nested loops or a single thread)
+*/
+static jbas_error jbas_pool_run_serial(jbas_env *env, jbas_parallel *par, int64_t from, int64_t to)
+{
+	for (int64_t i = from; i <= to; i++)
+	{
+		jbas_number_token num = {.type = JBAS_NUM_INT, .i = i};
+		jbas_error err = jbas_pool_set_number(env, par->var, num);
+		if (!err) err = jbas_run_block(env, par->body, par->end, NULL);
+		if (err) return err;
+	}
+
+	jbas_number_token end = {.type = JBAS_NUM_INT, .i = to + 1};
+	return jbas_pool_set_number(env, par->var, end);
+}
+
+/**
+	Runs iterations from..to (inclusive) of the PARALLEL FOR loop.
+	The pool is created on the first use.
+*/
+jbas_error jbas_pool_run(jbas_env *env, jbas_parallel *par, int64_t from, int64_t to)
+{
+	if (from > to)
+	{
+		jbas_number_token num = {.type = JBAS_NUM_INT, .i = from};
+		return jbas_pool_set_number(env, par->var, num);
+	}
+
+	for (int i = 0; i < par->reduce_count; i++)
+	{
+		jbas_resource *res = par->reduce[i]->res;
+		if (!res || res->type != JBAS_RESOURCE_NUMBER)
+		{
+			JBAS_ERROR_REASON(env, "REDUCE + variable has to hold a number");
+			return JBAS_TYPE_MISMATCH;
+		}
+	}
+
+	// The static profile has no threads
+#ifdef JBAS_STATIC
+	return jbas_pool_run_serial(env, par, from, to);
+#else
+	if (env->thread_count == 1)
+		return jbas_pool_run_serial(env, par, from, to);
+
+	if (!env->pool)
+	{
+		jbas_error err = jbas_pool_create(env, &env->pool);
+		if (err) return err;
+	}
+	jbas_pool *pool = env->pool;
+
+	// Even split, the rest is balanced by stealing
+	int64_t n = to - from + 1;
+	pool->par = par;
+	pool->grain = n / (pool->count * 8);
+	if (pool->grain < 1) pool->grain = 1;
+	atomic_store(&pool->failed, false);
+	for (int i = 0; i < pool->count; i++)
+	{
+		jbas_pool_worker *w = &pool->workers[i];
+		w->lo = from + n * i / pool->count;
+		w->hi = from + n * (i + 1) / pool->count;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	pool->running = pool->count - 1;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+
+	jbas_pool_job(pool, &pool->workers[0]);
+
+	pthread_mutex_lock(&pool->lock);
+	while (pool->running)
+		pthread_cond_wait(&pool->done, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+
+	// The first error (by worker) is reported
+	jbas_error err = JBAS_OK;
+	for (int i = 0; !err && i < pool->count; i++)
+	{
+		err = pool->workers[i].err;
+		if (err) env->error_reason = pool->workers[i].error_reason;
+	}
+
+	if (!err) err = jbas_pool_merge(env, pool, to);
+
+	for (int i = 0; i < pool->count; i++)
+		jbas_pool_worker_release(&pool->workers[i]);
+	return err;
+#endif
+}
+
+/**
+	Stops the threads and frees the worker environments
+*/
+void jbas_pool_destroy(jbas_pool *pool)
+{
+	if (!pool) return;
+#ifndef JBAS_STATIC
+
+	pthread_mutex_lock(&pool->lock);
+	pool->quit = true;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (int i = 0; i < pool->count; i++)
+	{
+		jbas_pool_worker *w = &pool->workers[i];
+		if (w->started) pthread_join(w->thread, NULL);
+
+		jbas_pool_worker_release(w);
+		jbas_env_destroy(&w->env);
+		pthread_mutex_destroy(&w->lock);
+		free(w->map);
+		free(w->borrowed);
+	}
+
+	pthread_mutex_destroy(&pool->lock);
+	pthread_cond_destroy(&pool->start);
+	pthread_cond_destroy(&pool->done);
+	free(pool->workers);
+	free(pool);
+#endif
+}
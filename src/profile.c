@@ -0,0 +1,298 @@
+#include <jbasic/profile.h>
+#include <jbasic/jbasic.h>
+#include <time.h>
+#include <sys/time.h>
+
+static uint64_t jbas_profile_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+void jbas_profile_init(jbas_profile *p)
+{
+	*p = (jbas_profile){0};
+}
+
+void jbas_profile_destroy(jbas_profile *p)
+{
+	free(p->lines);
+	free(p->stack);
+	*p = (jbas_profile){0};
+}
+
+/**
+	Called before an instruction on `line` is run
+*/
+jbas_error jbas_profile_enter(jbas_profile *p, jbas_env *env, int line)
+{
+	if (line < 0) line = 0;
+	if (line >= p->line_count)
+	{
+		int count = line + 64;
+		jbas_profile_line *lines = realloc(p->lines, count * sizeof(*lines));
+		if (!lines) return JBAS_ALLOC;
+		memset(lines + p->line_count, 0, (count - p->line_count) * sizeof(*lines));
+		p->lines = lines;
+		p->line_count = count;
+	}
+
+	if (p->depth == p->stack_size)
+	{
+		int size = p->stack_size ? 2 * p->stack_size : 64;
+		jbas_profile_frame *stack = realloc(p->stack, size * sizeof(*stack));
+		if (!stack) return JBAS_ALLOC;
+		p->stack = stack;
+		p->stack_size = size;
+	}
+
+	p->stack[p->depth++] = (jbas_profile_frame){
+		.line = line,
+		.start = {
+			.tokens = env->token_pool.taken,
+			.resources = env->resource_manager.created,
+			.gc_runs = env->resource_manager.gc_runs,
+			.total_ns = jbas_profile_now(),
+		},
+	};
+	return JBAS_OK;
+}
+
+/**
+	Called after the instruction (whether it has succeeded or not)
+*/
+void jbas_profile_leave(jbas_profile *p, jbas_env *env)
+{
+	uint64_t now = jbas_profile_now();
+	if (!p->depth) return;
+
+	jbas_profile_frame *f = &p->stack[--p->depth];
+	jbas_profile_line used = {
+		.total_ns = now - f->start.total_ns,
+		.tokens = env->token_pool.taken - f->start.tokens,
+		.resources = env->resource_manager.created - f->start.resources,
+		.gc_runs = env->resource_manager.gc_runs - f->start.gc_runs,
+	};
+
+	jbas_profile_line *l = &p->lines[f->line];
+	l->count++;
+	l->total_ns += used.total_ns;
+	l->self_ns += used.total_ns - f->child.total_ns;
+	l->tokens += used.tokens - f->child.tokens;
+	l->resources += used.resources - f->child.resources;
+	l->gc_runs += used.gc_runs - f->child.gc_runs;
+
+	// The enclosing instruction only keeps what it has used itself
+	if (p->depth)
+	{
+		jbas_profile_line *child = &p->stack[p->depth - 1].child;
+		child->total_ns += used.total_ns;
+		child->tokens += used.tokens;
+		child->resources += used.resources;
+		child->gc_runs += used.gc_runs;
+	}
+}
+
+/**
+	Finds the line in the program text (NULL if there's no such line).
+	The indentation is skipped.
+*/
+static const char *jbas_profile_source_line(const char *source, int line, int *len)
+{
+	if (line < 1) return NULL;
+
+	const char *s = source;
+	for (int k = 1; s && k < line; k++)
+	{
+		s = strchr(s, '\n');
+		if (s) s++;
+	}
+	if (!s) return NULL;
+
+	while (*s == ' ' || *s == '\t') s++;
+	*len = strcspn(s, "\r\n");
+	if (*len > 60) *len = 60;
+	return s;
+}
+
+static const jbas_profile_line *jbas_profile_sort_lines;
+
+static int jbas_profile_cmp(const void *a, const void *b)
+{
+	uint64_t x = jbas_profile_sort_lines[*(const int*) a].self_ns;
+	uint64_t y = jbas_profile_sort_lines[*(const int*) b].self_ns;
+	if (x != y) return x < y ? 1 : -1;
+	return *(const int*) a - *(const int*) b;
+}
+
+/**
+	Prints the lines that have been run, the most expensive (by the self
+	time) first. `source` (may be NULL) is the program text the lines are
+	quoted from.
+*/
+void jbas_profile_report(const jbas_profile *p, FILE *f, const char *source)
+{
+	int *order = malloc((p->line_count + 1) * sizeof(int));
+	if (!order) return;
+
+	int n = 0;
+	uint64_t count = 0, self_ns = 0;
+	for (int i = 0; i < p->line_count; i++)
+	{
+		if (!p->lines[i].count) continue;
+		order[n++] = i;
+		count += p->lines[i].count;
+		self_ns += p->lines[i].self_ns;
+	}
+
+	// The report is only made once, so a static comparison context does
+	jbas_profile_sort_lines = p->lines;
+	qsort(order, n, sizeof(int), jbas_profile_cmp);
+
+	fprintf(f, "profile: %" PRIu64 " instructions on %d lines, %.3f ms\n", count, n, self_ns / 1e6);
+	fprintf(f, "%6s %12s %12s %12s %7s %10s %10s %10s%s\n",
+		"line", "count", "total ms", "self ms", "self %", "tokens", "resources", "gc", source ? "  source" : "");
+
+	for (int i = 0; i < n; i++)
+	{
+		const jbas_profile_line *l = &p->lines[order[i]];
+		char line[16] = "-";
+		if (order[i]) snprintf(line, sizeof(line), "%d", order[i]);
+
+		fprintf(f, "%6s %12" PRIu64 " %12.3f %12.3f %6.1f%% %10" PRIu64 " %10" PRIu64 " %10" PRIu64,
+			line, l->count, l->total_ns / 1e6, l->self_ns / 1e6,
+			self_ns ? 100.0 * l->self_ns / self_ns : 0.0,
+			l->tokens, l->resources, l->gc_runs);
+
+		int len;
+		const char *s = jbas_profile_source_line(source, order[i], &len);
+		if (s) fprintf(f, "  %.*s", len, s);
+		fputc('\n', f);
+	}
+
+	free(order);
+}
+
+static jbas_sampler *volatile jbas_active_sampler;
+
+static void jbas_sampler_signal(int sig)
+{
+	jbas_sampler *s = jbas_active_sampler;
+	if (!s) return;
+
+	const jbas_token *t = s->env->current;
+	const jbas_token_pool *pool = &s->env->token_pool;
+	if (t >= pool->tokens && t < pool->tokens + pool->pool_size)
+		s->counts[t - pool->tokens]++;
+	s->samples++;
+}
+
+/**
+	Starts sampling the instructions run by the environment every
+	`interval_us` microseconds of CPU time
+*/
+jbas_error jbas_sampler_start(jbas_sampler *s, jbas_env *env, int interval_us)
+{
+	*s = (jbas_sampler){.env = env};
+	s->counts = calloc(env->token_pool.pool_size, sizeof(*s->counts));
+	if (!s->counts) return JBAS_ALLOC;
+
+	struct sigaction sa = {.sa_handler = jbas_sampler_signal, .sa_flags = SA_RESTART};
+	sigemptyset(&sa.sa_mask);
+	if (sigaction(SIGPROF, &sa, &s->old_action))
+	{
+		free(s->counts);
+		s->counts = NULL;
+		return JBAS_IO_ERROR;
+	}
+	jbas_active_sampler = s;
+
+	struct timeval tv = {interval_us / 1000000, interval_us % 1000000};
+	struct itimerval it = {.it_interval = tv, .it_value = tv};
+	if (setitimer(ITIMER_PROF, &it, NULL))
+	{
+		jbas_sampler_stop(s);
+		return JBAS_IO_ERROR;
+	}
+
+	return JBAS_OK;
+}
+
+void jbas_sampler_stop(jbas_sampler *s)
+{
+	struct itimerval it = {0};
+	setitimer(ITIMER_PROF, &it, NULL);
+	jbas_active_sampler = NULL;
+	sigaction(SIGPROF, &s->old_action, NULL);
+}
+
+void jbas_sampler_destroy(jbas_sampler *s)
+{
+	free(s->counts);
+	s->counts = NULL;
+}
+
+/**
+	Writes a stack frame - the quoted line if there's the program text,
+	otherwise the keyword or "line N"
+*/
+static void jbas_sampler_frame(FILE *f, const jbas_token *t, const char *source)
+{
+	int len;
+	const char *s = jbas_profile_source_line(source, t->line, &len);
+	if (s)
+	{
+		// Semicolons separate the frames
+		fprintf(f, "%d: ", t->line);
+		for (int i = 0; i < len; i++)
+			fputc(s[i] == ';' ? ',' : s[i], f);
+	}
+	else if (t->type == JBAS_TOKEN_KEYWORD)
+		fprintf(f, "%s:%d", t->keyword_token.kw->str, t->line);
+	else
+		fprintf(f, "line %d", t->line);
+}
+
+/**
+	Writes the samples taken so far as collapsed stacks (outermost block
+	first). Samples taken outside of the program's instructions are
+	written as `[other]`.
+*/
+jbas_error jbas_sampler_write(const jbas_sampler *s, FILE *f, const char *source)
+{
+	const jbas_env *env = s->env;
+	const jbas_token *blocks[JBAS_SAMPLER_MAX_DEPTH];
+	int depth = 0;
+	uint64_t written = 0;
+
+	// The blocks are found the same way jbas_resume() finds them
+	for (jbas_token *t = jbas_token_list_begin(env->tokens); t; t = t->r)
+	{
+		uint32_t n = s->counts[t - env->token_pool.tokens];
+		if (n)
+		{
+			for (int i = 0; i < depth && i < JBAS_SAMPLER_MAX_DEPTH; i++)
+			{
+				jbas_sampler_frame(f, blocks[i], source);
+				fputc(';', f);
+			}
+			jbas_sampler_frame(f, t, source);
+			fprintf(f, " %" PRIu32 "\n", n);
+			written += n;
+		}
+
+		int diff = jbas_block_level_diff(t);
+		if (diff < 0 && depth) depth--;
+		if (diff > 0)
+		{
+			if (depth < JBAS_SAMPLER_MAX_DEPTH) blocks[depth] = t;
+			depth++;
+		}
+	}
+
+	if (s->samples > written)
+		fprintf(f, "[other] %" PRIu64 "\n", s->samples - written);
+
+	return ferror(f) ? JBAS_IO_ERROR : JBAS_OK;
+}
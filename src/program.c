@@ -0,0 +1,115 @@
+#include <jbasic/program.h>
+#include <jbasic/jbasic.h>
+#include <jbasic/image.h>
+#include <jbasic/opt.h>
+#include <jbasic/infer.h>
+
+/**
+	Compiled program - an image of the processed program
+*/
+typedef struct jbas_program
+{
+	char *image;
+	size_t size;
+} jbas_program;
+
+/**
+	Processes the source in the scratch environment and writes the image
+*/
+static jbas_error jbas_compile_image(jbas_env *tmp, const char *source, int opt_flags, jbas_program *p)
+{
+	jbas_error err = jbas_tokenize_string(tmp, source);
+	if (!err && opt_flags) err = jbas_optimize(tmp, opt_flags, NULL);
+	if (!err) err = jbas_infer_types(tmp);
+	if (err) return err;
+
+	FILE *f = open_memstream(&p->image, &p->size);
+	if (!f) return JBAS_ALLOC;
+	err = jbas_image_write(tmp, f);
+	if (fclose(f) && !err) err = JBAS_IO_ERROR;
+	return err;
+}
+
+/**
+	Compiles a program. The environment is not modified (except for the
+	error reason) - it only provides the C functions the program can call
+	and the pool sizes. `opt_flags` are passed to jbas_optimize().
+*/
+jbas_error jbas_compile(jbas_env *env, const char *source, int opt_flags, jbas_program **program)
+{
+	jbas_program *p = calloc(1, sizeof(jbas_program));
+	if (!p) return JBAS_ALLOC;
+
+	// The program is processed in a scratch environment of the same size
+	jbas_env tmp;
+	jbas_error err = jbas_env_init(&tmp,
+		env->token_pool.pool_size,
+		env->text_manager.max_count,
+		env->symbol_manager.max_count,
+		env->resource_manager.max_count,
+		env->memo_manager.max_count);
+
+	// Import the C functions bound in the environment
+	jbas_symbol_manager *sm = &env->symbol_manager;
+	for (int i = 0; !err && i < sm->max_count; i++)
+	{
+		jbas_symbol *sym = &sm->symbol_storage[i];
+		if (!sm->is_used[i] || !sym->res || sym->res->type != JBAS_RESOURCE_CFUN) continue;
+
+		jbas_cres cres = {.name = sym->name->str, .cfun = sym->res->cfun};
+		err = jbas_symbol_import(&tmp, &cres, 1);
+	}
+
+	if (!err) err = jbas_compile_image(&tmp, source, opt_flags, p);
+
+	env->error_reason = tmp.error_reason;
+	jbas_env_destroy(&tmp);
+
+	if (err)
+	{
+		jbas_program_destroy(p);
+		return err;
+	}
+
+	*program = p;
+	return JBAS_OK;
+}
+
+/**
+	Links the program into the environment without running it (e.g. before
+	jbas_env_restore()). Linking the same program again does nothing,
+	an environment holding a different program is rejected.
+*/
+jbas_error jbas_link(jbas_env *env, const jbas_program *program)
+{
+	if (env->program == program) return JBAS_OK;
+
+	if (env->tokens)
+	{
+		JBAS_ERROR_REASON(env, "the environment already holds another program");
+		return JBAS_ENV_BUSY;
+	}
+
+	jbas_error err = jbas_image_load_memory(env, program->image, program->size);
+	if (err) return err;
+	env->program = program;
+	return JBAS_OK;
+}
+
+/**
+	Runs the program in the environment. The program is linked into the
+	environment on the first call.
+*/
+jbas_error jbas_exec(jbas_env *env, const jbas_program *program)
+{
+	jbas_error err = jbas_link(env, program);
+	if (err) return err;
+	return jbas_run(env);
+}
+
+void jbas_program_destroy(jbas_program *program)
+{
+	if (!program) return;
+	free(program->image);
+	free(program);
+}
@@ -1,15 +1,32 @@
 #include <jbasic/resource.h>
 #include <stdlib.h>
 
-jbas_error jbas_resource_manager_init(jbas_resource_manager *rm, int max_count)
+jbas_error jbas_resource_manager_init(jbas_resource_manager *rm, int max_count, const jbas_allocator *allocator)
 {
 	rm->max_count = max_count;
-	rm->refs = calloc(max_count, sizeof(jbas_resource*));
+	rm->allocator = allocator;
+	rm->refs = jbas_alloc(allocator, max_count * sizeof(jbas_resource*));
 	rm->ref_count = 0;
+	rm->peak_count = 0;
+	rm->created = rm->deleted = rm->gc_runs = rm->collected = 0;
+	rm->memory = NULL;
 
 	if (!rm->refs)
 		return JBAS_ALLOC;
 
+#ifdef JBAS_STATIC
+	// All resources are allocated up front - refs[ref_count..max_count) are the free ones
+	rm->storage = jbas_alloc(allocator, max_count * sizeof(jbas_resource));
+	if (!rm->storage)
+	{
+		jbas_free(allocator, rm->refs, max_count * sizeof(jbas_resource*));
+		return JBAS_ALLOC;
+	}
+
+	for (int i = 0; i < max_count; i++)
+		rm->refs[i] = &rm->storage[i];
+#endif
+
 	return JBAS_OK;
 }
 
@@ -20,7 +37,25 @@ void jbas_resource_manager_destroy(jbas_resource_manager *rm)
 {
 	while (rm->ref_count)
 		jbas_resource_delete(rm, rm->refs[0]);
-	free(rm->refs);
+#ifdef JBAS_STATIC
+	jbas_free(rm->allocator, rm->storage, rm->max_count * sizeof(jbas_resource));
+#endif
+	jbas_free(rm->allocator, rm->refs, rm->max_count * sizeof(jbas_resource*));
+}
+
+/**
+	Deletes all resources apart from C functions
+*/
+void jbas_resource_manager_reset(jbas_resource_manager *rm)
+{
+	// Deleted resources are replaced with the last one, which has been visited already
+	for (int i = rm->ref_count - 1; i >= 0; i--)
+	{
+		if (rm->refs[i]->type == JBAS_RESOURCE_CFUN)
+			rm->refs[i]->ref_count = 1;
+		else
+			jbas_resource_delete(rm, rm->refs[i]);
+	}
 }
 
 /**
@@ -29,6 +64,7 @@ void jbas_resource_manager_destroy(jbas_resource_manager *rm)
 jbas_error jbas_resource_manager_garbage_collect(jbas_resource_manager *rm, int *collected)
 {
 	int n = 0;
+	rm->gc_runs++;
 	for (int i = rm->ref_count - 1; i >= 0; i--)
 	{
 		if (rm->refs[i] && rm->refs[i]->ref_count == 0)
@@ -38,6 +74,7 @@ jbas_error jbas_resource_manager_garbage_collect(jbas_resource_manager *rm, int
 		}
 	}
 
+	rm->collected += n;
 	if (collected) *collected = n;
 
 	return JBAS_OK;
@@ -66,25 +103,35 @@ jbas_error jbas_resource_add_ref(jbas_resource *res)
 */
 jbas_error jbas_resource_create(jbas_resource_manager *rm, jbas_resource **res)
 {
-	jbas_resource *r = calloc(1, sizeof(jbas_resource));
-	if (!r) return JBAS_ALLOC;
+	// Try GC when there's no room left
+	if (rm->ref_count >= rm->max_count || !jbas_memory_fits(rm->memory, sizeof(jbas_resource)))
+		jbas_resource_manager_garbage_collect(rm, NULL);
+	if (rm->ref_count >= rm->max_count) return JBAS_RESOURCE_MANAGER_OVERFLOW;
+
+	jbas_error err = jbas_memory_charge(rm->memory, sizeof(jbas_resource));
+	if (err) return err;
+
+#ifdef JBAS_STATIC
+	jbas_resource *r = rm->refs[rm->ref_count];
+	*r = (jbas_resource){0};
+#else
+	jbas_resource *r = jbas_alloc(rm->allocator, sizeof(jbas_resource));
+	if (!r)
+	{
+		jbas_memory_release(rm->memory, sizeof(jbas_resource));
+		return JBAS_ALLOC;
+	}
+#endif
 	
 	r->ref_count = 1;
 
 	// Register in the resource manager
 	int index = rm->ref_count;
-	if (index >= rm->max_count)
-	{
-		// Try GC
-		int collected;
-		jbas_resource_manager_garbage_collect(rm, &collected);
-		if (!collected) return JBAS_RESOURCE_MANAGER_OVERFLOW;
-
-		index = rm->ref_count;
-	}
 	r->rm_index = index;
 	rm->refs[index] = r;
 	rm->ref_count++;
+	rm->created++;
+	if (rm->ref_count > rm->peak_count) rm->peak_count = rm->ref_count;
 
 	*res = r;
 	return JBAS_OK;
@@ -95,39 +142,53 @@ jbas_error jbas_resource_create(jbas_resource_manager *rm, jbas_resource **res)
 */
 void jbas_resource_delete(jbas_resource_manager *rm, jbas_resource *res)
 {
-	switch (res->type)
+	// Buffers borrowed from another environment are detached (NULL) first
+	bool array = res->type == JBAS_RESOURCE_INT_ARRAY || res->type == JBAS_RESOURCE_FLOAT_ARRAY;
+	if (array && res->data)
 	{
-		case JBAS_RESOURCE_INT_ARRAY:
-			free(res->iptr);
-			break;
-
-		case JBAS_RESOURCE_FLOAT_ARRAY:
-			free(res->fptr);
-			break;
-
-		default:
-			break;
+		size_t bytes = jbas_resource_array_bytes(res);
+		jbas_memory_release(rm->memory, bytes);
+		jbas_free(rm->allocator, res->data, bytes);
 	}
 
 	// Update resource manager refs
 	int index = --rm->ref_count;
 	if (index < 0) return;
+	rm->deleted++;
 	jbas_resource *m = rm->refs[index];
 	rm->refs[res->rm_index] = m;
 	m->rm_index = res->rm_index;
 	res->rm_index = -1;
 
-	free(res);
+#ifdef JBAS_STATIC
+	rm->refs[index] = res;
+#else
+	jbas_free(rm->allocator, res, sizeof(jbas_resource));
+#endif
+	jbas_memory_release(rm->memory, sizeof(jbas_resource));
+}
+
+/**
+	Size of the buffer of an array resource (0 for other resources)
+*/
+size_t jbas_resource_array_bytes(const jbas_resource *res)
+{
+	if (res->type == JBAS_RESOURCE_INT_ARRAY) return res->size * sizeof(int);
+	if (res->type == JBAS_RESOURCE_FLOAT_ARRAY) return res->size * sizeof(jbas_float);
+	return 0;
 }
 
 /**
-	Copies all resource data apart from the reference counter
+	Copies all resource data apart from the reference counter and
+	the position in the resource manager
 */
 void jbas_resource_copy(jbas_resource *dest, jbas_resource *src)
 {
 	int ref_count = dest->ref_count;
+	int rm_index = dest->rm_index;
 	*dest = *src;
 	dest->ref_count = ref_count;
+	dest->rm_index = rm_index;
 }
 
 
@@ -0,0 +1,218 @@
+#include <jbasic/sched.h>
+#include <jbasic/jbasic.h>
+#include <time.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+void jbas_sched_init(jbas_sched *sched)
+{
+	*sched = (jbas_sched){0};
+	sched->epoll_fd = -1;
+}
+
+void jbas_sched_destroy(jbas_sched *sched)
+{
+	if (sched->epoll_fd >= 0) close(sched->epoll_fd);
+	sched->epoll_fd = -1;
+}
+
+static void jbas_sched_push(jbas_sched *sched, jbas_task *task)
+{
+	task->state = JBAS_TASK_READY;
+	task->prev = sched->ready_tail;
+	task->next = NULL;
+	if (sched->ready_tail) sched->ready_tail->next = task;
+	else sched->ready = task;
+	sched->ready_tail = task;
+}
+
+static jbas_task *jbas_sched_pop(jbas_sched *sched)
+{
+	jbas_task *task = sched->ready;
+	if (!task) return NULL;
+
+	sched->ready = task->next;
+	if (sched->ready) sched->ready->prev = NULL;
+	else sched->ready_tail = NULL;
+	task->next = NULL;
+	return task;
+}
+
+static void jbas_sched_block(jbas_sched *sched, jbas_task *task)
+{
+	task->state = JBAS_TASK_BLOCKED;
+	task->prev = NULL;
+	task->next = sched->blocked;
+	if (sched->blocked) sched->blocked->prev = task;
+	sched->blocked = task;
+	sched->blocked_count++;
+
+	// Descriptors that epoll can't watch (e.g. regular files, or one
+	// already watched for another task) are simply tried again later
+	if (task->wait_fd < 0) return;
+	if (sched->epoll_fd < 0) sched->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	struct epoll_event ev = {.events = task->wait_events, .data.ptr = task};
+	if (sched->epoll_fd >= 0 && !epoll_ctl(sched->epoll_fd, EPOLL_CTL_ADD, task->wait_fd, &ev))
+	{
+		task->polled = true;
+		sched->polled_count++;
+	}
+}
+
+/**
+	Adds a task running the program linked into the environment
+*/
+void jbas_sched_add(jbas_sched *sched, jbas_task *task, jbas_env *env)
+{
+	task->env = env;
+	task->status = JBAS_OK;
+	task->wait_fd = -1;
+	task->polled = false;
+	env->task = task;
+	sched->task_count++;
+	jbas_sched_push(sched, task);
+}
+
+/**
+	Moves a blocked task to the ready queue (other tasks are left alone)
+*/
+void jbas_sched_wake(jbas_sched *sched, jbas_task *task)
+{
+	if (task->state != JBAS_TASK_BLOCKED) return;
+
+	if (task->prev) task->prev->next = task->next;
+	else sched->blocked = task->next;
+	if (task->next) task->next->prev = task->prev;
+	sched->blocked_count--;
+
+	if (task->polled)
+	{
+		epoll_ctl(sched->epoll_fd, EPOLL_CTL_DEL, task->wait_fd, NULL);
+		task->polled = false;
+		sched->polled_count--;
+	}
+	task->wait_fd = -1;
+
+	jbas_sched_push(sched, task);
+}
+
+/**
+	Waits up to `timeout` milliseconds (-1 = no limit) until some of the
+	descriptors the blocked tasks wait for are ready and wakes the tasks
+*/
+jbas_error jbas_sched_poll(jbas_sched *sched, int timeout)
+{
+	if (!sched->polled_count)
+	{
+		if (timeout < 0) return JBAS_OK;
+		struct timespec ts = {timeout / 1000, timeout % 1000 * 1000000L};
+		nanosleep(&ts, NULL);
+		return JBAS_OK;
+	}
+
+	struct epoll_event ev[64];
+	int n = epoll_wait(sched->epoll_fd, ev, 64, timeout);
+	if (n < 0) return errno == EINTR ? JBAS_OK : JBAS_IO_ERROR;
+
+	for (int i = 0; i < n; i++)
+		jbas_sched_wake(sched, ev[i].data.ptr);
+	return JBAS_OK;
+}
+
+/**
+	Default wait - waits for the descriptors, all other blocked tasks
+	try again a bit later
+*/
+static jbas_error jbas_sched_wait_all(jbas_sched *sched)
+{
+	bool others = sched->blocked_count > sched->polled_count;
+	jbas_error err = jbas_sched_poll(sched, others ? 1 : -1);
+	if (err || !others) return err;
+
+	for (jbas_task *task = sched->blocked, *next; task; task = next)
+	{
+		next = task->next;
+		if (!task->polled) jbas_sched_wake(sched, task);
+	}
+	return JBAS_OK;
+}
+
+/**
+	Runs the first ready task until it yields, blocks, uses up its slice
+	or finishes.
+	Waits for blocked tasks if there are no ready ones.
+*/
+jbas_error jbas_sched_step(jbas_sched *sched)
+{
+	if (!sched->ready)
+	{
+		if (!sched->blocked) return JBAS_OK;
+		return sched->wait ? sched->wait(sched) : jbas_sched_wait_all(sched);
+	}
+
+	jbas_task *task = jbas_sched_pop(sched);
+	task->wait_fd = -1;
+	if (sched->slice) task->env->budget = sched->slice;
+	jbas_error err = jbas_run(task->env);
+
+	if (err == JBAS_YIELD || (err == JBAS_BUDGET_EXHAUSTED && sched->slice))
+		jbas_sched_push(sched, task);
+	else if (err == JBAS_WOULD_BLOCK)
+		jbas_sched_block(sched, task);
+	else
+	{
+		task->state = JBAS_TASK_DONE;
+		task->status = err;
+		task->wait_fd = -1;
+		task->env->task = NULL;
+		sched->task_count--;
+		if (sched->done) sched->done(sched, task);
+	}
+
+	return JBAS_OK;
+}
+
+/**
+	Runs all tasks until they finish. Errors of the tasks are left in
+	their `status`, only errors of sched->wait are returned.
+*/
+jbas_error jbas_sched_run(jbas_sched *sched)
+{
+	while (sched->task_count)
+	{
+		jbas_error err = jbas_sched_step(sched);
+		if (err) return err;
+	}
+
+	return JBAS_OK;
+}
+
+/**
+	Called by C functions when `fd` isn't ready for `events` (POLLIN or
+	POLLOUT, fd < 0 if there's nothing to wait for). In a scheduler task,
+	JBAS_WOULD_BLOCK is returned and should be passed on - the task is
+	blocked until the descriptor is ready and the instruction is run
+	again. Otherwise the call blocks and JBAS_OK means "try again".
+*/
+jbas_error jbas_sched_wait_fd(jbas_env *env, int fd, short events)
+{
+	if (env->task)
+	{
+		env->task->wait_fd = fd;
+		env->task->wait_events = events;
+		return JBAS_WOULD_BLOCK;
+	}
+
+	if (fd < 0)
+	{
+		struct timespec ts = {0, 1000000};
+		nanosleep(&ts, NULL);
+		return JBAS_OK;
+	}
+
+	struct pollfd p = {.fd = fd, .events = events};
+	if (poll(&p, 1, -1) < 0 && errno != EINTR) return JBAS_IO_ERROR;
+	return JBAS_OK;
+}
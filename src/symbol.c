@@ -2,20 +2,26 @@
 #include <jbasic/jbasic.h>
 #include <stdlib.h>
 
-jbas_error jbas_symbol_manager_init(jbas_symbol_manager *sm, int symbol_count)
+jbas_error jbas_symbol_manager_init(jbas_symbol_manager *sm, int symbol_count, const jbas_allocator *allocator)
 {
 	sm->max_count = symbol_count;
 	sm->free_slot_count = symbol_count;
-
-	sm->symbol_storage = calloc(symbol_count, sizeof(jbas_symbol));
-	sm->is_used = calloc(symbol_count, sizeof(bool));
-	sm->free_slots = calloc(symbol_count, sizeof(int));
+	sm->allocator = allocator;
+
+	sm->symbol_storage = jbas_alloc(allocator, symbol_count * sizeof(jbas_symbol));
+	sm->is_used = jbas_alloc(allocator, symbol_count * sizeof(bool));
+	sm->free_slots = jbas_alloc(allocator, symbol_count * sizeof(int));
+	sm->used_slots = jbas_alloc(allocator, symbol_count * sizeof(int));
+	sm->used_index = jbas_alloc(allocator, symbol_count * sizeof(int));
+	sm->used_count = 0;
 	
-	if (!sm->symbol_storage)
+	if (!sm->symbol_storage || !sm->is_used || !sm->free_slots || !sm->used_slots || !sm->used_index)
 	{
-		free(sm->symbol_storage);
-		free(sm->is_used);
-		free(sm->free_slots);
+		jbas_free(allocator, sm->symbol_storage, symbol_count * sizeof(jbas_symbol));
+		jbas_free(allocator, sm->is_used, symbol_count * sizeof(bool));
+		jbas_free(allocator, sm->free_slots, symbol_count * sizeof(int));
+		jbas_free(allocator, sm->used_slots, symbol_count * sizeof(int));
+		jbas_free(allocator, sm->used_index, symbol_count * sizeof(int));
 		return JBAS_ALLOC;
 	}
 
@@ -30,13 +36,14 @@ jbas_error jbas_symbol_manager_init(jbas_symbol_manager *sm, int symbol_count)
 */
 void jbas_symbol_manager_destroy(jbas_symbol_manager *sm)
 {
-	for (int i = 0; i < sm->max_count; i++)
-		if (sm->is_used[i])
-			jbas_symbol_destroy(sm, &sm->symbol_storage[i]);
-
-	free(sm->symbol_storage);
-	free(sm->is_used);
-	free(sm->free_slots);
+	while (sm->used_count)
+		jbas_symbol_destroy(sm, &sm->symbol_storage[sm->used_slots[0]]);
+
+	jbas_free(sm->allocator, sm->symbol_storage, sm->max_count * sizeof(jbas_symbol));
+	jbas_free(sm->allocator, sm->is_used, sm->max_count * sizeof(bool));
+	jbas_free(sm->allocator, sm->free_slots, sm->max_count * sizeof(int));
+	jbas_free(sm->allocator, sm->used_slots, sm->max_count * sizeof(int));
+	jbas_free(sm->allocator, sm->used_index, sm->max_count * sizeof(int));
 }
 
 
@@ -55,12 +62,12 @@ jbas_error jbas_symbol_create(jbas_env *env, jbas_symbol **sym, const char *s, c
 	if (!sm->free_slot_count) return JBAS_SYMBOL_MANAGER_OVERFLOW;
 
 	// Look for collisions
-	for (int i = 0; i < sm->max_count; i++)
+	for (int i = 0; i < sm->used_count; i++)
 	{
-		if (!sm->is_used[i]) continue;
-		if (!jbas_namecmp(s, end, sm->symbol_storage[i].name->str, NULL))
+		jbas_symbol *cand = &sm->symbol_storage[sm->used_slots[i]];
+		if (!jbas_namecmp(s, end, cand->name->str, NULL))
 		{
-			*sym = &sm->symbol_storage[i];
+			*sym = cand;
 			return JBAS_SYMBOL_COLLISION;
 		}
 	}
@@ -73,9 +80,12 @@ jbas_error jbas_symbol_create(jbas_env *env, jbas_symbol **sym, const char *s, c
 	// Get an empty slot
 	int slot = sm->free_slots[--sm->free_slot_count];
 	sm->is_used[slot] = true;
+	sm->used_index[slot] = sm->used_count;
+	sm->used_slots[sm->used_count++] = slot;
 
 	sm->symbol_storage[slot].name = name_text;
 	sm->symbol_storage[slot].res = NULL;
+	sm->symbol_storage[slot].type = JBAS_TYPE_NONE;
 	*sym = &sm->symbol_storage[slot];
 
 	return JBAS_OK;
@@ -87,12 +97,12 @@ jbas_error jbas_symbol_create(jbas_env *env, jbas_symbol **sym, const char *s, c
 */
 jbas_error jbas_symbol_lookup(jbas_symbol_manager *sm, jbas_symbol **sym, const char *s, const char *end)
 {
-	for (int i = 0; i < sm->max_count; i++)
+	for (int i = 0; i < sm->used_count; i++)
 	{
-		if (!sm->is_used[i]) continue;
-		if (!jbas_namecmp(s, end, sm->symbol_storage[i].name->str, NULL))
+		jbas_symbol *cand = &sm->symbol_storage[sm->used_slots[i]];
+		if (!jbas_namecmp(s, end, cand->name->str, NULL))
 		{
-			*sym = &sm->symbol_storage[i];
+			*sym = cand;
 			return JBAS_OK;
 		}
 	}
@@ -107,10 +117,40 @@ jbas_error jbas_symbol_lookup(jbas_symbol_manager *sm, jbas_symbol **sym, const
 void jbas_symbol_destroy(jbas_symbol_manager *sm, jbas_symbol *sym)
 {
 	int slot = sym - sm->symbol_storage;
-	if (slot >= sm->max_count) return;
+	if (slot >= sm->max_count || !sm->is_used[slot]) return;
 
 	sm->free_slots[sm->free_slot_count++] = slot;
 	sm->is_used[slot] = false;
+
+	// Move the last used slot into the gap
+	int last = sm->used_slots[--sm->used_count];
+	sm->used_slots[sm->used_index[slot]] = last;
+	sm->used_index[last] = sm->used_index[slot];
+}
+
+/**
+	Binds C functions to symbols in the environment. The function list
+	(e.g. `jbas_symbols` of a JBASLIB library) is only read, so it can be
+	imported into many environments.
+*/
+jbas_error jbas_symbol_import(jbas_env *env, const jbas_cres *cres, int count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		// Create/get symbol
+		jbas_symbol *sym = NULL;
+		jbas_error err = jbas_symbol_create(env, &sym, cres[i].name, NULL);
+		if (err && err != JBAS_SYMBOL_COLLISION) return err;
+
+		// Create jbas resource
+		err = jbas_resource_create(&env->resource_manager, &sym->res);
+		if (err) return err;
+
+		sym->res->type = JBAS_RESOURCE_CFUN;
+		sym->res->cfun = cres[i].cfun;
+	}
+
+	return JBAS_OK;
 }
 
 
@@ -2,22 +2,24 @@
 #include <stdlib.h>
 #include <string.h>
 
-jbas_error jbas_text_manager_init(jbas_text_manager *tm, int text_count)
+jbas_error jbas_text_manager_init(jbas_text_manager *tm, int text_count, const jbas_allocator *allocator)
 {
 	tm->max_count = text_count;
 	tm->free_slot_count = text_count;
+	tm->memory = NULL;
+	tm->allocator = allocator;
 
 	// Allocate memory
-	tm->text_storage = calloc(text_count, sizeof(jbas_text));
-	tm->free_slots = calloc(text_count, sizeof(int));
-	tm->is_used = calloc(text_count, sizeof(bool));
+	tm->text_storage = jbas_alloc(allocator, text_count * sizeof(jbas_text));
+	tm->free_slots = jbas_alloc(allocator, text_count * sizeof(int));
+	tm->is_used = jbas_alloc(allocator, text_count * sizeof(bool));
 
-	// Handle calloc errors
+	// Handle allocation errors
 	if (!tm->text_storage || !tm->free_slots || !tm->is_used)
 	{
-		free(tm->text_storage);
-		free(tm->free_slots);
-		free(tm->is_used);
+		jbas_free(allocator, tm->text_storage, text_count * sizeof(jbas_text));
+		jbas_free(allocator, tm->free_slots, text_count * sizeof(int));
+		jbas_free(allocator, tm->is_used, text_count * sizeof(bool));
 		return JBAS_ALLOC;
 	}
 
@@ -31,22 +33,25 @@ jbas_error jbas_text_create(jbas_text_manager *tm, const char *s, const char *en
 {
 	if (!tm->free_slot_count) return JBAS_TEXT_MANAGER_OVERFLOW;
 
+	size_t length = end ? (size_t) (end - s) : strlen(s);
+	jbas_error err = jbas_memory_charge(tm->memory, length + 1);
+	if (err) return err;
+
+	char *str = jbas_alloc(tm->allocator, length + 1);
+	if (!str)
+	{
+		jbas_memory_release(tm->memory, length + 1);
+		return JBAS_ALLOC;
+	}
+
 	int slot = tm->free_slots[--tm->free_slot_count];
 	jbas_text *t = tm->text_storage + slot;
 	tm->is_used[slot] = true;
 
 	// Copy provided string
-	if (end)
-	{
-		t->str = calloc(end - s + 1, sizeof(char));
-		t->length = end - s;
-		memcpy(t->str, s, t->length);
-	}
-	else
-	{
-		t->str = strdup(s);
-		t->length = strlen(s);
-	}
+	memcpy(str, s, length);
+	t->str = str;
+	t->length = length;
 
 
 	// Return a pointer to the new text
@@ -103,7 +108,8 @@ jbas_error jbas_text_destroy(jbas_text_manager *tm, jbas_text *txt)
 	if (slot > tm->max_count) return JBAS_TEXT_MANAGER_MISMATCH;
 
 	// Actually delete the stored text
-	free(txt->str);
+	jbas_memory_release(tm->memory, txt->length + 1);
+	jbas_free(tm->allocator, txt->str, txt->length + 1);
 	txt->str = NULL;
 	tm->is_used[slot] = false;
 
@@ -121,9 +127,9 @@ void jbas_text_manager_destroy(jbas_text_manager *tm)
 		if (tm->is_used[i])
 			jbas_text_destroy(tm, &tm->text_storage[i]);
 
-	free(tm->text_storage);
-	free(tm->free_slots);
-	free(tm->is_used);
+	jbas_free(tm->allocator, tm->text_storage, tm->max_count * sizeof(jbas_text));
+	jbas_free(tm->allocator, tm->free_slots, tm->max_count * sizeof(int));
+	jbas_free(tm->allocator, tm->is_used, tm->max_count * sizeof(bool));
 }
 
 
@@ -1,6 +1,8 @@
 #include <jbasic/token.h>
 #include <jbasic/resource.h>
+#include <jbasic/memo.h>
 #include <stdlib.h>
+#include <string.h>
 
 /**
 	Moves token data - the source token is invalidated
@@ -67,8 +69,16 @@ jbas_error jbas_token_copy(jbas_token *dest, jbas_token *src, jbas_token_pool *p
 		}
 	}
 
+	// Parentheses with a valid cached value are copied as the value itself
+	if (src->type == JBAS_TOKEN_PAREN && src->paren_token.memo && src->paren_token.memo->valid
+		&& src->paren_token.memo->kind == JBAS_MEMO_VALUE)
+	{
+		tmp.type = JBAS_TOKEN_NUMBER;
+		tmp.number_token = src->paren_token.memo->value;
+	}
+
 	// Copy source parentheses contents - recursively
-	if (src->type == JBAS_TOKEN_PAREN)
+	else if (src->type == JBAS_TOKEN_PAREN)
 	{
 		tmp.paren_token.tokens = NULL;
 		for (jbas_token *t = jbas_token_list_begin(src->paren_token.tokens); t; t = t->r)
@@ -121,6 +131,9 @@ jbas_error jbas_token_pool_get(jbas_token_pool *pool, jbas_token **t)
 {
 	if (!pool->unused_count) return JBAS_TOKEN_POOL_EMPTY;
 	*t = pool->unused_stack[--pool->unused_count];
+	if (pool->unused_count < pool->low_count) pool->low_count = pool->unused_count;
+	if (pool->unused_count < pool->min_count) pool->min_count = pool->unused_count;
+	pool->taken++;
 	// fprintf(stderr, "\ngot %p from pool\n", *t);
 	return JBAS_OK;
 }
@@ -129,21 +142,27 @@ jbas_error jbas_token_pool_return(jbas_token_pool *pool, jbas_token *t)
 {
 	if (pool->unused_count >= pool->pool_size) return JBAS_TOKEN_POOL_OVERFLOW;
 	pool->unused_stack[pool->unused_count++] = t;
+	pool->returned++;
 	// fprintf(stderr, "\nreturned %p to pool\n", t);
 	return JBAS_OK;
 }
 
 
-jbas_error jbas_token_pool_init(jbas_token_pool *pool, int size)
+jbas_error jbas_token_pool_init(jbas_token_pool *pool, int size, const jbas_allocator *allocator)
 {
 	pool->pool_size = pool->unused_count = size;
-	pool->tokens = calloc(size, sizeof(jbas_token));
-	pool->unused_stack = calloc(size, sizeof(jbas_token*));
+	pool->mark_stack = NULL;
+	pool->mark_count = pool->low_count = size;
+	pool->taken = pool->returned = 0;
+	pool->min_count = size;
+	pool->allocator = allocator;
+	pool->tokens = jbas_alloc(allocator, size * sizeof(jbas_token));
+	pool->unused_stack = jbas_alloc(allocator, size * sizeof(jbas_token*));
 	
 	if (!pool->tokens || !pool->unused_stack)
 	{
-		free(pool->tokens);
-		free(pool->unused_stack);
+		jbas_free(allocator, pool->tokens, size * sizeof(jbas_token));
+		jbas_free(allocator, pool->unused_stack, size * sizeof(jbas_token*));
 		return JBAS_ALLOC;
 	}
 
@@ -158,11 +177,47 @@ jbas_error jbas_token_pool_init(jbas_token_pool *pool, int size)
 
 jbas_error jbas_token_pool_destroy(jbas_token_pool *pool)
 {
-	free(pool->tokens);
-	free(pool->unused_stack);
+	jbas_free(pool->allocator, pool->tokens, pool->pool_size * sizeof(jbas_token));
+	jbas_free(pool->allocator, pool->unused_stack, pool->pool_size * sizeof(jbas_token*));
+	jbas_free(pool->allocator, pool->mark_stack, pool->pool_size * sizeof(jbas_token*));
 	return JBAS_ALLOC;
 }
 
+/**
+	Remembers which tokens are unused, so jbas_token_pool_rewind() can
+	return all tokens taken from the pool since then
+*/
+jbas_error jbas_token_pool_mark(jbas_token_pool *pool)
+{
+	if (!pool->mark_stack)
+	{
+		pool->mark_stack = jbas_alloc(pool->allocator, pool->pool_size * sizeof(jbas_token*));
+		if (!pool->mark_stack) return JBAS_ALLOC;
+	}
+
+	memcpy(pool->mark_stack, pool->unused_stack, pool->unused_count * sizeof(jbas_token*));
+	pool->mark_count = pool->low_count = pool->unused_count;
+	return JBAS_OK;
+}
+
+/**
+	Returns the pool to the marked state. The stack below the lowest
+	point it has reached since has not been touched, so only the part
+	above it has to be restored - the cost depends on how many tokens
+	have been used, not on the pool size.
+*/
+void jbas_token_pool_rewind(jbas_token_pool *pool)
+{
+	if (!pool->mark_stack) return;
+
+	if (pool->low_count < pool->mark_count)
+		memcpy(pool->unused_stack + pool->low_count,
+			pool->mark_stack + pool->low_count,
+			(pool->mark_count - pool->low_count) * sizeof(jbas_token*));
+
+	pool->unused_count = pool->low_count = pool->mark_count;
+}
+
 // --------------------------------------
 
 
@@ -0,0 +1,8 @@
+IDIM a (10)
+i = 0
+n = 12
+while i < n
+	a(i) = i * 2
+	i = i + 1
+end
+println "unreachable"
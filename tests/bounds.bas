@@ -0,0 +1,37 @@
+# bounds check hoisting
+w = 6
+h = 4
+IDIM a (w*h)
+FDIM f (w)
+y = 0
+while y < h
+	x = 0
+	while x < w
+		a(y*w+x) = y * 10 + x
+		x = x + 1
+		f(x - 1) = x * 0.5
+	end
+	y = y + 1
+end
+s = 0
+i = w*h - 1
+while i >= 0
+	s = s + a(i) * 2 - a(w*h - 1 - i)
+	i = i - 1
+end
+println s
+i = 0
+while 6 > i
+	v = f(i)
+	print v; print " "
+	i = i + 2
+end
+println ""
+# Starts in range but ends out of range
+i = 0
+while i <= w
+	v = a(i + 18)
+	print v; print " "
+	i = i + 1
+end
+println "unreachable"
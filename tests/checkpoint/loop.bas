@@ -0,0 +1,32 @@
+# Runs for a few seconds and prints only at the end, so a run killed
+# after a checkpoint and restored prints the same as an uninterrupted one.
+# PRINT keeps the inner loop interpreted even with -jit, the compiled
+# one would finish before the first checkpoint.
+IDIM a (1000)
+FDIM f (1000)
+n = 0
+s = 0
+x = 0.5
+while n < 1500
+	i = 0
+	while i < 1000
+		if i mod 3 == 0
+			a(i) = a(i) + n
+		else
+			if n mod 2 == 0
+				s = (s + a(i - 1)) mod 1000000
+			else
+				f(i) = f(i) + x
+			end
+		end
+		i = i + 1
+		print ""
+	end
+	x = x * 1.001
+	n = n + 1
+end
+println s
+y = f(1) + f(2)
+println y
+z = a(999)
+println z
@@ -0,0 +1,64 @@
+#ifndef JBASIC_TESTS_COMMON_H
+#define JBASIC_TESTS_COMMON_H
+
+#include <jbasic/jbasic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <dlfcn.h>
+
+/*
+	Helpers shared by the test drivers
+*/
+
+/**
+	Reads the whole file into a NUL-terminated buffer (NULL on failure)
+*/
+static inline char *test_read_file(const char *filename)
+{
+	FILE *f = fopen(filename, "rb");
+	if (!f) return NULL;
+
+	char *data = NULL;
+	size_t size = 0;
+	FILE *m = open_memstream(&data, &size);
+	char buf[4096];
+	size_t n;
+	while (m && (n = fread(buf, 1, sizeof(buf), f)))
+		fwrite(buf, 1, n, m);
+	fclose(f);
+	if (m) fclose(m);
+	return data;
+}
+
+/**
+	Loads the C functions of JBASLIB and returns their count (0 when
+	JBASLIB isn't set). Exits when the library can't be loaded or has
+	been built for a different interpreter version.
+*/
+static inline int test_load_lib(const jbas_cres **cres)
+{
+	*cres = NULL;
+	const char *libname = getenv("JBASLIB");
+	if (!libname) return 0;
+
+	void *handle = dlopen(libname, RTLD_NOW);
+	if (!handle)
+	{
+		fprintf(stderr, "could not load %s: %s\n", libname, dlerror());
+		exit(EXIT_FAILURE);
+	}
+
+	int *abi = dlsym(handle, "jbas_abi_version");
+	if (!abi || *abi != JBAS_ABI_VERSION)
+	{
+		fprintf(stderr, "%s: built for a different interpreter version (ABI %d, expected %d)\n",
+			libname, abi ? *abi : 0, JBAS_ABI_VERSION);
+		exit(EXIT_FAILURE);
+	}
+
+	*cres = dlsym(handle, "jbas_symbols");
+	int *count = dlsym(handle, "jbas_symbol_count");
+	return *cres && count ? *count : 0;
+}
+
+#endif
@@ -0,0 +1,15 @@
+IDIM m (16)
+i = 0
+while i < 16
+	m(i) = i mod 5
+	i = i + 1
+end
+i = 1
+c = 0
+while i < 15
+	c = c + (m((i-1) mod 16) == 2) + (m((i+1) mod 16) == 2) + (m((i-1) mod 16) == 3)
+	m(i) = m((i-1) mod 16) + 1
+	c = c + (m((i-1) mod 16) == 3) + m(i)
+	i = i + 1
+end
+println c
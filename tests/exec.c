@@ -0,0 +1,150 @@
+#include <jbasic/jbasic.h>
+#include <jbasic/program.h>
+#include <jbasic/opt.h>
+#include "common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/*
+	Compiles every script once and runs the shared program in fresh
+	environments on THREADS threads at once, each of them RUNS times.
+	All the outputs must be the same as the first one. The scripts read
+	INPUT and get the C functions of JBASLIB.
+
+	Usage: exec THREADS RUNS INPUT SCRIPT...
+*/
+
+static const char *input;
+static size_t input_size;
+static const jbas_cres *cres;
+static int cres_count;
+static int runs;
+
+typedef struct job
+{
+	const jbas_program *program;
+	const char *expected;
+	size_t expected_size;
+	int failed;
+	pthread_t thread;
+} job;
+
+/**
+	Runs the program in a new environment
+*/
+static char *exec_program(const jbas_program *program, size_t *size)
+{
+	char *output = NULL;
+	jbas_env env;
+	jbas_error err = jbas_env_init(&env, 100000, 10000, 10000, 10000, 10000);
+	env.input = fmemopen((void*) input, input_size, "r");
+	env.output = open_memstream(&output, size);
+
+	if (!err && cres) err = jbas_symbol_import(&env, cres, cres_count);
+	if (!err) err = jbas_exec(&env, program);
+
+	fprintf(env.output, "status %d\n", err);
+	fclose(env.output);
+	fclose(env.input);
+	jbas_env_destroy(&env);
+	return output;
+}
+
+static void *run(void *arg)
+{
+	job *j = arg;
+	for (int i = 0; i < runs; i++)
+	{
+		size_t size;
+		char *output = exec_program(j->program, &size);
+		if (size != j->expected_size || memcmp(output, j->expected, size)) j->failed++;
+		free(output);
+	}
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	int threads = argc > 4 ? atoi(argv[1]) : 0;
+	runs = argc > 4 ? atoi(argv[2]) : 0;
+	if (threads <= 0 || runs <= 0)
+	{
+		fprintf(stderr, "Usage: %s THREADS RUNS INPUT SCRIPT...\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	cres_count = test_load_lib(&cres);
+
+	if (!(input = test_read_file(argv[3])))
+	{
+		perror(argv[3]);
+		return EXIT_FAILURE;
+	}
+	input_size = strlen(input);
+
+	job *jobs = calloc(threads, sizeof(job));
+	if (!jobs)
+	{
+		perror("exec");
+		return EXIT_FAILURE;
+	}
+
+	int failed = 0;
+	for (int s = 4; s < argc; s++)
+	{
+		char *source = test_read_file(argv[s]);
+		if (!source)
+		{
+			perror(argv[s]);
+			return EXIT_FAILURE;
+		}
+
+		// The environment is only needed for compiling
+		jbas_program *program = NULL;
+		jbas_env env;
+		jbas_error err = jbas_env_init(&env, 100000, 10000, 10000, 10000, 10000);
+		if (!err && cres) err = jbas_symbol_import(&env, cres, cres_count);
+		if (!err) err = jbas_compile(&env, source, JBAS_OPT_ALL, &program);
+		jbas_env_destroy(&env);
+		free(source);
+		if (err)
+		{
+			fprintf(stderr, "exec: %s: compile error %d\n", argv[s], err);
+			failed++;
+			continue;
+		}
+
+		size_t expected_size;
+		char *expected = exec_program(program, &expected_size);
+		for (int i = 0; i < threads; i++)
+		{
+			jobs[i] = (job){.program = program, .expected = expected, .expected_size = expected_size};
+			if (pthread_create(&jobs[i].thread, NULL, run, &jobs[i]))
+			{
+				perror("could not start a thread");
+				return EXIT_FAILURE;
+			}
+		}
+
+		int mismatches = 0;
+		for (int i = 0; i < threads; i++)
+		{
+			pthread_join(jobs[i].thread, NULL);
+			mismatches += jobs[i].failed;
+		}
+		if (mismatches)
+		{
+			fprintf(stderr, "exec: %s: %d of %d runs differ\n", argv[s], mismatches, threads * runs);
+			failed++;
+		}
+
+		free(expected);
+		jbas_program_destroy(program);
+	}
+
+	free(jobs);
+	free((void*) input);
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
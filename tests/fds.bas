@@ -0,0 +1,22 @@
+# FREAD, FWRITE and FCLOSE only take the descriptors opened by FOPEN
+IDIM buf (100)
+n = FREAD(0, buf, 1)
+println n
+n = FWRITE(1, buf, 1)
+println n
+n = FCLOSE(2)
+println n
+f = FOPEN("tests/missing.txt", 0)
+println f
+f = FOPEN("tests/fds.bas", 0)
+total = 0
+n = 1
+while n > 0
+	n = FREAD(f, buf, 100)
+	total = total + n
+end
+println total
+n = FCLOSE(f)
+println n
+n = FCLOSE(f)
+println n
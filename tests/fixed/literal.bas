@@ -0,0 +1,3 @@
+# A literal out of the Q16.16 range is refused when the script is loaded
+println 1
+x = 100000.0
@@ -0,0 +1,23 @@
+# Q16.16 results out of the range saturate and division by zero doesn't trap
+x = 1.0 / 0.0
+println x
+x = -1.0 / 0.0
+println x
+x = 0.0 / 0.0
+println x
+x = 5.5 mod 0.0
+println x
+a = 300.0
+x = a * a
+println x
+x = 30000.0 + 30000.0
+println x
+x = -30000.0 - 30000.0
+println x
+i = 100000
+x = i + 0.5
+println x
+x = 7.5 mod 2.0
+println x
+x = 7.0 / 2.0
+println x
@@ -0,0 +1,46 @@
+# FLOAT arithmetic, comparisons and FDIM arrays in compiled loops
+# (the values are exact in Q16.16 too)
+n = 10
+FDIM f (n)
+IDIM k (n)
+i = 0
+while i < n
+	f(i) = i * 0.25 - 1
+	k(i) = f(i) * 3
+	i = i + 1
+end
+x = 0.0
+y = 1.0
+i = 0
+while i < n
+	x = x + f(i) / 4 - -y
+	y = y * 2 - 0.5
+	if f(i) >= 0 && i != 9
+		x = x - 0.125
+	end
+	if f(i) <= k(i)
+		x = x + 2
+	end
+	f(k(i) + 3) = x
+	i = i + 1
+end
+println x
+println y
+i = 0
+while i < n
+	v = f(i)
+	print v; print " "
+	v = k(i)
+	print v; print " "
+	i = i + 1
+end
+println ""
+# INT and FLOAT operands mixed in a condition
+s = 1.5
+c = 0
+while s > -2 && c < 10
+	s = s - 0.75
+	c = c + 1
+end
+println s
+println c
@@ -0,0 +1,15 @@
+w = 3
+y = 0.5
+s = 0
+while y < 4
+	s = s + y * w
+	y = y + 1
+end
+println s
+y = 0
+while y < 4
+	s = s + y * w
+	y = y + 1
+	w = 2.5
+end
+println s
@@ -0,0 +1,16 @@
+# Copies the FIFO "fifo" into "copy.txt" (run in a temporary directory by tests/run.sh)
+IDIM buf (100)
+f = FOPEN("fifo", 0)
+o = FOPEN("copy.txt", 1)
+total = 0
+n = 1
+while n > 0
+	n = FREAD(f, buf, 100)
+	if n > 0
+		w = FWRITE(o, buf, n)
+		total = total + w
+	end
+end
+FCLOSE(f)
+FCLOSE(o)
+println total
@@ -0,0 +1,5 @@
+# 4 MB fit in -memory-limit 16 (the tables take about 6 MB), 16 MB more do not
+IDIM a (1000000)
+println "fits"
+IDIM b (4000000)
+println "unreachable"
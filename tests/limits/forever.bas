@@ -0,0 +1,5 @@
+# Never ends - stopped by -budget
+i = 0
+while 1
+	i = i + 1
+end
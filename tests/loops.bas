@@ -0,0 +1,52 @@
+# nested loops with invariants
+w = 7
+h = 5
+IDIM a (w*h)
+FDIM f (w*h)
+y = 0
+while y < h
+	x = 0
+	while x < w
+		a(y*w+x) = (y*w+x) * 3 - (w*2) mod 5
+		f(y*w+x) = (y + 0.5) * (w / 2.0) + x
+		x = x + 1
+	end
+	y = y + 1
+end
+s = 0
+t = 0.0
+i = 0
+while i < w*h
+	s = s + a(i) * (h + 1) + (w*h - 1)
+	t = t + f(i) / (w + 1)
+	i = i + 1
+end
+println s
+println t
+k = 10
+while k > 0
+	k = k - 3
+	print k * w; print " "
+end
+println ""
+z = 1
+z = z and 0
+println z
+q = 3
+while q
+	q = q - 1
+	if q == 1
+		println "one"
+	else
+		println q * (w + h)
+	end
+end
+(u, v) = (4, 5.5)
+println u + v
+b = 2 < 3
+println b
+println -(2 + 3) * 4
+println 7 / 2
+println 7.0 / 2
+println -7 mod 3
+println -7 % 3
@@ -0,0 +1,10 @@
+# Starts in range and runs below 0 - the error must come at a(-1)
+IDIM a (4)
+i = 3
+while i >= 0
+	a(i - 1) = i
+	v = a(i - 1)
+	print v; print " "
+	i = i - 1
+end
+println "unreachable"
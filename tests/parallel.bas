@@ -0,0 +1,46 @@
+# PARALLEL FOR: nested blocks, int and float REDUCE, empty range, errors
+IDIM a (100)
+FDIM f (100)
+s = 0
+t = 0.5
+PARALLEL FOR i = 0 TO 99 REDUCE + s REDUCE + t
+	j = 0
+	while j < 3
+		if (i + j) mod 2 == 0
+			a(i) = a(i) + j
+		else
+			f(i) = f(i) + 0.25
+		end
+		j = j + 1
+	end
+	s = s + i
+	t = t + 0.5
+END
+println s
+println t
+println i
+k = 0
+c = 0
+while k < 100
+	c = c + a(k)
+	k = k + 1
+end
+println c
+x = 0.0
+k = 0
+while k < 100
+	x = x + f(k)
+	k = k + 1
+end
+println x
+e = 7
+PARALLEL FOR i = 5 TO 4 REDUCE + e
+	e = e + 100
+END
+println e
+println i
+# The error is raised in a worker
+PARALLEL FOR i = 0 TO 99
+	a(i * 2) = 1
+END
+println "unreachable"
@@ -0,0 +1,296 @@
+#include <jbasic/jbasic.h>
+#include <jbasic/program.h>
+#include <jbasic/sched.h>
+#include <jbasic/opt.h>
+#include "common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+/*
+	Runs many scripts reading pipes on one scheduler thread. Another
+	thread writes the pipes in small chunks in random order, so the
+	scripts keep blocking in FREAD and the epoll loop has to wake them.
+	Every script must see all of its bytes, and the descriptors it
+	hasn't closed must be closed with its environment. Then a script
+	whose FREAD blocks after an FWRITE in the same instruction checks
+	that the FWRITE isn't made again when the instruction is rerun.
+	Needs JBASLIB.
+
+	Usage: pipes [JIT]
+*/
+
+#define PIPES_TASKS 200
+#define PIPES_BYTES 3000
+
+static const char pipes_script[] =
+	"IDIM buf (64)\n"
+	"f = INFD()\n"
+	"sum = 0\n"
+	"count = 0\n"
+	"n = 1\n"
+	"while n > 0\n"
+	"	n = FREAD(f, buf, 64)\n"
+	"	i = 0\n"
+	"	while i < n\n"
+	"		sum = sum + buf(i)\n"
+	"		i = i + 1\n"
+	"	end\n"
+	"	count = count + n\n"
+	"end\n"
+	"print sum\n"
+	"print \" \"\n"
+	"println count\n";
+
+static jbas_task tasks[PIPES_TASKS];
+static jbas_env envs[PIPES_TASKS];
+static int read_fds[PIPES_TASKS], write_fds[PIPES_TASKS];
+
+static unsigned char pipes_byte(int task, int offset)
+{
+	return offset * 7 + task;
+}
+
+/**
+	INFD() - the read end of the task's pipe
+*/
+static jbas_error pipes_infd(jbas_env *env, jbas_token *args, jbas_token *res)
+{
+	res->type = JBAS_TOKEN_NUMBER;
+	res->number_token.type = JBAS_NUM_INT;
+	res->number_token.i = *(int*) env->task->data;
+	return JBAS_OK;
+}
+
+/**
+	OUTFD() - the write end of the rerun test's output pipe
+*/
+static jbas_error pipes_outfd(jbas_env *env, jbas_token *args, jbas_token *res)
+{
+	res->type = JBAS_TOKEN_NUMBER;
+	res->number_token.type = JBAS_NUM_INT;
+	res->number_token.i = ((int*) env->task->data)[1];
+	return JBAS_OK;
+}
+
+static const char pipes_rerun_script[] =
+	"IDIM buf (1)\n"
+	"buf(0) = 42\n"
+	"n = FWRITE(OUTFD(), buf, 1) + FREAD(INFD(), buf, 1)\n"
+	"println n\n";
+
+static int rerun_waits;
+
+/**
+	Called once the rerun test's task has blocked in FREAD - gives it a byte
+*/
+static jbas_error pipes_rerun_wait(jbas_sched *sched)
+{
+	if (!rerun_waits++ && write(*(int*) sched->data, "x", 1) != 1)
+		return JBAS_IO_ERROR;
+	return jbas_sched_poll(sched, -1);
+}
+
+/**
+	Runs pipes_rerun_script and returns the number of failures
+*/
+static int pipes_rerun(const jbas_cres *cres, int cres_count, const jbas_cres *pipes_cres, int jit)
+{
+	int in[2], out[2];
+	if (pipe(in) || pipe(out) || fcntl(in[0], F_SETFL, O_NONBLOCK) || fcntl(out[0], F_SETFL, O_NONBLOCK))
+	{
+		perror("pipes: pipe");
+		exit(EXIT_FAILURE);
+	}
+
+	char *output = NULL;
+	size_t output_size = 0;
+	int data[2] = {in[0], out[1]};
+	jbas_task task = {.data = data};
+	jbas_sched sched;
+	jbas_sched_init(&sched);
+	sched.wait = pipes_rerun_wait;
+	sched.data = &in[1];
+
+	jbas_program *program = NULL;
+	jbas_env env;
+	jbas_error err = jbas_env_init(&env, 1000, 1000, 1000, 1000, 1000);
+	env.jit_threshold = jit;
+	if (!err) err = jbas_symbol_import(&env, cres, cres_count);
+	if (!err) err = jbas_symbol_import(&env, pipes_cres, 2);
+	if (!err) err = jbas_compile(&env, pipes_rerun_script, JBAS_OPT_ALL, &program);
+	if (!err) err = jbas_link(&env, program);
+	if (!err) err = jbas_env_add_fd(&env, in[0]);
+	if (!err) err = jbas_env_add_fd(&env, out[1]);
+	if (err)
+	{
+		fprintf(stderr, "pipes: could not set up the rerun test (error %d)\n", err);
+		exit(EXIT_FAILURE);
+	}
+
+	env.output = open_memstream(&output, &output_size);
+	jbas_sched_add(&sched, &task, &env);
+	err = jbas_sched_run(&sched);
+	fclose(env.output);
+	jbas_env_destroy(&env);
+
+	// The environment has closed the write end, so the read stops at the end
+	char written[16];
+	ssize_t n = read(out[0], written, sizeof(written));
+
+	int failed = 0;
+	if (err || task.status || rerun_waits != 1 || strcmp(output, "2\n") || n != 1)
+	{
+		fprintf(stderr, "pipes: rerun: error %d, status %d, %d waits, output '%s', %zd bytes written (expected 1)\n",
+			err, task.status, rerun_waits, output, n);
+		failed++;
+	}
+
+	free(output);
+	close(in[1]);
+	close(out[0]);
+	jbas_sched_destroy(&sched);
+	jbas_program_destroy(program);
+	return failed;
+}
+
+static void *pipes_writer(void *arg)
+{
+	int sent[PIPES_TASKS] = {0};
+	int left = PIPES_TASKS;
+	unsigned rnd = 7;
+	while (left)
+	{
+		rnd = rnd * 1103515245 + 12345;
+		int i = (rnd >> 8) % PIPES_TASKS;
+		if (sent[i] == PIPES_BYTES) continue;
+
+		unsigned char chunk[100];
+		int size = 1 + (rnd >> 20) % sizeof(chunk);
+		if (size > PIPES_BYTES - sent[i]) size = PIPES_BYTES - sent[i];
+		for (int k = 0; k < size; k++)
+			chunk[k] = pipes_byte(i, sent[i] + k);
+
+		if (write(write_fds[i], chunk, size) != size)
+		{
+			perror("pipes: write");
+			exit(EXIT_FAILURE);
+		}
+
+		sent[i] += size;
+		if (sent[i] == PIPES_BYTES)
+		{
+			close(write_fds[i]);
+			left--;
+		}
+
+		// Let the scripts run dry now and then
+		if ((rnd >> 4) % 50 == 0) nanosleep(&(struct timespec){.tv_nsec = 200000}, NULL);
+	}
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	const jbas_cres *cres;
+	int cres_count = test_load_lib(&cres);
+	if (!cres_count)
+	{
+		fprintf(stderr, "pipes: JBASLIB must be set to stdjbas\n");
+		return EXIT_FAILURE;
+	}
+	jbas_cres pipes_cres[2] = {{.name = "INFD", .cfun = pipes_infd}, {.name = "OUTFD", .cfun = pipes_outfd}};
+
+	jbas_program *program = NULL;
+	jbas_env tmpl;
+	jbas_error err = jbas_env_init(&tmpl, 1000, 1000, 1000, 1000, 1000);
+	if (!err) err = jbas_symbol_import(&tmpl, cres, cres_count);
+	if (!err) err = jbas_symbol_import(&tmpl, pipes_cres, 1);
+	if (!err) err = jbas_compile(&tmpl, pipes_script, JBAS_OPT_ALL, &program);
+	jbas_env_destroy(&tmpl);
+	if (err)
+	{
+		fprintf(stderr, "pipes: compile error %d\n", err);
+		return EXIT_FAILURE;
+	}
+
+	char *outputs[PIPES_TASKS];
+	size_t output_sizes[PIPES_TASKS];
+	jbas_sched sched;
+	jbas_sched_init(&sched);
+	for (int i = 0; i < PIPES_TASKS; i++)
+	{
+		int fds[2];
+		if (pipe(fds) || fcntl(fds[0], F_SETFL, O_NONBLOCK))
+		{
+			perror("pipes: pipe");
+			return EXIT_FAILURE;
+		}
+		read_fds[i] = fds[0];
+		write_fds[i] = fds[1];
+
+		jbas_env *env = &envs[i];
+		err = jbas_env_init(env, 1000, 1000, 1000, 1000, 1000);
+		env->jit_threshold = argc > 1 ? atoi(argv[1]) : 0;
+		if (!err) err = jbas_symbol_import(env, cres, cres_count);
+		if (!err) err = jbas_symbol_import(env, pipes_cres, 1);
+		if (!err) err = jbas_link(env, program);
+		if (!err) err = jbas_env_add_fd(env, read_fds[i]);
+		if (err)
+		{
+			fprintf(stderr, "pipes: could not set up task %d (error %d)\n", i, err);
+			return EXIT_FAILURE;
+		}
+
+		env->output = open_memstream(&outputs[i], &output_sizes[i]);
+		tasks[i].data = &read_fds[i];
+		jbas_sched_add(&sched, &tasks[i], env);
+	}
+
+	pthread_t writer;
+	if (pthread_create(&writer, NULL, pipes_writer, NULL))
+	{
+		perror("could not start the writer");
+		return EXIT_FAILURE;
+	}
+	err = jbas_sched_run(&sched);
+	pthread_join(writer, NULL);
+
+	int failed = err != JBAS_OK;
+	if (err) fprintf(stderr, "pipes: scheduler error %d\n", err);
+	for (int i = 0; i < PIPES_TASKS; i++)
+	{
+		long sum = 0;
+		for (int k = 0; k < PIPES_BYTES; k++)
+			sum += pipes_byte(i, k);
+		char expected[64];
+		snprintf(expected, sizeof(expected), "%ld %d\n", sum, PIPES_BYTES);
+
+		fclose(envs[i].output);
+		if (tasks[i].status || strcmp(outputs[i], expected))
+		{
+			fprintf(stderr, "pipes: task %d: status %d, output '%s', expected '%s'\n", i, tasks[i].status, outputs[i], expected);
+			failed++;
+		}
+		free(outputs[i]);
+
+		// The script hasn't closed its pipe
+		jbas_env_destroy(&envs[i]);
+		if (fcntl(read_fds[i], F_GETFD) != -1 || errno != EBADF)
+		{
+			fprintf(stderr, "pipes: task %d: the pipe was left open\n", i);
+			failed++;
+		}
+	}
+
+	jbas_sched_destroy(&sched);
+	jbas_program_destroy(program);
+
+	failed += pipes_rerun(cres, cres_count, pipes_cres, argc > 1 ? atoi(argv[1]) : 0);
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,110 @@
+#include <jbasic/jbasic.h>
+#include <jbasic/program.h>
+#include <jbasic/opt.h>
+#include "common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+	Runs every script RUNS times in one environment, which is reset with
+	jbas_env_reset() in between. Every output must be the same as the
+	first one, and the pool, the resources and the memory in use must
+	be back where they were after the first reset. The scripts read
+	INPUT and get the C functions of JBASLIB.
+
+	Usage: reset RUNS INPUT SCRIPT...
+*/
+
+int main(int argc, char *argv[])
+{
+	int runs = argc > 3 ? atoi(argv[1]) : 0;
+	if (runs <= 0)
+	{
+		fprintf(stderr, "Usage: %s RUNS INPUT SCRIPT...\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	const jbas_cres *cres;
+	int cres_count = test_load_lib(&cres);
+
+	char *input = test_read_file(argv[2]);
+	if (!input)
+	{
+		perror(argv[2]);
+		return EXIT_FAILURE;
+	}
+
+	int failed = 0;
+	for (int s = 3; s < argc; s++)
+	{
+		char *source = test_read_file(argv[s]);
+		if (!source)
+		{
+			perror(argv[s]);
+			return EXIT_FAILURE;
+		}
+
+		jbas_program *program = NULL;
+		jbas_env env;
+		jbas_error err = jbas_env_init(&env, 100000, 10000, 10000, 10000, 10000);
+		if (!err && cres) err = jbas_symbol_import(&env, cres, cres_count);
+		if (!err) err = jbas_compile(&env, source, JBAS_OPT_ALL, &program);
+		free(source);
+		if (err)
+		{
+			fprintf(stderr, "reset: %s: compile error %d\n", argv[s], err);
+			jbas_env_destroy(&env);
+			failed++;
+			continue;
+		}
+
+		char *first = NULL;
+		size_t first_size = 0;
+		int unused_count = 0, ref_count = 0;
+		size_t memory_used = 0;
+		int mismatches = 0, leaks = 0;
+		for (int i = 0; i < runs; i++)
+		{
+			char *output = NULL;
+			size_t size = 0;
+			env.input = fmemopen(input, strlen(input), "r");
+			env.output = open_memstream(&output, &size);
+			err = jbas_exec(&env, program);
+			fprintf(env.output, "status %d\n", err);
+			fclose(env.input);
+			fclose(env.output);
+			jbas_env_reset(&env);
+
+			if (!i)
+			{
+				first = output;
+				first_size = size;
+				unused_count = env.token_pool.unused_count;
+				ref_count = env.resource_manager.ref_count;
+				memory_used = env.memory.used;
+				continue;
+			}
+
+			if (size != first_size || memcmp(output, first, size)) mismatches++;
+			if (env.token_pool.unused_count != unused_count || env.resource_manager.ref_count != ref_count
+				|| env.memory.used != memory_used)
+				leaks++;
+			free(output);
+		}
+
+		if (mismatches || leaks)
+		{
+			fprintf(stderr, "reset: %s: %d of %d runs differ, %d leave more behind than the first one\n",
+				argv[s], mismatches, runs, leaks);
+			failed++;
+		}
+
+		free(first);
+		jbas_program_destroy(program);
+		jbas_env_destroy(&env);
+	}
+
+	free(input);
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
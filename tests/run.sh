@@ -0,0 +1,214 @@
+#!/bin/sh
+# Regression tests (make test)
+#
+# Every tests/*.bas is run without the optimizer (-noopt), with it and
+# with the JIT compiling every loop (-jit=1). The output followed by
+# "exit STATUS" must be tests/NAME.out in all of them. The input is
+# tests/NAME.in (empty if there's none). The static interpreters (jbs
+# and jbs-fixed), the images written by jbi -c and the programs
+# translated by jbc run them too. The C drivers test the library API
+# and are built by make test.
+
+cd "$(dirname "$0")/.." || exit 1
+root=$(pwd)
+export JBASLIB="$root/libs/stdjbas.so"
+tmp=$(mktemp -d) || exit 1
+trap 'rm -rf "$tmp"' EXIT
+failed=0
+
+fail()
+{
+	echo "FAIL $*"
+	failed=$((failed + 1))
+}
+
+# check SCRIPT [JBI SWITCHES...] - runs tests/SCRIPT.bas and compares with tests/SCRIPT.out
+check()
+{
+	n=${1%.bas}
+	shift
+	input=/dev/null
+	[ -f "$n.in" ] && input=$n.in
+	{ timeout 60 ./jbi "$n.bas" -nocache "$@" < "$input" 2> /dev/null; echo "exit $?"; } > "$tmp/out"
+	cmp -s "$n.out" "$tmp/out" || { fail "$n.bas $*"; diff "$n.out" "$tmp/out" | head -5; }
+}
+
+for f in tests/*.bas; do
+	for mode in -noopt "" -jit=1; do
+		check "$f" $mode
+	done
+done
+
+# PARALLEL FOR on one thread and on a pool
+for threads in 1 4; do
+	for mode in -noopt "" -jit=1; do
+		check tests/parallel.bas -threads $threads $mode
+	done
+done
+
+# tests/io/fifo.bas copies a FIFO into a file in a temporary directory
+mkdir "$tmp/fifo" && head -c 5000 /dev/urandom > "$tmp/fifo/data"
+for mode in -noopt "" -jit=1; do
+	rm -f "$tmp/fifo/fifo" "$tmp/fifo/copy.txt"
+	mkfifo "$tmp/fifo/fifo" || exit 1
+	timeout 60 sh -c "cat '$tmp/fifo/data' > '$tmp/fifo/fifo'" &
+	out=$(cd "$tmp/fifo" && timeout 60 "$root/jbi" "$root/tests/io/fifo.bas" -nocache $mode 2> /dev/null)
+	wait
+	[ "$out" = 5000 ] && cmp -s "$tmp/fifo/data" "$tmp/fifo/copy.txt" || fail "tests/io/fifo.bas ${mode:-(default)}"
+done
+
+# A run killed after a checkpoint continues in a new process with -restore
+for mode in -noopt "" -jit=1; do
+	rm -f "$tmp/checkpoint"
+	./jbi tests/checkpoint/loop.bas -nocache $mode -checkpoint "$tmp/checkpoint" -checkpoint-every 1 > /dev/null 2>&1 &
+	sleep 1.5
+	kill -9 $! 2> /dev/null
+	wait
+	timeout 60 ./jbi tests/checkpoint/loop.bas -nocache $mode -restore "$tmp/checkpoint" > "$tmp/out" 2> /dev/null
+	cmp -s tests/checkpoint/loop.out "$tmp/out" || fail "tests/checkpoint/loop.bas -restore ${mode:-(default)}"
+done
+
+# A checkpoint of another program is refused with JBAS_BAD_CHECKPOINT
+./jbi tests/cse.bas -nocache -restore "$tmp/checkpoint" 2>&1 > /dev/null | grep -q "^restore error 35:" \
+	|| fail "tests/cse.bas -restore of another program's checkpoint"
+
+# -budget stops a runaway loop with JBAS_BUDGET_EXHAUSTED, compiled or not
+for mode in -noopt "" -jit=1; do
+	{ timeout 60 ./jbi tests/limits/forever.bas -nocache $mode -budget 100000 < /dev/null 2>&1; echo "exit $?"; } > "$tmp/out"
+	cmp -s tests/limits/forever.out "$tmp/out" || { fail "tests/limits/forever.bas -budget ${mode:-(default)}"; diff tests/limits/forever.out "$tmp/out" | head -5; }
+done
+
+# -memory-limit refuses an IDIM over the limit with JBAS_MEMORY_LIMIT
+for mode in -noopt "" -jit=1; do
+	{ timeout 60 ./jbi tests/limits/bigdim.bas -nocache $mode -memory-limit 16 < /dev/null 2> "$tmp/err"; echo "exit $?"; } > "$tmp/out"
+	cmp -s tests/limits/bigdim.out "$tmp/out" && grep -q "^run error 39:" "$tmp/err" \
+		|| fail "tests/limits/bigdim.bas -memory-limit ${mode:-(default)}"
+done
+
+# Every script prints the same and exits with the same status with the
+# memory taken from an arena (-arena)
+for f in bas/*.bas tests/*.bas; do
+	input=tests/glider.txt
+	case $f in tests/*) input=/dev/null; [ -f "${f%.bas}.in" ] && input=${f%.bas}.in;; esac
+	{ timeout 60 ./jbi "$f" -nocache < "$input" 2> /dev/null; echo "exit $?"; } > "$tmp/expected"
+	{ timeout 60 ./jbi "$f" -nocache -arena < "$input" 2> /dev/null; echo "exit $?"; } > "$tmp/out"
+	cmp -s "$tmp/expected" "$tmp/out" || { fail "$f -arena"; diff "$tmp/expected" "$tmp/out" | head -5; }
+done
+
+# -profile doesn't change the output and prints the profile to stderr
+timeout 60 ./jbi bas/primes.bas -nocache > "$tmp/expected" 2> /dev/null
+timeout 60 ./jbi bas/primes.bas -nocache -profile > "$tmp/out" 2> "$tmp/err"
+cmp -s "$tmp/expected" "$tmp/out" && grep -q "^profile: [1-9][0-9]* instructions" "$tmp/err" \
+	&& grep -q "^ *9 .*ok = ok and (n % i)$" "$tmp/err" || fail "bas/primes.bas -profile"
+
+# -sample writes collapsed stacks with their sample counts into the file
+timeout 60 ./jbi bas/conway.bas -nocache < tests/glider.txt > "$tmp/expected" 2> /dev/null
+timeout 60 ./jbi bas/conway.bas -nocache -sample "$tmp/samples" < tests/glider.txt > "$tmp/out" 2> /dev/null
+cmp -s "$tmp/expected" "$tmp/out" && [ -s "$tmp/samples" ] && grep -q "^[0-9]*: while .* [1-9][0-9]*$" "$tmp/samples" \
+	|| fail "bas/conway.bas -sample"
+
+# -stats prints the environment's counters to stderr
+timeout 60 ./jbi bas/primes.bas -nocache > "$tmp/expected" 2> /dev/null
+timeout 60 ./jbi bas/primes.bas -nocache -stats > "$tmp/out" 2> "$tmp/err"
+cmp -s "$tmp/expected" "$tmp/out" && grep -q "^statements: *[1-9]" "$tmp/err" && grep -q "^tokens: *[1-9][0-9]* taken" "$tmp/err" \
+	|| fail "bas/primes.bas -stats"
+
+# Every script written to an image with -c and run from it prints the same
+# and exits with the same status as when it's run directly
+mkdir "$tmp/image"
+for f in bas/*.bas tests/*.bas; do
+	n=$(basename "$f" .bas)
+	input=tests/glider.txt
+	case $f in tests/*) input=/dev/null; [ -f "${f%.bas}.in" ] && input=${f%.bas}.in;; esac
+	if ! ./jbi "$f" -c "$tmp/image/$n.jbx" > /dev/null 2>&1; then
+		fail "jbi $f -c"
+		continue
+	fi
+	{ timeout 60 ./jbi "$f" -nocache < "$input" 2> /dev/null; echo "exit $?"; } > "$tmp/expected"
+	for mode in "" -jit=1; do
+		{ timeout 60 ./jbi "$tmp/image/$n.jbx" $mode < "$input" 2> /dev/null; echo "exit $?"; } > "$tmp/out"
+		cmp -s "$tmp/expected" "$tmp/out" || { fail "image of $f $mode"; diff "$tmp/expected" "$tmp/out" | head -5; }
+	done
+done
+
+# A truncated image is refused
+head -c 1000 "$tmp/image/bounds.jbx" > "$tmp/image/truncated.jbx"
+./jbi "$tmp/image/truncated.jbx" 2>&1 > /dev/null | grep -q "^image load error 32:" \
+	|| fail "truncated image"
+
+# The program cache in $XDG_CACHE_HOME: the first run writes an entry, the
+# second one runs from it, a changed script misses and -clear-cache empties it
+mkdir "$tmp/cache"
+cache_entries()
+{
+	ls "$tmp/cache/jbasic" 2> /dev/null | grep -c "\.jbx$"
+}
+
+# cache_run [JBI SWITCHES...] - runs $tmp/script.bas with the cache in $tmp/cache
+cache_run()
+{
+	{ XDG_CACHE_HOME="$tmp/cache" timeout 60 ./jbi "$tmp/script.bas" "$@" < /dev/null 2> "$tmp/err"; echo "exit $?"; } > "$tmp/out"
+}
+
+cp tests/cse.bas "$tmp/script.bas"
+cache_run; cmp -s tests/cse.out "$tmp/out" && [ "$(cache_entries)" = 1 ] || fail "cache: cold run"
+cache_run -debug; grep -q "^cache hit:" "$tmp/err" || fail "cache: warm run is not a hit"
+cache_run; cmp -s tests/cse.out "$tmp/out" || fail "cache: warm run"
+
+cp tests/bounds.bas "$tmp/script.bas"
+cache_run -debug; grep -q "^cache miss:" "$tmp/err" || fail "cache: changed script is not a miss"
+cache_run; cmp -s tests/bounds.out "$tmp/out" && [ "$(cache_entries)" = 2 ] || fail "cache: changed script"
+
+XDG_CACHE_HOME="$tmp/cache" ./jbi -clear-cache && [ "$(cache_entries)" = 0 ] || fail "cache: -clear-cache"
+cache_run -debug; grep -q "^cache miss:" "$tmp/err" || fail "cache: run after -clear-cache is not a miss"
+
+# Every script translated by jbc prints the same and exits with the same status as in jbi
+# (jbc doesn't support PARALLEL FOR)
+mkdir "$tmp/jbc"
+for f in bas/*.bas tests/*.bas; do
+	grep -q "PARALLEL" "$f" && continue
+	n=$(basename "$f" .bas)
+	input=tests/glider.txt
+	case $f in tests/*) input=/dev/null; [ -f "${f%.bas}.in" ] && input=${f%.bas}.in;; esac
+	if ! ./jbc "$f" -o "$tmp/jbc/$n.c" 2> /dev/null \
+		|| ! ${CC:-cc} -Iinclude -DJBAS_ERROR_REASONS -O1 -rdynamic -o "$tmp/jbc/$n" "$tmp/jbc/$n.c" \
+			-Wl,--whole-archive libjbasic.a -Wl,--no-whole-archive -lm -ldl -pthread; then
+		fail "jbc $f"
+		continue
+	fi
+	{ timeout 60 ./jbi "$f" -nocache < "$input" 2> /dev/null; echo "exit $?"; } > "$tmp/expected"
+	{ timeout 60 "$tmp/jbc/$n" < "$input" 2> /dev/null; echo "exit $?"; } > "$tmp/out"
+	cmp -s "$tmp/expected" "$tmp/out" || { fail "jbc $f"; diff "$tmp/expected" "$tmp/out" | head -5; }
+done
+
+# jbs and jbs-fixed (Q16.16 floats) run the scripts that don't need JBASLIB
+for f in tests/*.bas; do
+	grep -q "FOPEN\|FREAD\|FWRITE\|FCLOSE" "$f" && continue
+	for jbs in jbs jbs-fixed; do
+		{ timeout 60 ./$jbs "$f" < /dev/null 2> /dev/null; echo "exit $?"; } > "$tmp/out"
+		cmp -s "${f%.bas}.out" "$tmp/out" || fail "$jbs $f"
+	done
+done
+
+# jbs prints the same as jbi for every script in bas/
+for f in bas/*.bas; do
+	timeout 60 ./jbi "$f" -nocache < tests/glider.txt > "$tmp/expected" 2>&1
+	timeout 60 ./jbs "$f" < tests/glider.txt > "$tmp/out" 2>&1
+	cmp -s "$tmp/expected" "$tmp/out" || fail "jbs $f"
+done
+
+# Fixed point overflow and division by zero saturate, literals out of the range are refused
+for f in tests/fixed/*.bas; do
+	{ timeout 60 ./jbs-fixed "$f" < /dev/null 2>&1; echo "exit $?"; } > "$tmp/out"
+	cmp -s "${f%.bas}.out" "$tmp/out" || { fail "jbs-fixed $f"; diff "${f%.bas}.out" "$tmp/out" | head -5; }
+done
+
+./tests/threads 4 tests/glider.txt tests/*.bas bas/conway.bas bas/primes.bas bas/simple.bas || fail "tests/threads"
+./tests/exec 4 50 tests/glider.txt tests/*.bas bas/primes.bas bas/simple.bas || fail "tests/exec"
+./tests/reset 20 tests/glider.txt tests/*.bas bas/primes.bas bas/simple.bas || fail "tests/reset"
+
+./tests/pipes || fail "tests/pipes"
+./tests/pipes 1 || fail "tests/pipes 1"
+
+[ $failed = 0 ] && echo "all tests passed" || echo "$failed failed"
+[ $failed = 0 ]
@@ -0,0 +1,77 @@
+# dense, sparse, ranges, dynamic labels, float selector, nesting
+i = 0
+while i < 12
+	select i
+	case 0
+		print "zero "
+	case 1, 2
+		print "one-two "
+	case 3 TO 5
+		print "three-five "
+	case 4
+		print "never "
+	case 7
+		select i * 10
+		case 70
+			print "seventy "
+		case else
+			print "bad "
+		end
+	case else
+		print "other "; print i; print " "
+	end
+	i = i + 1
+end
+println ""
+k = 500
+j = -3
+while j < 4
+	select j * 1000
+	case -3000
+		print "a "
+	case 1000 TO 1999, 50000
+		print "b "
+	case -1000
+		print "c "
+	case 3000
+		print "d "
+	end
+	j = j + 1
+end
+println ""
+x = 5
+select 6
+case x + 1
+	println "dynamic six"
+case 6
+	println "never"
+end
+select 6
+case 6
+	println "const six"
+case x + 1
+	println "never"
+end
+select 2.5
+case 1 TO 2
+	println "never"
+case 2 TO 3
+	println "float in range"
+end
+if 1 > 2
+	select 1
+	case 1
+		println "no"
+	case else
+		println "no"
+	end
+else
+	println "if else ok"
+end
+if 1 < 2
+	while 0
+	end
+else
+	println "wrong"
+end
+println "done"
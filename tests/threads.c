@@ -0,0 +1,127 @@
+#include <jbasic/jbasic.h>
+#include <jbasic/opt.h>
+#include <jbasic/infer.h>
+#include "common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/*
+	Runs the scripts on one environment per thread, all at the same time,
+	and checks that every output (and status) is the same as the one of
+	a serial run. Every other round uses the JIT. All the scripts read
+	INPUT and get the C functions of JBASLIB.
+
+	Usage: threads ROUNDS INPUT SCRIPT...
+*/
+
+static const char *input;
+static size_t input_size;
+static const jbas_cres *cres;
+static int cres_count;
+
+typedef struct job
+{
+	const char *source;
+	int jit;
+	char *output;
+	size_t size;
+	pthread_t thread;
+} job;
+
+/**
+	Tokenizes, optimizes and runs the script in its own environment
+*/
+static void *run(void *arg)
+{
+	job *j = arg;
+	jbas_env env;
+	jbas_error err = jbas_env_init(&env, 100000, 10000, 10000, 10000, 10000);
+	env.jit_threshold = j->jit;
+	env.input = fmemopen((void*) input, input_size, "r");
+	env.output = open_memstream(&j->output, &j->size);
+
+	if (!err && cres) err = jbas_symbol_import(&env, cres, cres_count);
+	if (!err) err = jbas_tokenize_string(&env, j->source);
+	if (!err) err = jbas_optimize(&env, JBAS_OPT_ALL, NULL);
+	if (!err) err = jbas_infer_types(&env);
+	if (!err) err = jbas_run(&env);
+
+	fprintf(env.output, "status %d\n", err);
+	fclose(env.output);
+	fclose(env.input);
+	jbas_env_destroy(&env);
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	int rounds = argc > 3 ? atoi(argv[1]) : 0;
+	if (rounds <= 0)
+	{
+		fprintf(stderr, "Usage: %s ROUNDS INPUT SCRIPT...\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	cres_count = test_load_lib(&cres);
+
+	if (!(input = test_read_file(argv[2])))
+	{
+		perror(argv[2]);
+		return EXIT_FAILURE;
+	}
+	input_size = strlen(input);
+
+	int script_count = argc - 3;
+	int count = rounds * script_count;
+	char **sources = calloc(script_count, sizeof(char*));
+	job *serial = calloc(count, sizeof(job));
+	job *parallel = calloc(count, sizeof(job));
+	if (!sources || !serial || !parallel)
+	{
+		perror("threads");
+		return EXIT_FAILURE;
+	}
+
+	for (int i = 0; i < script_count; i++)
+		if (!(sources[i] = test_read_file(argv[i + 3])))
+		{
+			perror(argv[i + 3]);
+			return EXIT_FAILURE;
+		}
+
+	for (int i = 0; i < count; i++)
+	{
+		serial[i] = parallel[i] = (job){.source = sources[i % script_count], .jit = (i / script_count) % 2};
+		run(&serial[i]);
+	}
+
+	for (int i = 0; i < count; i++)
+		if (pthread_create(&parallel[i].thread, NULL, run, &parallel[i]))
+		{
+			perror("could not start a thread");
+			return EXIT_FAILURE;
+		}
+
+	int failed = 0;
+	for (int i = 0; i < count; i++)
+	{
+		pthread_join(parallel[i].thread, NULL);
+		if (serial[i].size != parallel[i].size || memcmp(serial[i].output, parallel[i].output, serial[i].size))
+		{
+			fprintf(stderr, "threads: %s differs when run on %d threads\n", argv[i % script_count + 3], count);
+			failed++;
+		}
+		free(serial[i].output);
+		free(parallel[i].output);
+	}
+
+	for (int i = 0; i < script_count; i++)
+		free(sources[i]);
+	free(sources);
+	free((void*) input);
+	free(serial);
+	free(parallel);
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
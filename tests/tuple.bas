@@ -0,0 +1,8 @@
+# Tuple parts must not be hoisted or strength-reduced
+k = 0
+while k < 2
+	(p, q) = (k, k * 2)
+	s = p + q
+	println s
+	k = k + 1
+end
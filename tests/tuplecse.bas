@@ -0,0 +1,9 @@
+# Common subexpressions are not shared between the parts of a tuple
+k = 0
+w = 3
+while k < 2
+	(p, q) = (k * 2, k * 2 + w * 4)
+	println p
+	println q
+	k = k + 1
+end
@@ -0,0 +1,7 @@
+i = 0
+while i < 3
+	if i == 2
+		x = q * 2 + 1
+	end
+	i = i + 1
+end